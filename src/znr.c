@@ -20,6 +20,7 @@ struct znr znr;
 void znr_init(void)
 {
 	memset(&znr, 0, sizeof(znr));
+	znr.net_features = ZNR_NET_FEATURES;
 }
 
 void znr_close(void)
@@ -35,6 +36,16 @@ int znr_open(const char *mntdir)
 	unsigned int i;
 	int ret;
 
+	/*
+	 * Start the server session before getting the zone information so
+	 * that changes made meanwhile are seen when resuming the session.
+	 */
+	if (znr.is_net_client) {
+		ret = znr_net_resume(&znr.ncli, NULL);
+		if (ret && ret != -EOPNOTSUPP)
+			return ret;
+	}
+
 	/* Open the mount directory to get the device name. */
 	ret = znr_fs_open(mntdir);
 	if (ret)
@@ -110,6 +121,58 @@ err:
 	return ret;
 }
 
+/*
+ * Apply the state changes received when reconnecting to the server.
+ */
+int znr_resync(struct znr_net_resync *rs)
+{
+	unsigned int i, zno;
+	int ret = 0;
+
+	if (rs->znos) {
+		for (i = 0; i < rs->nr_zones; i++) {
+			zno = rs->znos[i];
+			if (zno >= znr.nr_zones) {
+				ret = -EINVAL;
+				goto free;
+			}
+			znr.blk_zones[zno] = rs->zones[i];
+		}
+	} else if (rs->nr_zones) {
+		if (rs->nr_zones != znr.nr_zones) {
+			ret = -EINVAL;
+			goto free;
+		}
+		memcpy(znr.blk_zones, rs->zones,
+		       rs->nr_zones * sizeof(struct blk_zone));
+	}
+
+	if (rs->blockgroups) {
+		if (rs->nr_blockgroups != znr.nr_blockgroups) {
+			ret = -EINVAL;
+			goto free;
+		}
+
+		for (i = 0; i < znr.nr_blockgroups; i++) {
+			znr.blockgroups[i].sector = rs->blockgroups[i].sector;
+			znr.blockgroups[i].nr_sectors =
+				rs->blockgroups[i].nr_sectors;
+		}
+	}
+
+	/* Update the blockgroups write pointers */
+	if (znr.dev.is_zoned)
+		ret = znr_bg_map_zones_to_blockgroups(znr.blockgroups,
+						      znr.nr_blockgroups,
+						      znr.blk_zones,
+						      znr.nr_zones);
+
+free:
+	znr_net_free_resync(rs);
+
+	return ret;
+}
+
 void znr_print_info(void)
 {
 	printf("Mount directory %s: %s on device %s\n",
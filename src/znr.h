@@ -10,6 +10,15 @@
 #include "znr_fs.h"
 #include "znr_net.h"
 #include "znr_bg.h"
+#include "znr_cache.h"
+#include "znr_shm.h"
+#include "znr_batch.h"
+#include "znr_fleet.h"
+#include "znr_session.h"
+#include "znr_budget.h"
+#include "znr_sched.h"
+#include "znr_query.h"
+#include "znr_http.h"
 
 /*
  * Main data structure to share FS and device information.
@@ -24,10 +33,22 @@ struct znr {
 	bool			listen;
 	char			*ipaddr;
 	int			port;
+	char			*unix_path;
 	int			listen_sd;
 	int			listen_port;
 	struct znr_net_client	ncli;
 
+	/*
+	 * Protocol features offered to the peer with ZNR_NET_HELLO.
+	 */
+	unsigned int		net_features;
+
+	/*
+	 * Server zone report and extents cache freshness window.
+	 */
+	unsigned int		cache_ms;
+	unsigned int		shm_ms;
+
 	/*
 	 * Mount directory & file system.
 	 */
@@ -57,6 +78,7 @@ extern struct znr znr;
 void znr_init(void);
 int znr_open(const char *mntdir);
 void znr_close(void);
+int znr_resync(struct znr_net_resync *rs);
 void znr_print_info(void);
 
 int znr_gui_run(void);
@@ -0,0 +1,360 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "znr.h"
+
+/*
+ * Find a previous sub-request identical to reqs[idx] that succeeded.
+ */
+static struct znr_batch_req *znr_batch_find_same(struct znr_batch_req *reqs,
+						 unsigned int idx)
+{
+	struct znr_batch_req *req = &reqs[idx];
+	unsigned int i;
+
+	for (i = 0; i < idx; i++) {
+		if (reqs[i].type != req->type || reqs[i].err)
+			continue;
+		if (req->path) {
+			if (reqs[i].path && strcmp(reqs[i].path, req->path) == 0)
+				return &reqs[i];
+			continue;
+		}
+		if (!reqs[i].path && reqs[i].start == req->start &&
+		    reqs[i].len == req->len)
+			return &reqs[i];
+	}
+
+	return NULL;
+}
+
+static int znr_batch_copy_result(struct znr_batch_req *req,
+				 struct znr_batch_req *same)
+{
+	req->nr = same->nr;
+	if (!same->nr)
+		return 0;
+
+	if (same->zones) {
+		req->zones = malloc(same->nr * sizeof(struct blk_zone));
+		if (!req->zones)
+			return ENOMEM;
+		memcpy(req->zones, same->zones,
+		       same->nr * sizeof(struct blk_zone));
+	} else {
+		req->extents = malloc(same->nr * sizeof(struct znr_extent));
+		if (!req->extents)
+			return ENOMEM;
+		memcpy(req->extents, same->extents,
+		       same->nr * sizeof(struct znr_extent));
+	}
+
+	return 0;
+}
+
+/*
+ * Extents of the inode number extents sub-requests of a batch, collected with
+ * a single walk of the extents of all blockgroups.
+ */
+struct znr_batch_ino_walk {
+	struct znr_batch_req	*reqs;
+	unsigned int		nr_reqs;
+	struct znr_fs_extents	fe[ZNR_BATCH_MAX_REQS];
+};
+
+/*
+ * Extent walk callback adding the extents of a batch of extents to the inode
+ * number extents sub-requests of their owner.
+ */
+static int znr_batch_ino_extents(struct znr_extent *extents,
+				 unsigned int nr_extents, void *data)
+{
+	struct znr_batch_ino_walk *w = data;
+	struct znr_batch_req *req;
+	unsigned int i, j;
+	int ret;
+
+	for (i = 0; i < nr_extents; i++) {
+		for (j = 0; j < w->nr_reqs; j++) {
+			req = &w->reqs[j];
+			if (req->type != ZNR_BATCH_INO_EXTENTS ||
+			    req->start != extents[i].ino)
+				continue;
+			ret = znr_fs_collect_extents(&extents[i], 1, &w->fe[j]);
+			if (ret)
+				return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Execute all the inode number extents sub-requests with a single walk of the
+ * FSMAP extents of all blockgroups, keeping the extents owned by the requested
+ * inodes. Blockgroups are walked one by one as the extents of a range must be
+ * on a single device of the file system.
+ */
+static void znr_batch_exec_ino(struct znr_batch_req *reqs,
+			       unsigned int nr_reqs)
+{
+	struct znr_batch_ino_walk *w;
+	struct znr_batch_req *req;
+	unsigned int i, j;
+	int ret = 0;
+
+	for (i = 0; i < nr_reqs; i++) {
+		if (reqs[i].type == ZNR_BATCH_INO_EXTENTS)
+			break;
+	}
+	if (i == nr_reqs)
+		return;
+
+	w = calloc(1, sizeof(*w));
+	if (!w) {
+		ret = -ENOMEM;
+	} else {
+		w->reqs = reqs;
+		w->nr_reqs = nr_reqs;
+		for (i = 0; i < znr.nr_blockgroups; i++) {
+			ret = znr_cache_walk_extents_in_range(
+					znr.blockgroups[i].sector,
+					znr.blockgroups[i].nr_sectors,
+					ZNR_FS_EXTENTS_BATCH,
+					znr_batch_ino_extents, w);
+			if (ret)
+				break;
+		}
+	}
+
+	for (i = 0; i < nr_reqs; i++) {
+		req = &reqs[i];
+		if (req->type != ZNR_BATCH_INO_EXTENTS)
+			continue;
+		if (ret < 0) {
+			req->err = -ret;
+			if (w)
+				free(w->fe[i].extents);
+			continue;
+		}
+
+		req->extents = w->fe[i].extents;
+		req->nr = w->fe[i].nr_extents;
+		for (j = 0; j < req->nr; j++)
+			req->extents[j].idx = j;
+	}
+
+	free(w);
+}
+
+static int znr_batch_exec_req(struct znr_batch_req *req)
+{
+	struct znr_fs_file *f = NULL;
+	unsigned long long start;
+	int ret;
+
+	switch (req->type) {
+	case ZNR_BATCH_ZONES:
+		if (req->start >= znr.dev.nr_zones || !req->len ||
+		    req->len > znr.dev.nr_zones - req->start)
+			return EINVAL;
+		req->zones = malloc(req->len * sizeof(struct blk_zone));
+		if (!req->zones)
+			return ENOMEM;
+		ret = znr_cache_report_zones(req->start, req->len, req->zones);
+		if (ret >= 0 && (unsigned long long)ret != req->len)
+			ret = -EIO;
+		if (ret < 0) {
+			free(req->zones);
+			req->zones = NULL;
+			break;
+		}
+		req->nr = req->len;
+		ret = 0;
+		break;
+	case ZNR_BATCH_EXTENTS_IN_RANGE:
+		if (!req->len || req->start >= znr.dev.nr_sectors ||
+		    req->len > znr.dev.nr_sectors - req->start)
+			return EINVAL;
+		ret = znr_cache_get_extents_in_range(req->start, req->len,
+						     &req->extents, &req->nr);
+		break;
+	case ZNR_BATCH_FILE_EXTENTS:
+		if (!req->path || !strlen(req->path))
+			return EINVAL;
+		znr_budget_take();
+		ret = znr_sched_get();
+		if (ret)
+			break;
+		start = znr_stats_now_ns();
+		ret = znr_fs_get_file_extents_by_path(req->path, &f,
+						      &req->extents, &req->nr);
+		znr_budget_account_io(start);
+		znr_sched_put();
+		znr_fs_free_file(f);
+		break;
+	default:
+		return EINVAL;
+	}
+
+	return ret < 0 ? -ret : 0;
+}
+
+/*
+ * Execute a batch locally. Inode number extents are served from one walk of
+ * the extents, and sub-requests identical to a previous one reuse its result.
+ */
+void znr_batch_exec_local(struct znr_batch_req *reqs, unsigned int nr_reqs)
+{
+	struct znr_batch_req *req, *same;
+	unsigned int i;
+
+	for (i = 0; i < nr_reqs; i++) {
+		reqs[i].err = 0;
+		reqs[i].zones = NULL;
+		reqs[i].extents = NULL;
+		reqs[i].nr = 0;
+	}
+
+	znr_batch_exec_ino(reqs, nr_reqs);
+
+	for (i = 0; i < nr_reqs; i++) {
+		req = &reqs[i];
+		if (req->type == ZNR_BATCH_INO_EXTENTS)
+			continue;
+
+		same = znr_batch_find_same(reqs, i);
+		if (same)
+			req->err = znr_batch_copy_result(req, same);
+		else
+			req->err = znr_batch_exec_req(req);
+	}
+}
+
+/*
+ * Execute the sub-requests of a batch one by one, for servers not supporting
+ * ZNR_NET_BATCH.
+ */
+static void znr_batch_exec_each(struct znr_batch_req *reqs,
+				unsigned int nr_reqs)
+{
+	struct znr_batch_req *req;
+	struct znr_fs_file *f = NULL;
+	unsigned int i;
+	int ret;
+
+	for (i = 0; i < nr_reqs; i++) {
+		req = &reqs[i];
+		req->zones = NULL;
+		req->extents = NULL;
+		req->nr = 0;
+
+		switch (req->type) {
+		case ZNR_BATCH_ZONES:
+			if (req->start >= znr.dev.nr_zones || !req->len ||
+			    req->len > znr.dev.nr_zones - req->start) {
+				ret = -EINVAL;
+				break;
+			}
+			req->zones = malloc(req->len * sizeof(struct blk_zone));
+			if (!req->zones) {
+				ret = -ENOMEM;
+				break;
+			}
+			ret = znr_dev_report_zones(&znr.dev, req->start,
+						   req->zones, req->len);
+			if (ret >= 0) {
+				req->nr = ret;
+				ret = 0;
+			}
+			break;
+		case ZNR_BATCH_EXTENTS_IN_RANGE:
+			ret = znr_fs_get_extents_in_range(req->start, req->len,
+							  &req->extents,
+							  &req->nr);
+			break;
+		case ZNR_BATCH_FILE_EXTENTS:
+			ret = znr_fs_get_file_extents_by_path(req->path, &f,
+							&req->extents, &req->nr);
+			znr_fs_free_file(f);
+			f = NULL;
+			break;
+		case ZNR_BATCH_INO_EXTENTS:
+			ret = znr_fs_get_file_extents_by_ino(req->start, &f,
+							&req->extents, &req->nr);
+			znr_fs_free_file(f);
+			f = NULL;
+			break;
+		default:
+			ret = -EINVAL;
+			break;
+		}
+
+		req->err = 0;
+		if (ret < 0) {
+			req->err = -ret;
+			free(req->zones);
+			req->zones = NULL;
+			req->nr = 0;
+		}
+	}
+}
+
+/*
+ * Execute a batch of sub-requests, using a single ZNR_NET_BATCH request for
+ * clients of a server supporting it. Return 0 if the batch was executed, with
+ * the result of each sub-request in its err field, and a negative error code
+ * otherwise.
+ */
+int znr_batch_exec(struct znr_batch_req *reqs, unsigned int nr_reqs)
+{
+	if (!nr_reqs || nr_reqs > ZNR_BATCH_MAX_REQS)
+		return -EINVAL;
+
+	if (!znr.is_net_client) {
+		znr_batch_exec_local(reqs, nr_reqs);
+		return 0;
+	}
+
+	if (znr.ncli.features & ZNR_NET_FEAT_BATCH)
+		return znr_net_batch(&znr.ncli, reqs, nr_reqs);
+
+	znr_batch_exec_each(reqs, nr_reqs);
+
+	return 0;
+}
+
+void znr_batch_clear(struct znr_batch_req *reqs, unsigned int nr_reqs)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_reqs; i++) {
+		free(reqs[i].zones);
+		reqs[i].zones = NULL;
+		free(reqs[i].extents);
+		reqs[i].extents = NULL;
+		reqs[i].nr = 0;
+	}
+}
+
+const char *znr_batch_type_name(enum znr_batch_type type)
+{
+	switch (type) {
+	case ZNR_BATCH_ZONES:
+		return "zones";
+	case ZNR_BATCH_EXTENTS_IN_RANGE:
+		return "extents in range";
+	case ZNR_BATCH_FILE_EXTENTS:
+		return "file extents";
+	case ZNR_BATCH_INO_EXTENTS:
+		return "inode extents";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#ifndef ZNR_BATCH_H
+#define ZNR_BATCH_H
+
+#include "config.h"
+#include "znr_device.h"
+#include "znr_fs.h"
+
+/*
+ * Maximum number of sub-requests of a batch.
+ */
+#define ZNR_BATCH_MAX_REQS	64
+
+enum znr_batch_type {
+	/* Zone report: start zone number and number of zones */
+	ZNR_BATCH_ZONES = 1,
+
+	/* Extents in a range: start sector and number of sectors */
+	ZNR_BATCH_EXTENTS_IN_RANGE,
+
+	/* File extents, by file path */
+	ZNR_BATCH_FILE_EXTENTS,
+
+	/* File extents, by inode number (start) */
+	ZNR_BATCH_INO_EXTENTS,
+};
+
+/*
+ * Batch sub-request. The results are set by znr_batch_exec() and must be
+ * freed with znr_batch_clear().
+ */
+struct znr_batch_req {
+	enum znr_batch_type	type;
+	unsigned long long	start;
+	unsigned long long	len;
+	char			*path;
+
+	/* Result: positive errno code, or zones or extents */
+	int			err;
+	struct blk_zone		*zones;
+	struct znr_extent	*extents;
+	unsigned int		nr;
+};
+
+int znr_batch_exec(struct znr_batch_req *reqs, unsigned int nr_reqs);
+void znr_batch_exec_local(struct znr_batch_req *reqs, unsigned int nr_reqs);
+void znr_batch_clear(struct znr_batch_req *reqs, unsigned int nr_reqs);
+const char *znr_batch_type_name(enum znr_batch_type type);
+
+#endif /* ZNR_BATCH_H */
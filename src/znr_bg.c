@@ -20,10 +20,10 @@ int znr_bg_get_blockgroups(struct znr_bg **blockgroups,
 	return znr_fs_get_blockgroups(blockgroups, nr_blockgroups);
 }
 
-static int znr_bg_map_zones_to_blockgroups(struct znr_bg *blockgroups,
-					   unsigned int nr_blockgroups,
-					   struct blk_zone *zones,
-					   unsigned int nr_zones)
+int znr_bg_map_zones_to_blockgroups(struct znr_bg *blockgroups,
+				    unsigned int nr_blockgroups,
+				    struct blk_zone *zones,
+				    unsigned int nr_zones)
 {
 	unsigned long bg_sector_end, zone_sector_end;
 	unsigned int bg_zone_idx, j, i, zone_start_idx = 0;
@@ -132,13 +132,48 @@ static int znr_bg_to_zno(struct znr_device *dev,
 	return 0;
 }
 
+/*
+ * Get the range of zones [*zno, *zno + *nr_zones) used by a set of
+ * blockgroups.
+ */
+int znr_bg_get_zone_range(struct znr_device *dev, struct znr_bg *blockgroups,
+			  unsigned int nr_blockgroups,
+			  unsigned int *zno, unsigned int *nr_zones)
+{
+	unsigned int last_zone_no;
+	unsigned long max_sector;
+	int ret;
+
+	if (!blockgroups || !nr_blockgroups)
+		return -EINVAL;
+
+	/* The last sector in this set of blockgroups */
+	max_sector = blockgroups[nr_blockgroups - 1].sector +
+		     blockgroups[nr_blockgroups - 1].nr_sectors;
+	if (max_sector > dev->nr_sectors) {
+		fprintf(stderr, "Sector out of bounds: sector: %ld | max: %lld\n",
+			max_sector, dev->nr_sectors);
+		return -EINVAL;
+	}
+
+	ret = znr_bg_to_zno(dev, blockgroups, &blockgroups[nr_blockgroups - 1],
+			    zno, &last_zone_no);
+	if (ret)
+		return ret;
+
+	*nr_zones = last_zone_no - *zno;
+	if (!*nr_zones)
+		return -EINVAL;
+
+	return 0;
+}
+
 static int znr_bg_report(struct znr_device *dev, struct blk_zone *zones,
 			 unsigned int max_zones, struct znr_bg *blockgroups,
 			 unsigned int blockgroup_no,
 			 unsigned int nr_blockgroups)
 {
-	unsigned int last_zone_no, start_zone_no, nr_zones, i;
-	unsigned long max_sector;
+	unsigned int start_zone_no, nr_zones, i;
 	int ret;
 
 	if (!blockgroups || !nr_blockgroups ||
@@ -162,22 +197,12 @@ static int znr_bg_report(struct znr_device *dev, struct blk_zone *zones,
 	znr_verbose("Do blockgroup reports from group %u, %u groups\n",
 		    blockgroup_no, nr_blockgroups);
 
-	/* The last sector in this set of blockgroups */
-	max_sector = blockgroups[nr_blockgroups - 1].sector +
-		     blockgroups[nr_blockgroups - 1].nr_sectors;
-	if (max_sector > dev->nr_sectors) {
-		fprintf(stderr, "Sector out of bounds: sector: %ld | max: %lld\n",
-			max_sector, dev->nr_sectors);
-		return -EINVAL;
-	}
-
-	ret = znr_bg_to_zno(dev, blockgroups, &blockgroups[nr_blockgroups - 1],
-			    &start_zone_no, &last_zone_no);
+	ret = znr_bg_get_zone_range(dev, blockgroups, nr_blockgroups,
+				    &start_zone_no, &nr_zones);
 	if (ret)
 		return ret;
 
-	nr_zones = last_zone_no - start_zone_no;
-	if (!nr_zones || nr_zones > max_zones)
+	if (nr_zones > max_zones)
 		return -EINVAL;
 
 	/* Do zone report */
@@ -34,4 +34,12 @@ int znr_bg_refresh(struct znr_device *dev, struct blk_zone *zones,
 		   unsigned int max_zones, struct znr_bg *blockgroups,
 		   unsigned int blockgroup_num, unsigned int nr_blockgroups);
 
+int znr_bg_get_zone_range(struct znr_device *dev, struct znr_bg *blockgroups,
+			  unsigned int nr_blockgroups,
+			  unsigned int *zno, unsigned int *nr_zones);
+int znr_bg_map_zones_to_blockgroups(struct znr_bg *blockgroups,
+				    unsigned int nr_blockgroups,
+				    struct blk_zone *zones,
+				    unsigned int nr_zones);
+
 #endif /* ZNR_BG_H */
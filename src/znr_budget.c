@@ -0,0 +1,324 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+
+#include "znr.h"
+
+/*
+ * I/O priority definitions, from linux/ioprio.h which older kernel headers
+ * do not have.
+ */
+#ifndef IOPRIO_CLASS_IDLE
+#define IOPRIO_CLASS_IDLE	3
+#endif
+#ifndef IOPRIO_WHO_PROCESS
+#define IOPRIO_WHO_PROCESS	1
+#endif
+#ifndef IOPRIO_CLASS_SHIFT
+#define IOPRIO_CLASS_SHIFT	13
+#endif
+
+static struct znr_budget {
+	pthread_mutex_t		lock;
+
+	/* Token bucket: rate per second and tokens available. */
+	unsigned int		rate;
+	double			tokens;
+	unsigned long long	last_ns;
+
+	struct znr_budget_stats	stats;
+} znrb = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*
+ * Set for the server poller threads.
+ */
+static __thread bool znr_budget_poller;
+
+/*
+ * Use the idle I/O priority class for the calling thread and all threads it
+ * creates afterwards: the device is accessed only when no other process
+ * needs it.
+ */
+int znr_budget_set_idle_ioprio(void)
+{
+	int ret;
+
+	ret = syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+		      IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+	if (ret) {
+		ret = -errno;
+		znr_err("Set idle I/O priority failed (%s)\n",
+			strerror(errno));
+		return ret;
+	}
+
+	znr_verbose("Using idle I/O priority class\n");
+
+	return 0;
+}
+
+/*
+ * Run the calling thread and all threads it creates afterwards on the CPUs of
+ * the list @cpus, e.g. "0-3,6".
+ */
+int znr_budget_set_cpus(const char *cpus)
+{
+	unsigned long first, last, cpu;
+	const char *p = cpus;
+	cpu_set_t set;
+	char *end;
+
+	CPU_ZERO(&set);
+
+	while (*p) {
+		first = strtoul(p, &end, 10);
+		if (end == p)
+			goto invalid;
+		last = first;
+		if (*end == '-') {
+			p = end + 1;
+			last = strtoul(p, &end, 10);
+			if (end == p)
+				goto invalid;
+		}
+		if (first > last || last >= CPU_SETSIZE)
+			goto invalid;
+
+		for (cpu = first; cpu <= last; cpu++)
+			CPU_SET(cpu, &set);
+
+		if (*end == ',')
+			end++;
+		else if (*end)
+			goto invalid;
+		p = end;
+	}
+
+	if (!CPU_COUNT(&set))
+		goto invalid;
+
+	if (sched_setaffinity(0, sizeof(set), &set)) {
+		znr_err("Set CPU affinity to %s failed (%s)\n",
+			cpus, strerror(errno));
+		return -errno;
+	}
+
+	znr_verbose("Running on CPUs %s\n", cpus);
+
+	return 0;
+
+invalid:
+	znr_err("Invalid CPU list %s\n", cpus);
+	return -EINVAL;
+}
+
+/*
+ * Limit the zone report and FSMAP ioctls to @rate per second, 0 for no limit.
+ */
+void znr_budget_init(unsigned int rate)
+{
+	pthread_mutex_lock(&znrb.lock);
+	znrb.rate = rate;
+	znrb.tokens = rate;
+	znrb.last_ns = znr_stats_now_ns();
+	memset(&znrb.stats, 0, sizeof(znrb.stats));
+	pthread_mutex_unlock(&znrb.lock);
+
+	if (rate)
+		znr_verbose("Ioctl rate limited to %u / s\n", rate);
+}
+
+bool znr_budget_enabled(void)
+{
+	return znrb.rate > 0;
+}
+
+/*
+ * Mark the calling thread as a poller: it can take a token only while the
+ * bucket is more than half full.
+ */
+void znr_budget_set_poller(void)
+{
+	znr_budget_poller = true;
+}
+
+static void znr_budget_refill(unsigned long long now)
+{
+	znrb.tokens += (double)(now - znrb.last_ns) * znrb.rate / 1e9;
+	if (znrb.tokens > znrb.rate)
+		znrb.tokens = znrb.rate;
+	znrb.last_ns = now;
+}
+
+/*
+ * Tokens needed in the bucket for the calling thread to take one. The bucket
+ * never holds more than rate tokens: with low rates, pollers wait for a full
+ * bucket.
+ */
+static double znr_budget_threshold(void)
+{
+	double threshold = 1.0;
+
+	if (znr_budget_poller) {
+		threshold += znrb.rate / 2.0;
+		if (threshold > znrb.rate)
+			threshold = znrb.rate;
+	}
+
+	return threshold;
+}
+
+/*
+ * Take a token if one is available. Always succeeds without a rate limit.
+ */
+bool znr_budget_try_take(void)
+{
+	bool taken = true;
+
+	if (!znr_budget_enabled())
+		return true;
+
+	pthread_mutex_lock(&znrb.lock);
+	znr_budget_refill(znr_stats_now_ns());
+	if (znrb.tokens >= znr_budget_threshold())
+		znrb.tokens -= 1.0;
+	else
+		taken = false;
+	pthread_mutex_unlock(&znrb.lock);
+
+	return taken;
+}
+
+/*
+ * Take a token, waiting for one if none is available.
+ */
+void znr_budget_take(void)
+{
+	unsigned long long start, now, wait_ns;
+	double threshold = znr_budget_threshold();
+	struct timespec ts;
+	bool waited = false;
+
+	if (!znr_budget_enabled())
+		return;
+
+	start = znr_stats_now_ns();
+
+	pthread_mutex_lock(&znrb.lock);
+
+	for (;;) {
+		now = znr_stats_now_ns();
+		znr_budget_refill(now);
+		if (znrb.tokens >= threshold)
+			break;
+
+		wait_ns = (threshold - znrb.tokens) * 1e9 / znrb.rate + 1;
+		pthread_mutex_unlock(&znrb.lock);
+
+		ts.tv_sec = wait_ns / 1000000000ULL;
+		ts.tv_nsec = wait_ns % 1000000000ULL;
+		nanosleep(&ts, NULL);
+
+		pthread_mutex_lock(&znrb.lock);
+		waited = true;
+	}
+
+	znrb.tokens -= 1.0;
+	if (waited) {
+		znrb.stats.delayed++;
+		znrb.stats.delay_ns += now - start;
+	}
+
+	pthread_mutex_unlock(&znrb.lock);
+}
+
+/*
+ * Take a token for the next ioctl of a zone report or FSMAP walk, the token of
+ * the first one having been taken before the walk started. The device is
+ * released while waiting for a token. Return -ECANCELED if the request
+ * executed by the calling thread was cancelled while waiting.
+ */
+int znr_budget_take_next(void)
+{
+	if (znr_budget_try_take())
+		return 0;
+
+	if (!znr_sched_held()) {
+		znr_budget_take();
+		return 0;
+	}
+
+	znr_sched_put();
+	znr_budget_take();
+
+	return znr_sched_get();
+}
+
+/*
+ * Account a zone report or FSMAP ioctl.
+ */
+void znr_budget_account_ioctl(void)
+{
+	pthread_mutex_lock(&znrb.lock);
+	znrb.stats.ioctls++;
+	pthread_mutex_unlock(&znrb.lock);
+}
+
+/*
+ * Account a device request started at @start_ns.
+ */
+void znr_budget_account_io(unsigned long long start_ns)
+{
+	unsigned long long ns = znr_stats_now_ns() - start_ns;
+
+	pthread_mutex_lock(&znrb.lock);
+	znrb.stats.requests++;
+	znrb.stats.io_ns += ns;
+	pthread_mutex_unlock(&znrb.lock);
+}
+
+void znr_budget_get_stats(struct znr_budget_stats *stats)
+{
+	struct rusage ru;
+
+	pthread_mutex_lock(&znrb.lock);
+	memcpy(stats, &znrb.stats, sizeof(*stats));
+	pthread_mutex_unlock(&znrb.lock);
+
+	if (getrusage(RUSAGE_SELF, &ru))
+		return;
+
+	stats->utime_us = (unsigned long long)ru.ru_utime.tv_sec * 1000000ULL +
+		ru.ru_utime.tv_usec;
+	stats->stime_us = (unsigned long long)ru.ru_stime.tv_sec * 1000000ULL +
+		ru.ru_stime.tv_usec;
+	stats->inblock = ru.ru_inblock;
+}
+
+void znr_budget_print_stats(void)
+{
+	struct znr_budget_stats st;
+
+	znr_budget_get_stats(&st);
+
+	printf("Resources: %llu requests (%llu ioctls) in %llu ms, "
+	       "%llu delayed for %llu ms, "
+	       "CPU %llu ms user %llu ms system, %llu blocks read\n",
+	       st.requests, st.ioctls, st.io_ns / 1000000ULL,
+	       st.delayed, st.delay_ns / 1000000ULL,
+	       st.utime_us / 1000ULL, st.stime_us / 1000ULL,
+	       st.inblock);
+}
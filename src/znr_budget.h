@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#ifndef ZNR_BUDGET_H
+#define ZNR_BUDGET_H
+
+#include "config.h"
+
+#include <stdbool.h>
+
+/*
+ * Default rate in ioctls per second of zone reports and FSMAP walks of the
+ * low impact mode.
+ */
+#define ZNR_BUDGET_DEFAULT_RATE		10
+
+/*
+ * Low impact mode. The server device accesses use the idle I/O priority class
+ * and the zone report and FSMAP ioctls are limited to a rate with a token
+ * bucket holding up to one second of tokens. Requests over budget are served
+ * from stale cached data if there is any, and wait for a token otherwise.
+ * Each ioctl takes a token: a zone report or FSMAP walk needing several
+ * ioctls takes the tokens of the following ones as it goes. The server
+ * pollers (shared memory and web viewer updates) may only use half of the
+ * bucket, leaving the other half to client requests.
+ */
+struct znr_budget_stats {
+	/* Device requests executed and the time spent executing them. */
+	unsigned long long	requests;
+	unsigned long long	io_ns;
+
+	/* Zone report and FSMAP ioctls of these requests. */
+	unsigned long long	ioctls;
+
+	/* Ioctls which waited for a token and the time waited. */
+	unsigned long long	delayed;
+	unsigned long long	delay_ns;
+
+	/* Server process CPU time and blocks read. */
+	unsigned long long	utime_us;
+	unsigned long long	stime_us;
+	unsigned long long	inblock;
+};
+
+int znr_budget_set_idle_ioprio(void);
+int znr_budget_set_cpus(const char *cpus);
+void znr_budget_init(unsigned int rate);
+
+bool znr_budget_enabled(void);
+void znr_budget_set_poller(void);
+bool znr_budget_try_take(void);
+void znr_budget_take(void);
+int znr_budget_take_next(void);
+void znr_budget_account_ioctl(void);
+void znr_budget_account_io(unsigned long long start_ns);
+
+void znr_budget_get_stats(struct znr_budget_stats *stats);
+void znr_budget_print_stats(void);
+
+#endif /* ZNR_BUDGET_H */
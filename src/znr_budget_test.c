@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ *
+ * Token bucket tests: a poller must get tokens whatever the rate limit.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+
+#include "znr.h"
+
+static void znr_budget_test_timeout(int sig)
+{
+	fprintf(stderr, "FAIL: token wait did not complete\n");
+	_exit(1);
+}
+
+/*
+ * Take 2 tokens as a poller with a rate limit of @rate: the first from the
+ * full bucket, the second after the bucket refills.
+ */
+static int znr_budget_test_poller(unsigned int rate)
+{
+	znr_budget_init(rate);
+
+	alarm(10);
+	znr_budget_take();
+	znr_budget_take();
+	alarm(0);
+
+	if (znr_budget_try_take()) {
+		fprintf(stderr, "FAIL: rate %u, token taken from an empty bucket\n",
+			rate);
+		return 1;
+	}
+
+	printf("PASS: rate %u poller tokens\n", rate);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int rate;
+	int ret = 0;
+
+	signal(SIGALRM, znr_budget_test_timeout);
+
+	znr_budget_set_poller();
+	for (rate = 1; rate <= 3; rate++)
+		ret |= znr_budget_test_poller(rate);
+
+	return ret;
+}
@@ -0,0 +1,660 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "znr.h"
+
+enum znr_cache_type {
+	ZNR_CACHE_ZONES,
+	ZNR_CACHE_EXTENTS,
+};
+
+/*
+ * Cached data. Once filled, the data is never modified and it is reference
+ * counted so that cache hits can copy it without holding the cache lock.
+ */
+struct znr_cache_data {
+	unsigned int		refs;
+	unsigned int		nr;
+	size_t			size;
+	void			*buf;
+};
+
+/*
+ * A cache entry is keyed by a zone range (zone reports) or by a sector range
+ * (extents in range).
+ */
+struct znr_cache_entry {
+	enum znr_cache_type	type;
+	unsigned long long	start;
+	unsigned long long	len;
+
+	bool			used;
+	bool			filling;
+	unsigned long long	fill_time;
+	unsigned long long	last_use;
+
+	struct znr_cache_data	*data;
+};
+
+static struct znr_cache {
+	pthread_mutex_t		lock;
+	pthread_cond_t		fill_cond;
+
+	unsigned long long	fresh_ns;
+	unsigned long long	tick;
+	unsigned long long	bytes;
+
+	struct znr_cache_entry	entries[ZNR_CACHE_MAX_ENTRIES];
+	struct znr_cache_stats	stats;
+
+	/*
+	 * Last known state of the zones, compared with new zone reports. This
+	 * is a copy of the zone information obtained when opening the device:
+	 * the cache is used concurrently by the connection threads and must
+	 * not modify znr.blk_zones.
+	 */
+	struct blk_zone		*zones;
+	unsigned int		nr_zones;
+} znrc = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.fill_cond = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * Time the calling thread spent waiting for entries being filled by other
+ * threads.
+ */
+static __thread unsigned long long znr_cache_wait_ns;
+
+/*
+ * Set when data was served to the calling thread from a stale entry.
+ */
+static __thread bool znr_cache_stale;
+
+static unsigned long long znr_cache_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void znr_cache_put_data(struct znr_cache_data *d)
+{
+	if (!d || --d->refs)
+		return;
+
+	free(d->buf);
+	free(d);
+}
+
+static void znr_cache_drop_entry(struct znr_cache_entry *e)
+{
+	if (e->data) {
+		znrc.bytes -= e->data->size;
+		znr_cache_put_data(e->data);
+		e->data = NULL;
+	}
+	e->used = false;
+}
+
+static bool znr_cache_match(struct znr_cache_entry *e,
+			    enum znr_cache_type type,
+			    unsigned long long start, unsigned long long len)
+{
+	if (!e->used || e->type != type)
+		return false;
+
+	/*
+	 * Zone reports can be served from any entry covering the requested
+	 * zones. Extents must match exactly as their index depends on the
+	 * range start.
+	 */
+	if (type == ZNR_CACHE_ZONES)
+		return e->start <= start && start + len <= e->start + e->len;
+
+	return e->start == start && e->len == len;
+}
+
+/*
+ * Find an entry usable for a request that arrived at @arrival: either a fresh
+ * entry or an entry that was filled after the request arrived. If there is
+ * none, return in @filling an in-flight entry the request can wait for.
+ */
+static struct znr_cache_entry *
+znr_cache_find(enum znr_cache_type type,
+	       unsigned long long start, unsigned long long len,
+	       unsigned long long arrival, struct znr_cache_entry **filling)
+{
+	unsigned long long now = znr_cache_now_ns();
+	struct znr_cache_entry *e;
+	unsigned int i;
+
+	*filling = NULL;
+	for (i = 0; i < ZNR_CACHE_MAX_ENTRIES; i++) {
+		e = &znrc.entries[i];
+		if (!znr_cache_match(e, type, start, len))
+			continue;
+
+		if (e->filling) {
+			if (!*filling)
+				*filling = e;
+			continue;
+		}
+
+		if (e->data &&
+		    (e->fill_time >= arrival ||
+		     now - e->fill_time <= znrc.fresh_ns))
+			return e;
+	}
+
+	return NULL;
+}
+
+/*
+ * Find the most recently filled entry usable for a request over the ioctl
+ * budget, however old it is.
+ */
+static struct znr_cache_entry *
+znr_cache_find_stale(enum znr_cache_type type,
+		     unsigned long long start, unsigned long long len)
+{
+	struct znr_cache_entry *e, *stale = NULL;
+	unsigned int i;
+
+	for (i = 0; i < ZNR_CACHE_MAX_ENTRIES; i++) {
+		e = &znrc.entries[i];
+		if (!znr_cache_match(e, type, start, len) ||
+		    e->filling || !e->data)
+			continue;
+		if (!stale || e->fill_time > stale->fill_time)
+			stale = e;
+	}
+
+	return stale;
+}
+
+static struct znr_cache_entry *
+znr_cache_alloc_entry(enum znr_cache_type type,
+		      unsigned long long start, unsigned long long len)
+{
+	struct znr_cache_entry *e, *victim = NULL;
+	unsigned int i;
+
+	for (i = 0; i < ZNR_CACHE_MAX_ENTRIES; i++) {
+		e = &znrc.entries[i];
+		if (e->filling)
+			continue;
+
+		/* Reuse a stale entry for the same range, or a free entry. */
+		if (!e->used ||
+		    (e->type == type && e->start == start && e->len == len)) {
+			victim = e;
+			break;
+		}
+
+		if (!victim || e->last_use < victim->last_use)
+			victim = e;
+	}
+
+	if (!victim)
+		return NULL;
+
+	if (victim->used) {
+		if (victim->type != type || victim->start != start ||
+		    victim->len != len)
+			znrc.stats.evictions++;
+		znr_cache_drop_entry(victim);
+	}
+
+	victim->type = type;
+	victim->start = start;
+	victim->len = len;
+	victim->used = true;
+	victim->filling = true;
+	victim->last_use = ++znrc.tick;
+
+	return victim;
+}
+
+/*
+ * Keep the total amount of cached data under ZNR_CACHE_MAX_BYTES by evicting
+ * the least recently used entries.
+ */
+static void znr_cache_shrink(void)
+{
+	struct znr_cache_entry *e, *victim;
+	unsigned int i;
+
+	while (znrc.bytes > ZNR_CACHE_MAX_BYTES) {
+		victim = NULL;
+		for (i = 0; i < ZNR_CACHE_MAX_ENTRIES; i++) {
+			e = &znrc.entries[i];
+			if (!e->used || e->filling || !e->data)
+				continue;
+			if (!victim || e->last_use < victim->last_use)
+				victim = e;
+		}
+
+		if (!victim)
+			break;
+
+		znrc.stats.evictions++;
+		znr_cache_drop_entry(victim);
+	}
+}
+
+/*
+ * Drop the cached extents overlapping a zone and the cached zone reports
+ * including the zone.
+ */
+static void znr_cache_invalidate_zone(unsigned int zno, struct blk_zone *blkz,
+				      struct znr_cache_entry *skip)
+{
+	struct znr_cache_entry *e;
+	unsigned int i;
+
+	for (i = 0; i < ZNR_CACHE_MAX_ENTRIES; i++) {
+		e = &znrc.entries[i];
+		if (e == skip || !e->used || e->filling)
+			continue;
+
+		if (e->type == ZNR_CACHE_ZONES) {
+			if (zno < e->start || zno >= e->start + e->len)
+				continue;
+		} else if (e->start >= blkz->start + blkz->len ||
+			   e->start + e->len <= blkz->start) {
+			continue;
+		}
+
+		znrc.stats.invalidations++;
+		znr_cache_drop_entry(e);
+	}
+}
+
+/*
+ * Compare a new zone report with the last known zone state and invalidate
+ * the entries for all zones that changed write pointer or condition.
+ */
+static void znr_cache_update_zones(struct znr_cache_entry *filled)
+{
+	struct blk_zone *zones = filled->data->buf;
+	struct blk_zone *blkz;
+	unsigned int i, zno;
+
+	for (i = 0; i < filled->data->nr; i++) {
+		zno = filled->start + i;
+		if (zno >= znrc.nr_zones)
+			break;
+		blkz = &znrc.zones[zno];
+		if (blkz->wp == zones[i].wp && blkz->cond == zones[i].cond)
+			continue;
+
+		znr_verbose("Zone %u changed, invalidating cache entries\n",
+			    zno);
+
+		memcpy(blkz, &zones[i], sizeof(*blkz));
+		znr_cache_invalidate_zone(zno, blkz, filled);
+		znr_session_zone_changed(zno);
+	}
+}
+
+static int znr_cache_fill(struct znr_cache_entry *e, struct znr_cache_data *d)
+{
+	struct znr_extent *extents = NULL;
+	unsigned int nr_extents = 0;
+	unsigned long long start;
+	int ret;
+
+	if (e->type == ZNR_CACHE_ZONES) {
+		d->size = e->len * sizeof(struct blk_zone);
+		d->buf = malloc(d->size);
+		if (!d->buf)
+			return -ENOMEM;
+	}
+
+	ret = znr_sched_get();
+	if (ret)
+		return ret;
+
+	start = znr_cache_now_ns();
+	if (e->type == ZNR_CACHE_ZONES)
+		ret = znr_dev_report_zones(&znr.dev, e->start,
+					   d->buf, e->len);
+	else
+		ret = znr_fs_get_extents_in_range(e->start, e->len,
+						  &extents, &nr_extents);
+	znr_budget_account_io(start);
+
+	znr_sched_put();
+
+	if (ret < 0)
+		return ret;
+
+	if (e->type == ZNR_CACHE_ZONES) {
+		if ((unsigned int)ret != e->len)
+			return -EIO;
+		d->nr = e->len;
+		return 0;
+	}
+
+	d->buf = extents;
+	d->nr = nr_extents;
+	d->size = (size_t)nr_extents * sizeof(struct znr_extent);
+
+	return 0;
+}
+
+static void znr_cache_wait_fill(void)
+{
+	unsigned long long start = znr_cache_now_ns();
+
+	pthread_cond_wait(&znrc.fill_cond, &znrc.lock);
+
+	znr_cache_wait_ns += znr_cache_now_ns() - start;
+}
+
+/*
+ * Get and reset the time the calling thread spent waiting for data being
+ * obtained for other threads.
+ */
+unsigned long long znr_cache_get_wait_ns(void)
+{
+	unsigned long long wait_ns = znr_cache_wait_ns;
+
+	znr_cache_wait_ns = 0;
+
+	return wait_ns;
+}
+
+/*
+ * Test if data was served to the calling thread from a stale entry since the
+ * last call to znr_cache_clear_stale().
+ */
+bool znr_cache_served_stale(void)
+{
+	return znr_cache_stale;
+}
+
+void znr_cache_clear_stale(void)
+{
+	znr_cache_stale = false;
+}
+
+/*
+ * Get a reference on fresh data for a range, executing the ioctl if needed.
+ * Concurrent identical requests share a single ioctl execution. With an ioctl
+ * budget, requests over budget get stale data if there is any and wait for the
+ * budget otherwise.
+ */
+static int znr_cache_get(enum znr_cache_type type,
+			 unsigned long long start, unsigned long long len,
+			 struct znr_cache_data **data,
+			 unsigned long long *data_start)
+{
+	unsigned long long arrival = znr_cache_now_ns();
+	struct znr_cache_entry *e, *filling;
+	struct znr_cache_data *d;
+	bool waited = false, budget = false;
+	int ret;
+
+	pthread_mutex_lock(&znrc.lock);
+
+again:
+	e = znr_cache_find(type, start, len, arrival, &filling);
+	if (e) {
+		if (waited)
+			znrc.stats.coalesced++;
+		else
+			znrc.stats.hits++;
+		goto hit;
+	}
+
+	if (filling) {
+		waited = true;
+		znr_cache_wait_fill();
+		goto again;
+	}
+
+	if (!budget) {
+		if (znr_budget_try_take()) {
+			budget = true;
+		} else {
+			e = znr_cache_find_stale(type, start, len);
+			if (e) {
+				znrc.stats.stale++;
+				znr_cache_stale = true;
+				goto hit;
+			}
+
+			pthread_mutex_unlock(&znrc.lock);
+			znr_budget_take();
+			pthread_mutex_lock(&znrc.lock);
+			budget = true;
+			goto again;
+		}
+	}
+
+	znrc.stats.misses++;
+
+	e = znr_cache_alloc_entry(type, start, len);
+	if (!e) {
+		/* All entries are being filled: do not cache. */
+		znr_cache_wait_fill();
+		goto again;
+	}
+
+	pthread_mutex_unlock(&znrc.lock);
+
+	d = calloc(1, sizeof(*d));
+	if (d) {
+		d->refs = 1;
+		ret = znr_cache_fill(e, d);
+	} else {
+		ret = -ENOMEM;
+	}
+
+	pthread_mutex_lock(&znrc.lock);
+
+	e->filling = false;
+	if (ret < 0) {
+		znr_cache_put_data(d);
+		e->used = false;
+		pthread_cond_broadcast(&znrc.fill_cond);
+		pthread_mutex_unlock(&znrc.lock);
+		return ret;
+	}
+
+	e->data = d;
+	e->fill_time = znr_cache_now_ns();
+	znrc.bytes += d->size;
+
+	if (type == ZNR_CACHE_ZONES)
+		znr_cache_update_zones(e);
+
+	pthread_cond_broadcast(&znrc.fill_cond);
+
+hit:
+	e->last_use = ++znrc.tick;
+	e->data->refs++;
+	*data = e->data;
+	*data_start = e->start;
+
+	znr_cache_shrink();
+
+	pthread_mutex_unlock(&znrc.lock);
+
+	return 0;
+}
+
+static void znr_cache_release(struct znr_cache_data *d)
+{
+	pthread_mutex_lock(&znrc.lock);
+	znr_cache_put_data(d);
+	pthread_mutex_unlock(&znrc.lock);
+}
+
+/*
+ * Get zone information, using a cached zone report if it is fresh enough.
+ * Return the number of zones copied to @zones or a negative error code.
+ */
+int znr_cache_report_zones(unsigned int zno, unsigned int nr_zones,
+			   struct blk_zone *zones)
+{
+	struct znr_cache_data *d;
+	unsigned long long start;
+	struct blk_zone *blkz;
+	int ret;
+
+	ret = znr_cache_get(ZNR_CACHE_ZONES, zno, nr_zones, &d, &start);
+	if (ret)
+		return ret;
+
+	blkz = d->buf;
+	memcpy(zones, &blkz[zno - start], nr_zones * sizeof(*blkz));
+
+	znr_cache_release(d);
+
+	return nr_zones;
+}
+
+/*
+ * Get the extents in a sector range, using cached extents if they are fresh
+ * enough. The extents array returned must be freed by the caller.
+ */
+int znr_cache_get_extents_in_range(unsigned long long sector,
+				   unsigned long long nr_sectors,
+				   struct znr_extent **extents,
+				   unsigned int *nr_extents)
+{
+	struct znr_cache_data *d;
+	unsigned long long start;
+	int ret;
+
+	*extents = NULL;
+	*nr_extents = 0;
+
+	ret = znr_cache_get(ZNR_CACHE_EXTENTS, sector, nr_sectors,
+			    &d, &start);
+	if (ret)
+		return ret;
+
+	if (d->nr) {
+		*extents = malloc(d->size);
+		if (!*extents) {
+			ret = -ENOMEM;
+			goto release;
+		}
+		memcpy(*extents, d->buf, d->size);
+		*nr_extents = d->nr;
+	}
+
+release:
+	znr_cache_release(d);
+
+	return ret;
+}
+
+/*
+ * Walk the extents in a sector range, using cached extents if they are fresh
+ * enough. The extents are passed to @cb in batches of at most @batch extents,
+ * directly from the cached data: @cb must not modify them.
+ */
+int znr_cache_walk_extents_in_range(unsigned long long sector,
+				    unsigned long long nr_sectors,
+				    unsigned int batch,
+				    znr_fs_extents_cb cb, void *data)
+{
+	struct znr_cache_data *d;
+	struct znr_extent *ext;
+	unsigned long long start;
+	unsigned int i, nr;
+	int ret;
+
+	ret = znr_cache_get(ZNR_CACHE_EXTENTS, sector, nr_sectors,
+			    &d, &start);
+	if (ret)
+		return ret;
+
+	ext = d->buf;
+	for (i = 0; i < d->nr; i += nr) {
+		nr = d->nr - i;
+		if (nr > batch)
+			nr = batch;
+		ret = cb(&ext[i], nr, data);
+		if (ret)
+			break;
+	}
+
+	znr_cache_release(d);
+
+	return ret;
+}
+
+void znr_cache_get_stats(struct znr_cache_stats *stats)
+{
+	pthread_mutex_lock(&znrc.lock);
+	memcpy(stats, &znrc.stats, sizeof(*stats));
+	pthread_mutex_unlock(&znrc.lock);
+}
+
+void znr_cache_print_stats(void)
+{
+	struct znr_cache_stats st;
+
+	znr_cache_get_stats(&st);
+
+	printf("Cache: %llu hits, %llu misses, %llu coalesced, "
+	       "%llu invalidations, %llu evictions, %llu stale\n",
+	       st.hits, st.misses, st.coalesced,
+	       st.invalidations, st.evictions, st.stale);
+}
+
+int znr_cache_init(unsigned int fresh_ms)
+{
+	struct blk_zone *zones = NULL;
+
+	if (znr.nr_zones) {
+		zones = malloc(znr.nr_zones * sizeof(struct blk_zone));
+		if (!zones)
+			return -ENOMEM;
+		memcpy(zones, znr.blk_zones,
+		       znr.nr_zones * sizeof(struct blk_zone));
+	}
+
+	pthread_mutex_lock(&znrc.lock);
+	znrc.fresh_ns = (unsigned long long)fresh_ms * 1000000ULL;
+	memset(&znrc.stats, 0, sizeof(znrc.stats));
+	free(znrc.zones);
+	znrc.zones = zones;
+	znrc.nr_zones = znr.nr_zones;
+	pthread_mutex_unlock(&znrc.lock);
+
+	znr_verbose("Cache freshness window: %u ms\n", fresh_ms);
+
+	return 0;
+}
+
+void znr_cache_destroy(void)
+{
+	unsigned int i;
+
+	pthread_mutex_lock(&znrc.lock);
+	for (i = 0; i < ZNR_CACHE_MAX_ENTRIES; i++) {
+		if (znrc.entries[i].used && !znrc.entries[i].filling)
+			znr_cache_drop_entry(&znrc.entries[i]);
+	}
+	free(znrc.zones);
+	znrc.zones = NULL;
+	znrc.nr_zones = 0;
+	pthread_mutex_unlock(&znrc.lock);
+}
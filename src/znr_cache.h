@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#ifndef ZNR_CACHE_H
+#define ZNR_CACHE_H
+
+#include "config.h"
+#include "znr_device.h"
+#include "znr_fs.h"
+
+/*
+ * Default freshness window of cached zone reports and extents.
+ */
+#define ZNR_CACHE_DEFAULT_MS	100
+
+/*
+ * Maximum number of cached entries and total size of the cached data.
+ */
+#define ZNR_CACHE_MAX_ENTRIES	64
+#define ZNR_CACHE_MAX_BYTES	(64ULL * 1024 * 1024)
+
+/*
+ * Cache statistics.
+ */
+struct znr_cache_stats {
+	/* Requests served from a fresh cache entry. */
+	unsigned long long	hits;
+
+	/* Requests that had to execute an ioctl. */
+	unsigned long long	misses;
+
+	/* Requests that waited for and shared an in-flight ioctl. */
+	unsigned long long	coalesced;
+
+	/* Entries dropped due to zone write pointer or condition changes. */
+	unsigned long long	invalidations;
+
+	/* Entries dropped to make room for new entries. */
+	unsigned long long	evictions;
+
+	/* Requests over the ioctl budget served from a stale entry. */
+	unsigned long long	stale;
+};
+
+int znr_cache_init(unsigned int fresh_ms);
+void znr_cache_destroy(void);
+
+int znr_cache_report_zones(unsigned int zno, unsigned int nr_zones,
+			   struct blk_zone *zones);
+int znr_cache_get_extents_in_range(unsigned long long sector,
+				   unsigned long long nr_sectors,
+				   struct znr_extent **extents,
+				   unsigned int *nr_extents);
+int znr_cache_walk_extents_in_range(unsigned long long sector,
+				    unsigned long long nr_sectors,
+				    unsigned int batch,
+				    znr_fs_extents_cb cb, void *data);
+
+unsigned long long znr_cache_get_wait_ns(void);
+bool znr_cache_served_stale(void);
+void znr_cache_clear_stale(void);
+
+void znr_cache_get_stats(struct znr_cache_stats *stats);
+void znr_cache_print_stats(void);
+
+#endif /* ZNR_CACHE_H */
@@ -442,6 +442,13 @@ int znr_dev_report_zones(struct znr_device *dev, unsigned int start_zone_no,
 	}
 
 	while (n < nr_zones && sector < end_sector) {
+		/* Each ioctl is charged to the budget */
+		if (n) {
+			ret = znr_budget_take_next();
+			if (ret)
+				goto out;
+		}
+
 		memset(rep, 0, rep_size);
 		rep->sector = sector;
 		rep->nr_zones = rep_nr_zones;
@@ -461,6 +468,7 @@ int znr_dev_report_zones(struct znr_device *dev, unsigned int start_zone_no,
 				errno, strerror(errno));
 			goto out;
 		}
+		znr_budget_account_ioctl();
 
 		if (!rep->nr_zones)
 			break;
@@ -479,7 +487,7 @@ int znr_dev_report_zones(struct znr_device *dev, unsigned int start_zone_no,
 		}
 	}
 
-	return n;
+	ret = n;
 
 out:
 	free(rep);
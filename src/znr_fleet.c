@@ -0,0 +1,584 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+
+#include "znr.h"
+
+/*
+ * Upstream host of an aggregator. Each host is polled by its own thread, so
+ * that a slow or unreachable host does not delay the others.
+ */
+struct znr_fleet_host {
+	char			*name;
+	char			*addr;
+	int			port;
+
+	/* Poll thread state */
+	pthread_t		thread;
+	bool			thread_started;
+	struct znr_net_client	ncli;
+
+	/*
+	 * Serializes the connection and disconnection of ncli with its
+	 * shutdown by znr_fleet_destroy().
+	 */
+	pthread_mutex_t		ncli_lock;
+	struct znr_device	dev;
+	char			*dev_path;
+	struct blk_zone		*zones;
+	unsigned long long	*used;
+	unsigned long long	*live;
+	unsigned long long	poll_ns;
+	unsigned long long	nr_polls;
+	unsigned long long	gc_ns;
+
+	/* Host summary and time of the last successful poll */
+	struct znr_net_fleet_host sum;
+	unsigned long long	sum_ns;
+};
+
+static struct znr_fleet {
+	struct znr_fleet_host	*hosts;
+	unsigned int		nr_hosts;
+	unsigned long long	poll_ns;
+	unsigned long long	gc_ns;
+	bool			stop;
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+} znrf = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static void znr_fleet_disconnect(struct znr_fleet_host *h)
+{
+	pthread_mutex_lock(&h->ncli_lock);
+	znr_net_disconnect(&h->ncli);
+	pthread_mutex_unlock(&h->ncli_lock);
+
+	free(h->dev_path);
+	h->dev_path = NULL;
+	free(h->zones);
+	h->zones = NULL;
+	free(h->used);
+	h->used = NULL;
+	free(h->live);
+	h->live = NULL;
+	h->nr_polls = 0;
+	h->gc_ns = 0;
+}
+
+static int znr_fleet_connect_host(struct znr_fleet_host *h)
+{
+	struct znr_net_client ncli;
+	unsigned int nr_zones;
+	bool stop;
+	int ret;
+
+	ret = znr_net_connect_host(&ncli, h->addr, h->port);
+	if (ret)
+		return -EHOSTUNREACH;
+
+	/*
+	 * Use the connection only if znr_fleet_destroy() did not start: it
+	 * shuts down the socket of connected hosts to unblock their poll.
+	 */
+	pthread_mutex_lock(&h->ncli_lock);
+	pthread_mutex_lock(&znrf.lock);
+	stop = znrf.stop;
+	pthread_mutex_unlock(&znrf.lock);
+	if (!stop)
+		h->ncli = ncli;
+	pthread_mutex_unlock(&h->ncli_lock);
+
+	if (stop) {
+		znr_net_disconnect(&ncli);
+		return -ECANCELED;
+	}
+
+	ret = znr_net_negotiate(&h->ncli, znr.net_features);
+	if (ret)
+		goto err;
+
+	/* Polling is background work for the hosts */
+	h->ncli.req_class = ZNR_SCHED_BACKGROUND;
+
+	ret = znr_net_get_device(&h->ncli, &h->dev, &h->dev_path);
+	if (ret)
+		goto err;
+
+	nr_zones = h->dev.is_zoned ? h->dev.nr_zones : 0;
+	if (!nr_zones) {
+		znr_err("Host %s: device %s is not zoned\n",
+			h->name, h->dev_path);
+		ret = -ENODEV;
+		goto err;
+	}
+
+	h->zones = calloc(nr_zones, sizeof(struct blk_zone));
+	h->used = calloc(nr_zones, sizeof(unsigned long long));
+	h->live = calloc(nr_zones, sizeof(unsigned long long));
+	if (!h->zones || !h->used || !h->live) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	return 0;
+
+err:
+	znr_fleet_disconnect(h);
+	return ret;
+}
+
+/*
+ * Account the extents of a host file system to the zones they are in.
+ */
+static int znr_fleet_live_cb(struct znr_extent *extents,
+			     unsigned int nr_extents, void *data)
+{
+	struct znr_fleet_host *h = data;
+	unsigned long long sector, end, zend;
+	unsigned int i, zno;
+
+	for (i = 0; i < nr_extents; i++) {
+		sector = extents[i].sector;
+		end = sector + extents[i].nr_sectors;
+		while (sector < end) {
+			zno = sector / h->dev.zone_sectors;
+			if (zno >= h->dev.nr_zones)
+				break;
+			zend = (unsigned long long)(zno + 1) *
+				h->dev.zone_sectors;
+			if (zend > end)
+				zend = end;
+			h->live[zno] += zend - sector;
+			sector = zend;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Count the full zones with little live data. Extents are walked only with a
+ * walk period set and once per period: keep the previous count in between.
+ */
+static int znr_fleet_count_gc_candidates(struct znr_fleet_host *h,
+					 struct znr_net_fleet_host *sum,
+					 unsigned long long now)
+{
+	unsigned long long cap;
+	struct blk_zone *blkz;
+	unsigned int i;
+	int ret;
+
+	if (!znrf.gc_ns)
+		return 0;
+
+	if (h->gc_ns && now - h->gc_ns < znrf.gc_ns) {
+		sum->nr_gc_candidates = h->sum.nr_gc_candidates;
+		return 0;
+	}
+
+	memset(h->live, 0, h->dev.nr_zones * sizeof(unsigned long long));
+	ret = znr_net_walk_extents_in_range(&h->ncli, 0, h->dev.nr_sectors,
+					    znr_fleet_live_cb, h);
+	if (ret)
+		return ret;
+
+	sum->nr_gc_candidates = 0;
+	for (i = 0; i < h->dev.nr_zones; i++) {
+		blkz = &h->zones[i];
+		if (blkz->type == BLK_ZONE_TYPE_CONVENTIONAL ||
+		    blkz->cond != BLK_ZONE_COND_FULL)
+			continue;
+		cap = blkz->capacity ? blkz->capacity : blkz->len;
+		if (h->live[i] * 100 < cap * ZNR_FLEET_GC_LIVE_PCT)
+			sum->nr_gc_candidates++;
+	}
+	h->gc_ns = now;
+
+	return 0;
+}
+
+static int znr_fleet_poll(struct znr_fleet_host *h)
+{
+	unsigned long long now, cap, used, written = 0;
+	struct znr_net_fleet_host sum;
+	struct blk_zone *blkz;
+	unsigned int i;
+	int ret;
+
+	if (h->ncli.sd <= 0) {
+		ret = znr_fleet_connect_host(h);
+		if (ret)
+			return ret;
+	}
+
+	ret = znr_net_get_dev_rep_zones(&h->ncli, 0, h->zones,
+					h->dev.nr_zones);
+	if (ret < 0)
+		return ret;
+	now = znr_stats_now_ns();
+
+	memset(&sum, 0, sizeof(sum));
+	sum.nr_zones = h->dev.nr_zones;
+	sum.max_nr_open_zones = h->dev.max_nr_open_zones;
+
+	for (i = 0; i < h->dev.nr_zones; i++) {
+		blkz = &h->zones[i];
+		if (blkz->type == BLK_ZONE_TYPE_CONVENTIONAL) {
+			sum.nr_conv_zones++;
+			continue;
+		}
+
+		cap = blkz->capacity ? blkz->capacity : blkz->len;
+		switch (blkz->cond) {
+		case BLK_ZONE_COND_EMPTY:
+			sum.nr_empty_zones++;
+			used = 0;
+			break;
+		case BLK_ZONE_COND_IMP_OPEN:
+		case BLK_ZONE_COND_EXP_OPEN:
+			sum.nr_open_zones++;
+			used = blkz->wp - blkz->start;
+			break;
+		case BLK_ZONE_COND_CLOSED:
+			sum.nr_closed_zones++;
+			used = blkz->wp - blkz->start;
+			break;
+		case BLK_ZONE_COND_FULL:
+			sum.nr_full_zones++;
+			used = cap;
+			break;
+		default:
+			used = 0;
+			break;
+		}
+
+		sum.capacity += cap;
+		sum.used += used;
+
+		/* A zone written less than before was reset. */
+		if (used >= h->used[i])
+			written += used - h->used[i];
+		else
+			written += used;
+		h->used[i] = used;
+	}
+
+	/* The first poll only gives the write pointers reference. */
+	if (h->nr_polls && now > h->poll_ns)
+		sum.write_bps = written * 512ULL * 1000000000ULL /
+			(now - h->poll_ns);
+
+	ret = znr_fleet_count_gc_candidates(h, &sum, now);
+	if (ret)
+		return ret;
+
+	h->poll_ns = now;
+	h->nr_polls++;
+	sum.nr_polls = h->nr_polls;
+
+	pthread_mutex_lock(&znrf.lock);
+	memcpy(sum.name, h->sum.name, sizeof(sum.name));
+	h->sum = sum;
+	h->sum_ns = now;
+	pthread_mutex_unlock(&znrf.lock);
+
+	return 0;
+}
+
+static void *znr_fleet_poll_thread(void *arg)
+{
+	struct znr_fleet_host *h = arg;
+	struct timespec ts;
+	sigset_t set;
+	int ret;
+
+	/* Let the main thread handle signals. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	pthread_mutex_lock(&znrf.lock);
+
+	while (!znrf.stop) {
+		pthread_mutex_unlock(&znrf.lock);
+
+		ret = znr_fleet_poll(h);
+		if (ret == -1)
+			ret = -EIO;
+		if (ret) {
+			znr_verbose("Host %s: poll failed %d\n", h->name, ret);
+			znr_fleet_disconnect(h);
+		}
+
+		pthread_mutex_lock(&znrf.lock);
+
+		h->sum.err = -ret;
+		if (znrf.stop)
+			break;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += znrf.poll_ns / 1000000000ULL;
+		ts.tv_nsec += znrf.poll_ns % 1000000000ULL;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&znrf.cond, &znrf.lock, &ts);
+	}
+
+	pthread_mutex_unlock(&znrf.lock);
+
+	znr_fleet_disconnect(h);
+
+	return NULL;
+}
+
+/*
+ * Parse a host specification: an IP address with an optional ":port" suffix,
+ * or a unix socket path.
+ */
+static int znr_fleet_parse_host(struct znr_fleet_host *h, char *spec,
+				int port)
+{
+	char *p;
+
+	pthread_mutex_init(&h->ncli_lock, NULL);
+
+	h->name = strdup(spec);
+	h->addr = strdup(spec);
+	if (!h->name || !h->addr)
+		return -ENOMEM;
+
+	h->port = port;
+	p = strchr(h->addr, ':');
+	if (h->addr[0] != '/' && p) {
+		*p = '\0';
+		h->port = atoi(p + 1);
+		if (h->port <= 0 || h->port > 65535) {
+			znr_err("Invalid port for host %s\n", spec);
+			return -EINVAL;
+		}
+	}
+
+	strncpy((char *)h->sum.name, spec, ZNR_NET_HOST_NAME_LEN - 1);
+	h->sum.err = EAGAIN;
+
+	return 0;
+}
+
+/*
+ * Start polling the comma separated list of hosts @hosts every @poll_ms
+ * milliseconds. Hosts without a port use @port. The extents of the hosts are
+ * walked to count garbage collection candidates every @gc_ms milliseconds,
+ * never if @gc_ms is 0.
+ */
+int znr_fleet_init(char *hosts, int port, unsigned int poll_ms,
+		   unsigned int gc_ms)
+{
+	char *list, *spec, *saveptr = NULL;
+	unsigned int i;
+	int ret;
+
+	if (poll_ms < ZNR_FLEET_MIN_POLL_MS)
+		poll_ms = ZNR_FLEET_MIN_POLL_MS;
+	znrf.poll_ns = (unsigned long long)poll_ms * 1000000ULL;
+	if (gc_ms && gc_ms < ZNR_FLEET_MIN_GC_MS)
+		gc_ms = ZNR_FLEET_MIN_GC_MS;
+	znrf.gc_ns = (unsigned long long)gc_ms * 1000000ULL;
+
+	list = strdup(hosts);
+	if (!list)
+		return -ENOMEM;
+
+	znrf.hosts = calloc(ZNR_FLEET_MAX_HOSTS, sizeof(*znrf.hosts));
+	if (!znrf.hosts) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	for (spec = strtok_r(list, ",", &saveptr); spec;
+	     spec = strtok_r(NULL, ",", &saveptr)) {
+		if (znrf.nr_hosts >= ZNR_FLEET_MAX_HOSTS) {
+			znr_err("Too many hosts (maximum %d)\n",
+				ZNR_FLEET_MAX_HOSTS);
+			ret = -EINVAL;
+			goto err;
+		}
+
+		ret = znr_fleet_parse_host(&znrf.hosts[znrf.nr_hosts],
+					   spec, port);
+		znrf.nr_hosts++;
+		if (ret)
+			goto err;
+	}
+
+	if (!znrf.nr_hosts) {
+		znr_err("No host specified\n");
+		ret = -EINVAL;
+		goto err;
+	}
+
+	znrf.stop = false;
+	for (i = 0; i < znrf.nr_hosts; i++) {
+		ret = pthread_create(&znrf.hosts[i].thread, NULL,
+				     znr_fleet_poll_thread, &znrf.hosts[i]);
+		if (ret) {
+			znr_err("Failed to create host poll thread (%s)\n",
+				strerror(ret));
+			ret = -ret;
+			goto err;
+		}
+		znrf.hosts[i].thread_started = true;
+	}
+
+	printf("Aggregating %u hosts, polled every %u ms\n",
+	       znrf.nr_hosts, poll_ms);
+	if (gc_ms)
+		printf("Counting GC candidates every %u ms\n", gc_ms);
+
+	free(list);
+
+	return 0;
+
+err:
+	free(list);
+	znr_fleet_destroy();
+	return ret;
+}
+
+void znr_fleet_destroy(void)
+{
+	struct znr_fleet_host *h;
+	unsigned int i;
+
+	if (!znrf.hosts)
+		return;
+
+	pthread_mutex_lock(&znrf.lock);
+	znrf.stop = true;
+	pthread_cond_broadcast(&znrf.cond);
+	pthread_mutex_unlock(&znrf.lock);
+
+	for (i = 0; i < znrf.nr_hosts; i++) {
+		h = &znrf.hosts[i];
+
+		/* Unblock a poll waiting for an unresponsive host. */
+		if (h->thread_started) {
+			pthread_mutex_lock(&h->ncli_lock);
+			if (h->ncli.sd > 0)
+				shutdown(h->ncli.sd, SHUT_RDWR);
+			pthread_mutex_unlock(&h->ncli_lock);
+			pthread_join(h->thread, NULL);
+		}
+
+		pthread_mutex_destroy(&h->ncli_lock);
+		free(h->name);
+		free(h->addr);
+	}
+
+	free(znrf.hosts);
+	znrf.hosts = NULL;
+	znrf.nr_hosts = 0;
+}
+
+bool znr_fleet_enabled(void)
+{
+	return znrf.nr_hosts > 0;
+}
+
+/*
+ * Copy the hosts summary into @hosts, which must have room for
+ * ZNR_FLEET_MAX_HOSTS hosts, and return the number of hosts.
+ */
+unsigned int znr_fleet_get_hosts(struct znr_net_fleet_host *hosts)
+{
+	unsigned long long now = znr_stats_now_ns();
+	struct znr_fleet_host *h;
+	unsigned int i;
+
+	pthread_mutex_lock(&znrf.lock);
+
+	for (i = 0; i < znrf.nr_hosts; i++) {
+		h = &znrf.hosts[i];
+		hosts[i] = h->sum;
+		hosts[i].age_ms = h->sum_ns ? (now - h->sum_ns) / 1000000ULL :
+			0;
+	}
+
+	pthread_mutex_unlock(&znrf.lock);
+
+	return znrf.nr_hosts;
+}
+
+/*
+ * Connect @ncli to the host @host, negotiating the features among @features.
+ */
+int znr_fleet_connect(unsigned int host, struct znr_net_client *ncli,
+		      unsigned int features)
+{
+	struct znr_fleet_host *h;
+	int ret;
+
+	if (host >= znrf.nr_hosts)
+		return -ENOENT;
+
+	h = &znrf.hosts[host];
+	ret = znr_net_connect_host(ncli, h->addr, h->port);
+	if (ret)
+		return -EHOSTUNREACH;
+
+	ret = znr_net_negotiate(ncli, features);
+	if (ret) {
+		znr_net_disconnect(ncli);
+		return -EHOSTUNREACH;
+	}
+
+	return 0;
+}
+
+void znr_fleet_print(FILE *f, struct znr_net_fleet_host *hosts,
+		     unsigned int nr_hosts)
+{
+	struct znr_net_fleet_host *h;
+	unsigned int i;
+
+	fprintf(f, "%-4s %-24s %6s %6s %6s %6s %6s %6s %10s %8s\n",
+		"Host", "Name", "Zones", "Empty", "Open", "Closed", "Full",
+		"GC", "Fill", "MB/s");
+
+	for (i = 0; i < nr_hosts; i++) {
+		h = &hosts[i];
+		if (h->err && !h->nr_polls) {
+			fprintf(f, "%-4u %-24s %s\n",
+				i, (char *)h->name, strerror(h->err));
+			continue;
+		}
+
+		fprintf(f, "%-4u %-24s %6llu %6llu %3llu/%-2llu %6llu %6llu "
+			"%6llu %9.1f%% %8.1f",
+			i, (char *)h->name,
+			h->nr_zones, h->nr_empty_zones,
+			h->nr_open_zones, h->max_nr_open_zones,
+			h->nr_closed_zones, h->nr_full_zones,
+			h->nr_gc_candidates,
+			h->capacity ? 100.0 * h->used / h->capacity : 0.0,
+			(double)h->write_bps / 1000000.0);
+		if (h->err)
+			fprintf(f, " (%s, %llu.%03llu s ago)",
+				strerror(h->err),
+				h->age_ms / 1000, h->age_ms % 1000);
+		fprintf(f, "\n");
+	}
+}
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#ifndef ZNR_FLEET_H
+#define ZNR_FLEET_H
+
+#include "config.h"
+#include "znr_net.h"
+
+#include <stdio.h>
+
+/*
+ * Maximum number of hosts of an aggregator.
+ */
+#define ZNR_FLEET_MAX_HOSTS		64
+
+/*
+ * Default and minimum host poll period.
+ */
+#define ZNR_FLEET_DEFAULT_POLL_MS	1000
+#define ZNR_FLEET_MIN_POLL_MS		100
+
+/*
+ * Full zones with less than ZNR_FLEET_GC_LIVE_PCT % of their capacity used by
+ * file extents are counted as garbage collection candidates. This requires a
+ * walk of all the extents of the host file system, so candidates are counted
+ * only if a walk period is given, and at most every ZNR_FLEET_MIN_GC_MS.
+ */
+#define ZNR_FLEET_GC_LIVE_PCT		50
+#define ZNR_FLEET_MIN_GC_MS		60000
+
+/*
+ * Aggregator side.
+ */
+int znr_fleet_init(char *hosts, int port, unsigned int poll_ms,
+		    unsigned int gc_ms);
+void znr_fleet_destroy(void);
+bool znr_fleet_enabled(void);
+unsigned int znr_fleet_get_hosts(struct znr_net_fleet_host *hosts);
+int znr_fleet_connect(unsigned int host, struct znr_net_client *ncli,
+		      unsigned int features);
+
+/*
+ * Client side.
+ */
+void znr_fleet_print(FILE *f, struct znr_net_fleet_host *hosts,
+		     unsigned int nr_hosts);
+
+#endif /* ZNR_FLEET_H */
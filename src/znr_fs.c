@@ -182,9 +182,9 @@ close:
 	return ret;
 }
 
-static struct znr_fs_file *znr_fs_alloc_file(const char *path)
+struct znr_fs_file *znr_fs_alloc_file(const char *path)
 {
-	static struct znr_fs_file *f;
+	struct znr_fs_file *f;
 
 	f = calloc(1, sizeof(*f));
 	if (!f)
@@ -249,30 +249,185 @@ int znr_fs_get_file_extents_by_path(const char *path,
 	return 0;
 }
 
+/*
+ * Get the extents of the file with the inode number @ino. The file has no
+ * path: its extents are those owned by the inode in the FSMAP extents of all
+ * blockgroups, which are walked one by one as the extents of a range must be
+ * on a single device of the file system. With a server, the owner filter is
+ * evaluated by the server with an extent query.
+ */
 int znr_fs_get_file_extents_by_ino(unsigned long long ino,
 				   struct znr_fs_file **file,
 				   struct znr_extent **extents,
 				   unsigned int *nr_extents)
 {
-	fprintf(stderr, "Getting files by inode number is not supported yet\n");
+	struct znr_fs_extents fe = { };
+	struct znr_fs_file *f;
+	struct znr_query q;
+	char str[64];
+	unsigned int i;
+	int ret;
 
 	*file = NULL;
 	*extents = NULL;
 	*nr_extents = 0;
 
-	return -ENOTSUP;
+	snprintf(str, sizeof(str), "ino = %llu", ino);
+	ret = znr_query_parse(&q, str);
+	if (ret)
+		return ret;
+	q.cb = znr_fs_collect_extents;
+	q.data = &fe;
+
+	for (i = 0; i < znr.nr_blockgroups; i++) {
+		if (znr.is_net_client)
+			ret = znr_net_query(&znr.ncli,
+					    znr.blockgroups[i].sector,
+					    znr.blockgroups[i].nr_sectors, &q);
+		else
+			ret = znr_fs_walk_extents_in_range(
+					znr.blockgroups[i].sector,
+					znr.blockgroups[i].nr_sectors,
+					znr_query_extents, &q);
+		if (ret)
+			goto err;
+	}
+
+	f = znr_fs_alloc_file(NULL);
+	if (!f) {
+		ret = -ENOMEM;
+		goto err;
+	}
+	f->ino = ino;
+
+	/* Number the extents of the file */
+	for (i = 0; i < fe.nr_extents; i++)
+		fe.extents[i].idx = i;
+
+	znr_query_free(&q);
+
+	*file = f;
+	*extents = fe.extents;
+	*nr_extents = fe.nr_extents;
+
+	return 0;
+
+err:
+	znr_query_free(&q);
+	free(fe.extents);
+
+	return ret;
+}
+
+/*
+ * Extent walk callback accumulating the extents in a struct znr_fs_extents.
+ */
+int znr_fs_collect_extents(struct znr_extent *extents,
+			   unsigned int nr_extents, void *data)
+{
+	struct znr_fs_extents *fe = data;
+	struct znr_extent *ext;
+	unsigned int max_extents;
+
+	if (fe->nr_extents + nr_extents > fe->max_extents) {
+		max_extents = fe->max_extents ? fe->max_extents * 2 :
+			ZNR_FS_EXTENTS_BATCH;
+		while (max_extents < fe->nr_extents + nr_extents)
+			max_extents *= 2;
+		ext = realloc(fe->extents, max_extents * sizeof(*ext));
+		if (!ext)
+			return -ENOMEM;
+		fe->extents = ext;
+		fe->max_extents = max_extents;
+	}
+
+	memcpy(&fe->extents[fe->nr_extents], extents,
+	       nr_extents * sizeof(*extents));
+	fe->nr_extents += nr_extents;
+
+	return 0;
 }
 
 int znr_fs_get_extents_in_range(unsigned long long sector,
 				unsigned long long nr_sectors,
 				struct znr_extent **ext, unsigned int *nr_ext)
 {
+	struct znr_fs_extents fe = { };
+	int ret;
+
 	if (znr.is_net_client)
 		return znr_net_get_extents_in_range(&znr.ncli, sector,
 						    nr_sectors, ext, nr_ext);
 
-	return znr.mnt_dir.fs->ops->get_extents_in_range(sector,
-						nr_sectors, ext, nr_ext);
+	ret = znr.mnt_dir.fs->ops->walk_extents_in_range(sector, nr_sectors,
+					znr_fs_collect_extents, &fe);
+	if (ret) {
+		free(fe.extents);
+		*ext = NULL;
+		*nr_ext = 0;
+		return ret;
+	}
+
+	*ext = fe.extents;
+	*nr_ext = fe.nr_extents;
+
+	return 0;
+}
+
+/*
+ * Walk the extents in a sector range, passing them to @cb in batches.
+ */
+int znr_fs_walk_extents_in_range(unsigned long long sector,
+				 unsigned long long nr_sectors,
+				 znr_fs_extents_cb cb, void *data)
+{
+	if (znr.is_net_client)
+		return znr_net_walk_extents_in_range(&znr.ncli, sector,
+						     nr_sectors, cb, data);
+
+	return znr.mnt_dir.fs->ops->walk_extents_in_range(sector, nr_sectors,
+							  cb, data);
+}
+
+/*
+ * Start an incremental walk of the extents in a sector range: with a server
+ * connection, only the first batch of extents is passed to @cb and the
+ * following ones with znr_fs_poll_extents(). Locally, the walk is done
+ * entirely by this call. Return a positive value if more extents are to come,
+ * 0 if the walk is complete and a negative error code otherwise.
+ */
+int znr_fs_start_extents_in_range(unsigned long long sector,
+				  unsigned long long nr_sectors,
+				  znr_fs_extents_cb cb, void *data)
+{
+	if (znr.is_net_client)
+		return znr_net_start_extents_in_range(&znr.ncli, sector,
+						      nr_sectors, cb, data);
+
+	return znr.mnt_dir.fs->ops->walk_extents_in_range(sector, nr_sectors,
+							  cb, data);
+}
+
+/*
+ * Continue an incremental extent walk. Return a positive value if more
+ * extents are to come, 0 if the walk is complete and a negative error code
+ * otherwise.
+ */
+int znr_fs_poll_extents(void)
+{
+	if (znr.is_net_client)
+		return znr_net_stream_poll(&znr.ncli);
+
+	return 0;
+}
+
+/*
+ * Stop passing the extents of an incremental walk to its callback.
+ */
+void znr_fs_cancel_extents(void)
+{
+	if (znr.is_net_client)
+		znr_net_stream_cancel(&znr.ncli);
 }
 
 int znr_fs_get_blockgroups(struct znr_bg **blockgroups,
@@ -52,6 +52,28 @@ struct znr_extent {
 	char			info[ZNR_FS_EXT_INFO_SIZE];
 } __attribute__ ((packed));
 
+/*
+ * Extent walk callback: called with successive batches of extents, which are
+ * valid only during the call. A non-zero return value stops the walk and is
+ * returned to the walk caller.
+ */
+typedef int (*znr_fs_extents_cb)(struct znr_extent *extents,
+				 unsigned int nr_extents, void *data);
+
+/*
+ * Maximum number of extents of a batch passed to a znr_fs_extents_cb.
+ */
+#define ZNR_FS_EXTENTS_BATCH	512
+
+/*
+ * Extents array built by znr_fs_collect_extents().
+ */
+struct znr_fs_extents {
+	struct znr_extent	*extents;
+	unsigned int		nr_extents;
+	unsigned int		max_extents;
+};
+
 /*
  * File information
  */
@@ -73,10 +95,9 @@ struct znr_fs_ops {
 	int (*get_file_extents)(struct znr_fs_file *f,
 				struct znr_extent **extents,
 				unsigned int *nr_extents);
-	int (*get_extents_in_range)(unsigned long long sector,
-				    unsigned long long nr_sectors,
-				    struct znr_extent **extents,
-				    unsigned int *nr_extents);
+	int (*walk_extents_in_range)(unsigned long long sector,
+				     unsigned long long nr_sectors,
+				     znr_fs_extents_cb cb, void *data);
 	int (*get_blockgroups)(struct znr_bg **blockgroups,
 			       unsigned int *nr_blockgroups);
 };
@@ -102,11 +123,22 @@ int znr_fs_get_file_extents_by_ino(unsigned long long ino,
 				   struct znr_fs_file **f,
 				   struct znr_extent **extents,
 				   unsigned int *nr_extents);
+struct znr_fs_file *znr_fs_alloc_file(const char *path);
 void znr_fs_free_file(struct znr_fs_file *f);
 
 int znr_fs_get_extents_in_range(unsigned long long sector,
 				unsigned long long nr_sectors,
 				struct znr_extent **ext, unsigned int *nr_ext);
+int znr_fs_walk_extents_in_range(unsigned long long sector,
+				 unsigned long long nr_sectors,
+				 znr_fs_extents_cb cb, void *data);
+int znr_fs_start_extents_in_range(unsigned long long sector,
+				  unsigned long long nr_sectors,
+				  znr_fs_extents_cb cb, void *data);
+int znr_fs_poll_extents(void);
+void znr_fs_cancel_extents(void);
+int znr_fs_collect_extents(struct znr_extent *extents,
+			   unsigned int nr_extents, void *data);
 int znr_fs_get_blockgroups(struct znr_bg **blockgroups,
 			   unsigned int *nr_blockgroups);
 
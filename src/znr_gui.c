@@ -20,17 +20,76 @@
 
 /*
  * GUI blockgroups, contains the required data for rendering a blockgroups
- * and supporting per blockgroup extent tabs.
+ * and supporting per blockgroup extent tabs. The blockgroup is
+ * znr.blockgroups[bg_no]: it is not referenced with a pointer as the
+ * blockgroups array is replaced on updates.
  */
 struct znr_gui_blockgroup {
 	unsigned int		bg_no;
-	struct znr_bg		*bg;
-	GtkWidget		*da;
-	bool			hovered;
+
+	/* Cached drawing of the blockgroup, NULL when it must be redrawn */
+	GskRenderNode		*node;
 
 	struct znr_gui_extents_tab *tab;
 };
 
+/*
+ * Summary of consecutive blockgroups, drawn as a single cell of the map at a
+ * level of detail above 0.
+ */
+struct znr_gui_summary {
+	unsigned int		nr_bgs;
+	unsigned int		nr_conv;
+
+	/* Sequential blockgroups with an active (open or closed) or full zone */
+	unsigned int		nr_active;
+	unsigned int		nr_full;
+
+	/* Sectors and sectors written of the sequential blockgroups */
+	unsigned long long	nr_sectors;
+	unsigned long long	wp_sectors;
+
+	/* Highest write rate of the blockgroups, in sectors per second */
+	unsigned long long	max_rate;
+};
+
+/*
+ * Columns of the extents list of a tab: the extent index followed by extent
+ * query fields.
+ */
+enum znr_gui_extent_col {
+	ZNR_GUI_EXT_COL_IDX,
+	ZNR_GUI_EXT_COL_INO,
+	ZNR_GUI_EXT_COL_SECTOR,
+	ZNR_GUI_EXT_COL_END,
+	ZNR_GUI_EXT_COL_LEN,
+	ZNR_GUI_EXT_COL_ZONE,
+
+	ZNR_GUI_NR_EXT_COLS,
+};
+
+/*
+ * Extents list model of a tab: a virtual list over the extents of the tab,
+ * in the order of the column sorted, if any. Rows are only created for the
+ * extents in view and keep a copy of the fields shown, as the tab extents
+ * array is reallocated when extents are received.
+ */
+#define ZNR_TYPE_EXTENTS_MODEL		znr_extents_model_get_type()
+G_DECLARE_FINAL_TYPE(znr_extents_model, znr_extents_model,
+		     ZNR, EXTENTS_MODEL, GObject)
+
+#define ZNR_TYPE_EXTENT_ROW		znr_extent_row_get_type()
+G_DECLARE_FINAL_TYPE(znr_extent_row, znr_extent_row,
+		     ZNR, EXTENT_ROW, GObject)
+
+struct _znr_extent_row {
+	GObject			parent;
+
+	/* Index of the extent in the tab extents array */
+	unsigned int		pos;
+	unsigned long long	vals[ZNR_GUI_NR_EXT_COLS];
+};
+
 /*
  * Extents dialog tab data.
  */
@@ -42,16 +101,129 @@ struct znr_gui_extents_tab {
 
 	struct znr_extent	*extents;
 	unsigned int		nr_extents;
+
+	/*
+	 * Extents sorted by sector, once all extents are known, so that
+	 * drawing the extents of a blockgroup only looks at the extents
+	 * starting in it. NULL while extents are received.
+	 */
+	struct znr_extent	**sorted_extents;
+
+	/*
+	 * Extents list, with the information of the extent selected shown in
+	 * details.
+	 */
+	znr_extents_model	*model;
+	GtkSingleSelection	*selection;
+	GtkWidget		*details;
+
+	/*
+	 * Blockgroup extents being received: the extents are added to the
+	 * extents list as they are received and the total number of extents
+	 * inserted in text_buffer at total_mark once all are received.
+	 * The requests filling the tab are cancelled when the tab is closed.
+	 */
+	GtkTextBuffer		*text_buffer;
+	GtkTextMark		*total_mark;
+	GCancellable		*cancellable;
+
+	/*
+	 * The blockgroup of the tab changed since its extents were requested:
+	 * the tab is refreshed in place with the first auto-refresh following
+	 * the completion of the extents request in flight (loading set).
+	 */
+	bool			stale;
+	bool			loading;
+};
+
+struct _znr_extents_model {
+	GObject			parent;
+
+	/* Tab of the extents, NULL once the tab is closed */
+	struct znr_gui_extents_tab *tab;
+
+	/*
+	 * Tab extents indexes in list order, sorted on sort_col, or in
+	 * extents order if sort_col is negative.
+	 */
+	unsigned int		*order;
+	unsigned int		nr_extents;
+	int			sort_col;
+	bool			sort_desc;
+};
+
+/*
+ * GUI I/O requests. All zone reports and extent requests are executed by a
+ * single I/O worker thread, in order, so that a slow server or a large reply
+ * does not block the GTK main loop. Requests are completed on the main loop.
+ */
+enum znr_gui_io_type {
+	ZNR_GUI_IO_STOP,
+	ZNR_GUI_IO_REPORT_BLOCKGROUPS,
+	ZNR_GUI_IO_BLOCKGROUP_EXTENTS,
+	ZNR_GUI_IO_FILE_EXTENTS,
+};
+
+/*
+ * Events sent by the I/O worker to the main loop: extents received for a
+ * blockgroup tab, or the completion of a request.
+ */
+struct znr_gui_io_event {
+	struct znr_gui_io	*io;
+	struct znr_extent	*extents;
+	unsigned int		nr_extents;
+	bool			done;
+
+	/* State changes to apply after reconnecting to the server */
+	struct znr_net_resync	*rs;
 };
 
-/* Convert macros to string for CSS properties */
-#define STRINGIFY(x)    #x
-#define TOSTRING(x)     STRINGIFY(x)
+struct znr_gui_io {
+	enum znr_gui_io_type	type;
+	GCancellable		*cancellable;
+	int			ret;
+	bool			quiet;
+	bool			auto_refresh;
+
+	/*
+	 * Completion event and callbacks, called on the main loop: recv for
+	 * the extents received if the request is not cancelled, and done
+	 * once the request completes.
+	 */
+	struct znr_gui_io_event	ev;
+	unsigned int		nr_recv;
+	void (*recv)(struct znr_gui_io *io, struct znr_extent *extents,
+		     unsigned int nr_extents);
+	void (*done)(struct znr_gui_io *io);
+
+	/* Blockgroups report, and the zones reported */
+	unsigned int		bg_no;
+	unsigned int		nr_bgs;
+	unsigned int		zno;
+	unsigned int		nr_zones;
+	struct blk_zone		*zones;
+
+	/* Blockgroup tab to fill and extent range */
+	struct znr_gui_extents_tab *tab;
+	unsigned long long	sector;
+	unsigned long long	nr_sectors;
+
+	/* File extents, obtained with a batch request */
+	char			**paths;
+	struct znr_batch_req	*reqs;
+	unsigned int		nr_reqs;
+};
 
-/* CSS constants */
+/* Blockgroup map layout constants */
 #define ZNR_GUI_BLOCKGROUP_MARGIN     2
 #define ZNR_GUI_BLOCKGROUP_MARGINS    (ZNR_GUI_BLOCKGROUP_MARGIN * 2)
 
+/*
+ * Extents narrower than this number of pixels are not outlined: the pixel
+ * columns they cover are merged into spans drawn in one rectangle each.
+ */
+#define ZNR_GUI_EXTENT_MIN_WIDTH	4
+
 static const char *znr_gui_css_data =
 	/* Scrollbar styling */
 	"scrollbar.vertical slider {"
@@ -62,17 +234,13 @@ static const char *znr_gui_css_data =
 	"   border: 2px solid #727272ff;"
 	"   border-radius: 5px;"
 	"}"
-	/* Blockgroup grid background color */
+	/* Blockgroup map background color */
 	"flowbox {"
 	"   background-color: #8a8484ff;"
 	"}"
-	"gridview {"
+	"blockgroupmap {"
 	"   background-color: #8a8484ff;"
 	"}"
-	"gridview > child {"
-	"   padding: 0px;"
-	"   margin: " TOSTRING(ZNR_GUI_BLOCKGROUP_MARGIN) "px;"
-	"}"
 	/* Auto refresh toggle button active state */
 	"button.auto-refresh:checked {"
 	"   background-color: #468ee6ff;"
@@ -81,8 +249,36 @@ static const char *znr_gui_css_data =
 
 /* GUI constants */
 #define ZNR_GUI_MAX_ZOOM_OUT		10
+
+/*
+ * Minimap: maximum number of blockgroups (pixels) per row of the minimap
+ * texture and width of the minimap widget.
+ */
+#define ZNR_GUI_MINIMAP_MAX_COLS	64
+#define ZNR_GUI_MINIMAP_WIDTH		64
+
+/*
+ * Maximum number of levels of detail of the map.
+ */
+#define ZNR_GUI_NR_LODS			32
+
+/*
+ * Colors of the numbers drawn in the blockgroup map.
+ */
+enum znr_gui_num_color {
+	ZNR_GUI_NUM_TEXT,
+	ZNR_GUI_NUM_EXTENT,
+
+	ZNR_GUI_NR_NUM_COLORS,
+};
 #define	ZNR_GUI_MIN_REFRESH_MS		200
 
+/*
+ * Default longest auto-refresh period of the adaptive mode, reached when no
+ * write pointer moves.
+ */
+#define ZNR_GUI_DEF_MAX_REFRESH_MS	10000
+
 /*
  * GUI data.
  */
@@ -107,17 +303,68 @@ struct znr_gui {
 	GtkWidget		*legend_frame;
 	GtkWidget		*show_blockgroup_entry;
 	GtkWidget		*refresh_ms_entry;
+	GtkWidget		*refresh_max_ms_entry;
 	GtkWidget		*bg_status;
 	GtkWidget		*search_entry;
 	GtkWidget		*search_file;
-	GtkWidget		*grid_view;
-	GListStore		*blockgroup_list;
 
 	/*
-	 * Tracks visible blockgroup drawing areas for updates
+	 * Blockgroup map: a single widget drawing all blockgroups in view.
+	 * hovered is the map cell under the pointer, UINT_MAX if none.
+	 * Only the blockgroups drawn in the last frame, from map_first to
+	 * map_last, have a cached render node, of size node_width x
+	 * node_height.
+	 */
+	GtkWidget		*map;
+	struct znr_gui_blockgroup *blockgroups;
+	unsigned int		hovered;
+	unsigned int		map_first;
+	unsigned int		map_last;
+	int			node_width;
+	int			node_height;
+
+	/*
+	 * Minimap: one RGBA pixel per blockgroup, in rows of minimap_cols
+	 * pixels. The pixels of the blockgroups changed are updated as the
+	 * blockgroups are published and the texture, NULL when the pixels
+	 * changed, is created again with the next minimap frame.
 	 */
-	GHashTable		*drawing_areas;
-	unsigned long long	visible_blockgroups_no;
+	GtkWidget		*minimap;
+	guint8			*minimap_pixels;
+	unsigned int		minimap_cols;
+	unsigned int		minimap_rows;
+	GdkTexture		*minimap_texture;
+	guint8			minimap_conv[4];
+	guint8			minimap_seq[4];
+	guint8			minimap_seqw[4];
+
+	/*
+	 * Levels of detail of the map: at level lod, each cell of the map is
+	 * the summary of 2^lod consecutive blockgroups, the cells of level 0
+	 * being the blockgroups. summary[] are the nr_lods levels of a tree of
+	 * summaries: summary[0] has one summary per blockgroup and each
+	 * summary of summary[k + 1] merges 2 summaries of summary[k], so that
+	 * a blockgroup change updates one summary per level. The blockgroups
+	 * being written, with a write rate, are listed in rated_bgs.
+	 */
+	unsigned int		lod;
+	unsigned int		nr_lods;
+	struct znr_gui_summary	*summary[ZNR_GUI_NR_LODS];
+	unsigned int		*rated_bgs;
+	unsigned int		nr_rated;
+
+	/*
+	 * Blockgroup map frames drawn, blockgroups drawn and redrawn, and
+	 * time spent building them. Blockgroup reports published and
+	 * blockgroups changed by them.
+	 */
+	unsigned long long	map_frames;
+	unsigned long long	map_bgs;
+	unsigned long long	map_nodes;
+	unsigned long long	map_us;
+	unsigned long long	map_max_us;
+	unsigned long long	map_reports;
+	unsigned long long	map_changed;
 
 	/*
 	 * Blockgroup grid control.
@@ -133,54 +380,143 @@ struct znr_gui {
 	GtkWidget		*extents_dialog;
 	AdwTabView		*extents_tab_view;
 
+	/*
+	 * I/O worker: requests are queued to io_queue and the events of
+	 * these requests to io_events. io_spinner shows if any of the nr_io
+	 * requests submitted is still in flight. view_io is the pending
+	 * report of the blockgroups in view, if any, cancelled if the view
+	 * is scrolled away before it is executed.
+	 */
+	GThread			*io_thread;
+	GAsyncQueue		*io_queue;
+	GAsyncQueue		*io_events;
+	unsigned int		nr_io;
+	GtkWidget		*io_spinner;
+	struct znr_gui_io	*view_io;
+
+	/*
+	 * Zones and blockgroups double buffering: the I/O worker applies the
+	 * zone reports to the back buffer and maps the zones to the
+	 * blockgroups there. The main loop publishes the back buffer by
+	 * swapping it with the front buffer (znr.blk_zones and
+	 * znr.blockgroups), which it reads without locking. state_pending
+	 * is set while the back buffer holds a state not yet published.
+	 * state_lock serializes the worker updates of the back buffer with
+	 * the swaps and the changes to the front buffer on the main loop.
+	 * The blockgroups of the back buffer that differ from the front buffer
+	 * are listed in changed_bgs, for redrawing only these once published.
+	 * The blockgroups reported in the back buffer range from back_first
+	 * to back_last. Without a state pending, the back buffer differs from
+	 * the front buffer only for the blockgroups from stale_first to
+	 * stale_last and their zones, which the worker copies from the front
+	 * buffer before applying a report. report_us and back_report_us are
+	 * the times of the last report of each blockgroup, for the front and
+	 * back buffers, from which the write rates are computed.
+	 */
+	GMutex			state_lock;
+	struct blk_zone		*back_zones;
+	struct znr_bg		*back_blockgroups;
+	bool			state_pending;
+	bool			*back_changed;
+	unsigned int		*changed_bgs;
+	unsigned int		nr_changed;
+	unsigned int		back_first;
+	unsigned int		back_last;
+	unsigned int		stale_first;
+	unsigned int		stale_last;
+	gint64			*report_us;
+	gint64			*back_report_us;
+
 	/*
 	 * The GUI will do a blockgroup report for only the blockgroups in
-	 * view every refresh_ms milli-seconds.
+	 * view every refresh_ms milli-seconds. In adaptive mode, refresh_ms is
+	 * the shortest period: the period, refresh_cur_ms, is set back to
+	 * refresh_ms when write pointers move, and doubled up to
+	 * refresh_max_ms after each report finding none moving.
+	 * refresh_source is the timeout of the next refresh.
 	 */
 	unsigned int		refresh_ms;
+	unsigned int		refresh_max_ms;
+	bool			refresh_adaptive;
+	unsigned int		refresh_cur_ms;
+	guint			refresh_source;
 };
 
 static struct znr_gui znrg;
 
-#define ZNR_TYPE_BLOCKGROUP_ITEM	znr_blockgroup_item_get_type()
-G_DECLARE_FINAL_TYPE(znr_blockgroup_item, znr_blockgroup_item,
-		     ZNR, BLOCKGROUP_ITEM, GObject)
-
-struct _znr_blockgroup_item {
-	GObject parent;
-	unsigned int bg_no;
-	struct znr_bg *bg;
-};
+/*
+ * Blockgroup map widget. The map draws the blockgroups in view in a single
+ * snapshot and is scrolled vertically with its vertical adjustment
+ * (GtkScrollable), so that the number of blockgroups does not change the
+ * number of widgets. The blockgroup under the pointer is found from the
+ * pointer coordinates.
+ */
+#define ZNR_TYPE_BLOCKGROUP_MAP		znr_blockgroup_map_get_type()
+G_DECLARE_FINAL_TYPE(znr_blockgroup_map, znr_blockgroup_map,
+		     ZNR, BLOCKGROUP_MAP, GtkWidget)
 
-G_DEFINE_TYPE(znr_blockgroup_item, znr_blockgroup_item, G_TYPE_OBJECT)
+struct _znr_blockgroup_map {
+	GtkWidget		parent;
 
-static GtkWidget *znr_gui_create_grid(void);
+	GtkAdjustment		*hadj;
+	GtkAdjustment		*vadj;
+	GtkScrollablePolicy	hscroll_policy;
+	GtkScrollablePolicy	vscroll_policy;
 
-static void znr_blockgroup_item_init(znr_blockgroup_item *item)
-{
-	item->bg_no = 0;
-	item->bg = NULL;
-}
+	/* Blockgroup and extent numbers text */
+	PangoLayout		*layout;
 
-/*
- * Note: znr_blockgroup_itemClass is generated by the macro above, hence
- * we can't avoid the camelcase.
- */
-static void znr_blockgroup_item_class_init(znr_blockgroup_itemClass *class) {}
+	/*
+	 * Digits atlas: the digits are shaped and rendered once for each color
+	 * of the numbers, which are drawn by appending the nodes of their
+	 * digits. The numbers font is monospace: all digits have the same
+	 * advance. digit_top and digit_height are the vertical extent of the
+	 * ink of all digits.
+	 */
+	GskRenderNode		*digits[ZNR_GUI_NR_NUM_COLORS][10];
+	PangoRectangle		digit_ink[10];
+	int			digit_advance;
+	int			digit_top;
+	int			digit_height;
+	int			digit_baseline;
+
+	/* Last pointer position, to update the hovered blockgroup on scroll */
+	bool			has_pointer;
+	double			pointer_x;
+	double			pointer_y;
 
-static znr_blockgroup_item *znr_blockgroup_item_new(unsigned int bg_no,
-						    struct znr_bg *bg)
-{
-	znr_blockgroup_item *item =
-		g_object_new(ZNR_TYPE_BLOCKGROUP_ITEM, NULL);
+	/*
+	 * Pixel columns covered by narrow extents in a blockgroup, reused for
+	 * all blockgroups drawn and grown to the widest blockgroup.
+	 */
+	bool			*cover;
+	unsigned int		nr_cover_cols;
+};
 
-	item->bg_no = bg_no;
-	item->bg = bg;
+enum {
+	ZNR_MAP_PROP_0,
+	ZNR_MAP_PROP_HADJUSTMENT,
+	ZNR_MAP_PROP_VADJUSTMENT,
+	ZNR_MAP_PROP_HSCROLL_POLICY,
+	ZNR_MAP_PROP_VSCROLL_POLICY,
+};
 
-	return item;
-}
+G_DEFINE_TYPE_WITH_CODE(znr_blockgroup_map, znr_blockgroup_map,
+			GTK_TYPE_WIDGET,
+			G_IMPLEMENT_INTERFACE(GTK_TYPE_SCROLLABLE, NULL))
 
 static void znr_gui_update(void);
+static void znr_gui_extents_model_detach(znr_extents_model *model);
+static void znr_gui_minimap_update(unsigned int bg_no);
+static void znr_gui_minimap_update_all(void);
+static void znr_gui_map_redraw(void);
+static void znr_gui_blockgroup_invalidate(unsigned int bg_no);
+static void znr_gui_map_scroll_to(unsigned int bg_no);
+static void znr_gui_map_set_lod(unsigned int lod, unsigned int bg_no);
+static void znr_gui_summary_build(void);
+static void znr_gui_blockgroup_tab_info(struct znr_gui_extents_tab *tab,
+					unsigned int bg_no, int ret);
+static void znr_gui_refresh_done(unsigned int nr_moved);
 
 static void znr_gui_err(const char *msg, const char *fmt, ...)
 {
@@ -222,26 +558,19 @@ static struct znr_gui_extents_tab *znr_gui_get_current_extents_tab(void)
 }
 
 /*
- * Build extent information string for a file or a specific blockgroup.
+ * Build the extents information header of a file tab: the file and its
+ * number of extents. The extents are shown in the extents list of the tab.
  * Returns allocated string that must be freed by the caller, or NULL on error
  */
-static char *znr_gui_extent_info(struct znr_extent *extents,
-				 unsigned int nr_extents,
+static char *znr_gui_extent_info(unsigned int nr_extents,
 				 struct znr_fs_file *file)
 {
 	char *buf = NULL;
 	size_t buf_size;
 	size_t buf_offset = 0;
-	unsigned int i;
-	size_t len;
 
-	/*
-	 * Allocate buffer for extent information:
-	 * - Header: ~300 bytes (file path + extent count)
-	 * - Per extent: ~256 characters
-	 * - Safety margin: one extent.
-	 */
-	buf_size = 400 + (nr_extents + 1) * ZNR_FS_EXT_INFO_SIZE;
+	/* Header: ~300 bytes (file path + extent count) */
+	buf_size = 400 + strlen(file->path);
 	buf = calloc(buf_size, 1);
 	if (!buf) {
 		fprintf(stderr,
@@ -249,1229 +578,3635 @@ static char *znr_gui_extent_info(struct znr_extent *extents,
 		return NULL;
 	}
 
-	if (file)
-		buf_offset = snprintf(buf, buf_size,
-				      "<tt>"
-				      "<b>File</b>:          %s\n"
-				      "<b>Inode</b>:         %llu\n"
-				      "</tt>",
-				      file->path,
-				      file->ino);
+	buf_offset = snprintf(buf, buf_size,
+			      "<tt>"
+			      "<b>File</b>:          %s\n"
+			      "<b>Inode</b>:         %llu\n"
+			      "</tt>",
+			      file->path,
+			      file->ino);
+
+	if (!nr_extents)
+		snprintf(buf + buf_offset, buf_size - buf_offset,
+			 "\n<tt><i>No extents in this file</i></tt>");
+	else
+		snprintf(buf + buf_offset, buf_size - buf_offset,
+			 "<tt><b>Total Extents</b>: %u</tt>",
+			 nr_extents);
+
+	return buf;
+}
+
+static struct znr_gui_io *znr_gui_io_alloc(enum znr_gui_io_type type,
+					   GCancellable *cancellable)
+{
+	struct znr_gui_io *io;
+
+	io = calloc(1, sizeof(*io));
+	if (!io)
+		return NULL;
+
+	io->type = type;
+	if (cancellable)
+		io->cancellable = g_object_ref(cancellable);
+	else
+		io->cancellable = g_cancellable_new();
+	io->ev.io = io;
+	io->ev.done = true;
+
+	return io;
+}
 
-	if (!nr_extents) {
-		buf_offset +=
-			snprintf(buf + buf_offset, buf_size - buf_offset,
-				 "\n<tt><i>No extents in this %s</i></tt>",
-				 file ? "file" : "blockgroup");
-		return buf;
+static void znr_gui_io_free(struct znr_gui_io *io)
+{
+	if (io->reqs) {
+		znr_batch_clear(io->reqs, io->nr_reqs);
+		free(io->reqs);
 	}
+	g_strfreev(io->paths);
+	free(io->zones);
+	g_object_unref(io->cancellable);
+	free(io);
+}
 
-	buf_offset += snprintf(buf + buf_offset, buf_size - buf_offset,
-			       "<tt><b>Total Extents</b>: %u</tt>\n\n",
-			       nr_extents);
+static void znr_gui_io_update_spinner(void)
+{
+	char str[64];
 
-	for (i = 0; i < nr_extents; i++) {
-		len = strlen(extents[i].info);
-		if (len > buf_size - buf_offset) {
-			fprintf(stderr,
-				"Extent information buffer overflow\n");
-			goto out_err;
-		}
+	if (!znrg.io_spinner)
+		return;
 
-		strncpy(buf + buf_offset, extents[i].info,
-			buf_size - buf_offset);
-		buf_offset += len;
+	gtk_spinner_set_spinning(GTK_SPINNER(znrg.io_spinner),
+				    znrg.nr_io > 0);
+	if (znrg.nr_io) {
+		snprintf(str, sizeof(str), "%u request%s in flight",
+			 znrg.nr_io, znrg.nr_io > 1 ? "s" : "");
+		gtk_widget_set_tooltip_text(znrg.io_spinner, str);
+	} else {
+		gtk_widget_set_tooltip_text(znrg.io_spinner, "No request in flight");
 	}
+}
 
-	return buf;
+static void znr_gui_io_submit(struct znr_gui_io *io)
+{
+	znrg.nr_io++;
+	znr_gui_io_update_spinner();
+	g_async_queue_push(znrg.io_queue, io);
+}
 
-out_err:
-	free(buf);
-	return NULL;
+/*
+ * Clear the list of changed blockgroups. Called with state_lock held.
+ */
+static void znr_gui_clear_changed(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < znrg.nr_changed; i++)
+		znrg.back_changed[znrg.changed_bgs[i]] = false;
+	znrg.nr_changed = 0;
 }
 
-static int znr_gui_report_blockgroups(unsigned int bg_start,
-				      unsigned int nr_blockgroups)
+/*
+ * Mark the blockgroups from @first to @last of the back buffer as differing
+ * from the front buffer. Called with state_lock held.
+ */
+static void znr_gui_back_stale(unsigned int first, unsigned int last)
 {
-	int ret;
+	if (znrg.stale_first >= znrg.stale_last) {
+		znrg.stale_first = first;
+		znrg.stale_last = last;
+		return;
+	}
 
-	if (bg_start >= znr.nr_blockgroups)
-		return 0;
+	znrg.stale_first = MIN(znrg.stale_first, first);
+	znrg.stale_last = MAX(znrg.stale_last, last);
+}
 
-	if (bg_start + nr_blockgroups > znr.nr_blockgroups)
-		nr_blockgroups = znr.nr_blockgroups - bg_start;
+/*
+ * Process the events sent by the I/O worker, in order, one per call.
+ */
+static gboolean znr_gui_io_event_cb(gpointer user_data)
+{
+	struct znr_gui_io_event *ev;
+	struct znr_gui_io *io;
+	int ret;
 
-	/* Get blockgroup information */
-	ret = znr_bg_refresh(&znr.dev, znr.blk_zones, znr.nr_zones,
-			     znr.blockgroups, bg_start, nr_blockgroups);
-	if (ret < 0) {
-		fprintf(stderr, "Get blockgroup information failed %d (%s)\n",
-			errno, strerror(errno));
-		return ret;
+	ev = g_async_queue_try_pop(znrg.io_events);
+	if (!ev)
+		return G_SOURCE_REMOVE;
+
+	if (ev->rs) {
+		/* The state prepared by the worker predates the resync */
+		g_mutex_lock(&znrg.state_lock);
+		ret = znr_resync(ev->rs);
+		znrg.state_pending = false;
+		znr_gui_clear_changed();
+		znr_gui_back_stale(0, znr.nr_blockgroups);
+		if (znrg.report_us)
+			memcpy(znrg.back_report_us, znrg.report_us,
+			       znr.nr_blockgroups * sizeof(gint64));
+		g_mutex_unlock(&znrg.state_lock);
+		if (ret)
+			fprintf(stderr, "Apply server state failed (%s)\n",
+				strerror(-ret));
+		free(ev->rs);
+		free(ev);
+		znr_gui_minimap_update_all();
+		znr_gui_summary_build();
+		znr_gui_update();
+		return G_SOURCE_REMOVE;
 	}
 
-	if ((unsigned int)ret != nr_blockgroups) {
-		fprintf(stderr, "Got %d blockgroups, expected %u blockgroups\n",
-			ret, nr_blockgroups);
-		return -EIO;
+	io = ev->io;
+	if (!ev->done) {
+		if (!g_cancellable_is_cancelled(io->cancellable))
+			io->recv(io, ev->extents, ev->nr_extents);
+		free(ev->extents);
+		free(ev);
+		return G_SOURCE_REMOVE;
 	}
 
-	return 0;
+	if (io->done)
+		io->done(io);
+
+	if (znrg.view_io == io)
+		znrg.view_io = NULL;
+	znr_gui_io_free(io);
+
+	znrg.nr_io--;
+	znr_gui_io_update_spinner();
+
+	return G_SOURCE_REMOVE;
 }
 
-struct znr_gui_blockgroup_report_info {
-        unsigned int starting_blockgroup;
-        unsigned int nr_blockgroups;
-};
+static void znr_gui_io_send_event(struct znr_gui_io_event *ev)
+{
+	g_async_queue_push(znrg.io_events, ev);
+	g_idle_add(znr_gui_io_event_cb, NULL);
+}
 
 /*
- * Doing a large blockgroup report can be expensive to drives with a large
- * number of zones, in such cases, the GUI can lock up while the operation is
- * pending. Instead, this function is to be called from a g_idle_add() context.
- * This allows the GUI to not lock up at the cost of slightly delaying a
- * blockreport.
+ * Extent walk callback of the I/O worker: pass a copy of the extents received
+ * to the main loop.
  */
-static gboolean znr_gui_deferred_report_blockgroups(gpointer data)
+static int znr_gui_io_extents_cb(struct znr_extent *extents,
+				 unsigned int nr_extents, void *data)
 {
-        struct znr_gui_blockgroup_report_info *bg_rep = data;
-        unsigned int start = bg_rep->starting_blockgroup;
-        unsigned int nr_bgs = bg_rep->nr_blockgroups;
-        int ret;
+	struct znr_gui_io *io = data;
+	struct znr_gui_io_event *ev;
 
-        ret = znr_gui_report_blockgroups(start, nr_bgs);
-	if (ret) {
-		znr_gui_err("Report Blockgroup Failed",
-			    "Blockgroup %u, %u blockgroups failed (%s)",
-			    start, nr_bgs, strerror(ret));
-                goto out;
+	if (g_cancellable_is_cancelled(io->cancellable))
+		return -ECANCELED;
+
+	ev = calloc(1, sizeof(*ev));
+	if (!ev)
+		return -ENOMEM;
+
+	ev->extents = malloc(nr_extents * sizeof(*extents));
+	if (!ev->extents) {
+		free(ev);
+		return -ENOMEM;
 	}
 
-        znr_gui_update();
-out:
-        free(data);
-        return G_SOURCE_REMOVE;
+	memcpy(ev->extents, extents, nr_extents * sizeof(*extents));
+	ev->nr_extents = nr_extents;
+	ev->io = io;
+	io->nr_recv++;
+	znr_gui_io_send_event(ev);
+
+	return 0;
 }
 
-static void znr_gui_update(void)
+static int znr_gui_io_report_zones(struct znr_gui_io *io)
 {
-	GHashTableIter iter;
-	gpointer key, value;
+	int ret;
 
-	if (!znrg.drawing_areas)
-		return;
+	if (!io->nr_zones)
+		return 0;
 
-	/*
-	 * The drawing_areas hash table tracks all currently-bound drawing areas
-	 * (blockgroups visible in the grid). znr_gui_update() is typically
-	 * invoked when there are changes (e.g., extents change). So let's queue
-	 * a redraw on all drawing areas to refresh blockgroup display.
-	 */
-	g_hash_table_iter_init(&iter, znrg.drawing_areas);
-	while (g_hash_table_iter_next(&iter, &key, &value))
-		gtk_widget_queue_draw(GTK_WIDGET(value));
+	ret = znr_dev_report_zones(&znr.dev, io->zno, io->zones,
+				   io->nr_zones);
+	if ((unsigned int)ret != io->nr_zones) {
+		fprintf(stderr, "Got %d zones, expected %u zones\n",
+			ret, io->nr_zones);
+		return ret < 0 && ret != -1 ? ret : -EIO;
+	}
+
+	return 0;
+}
+
+/*
+ * Test if the drawing or the status of a blockgroup differ between two
+ * states.
+ */
+static bool znr_gui_bg_changed(struct znr_bg *a, struct znr_bg *b)
+{
+	return a->sector != b->sector ||
+		a->nr_sectors != b->nr_sectors ||
+		a->wp_sector != b->wp_sector ||
+		a->flags != b->flags ||
+		a->nr_zones != b->nr_zones ||
+		(a->nr_zones && a->zones[0]->cond != b->zones[0]->cond);
 }
 
-static void znr_gui_blockgroup_draw_written(struct znr_bg *bg, cairo_t *cr,
-					    int width, int height)
+/*
+ * Copy the blockgroups from @first to @last and their zones from the front
+ * buffer to the back buffer. The zone pointers of the blockgroups copied are
+ * rebased to the back buffer zones. Called with state_lock held.
+ */
+static void znr_gui_io_sync_back(unsigned int first, unsigned int last)
 {
-	long long w;
+	unsigned int i, j, zno, nr_zones;
+	struct znr_bg *bg;
 
-	if (!bg->nr_zones)
+	if (first >= last)
 		return;
 
-	if (bg->wp_sector == 0)
-		return;
+	if (znr_bg_get_zone_range(&znr.dev, &znr.blockgroups[first],
+				  last - first, &zno, &nr_zones)) {
+		zno = 0;
+		nr_zones = znr.nr_zones;
+	}
 
-	/* Written space in blockgroup */
-	w = (long long)width *
-		bg->wp_sector / bg->nr_sectors;
-	if (w > width)
-		w = width;
+	memcpy(&znrg.back_zones[zno], &znr.blk_zones[zno],
+	       nr_zones * sizeof(struct blk_zone));
+	memcpy(&znrg.back_blockgroups[first], &znr.blockgroups[first],
+	       (last - first) * sizeof(struct znr_bg));
 
-	gdk_cairo_set_source_rgba(cr, &znrg.color_seqw);
-	cairo_rectangle(cr, 0, 0, w, height);
-	cairo_fill(cr);
+	for (i = first; i < last; i++) {
+		bg = &znrg.back_blockgroups[i];
+		for (j = 0; j < bg->nr_zones; j++)
+			bg->zones[j] = znrg.back_zones +
+				(bg->zones[j] - znr.blk_zones);
+	}
 }
 
-static void znr_gui_blockgroup_draw_num(struct znr_gui_blockgroup *blockgroup,
-					cairo_t *cr, int width, int height)
+/*
+ * Apply the zones reported to the back buffer and map them to the
+ * blockgroups reported. The back buffer is first synchronized with the front
+ * buffer, unless it already holds a state not yet published, which is more
+ * recent. Only the blockgroups differing from the front buffer are copied,
+ * so that the cost of an update is proportional to the blockgroups reported
+ * and not to the device size. The blockgroups reported that changed are added
+ * to the changed list.
+ */
+static int znr_gui_io_update_state(struct znr_gui_io *io)
 {
-	cairo_text_extents_t te;
-	char str[16];
+	unsigned int i;
+	gint64 now;
+	int ret;
 
-	/* Draw blockgroup number */
-	gdk_cairo_set_source_rgba(cr, &znrg.color_text);
-	cairo_select_font_face(cr, "Monospace",
-			       CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
-	cairo_set_font_size(cr, 10);
+	g_mutex_lock(&znrg.state_lock);
 
-	snprintf(str, sizeof(str), "%u", blockgroup->bg_no);
-	cairo_text_extents(cr, str, &te);
-	cairo_move_to(cr,
-		      width / 2 - te.width / 2 - te.x_bearing,
-		      height / 2 - te.height / 2 - te.y_bearing);
-	cairo_show_text(cr, str);
-}
+	if (!znrg.state_pending) {
+		znr_gui_io_sync_back(znrg.stale_first, znrg.stale_last);
+		znrg.stale_first = 0;
+		znrg.stale_last = 0;
+		znrg.back_first = io->bg_no;
+		znrg.back_last = io->bg_no + io->nr_bgs;
+	} else {
+		znrg.back_first = MIN(znrg.back_first, io->bg_no);
+		znrg.back_last = MAX(znrg.back_last, io->bg_no + io->nr_bgs);
+	}
 
-static bool znr_gui_blockgroup_tab_open(struct znr_gui_blockgroup *blockgroup,
-					struct znr_gui_extents_tab **ext_tab)
+	now = g_get_monotonic_time();
+	for (i = io->bg_no; i < io->bg_no + io->nr_bgs; i++)
+		znrg.back_report_us[i] = now;
 
-{
-	AdwTabPage *page;
-	struct znr_gui_extents_tab *tab;
-	struct znr_gui_extents_tab *in_focus = znr_gui_get_current_extents_tab();
-	int nr_pages, i;
+	memcpy(&znrg.back_zones[io->zno], io->zones,
+	       io->nr_zones * sizeof(struct blk_zone));
 
-	if (!in_focus->blockgroup)
-		return false;
+	/* Map the blockgroups reported to the back buffer zones */
+	ret = znr_bg_map_zones_to_blockgroups(
+			&znrg.back_blockgroups[io->bg_no], io->nr_bgs,
+			&znrg.back_zones[io->zno], io->nr_zones);
+	if (ret) {
+		/* Drop the back buffer changes */
+		znrg.state_pending = false;
+		znr_gui_clear_changed();
+		znr_gui_back_stale(znrg.back_first, znrg.back_last);
+		memcpy(&znrg.back_report_us[znrg.back_first],
+		       &znrg.report_us[znrg.back_first],
+		       (znrg.back_last - znrg.back_first) * sizeof(gint64));
+		goto unlock;
+	}
 
-	nr_pages = adw_tab_view_get_n_pages(znrg.extents_tab_view);
-	for (i = 0; i < nr_pages; ++i) {
-		page = adw_tab_view_get_nth_page(znrg.extents_tab_view, i);
-		if (!page)
+	for (i = io->bg_no; i < io->bg_no + io->nr_bgs; i++) {
+		if (znrg.back_changed[i] ||
+		    !znr_gui_bg_changed(&znrg.back_blockgroups[i],
+					&znr.blockgroups[i]))
 			continue;
+		znrg.back_changed[i] = true;
+		znrg.changed_bgs[znrg.nr_changed++] = i;
+	}
+	znrg.state_pending = true;
 
-		tab = g_object_get_data(G_OBJECT(page), "tab");
-		if (!tab || !tab->blockgroup)
-			continue;
+unlock:
+	g_mutex_unlock(&znrg.state_lock);
 
-		if (blockgroup == tab->blockgroup) {
-			*ext_tab = tab;
-			return true;
+	return ret;
+}
+
+/*
+ * Get the extents of a blockgroup. The walk is stopped as soon as the request
+ * is cancelled, the remaining extents of a server reply being discarded.
+ */
+static int znr_gui_io_blockgroup_extents(struct znr_gui_io *io)
+{
+	int ret;
+
+	ret = znr_fs_start_extents_in_range(io->sector, io->nr_sectors,
+					    znr_gui_io_extents_cb, io);
+	while (ret > 0) {
+		if (g_cancellable_is_cancelled(io->cancellable)) {
+			znr_fs_cancel_extents();
+			return -ECANCELED;
 		}
+		ret = znr_fs_poll_extents();
 	}
 
-	*ext_tab = NULL;
-	return false;
+	return ret;
 }
 
-static bool
-znr_gui_should_draw_blockgroup_extents(struct znr_gui_blockgroup *blockgroup,
-				       struct znr_gui_extents_tab **ext_tab)
+static void znr_gui_io_exec(struct znr_gui_io *io)
 {
-	struct znr_gui_extents_tab *tab = znr_gui_get_current_extents_tab();
+	switch (io->type) {
+	case ZNR_GUI_IO_REPORT_BLOCKGROUPS:
+		znr.ncli.req_class = ZNR_SCHED_REFRESH;
+		io->ret = znr_gui_io_report_zones(io);
+		if (!io->ret && io->nr_zones)
+			io->ret = znr_gui_io_update_state(io);
+		break;
+	case ZNR_GUI_IO_BLOCKGROUP_EXTENTS:
+		znr.ncli.req_class = ZNR_SCHED_INTERACTIVE;
+		io->ret = znr_gui_io_blockgroup_extents(io);
+		break;
+	case ZNR_GUI_IO_FILE_EXTENTS:
+		znr.ncli.req_class = ZNR_SCHED_INTERACTIVE;
+		io->ret = znr_batch_exec(io->reqs, io->nr_reqs);
+		break;
+	default:
+		io->ret = -EINVAL;
+		break;
+	}
+}
 
-	if (!tab)
-		return false;
+/*
+ * Reconnect to the server after a request failed due to the loss of the
+ * connection and pass the state changes since the last synchronization to the
+ * main loop, ahead of the results of the request executed again. Extents
+ * already passed to the main loop cannot be taken back: the request then fails.
+ */
+static bool znr_gui_io_reconnect(struct znr_gui_io *io)
+{
+	struct znr_gui_io_event *ev;
+	struct znr_net_resync *rs;
+	int ret;
 
-	if (!blockgroup || !blockgroup->bg)
+	if (!znr.is_net_client || !znr_net_disconnected(io->ret))
 		return false;
 
-	if (!znrg.extents_tab_view)
+	ev = calloc(1, sizeof(*ev));
+	rs = calloc(1, sizeof(*rs));
+	if (!ev || !rs) {
+		free(ev);
+		free(rs);
 		return false;
+	}
 
-	/*
-	 * If a blockgroup tab is in focus, allow drawing extents for all
-	 * blockgroup tabs
-	 */
-	if (znr_gui_blockgroup_tab_open(blockgroup, ext_tab))
-		return true;
+	fprintf(stderr, "Lost connection to the server, reconnecting...\n");
 
-	/* If a file tab is in focus, draw extents for that file */
-	if (tab->file) {
-		*ext_tab = tab;
-		return true;
+	ret = znr_net_reconnect(&znr.ncli, rs);
+	if (ret) {
+		fprintf(stderr, "Reconnect failed (%s)\n", strerror(-ret));
+		free(ev);
+		free(rs);
+		return false;
 	}
 
-	return false;
-}
+	ev->rs = rs;
+	znr_gui_io_send_event(ev);
 
-static inline bool znr_gui_extent_in_blockgroup(struct znr_extent *ext,
-						struct znr_bg *bg)
-{
-	return ext->sector >= bg->sector &&
-		ext->sector + ext->nr_sectors <= bg->sector + bg->nr_sectors;
+	return !io->nr_recv;
 }
 
-static void
-znr_gui_blockgroup_draw_extents(struct znr_gui_blockgroup *blockgroup,
-				cairo_t *cr, int width, int height)
+/*
+ * I/O worker thread: the only thread using the device, file system and
+ * server connection once the GUI is running.
+ */
+static gpointer znr_gui_io_thread(gpointer data)
 {
-	unsigned long long bg_sect, bg_len;
-	struct znr_gui_extents_tab *tab = NULL;
-	struct znr_bg *bg = blockgroup->bg;
-	double x, y, w, h, ext_x, ext_w;
-	cairo_text_extents_t te;
-	struct znr_extent *ext;
-	unsigned int i;
-	char str[16];
-
-	if (!znr_gui_should_draw_blockgroup_extents(blockgroup, &tab))
-		return;
-
-	bg_sect = bg->sector;
-	bg_len = bg->nr_sectors;
+	struct znr_gui_io *io;
 
-	/* Set up drawing style and line width for the extents highlight. */
-	gdk_cairo_set_source_rgba(cr, &znrg.color_extent);
-	cairo_set_font_size(cr, 10);
-	cairo_set_line_width(cr, 3);
-	cairo_select_font_face(cr, "Monospace",
-			       CAIRO_FONT_SLANT_NORMAL,
-			       CAIRO_FONT_WEIGHT_BOLD);
+	while (true) {
+		io = g_async_queue_pop(znrg.io_queue);
+		if (io->type == ZNR_GUI_IO_STOP) {
+			znr_gui_io_free(io);
+			break;
+		}
 
-	/* Set drawing area with small margin */
-	x = 1;
-	y = 1;
-	w = width - 2;
-	h = height - 2;
+		/* Skip requests that became stale while queued */
+		if (g_cancellable_is_cancelled(io->cancellable)) {
+			io->ret = -ECANCELED;
+		} else {
+			znr_gui_io_exec(io);
+			if (znr_gui_io_reconnect(io)) {
+				if (io->reqs)
+					znr_batch_clear(io->reqs, io->nr_reqs);
+				znr_gui_io_exec(io);
+			}
+		}
 
-	for (i = 0; i < tab->nr_extents; i++) {
-		ext = &tab->extents[i];
-		if (!znr_gui_extent_in_blockgroup(ext, bg))
-			continue;
+		znr_gui_io_send_event(&io->ev);
+	}
 
-		/*
-		 * Calculate the extent rectangle position and width as a
-		 * percentage of the blockgroup.
-		 */
-		ext_x = ((ext->sector - bg_sect) * w) / bg_len;
-		ext_w = (ext->nr_sectors * w) / bg_len;
+	return NULL;
+}
 
-		/* Draw extent rectangle (no colour fill) */
-		cairo_rectangle(cr, x + ext_x, y, ext_w, h);
-		cairo_stroke(cr);
+static int znr_gui_io_start(void)
+{
+	unsigned int i;
+	gint64 now;
+
+	/* Zones and blockgroups back buffer */
+	if (znr.nr_zones) {
+		znrg.back_zones = calloc(znr.nr_zones,
+					 sizeof(struct blk_zone));
+		znrg.back_blockgroups = calloc(znr.nr_blockgroups,
+					       sizeof(struct znr_bg));
+		znrg.back_changed = calloc(znr.nr_blockgroups, sizeof(bool));
+		znrg.changed_bgs = calloc(znr.nr_blockgroups,
+					  sizeof(unsigned int));
+		znrg.report_us = calloc(znr.nr_blockgroups, sizeof(gint64));
+		znrg.back_report_us = calloc(znr.nr_blockgroups,
+					     sizeof(gint64));
+		if (!znrg.back_zones || !znrg.back_blockgroups ||
+		    !znrg.back_changed || !znrg.changed_bgs ||
+		    !znrg.report_us || !znrg.back_report_us)
+			return -ENOMEM;
+
+		now = g_get_monotonic_time();
+		for (i = 0; i < znr.nr_blockgroups; i++) {
+			znrg.report_us[i] = now;
+			znrg.back_report_us[i] = now;
+		}
 
-		/* Draw extent number */
-		sprintf(str, "%d", ext->idx);
-		cairo_text_extents(cr, str, &te);
+		/* The back buffer is synchronized on the first report */
+		znrg.stale_first = 0;
+		znrg.stale_last = znr.nr_blockgroups;
+	}
 
-		/*
-		 * With heavily fragmented files, only draw the extent number
-		 * if it fits in the extent
-		 */
-		if (te.width > ext_w / 2)
-			continue;
+	znrg.io_queue = g_async_queue_new();
+	znrg.io_events = g_async_queue_new();
+	znrg.io_thread = g_thread_try_new("zonar-io", znr_gui_io_thread,
+					  NULL, NULL);
+	if (!znrg.io_thread)
+		return -ENOMEM;
 
-		cairo_move_to(cr,
-			x + ext_x + ext_w / 2 - te.width / 2 - te.x_bearing,
-			y + h - 10);
-		cairo_show_text(cr, str);
-	}
+	return 0;
 }
 
-static void znr_gui_blockgroup_draw_cb(GtkDrawingArea *drawing_area,
-				       cairo_t *cr, int width, int height,
-				       gpointer user_data)
+static void znr_gui_io_stop(void)
 {
-	struct znr_gui_blockgroup *blockgroup = user_data;
-	struct znr_bg *bg = blockgroup->bg;
-	char info[256];
-	char wp[32];
-	char type[32];
-	char usage [8];
-	GdkRGBA fg_color;
-
-	if (!bg)
-		return;
-
-	/* Draw blockgroup background based on type in flags field */
-	if (bg->flags == BLK_ZONE_TYPE_CONVENTIONAL) {
-		gdk_cairo_set_source_rgba(cr, &znrg.color_conv);
-	} else if (bg->flags == BLK_ZONE_TYPE_SEQWRITE_REQ) {
-		gdk_cairo_set_source_rgba(cr, &znrg.color_seq);
-	} else {
-		fprintf(stderr, "Unknown blockgroup type: %u\n", bg->flags);
-		gdk_cairo_set_source_rgba(cr, &znrg.color_seq);
+	struct znr_gui_io_event *ev;
+	struct znr_gui_io *io;
+
+	if (znrg.io_thread) {
+		/* Stop the worker ahead of the requests still queued */
+		io = znr_gui_io_alloc(ZNR_GUI_IO_STOP, NULL);
+		if (!io) {
+			fprintf(stderr, "Failed to stop I/O worker\n");
+			return;
+		}
+		g_async_queue_push_front(znrg.io_queue, io);
+		g_thread_join(znrg.io_thread);
+		znrg.io_thread = NULL;
 	}
-	cairo_rectangle(cr, 0, 0, width, height);
-	cairo_fill(cr);
-
-	znr_gui_blockgroup_draw_written(bg, cr, width, height);
-
-	/* Draw file extents */
-	znr_gui_blockgroup_draw_extents(blockgroup, cr, width, height);
 
-	/* Draw blockgroup number */
-	znr_gui_blockgroup_draw_num(blockgroup, cr, width, height);
-
-	/* Draw selection highlight if blockgroup is selected */
-	if (blockgroup && znrg.show_blockgroup != UINT_MAX &&
-	    blockgroup->bg_no == znrg.show_blockgroup) {
-		gdk_cairo_set_source_rgba(cr, &znrg.color_jz);
-		cairo_set_line_width(cr, 4);
-		cairo_rectangle(cr, 2, 2, width - 4, height - 4);
-		cairo_stroke(cr);
-		znrg.show_blockgroup = UINT_MAX;
+	if (znrg.io_queue) {
+		while ((io = g_async_queue_try_pop(znrg.io_queue)))
+			znr_gui_io_free(io);
+		g_async_queue_unref(znrg.io_queue);
+		znrg.io_queue = NULL;
 	}
 
-	/* Draw hover highlight if blockgroup is hovered */
-	if (blockgroup && blockgroup->hovered) {
-		gtk_widget_get_color(blockgroup->da, &fg_color);
-		gdk_cairo_set_source_rgba(cr, &fg_color);
-		cairo_set_line_width(cr, 3);
-		cairo_rectangle(cr, 1, 1, width - 2, height - 2);
-		cairo_stroke(cr);
-
-		/* Render Blockgroup info in hover overview */
-		if (bg->flags == BLK_ZONE_TYPE_SEQWRITE_REQ) {
-			if (bg->nr_zones == 1 &&
-			    bg->zones[0]->cond == BLK_ZONE_COND_FULL) {
-				snprintf(wp, sizeof(wp), "N/A");
-				snprintf(usage, sizeof(usage), "100%%");
-			} else if (bg->nr_zones == 1) {
-				snprintf(wp, sizeof(wp), "0x%lx", bg->wp_sector);
-				snprintf(usage, sizeof(usage), "%lu%%",
-					 bg->wp_sector * 100 / bg->nr_sectors);
+	if (znrg.io_events) {
+		while ((ev = g_async_queue_try_pop(znrg.io_events))) {
+			if (ev->rs) {
+				znr_net_free_resync(ev->rs);
+				free(ev->rs);
+				free(ev);
+			} else if (ev->done) {
+				znr_gui_io_free(ev->io);
 			} else {
-				/* todo: Likely RAID, we need to revise */
-				snprintf(wp, sizeof(wp), "Unknown");
-				snprintf(usage, sizeof(usage), "N/A");
-				fprintf(stderr,
-					"Unsupported number of zones in blockgroups");
+				free(ev->extents);
+				free(ev);
 			}
-
-			snprintf(type, sizeof(type), "Sequential Write Required");
-		} else if (bg->flags == BLK_ZONE_TYPE_CONVENTIONAL) {
-			snprintf(wp, sizeof(wp), "N/A");
-			snprintf(type, sizeof(type), "Conventional");
-			snprintf(usage, sizeof(usage), "N/A");
-		} else {
-			snprintf(wp, sizeof(wp), "Unknown");
-			snprintf(type, sizeof(type), "Unknown");
-			snprintf(usage, sizeof(usage), "Unknown");
 		}
-
-		snprintf(info, sizeof(info),
-			 "Blockgroup [%u]: %s • Start: 0x%lx Size: 0x%lx sectors • WP: %s • Usage: %s",
-			 blockgroup->bg_no, type, bg->sector, bg->nr_sectors,
-			 wp, usage);
-		gtk_editable_set_text(GTK_EDITABLE(znrg.bg_status), info);
+		g_async_queue_unref(znrg.io_events);
+		znrg.io_events = NULL;
 	}
+
+	znrg.view_io = NULL;
+	znrg.nr_io = 0;
+
+	/* The front buffer is freed with the device */
+	free(znrg.back_zones);
+	znrg.back_zones = NULL;
+	free(znrg.back_blockgroups);
+	znrg.back_blockgroups = NULL;
+	free(znrg.back_changed);
+	znrg.back_changed = NULL;
+	free(znrg.changed_bgs);
+	znrg.changed_bgs = NULL;
+	free(znrg.report_us);
+	znrg.report_us = NULL;
+	free(znrg.back_report_us);
+	znrg.back_report_us = NULL;
+	znrg.nr_changed = 0;
+	znrg.state_pending = false;
 }
 
-static gboolean znr_gui_blockgroup_enter_cb(GtkWidget *widget,
-					    gpointer user_data)
+/*
+ * Number of cells of the map at the level of detail @lod.
+ */
+static unsigned int znr_gui_nr_cells(unsigned int lod)
 {
-	struct znr_gui_blockgroup *blockgroup = user_data;
+	unsigned long long nr = znr.nr_blockgroups;
 
-	if (!blockgroup || !widget || !blockgroup->da)
-		return FALSE;
-
-	blockgroup->hovered = true;
-	gtk_widget_queue_draw(blockgroup->da);
-
-	return FALSE;
+	return (nr + (1ULL << lod) - 1) >> lod;
 }
 
-static gboolean znr_gui_blockgroup_leave_cb(GtkWidget *widget,
-					    gpointer user_data)
+/*
+ * Summary of the blockgroup @bg, with a write rate of @rate.
+ */
+static void znr_gui_summary_set_bg(struct znr_gui_summary *s,
+				   struct znr_bg *bg, unsigned long long rate)
 {
-	struct znr_gui_blockgroup *blockgroup = user_data;
+	memset(s, 0, sizeof(*s));
+	s->nr_bgs = 1;
+	s->max_rate = rate;
 
-	if (!blockgroup || !widget || !blockgroup->da)
-		return FALSE;
+	if (bg->flags == BLK_ZONE_TYPE_CONVENTIONAL) {
+		s->nr_conv = 1;
+		return;
+	}
 
-	blockgroup->hovered = false;
-	gtk_widget_queue_draw(blockgroup->da);
+	s->nr_sectors = bg->nr_sectors;
+	s->wp_sectors = MIN(bg->wp_sector, bg->nr_sectors);
+	if (!bg->nr_zones)
+		return;
 
-	return FALSE;
+	switch (bg->zones[0]->cond) {
+	case BLK_ZONE_COND_IMP_OPEN:
+	case BLK_ZONE_COND_EXP_OPEN:
+	case BLK_ZONE_COND_CLOSED:
+		s->nr_active = 1;
+		break;
+	case BLK_ZONE_COND_FULL:
+		s->nr_full = 1;
+		s->wp_sectors = bg->nr_sectors;
+		break;
+	default:
+		break;
+	}
 }
 
-static void znr_gui_close_extents_tab(struct znr_gui_extents_tab *tab)
+/*
+ * Merge the 2 summaries of the level @lod - 1 below the summary @i of the
+ * level @lod, the last summary of a level possibly having only one.
+ */
+static void znr_gui_summary_merge(unsigned int lod, unsigned int i)
 {
-	if (!tab || !tab->page)
+	struct znr_gui_summary *s = &znrg.summary[lod][i];
+	struct znr_gui_summary *b;
+
+	*s = znrg.summary[lod - 1][i * 2];
+	if (i * 2 + 1 >= znr_gui_nr_cells(lod - 1))
 		return;
 
-	g_object_set_data(G_OBJECT(tab->page), "tab", (gpointer)NULL);
-	if (tab->blockgroup)
-		tab->blockgroup->tab = NULL;
-	else if (tab->file)
-		znr_fs_free_file(tab->file);
+	b = &znrg.summary[lod - 1][i * 2 + 1];
+	s->nr_bgs += b->nr_bgs;
+	s->nr_conv += b->nr_conv;
+	s->nr_active += b->nr_active;
+	s->nr_full += b->nr_full;
+	s->nr_sectors += b->nr_sectors;
+	s->wp_sectors += b->wp_sectors;
+	s->max_rate = MAX(s->max_rate, b->max_rate);
+}
 
-	free(tab->extents);
-	free(tab);
+/*
+ * Update the summaries of the blockgroup @bg_no, with a write rate of @rate,
+ * at all levels.
+ */
+static void znr_gui_summary_update(unsigned int bg_no,
+				   unsigned long long rate)
+{
+	unsigned int lod;
+
+	if (!znrg.nr_lods)
+		return;
+
+	znr_gui_summary_set_bg(&znrg.summary[0][bg_no],
+			       &znr.blockgroups[bg_no], rate);
+	for (lod = 1; lod < znrg.nr_lods; lod++)
+		znr_gui_summary_merge(lod, bg_no >> lod);
 }
 
-static void znr_gui_close_all_extents_tabs(void)
+/*
+ * Summarize all blockgroups again, keeping their write rate.
+ */
+static void znr_gui_summary_build(void)
 {
-	struct znr_gui_extents_tab *tab;
-	AdwTabPage *page;
-	int nr_pages, i;
+	unsigned int lod, i;
 
-	if (!znrg.extents_dialog)
+	if (!znrg.nr_lods)
 		return;
 
-	nr_pages = adw_tab_view_get_n_pages(znrg.extents_tab_view);
-	for (i = 0; i < nr_pages; ++i) {
-		page = adw_tab_view_get_nth_page(znrg.extents_tab_view, i);
-		if (!page)
-			return;
-		tab = g_object_get_data(G_OBJECT(page), "tab");
-		znr_gui_close_extents_tab(tab);
+	for (i = 0; i < znr.nr_blockgroups; i++)
+		znr_gui_summary_set_bg(&znrg.summary[0][i],
+				       &znr.blockgroups[i],
+				       znrg.summary[0][i].max_rate);
+
+	for (lod = 1; lod < znrg.nr_lods; lod++) {
+		for (i = 0; i < znr_gui_nr_cells(lod); i++)
+			znr_gui_summary_merge(lod, i);
 	}
 }
 
-static void znr_gui_close_extents_dialog(void)
+/*
+ * Update the summaries of the blockgroup @bg_no published, with its write
+ * rate since its previous state @old, reported @us micro-seconds earlier.
+ */
+static void znr_gui_summary_publish(unsigned int bg_no, struct znr_bg *old,
+				    gint64 us)
 {
-	if (!znrg.extents_dialog)
+	struct znr_bg *bg = &znr.blockgroups[bg_no];
+	unsigned long long rate = 0;
+
+	if (!znrg.nr_lods)
 		return;
 
-	znr_gui_close_all_extents_tabs();
-	gtk_window_close(GTK_WINDOW(znrg.extents_dialog));
+	if (bg->flags == BLK_ZONE_TYPE_SEQWRITE_REQ &&
+	    bg->wp_sector > old->wp_sector && us > 0)
+		rate = (bg->wp_sector - old->wp_sector) * G_USEC_PER_SEC / us;
 
-	znrg.extents_tab_view = NULL;
-	znrg.extents_dialog = NULL;
+	if (rate && !znrg.summary[0][bg_no].max_rate)
+		znrg.rated_bgs[znrg.nr_rated++] = bg_no;
 
-	znr_gui_update();
+	znr_gui_summary_update(bg_no, rate);
 }
 
-static void
-znr_gui_extents_dialog_close_cb(GtkWidget *widget __attribute__((unused)),
-				gpointer user_data)
+/*
+ * The blockgroups being written that were reported unchanged since the last
+ * state published are no longer written: drop their write rate. The
+ * blockgroups reported are approximated by the range of all reports.
+ */
+static void znr_gui_summary_expire_rates(void)
 {
-	znr_gui_close_extents_dialog();
+	unsigned int i = 0, bg_no;
+
+	while (i < znrg.nr_rated) {
+		bg_no = znrg.rated_bgs[i];
+		if (!znrg.back_changed[bg_no] &&
+		    bg_no >= znrg.back_first && bg_no < znrg.back_last)
+			znr_gui_summary_update(bg_no, 0);
+
+		if (znrg.summary[0][bg_no].max_rate)
+			i++;
+		else
+			znrg.rated_bgs[i] = znrg.rated_bgs[--znrg.nr_rated];
+	}
 }
 
-static gboolean znr_gui_extents_tab_close_cb(AdwTabView *tab_view,
-					AdwTabPage *page, gpointer user_data)
+static int znr_gui_summary_alloc(void)
 {
-	struct znr_gui_extents_tab *tab;
+	unsigned long long nr = znr.nr_blockgroups;
+	unsigned int lod;
 
-	/* If this is the last tab, close the entire dialog */
-	if (adw_tab_view_get_n_pages(tab_view) == 1) {
-		znr_gui_close_extents_dialog();
-		return GDK_EVENT_STOP;
-	}
+	if (!nr)
+		return 0;
 
-	tab = (struct znr_gui_extents_tab *)
-		g_object_get_data(G_OBJECT(page), "tab");
-	if (tab) {
-		znr_gui_close_extents_tab(tab);
-		znr_gui_update();
+	znrg.rated_bgs = calloc(nr, sizeof(unsigned int));
+	if (!znrg.rated_bgs)
+		return -ENOMEM;
+
+	for (lod = 0; lod < ZNR_GUI_NR_LODS; lod++) {
+		znrg.summary[lod] = calloc(nr, sizeof(struct znr_gui_summary));
+		if (!znrg.summary[lod])
+			return -ENOMEM;
+		znrg.nr_lods = lod + 1;
+		if (nr == 1)
+			break;
+		nr = (nr + 1) / 2;
 	}
 
-	return GDK_EVENT_PROPAGATE;
+	znr_gui_summary_build();
+
+	return 0;
 }
 
-static void znr_gui_extents_tab_focus_cb(GObject *object, GParamSpec *pspec,
-					 gpointer __attribute__((unused)))
+static void znr_gui_summary_free(void)
 {
-	struct znr_gui_extents_tab *tab = znr_gui_get_current_extents_tab();
-
-	if (!tab)
-		return;
+	unsigned int lod;
 
-	if (tab->blockgroup) {
-		znrg.show_blockgroup = tab->blockgroup->bg_no;
-		gtk_grid_view_scroll_to(GTK_GRID_VIEW(znrg.grid_view),
-					tab->blockgroup->bg_no,
-					GTK_LIST_SCROLL_FOCUS, NULL);
+	for (lod = 0; lod < znrg.nr_lods; lod++) {
+		free(znrg.summary[lod]);
+		znrg.summary[lod] = NULL;
 	}
+	znrg.nr_lods = 0;
+	znrg.lod = 0;
 
-	znr_gui_update();
+	free(znrg.rated_bgs);
+	znrg.rated_bgs = NULL;
+	znrg.nr_rated = 0;
 }
 
-static void znr_gui_open_extents_dialog(void)
+/*
+ * Publish the state prepared by the I/O worker, if any, by swapping the back
+ * and front buffers. The blockgroups changed are invalidated, their tabs
+ * marked stale, and their number returned, with the number of blockgroups
+ * whose write pointer moved in @nr_moved.
+ */
+static unsigned int znr_gui_publish_state(unsigned int *nr_moved)
 {
-	GtkEventController *controller;
-	GtkWidget *tab_toolbar;
-	AdwTabBar *tab_bar;
-	GtkWidget *dialog;
+	unsigned int i, bg_no, nr_changed = 0;
+	struct blk_zone *zones;
+	struct znr_bg *blockgroups;
+
+	*nr_moved = 0;
+
+	g_mutex_lock(&znrg.state_lock);
+
+	if (znrg.state_pending) {
+		zones = znr.blk_zones;
+		blockgroups = znr.blockgroups;
+		znr.blk_zones = znrg.back_zones;
+		znr.blockgroups = znrg.back_blockgroups;
+		znrg.back_zones = zones;
+		znrg.back_blockgroups = blockgroups;
+		znrg.state_pending = false;
+
+		/* The new back buffer misses the state just published */
+		znr_gui_back_stale(znrg.back_first, znrg.back_last);
+
+		nr_changed = znrg.nr_changed;
+		for (i = 0; i < nr_changed; i++) {
+			bg_no = znrg.changed_bgs[i];
+			znr_gui_blockgroup_invalidate(bg_no);
+			znr_gui_minimap_update(bg_no);
+			znr_gui_summary_publish(bg_no, &blockgroups[bg_no],
+						znrg.back_report_us[bg_no] -
+						znrg.report_us[bg_no]);
+			if (znr.blockgroups[bg_no].wp_sector !=
+			    blockgroups[bg_no].wp_sector)
+				(*nr_moved)++;
+			if (znrg.blockgroups && znrg.blockgroups[bg_no].tab)
+				znrg.blockgroups[bg_no].tab->stale = true;
+		}
+		znr_gui_summary_expire_rates();
+		znr_gui_clear_changed();
+		memcpy(&znrg.report_us[znrg.back_first],
+		       &znrg.back_report_us[znrg.back_first],
+		       (znrg.back_last - znrg.back_first) * sizeof(gint64));
+
+		znrg.map_reports++;
+		znrg.map_changed += nr_changed;
+	}
 
-	if (znrg.extents_dialog)
-		return;
+	g_mutex_unlock(&znrg.state_lock);
 
-	/*
-	 * Default libadwaita behavior is to hide tabs if N tabs == 1.
-	 * Having the blockgroup number visible at all times in the tab
-	 * is useful, so disable autohide.
-	 */
-	znrg.extents_tab_view = adw_tab_view_new();
-	tab_bar = adw_tab_bar_new();
-	adw_tab_bar_set_autohide(tab_bar, false);
-	adw_tab_bar_set_view(tab_bar, znrg.extents_tab_view);
+	return nr_changed;
+}
 
-	tab_toolbar = adw_toolbar_view_new();
-	adw_toolbar_view_add_top_bar(ADW_TOOLBAR_VIEW(tab_toolbar),
-				     GTK_WIDGET(tab_bar));
-	adw_toolbar_view_set_content(ADW_TOOLBAR_VIEW(tab_toolbar),
-				     GTK_WIDGET(znrg.extents_tab_view));
+/*
+ * Apply a blockgroups zone report: the zones were already mapped to the
+ * blockgroups by the I/O worker, in the back buffer. Reports cancelled after
+ * being executed still have up to date zones and are applied. The state
+ * published may include later reports.
+ */
+static void znr_gui_report_blockgroups_done(struct znr_gui_io *io)
+{
+	unsigned int nr_changed = 0, nr_moved = 0;
+	int ret = io->ret;
+
+	if (!ret)
+		nr_changed = znr_gui_publish_state(&nr_moved);
+
+	if (ret && ret != -ECANCELED) {
+		fprintf(stderr, "Report blockgroups %u + %u failed (%s)\n",
+			io->bg_no, io->nr_bgs, strerror(-ret));
+		if (!io->quiet)
+			znr_gui_err("Report Blockgroup Failed",
+				    "Blockgroup %u, %u blockgroups failed (%s)",
+				    io->bg_no, io->nr_bgs, strerror(-ret));
+	}
 
-	dialog = gtk_window_new();
-	gtk_window_set_child(GTK_WINDOW(dialog),
-			     GTK_WIDGET(tab_toolbar));
-	gtk_window_set_default_size(GTK_WINDOW(dialog), 700, 500);
-	gtk_window_set_title(GTK_WINDOW(dialog), "Extents Information");
-	gtk_window_set_modal(GTK_WINDOW(dialog), false);
-	gtk_window_set_resizable(GTK_WINDOW(dialog), true);
-	gtk_window_set_destroy_with_parent(GTK_WINDOW(dialog), true);
-	gtk_window_set_transient_for(GTK_WINDOW(dialog),
-				     GTK_WINDOW(znrg.window));
-	znrg.extents_dialog = dialog;
+	/* The extents of the tab are requested after this report */
+	if (io->tab && !g_cancellable_is_cancelled(io->cancellable)) {
+		io->tab->stale = false;
+		znr_gui_blockgroup_tab_info(io->tab, io->bg_no, ret);
+	}
 
-	controller = gtk_event_controller_focus_new();
-	gtk_widget_add_controller(dialog, controller);
+	/* Only redraw the blockgroups that changed */
+	if (nr_changed)
+		znr_gui_map_redraw();
 
-	g_signal_connect(dialog, "close-request",
-			 G_CALLBACK(znr_gui_extents_dialog_close_cb),
-			 NULL);
-	g_signal_connect(znrg.extents_tab_view, "close-page",
-			 G_CALLBACK(znr_gui_extents_tab_close_cb),
-			 NULL);
-	g_signal_connect(znrg.extents_tab_view,
-			 "notify::selected-page",
-			 G_CALLBACK(znr_gui_extents_tab_focus_cb), NULL);
-	gtk_window_present(GTK_WINDOW(dialog));
+	if (io->auto_refresh)
+		znr_gui_refresh_done(nr_moved);
 }
 
-static struct znr_gui_extents_tab *
-znr_gui_add_extents_dialog_tab(char *tab_label,
-			       GtkTextBuffer *tab_text_buffer)
+/*
+ * Submit a report of a set of blockgroups to the I/O worker. The blockgroups
+ * are updated on completion, with the zones reported, as well as the
+ * information of the blockgroup tab @tab, if any.
+ */
+static struct znr_gui_io *
+znr_gui_report_blockgroups(unsigned int bg_start, unsigned int nr_blockgroups,
+			   struct znr_gui_extents_tab *tab)
+{
+	struct znr_gui_io *io;
+	int ret;
+
+	if (bg_start >= znr.nr_blockgroups || !nr_blockgroups)
+		return NULL;
+
+	if (bg_start + nr_blockgroups > znr.nr_blockgroups)
+		nr_blockgroups = znr.nr_blockgroups - bg_start;
+
+	io = znr_gui_io_alloc(ZNR_GUI_IO_REPORT_BLOCKGROUPS,
+			      tab ? tab->cancellable : NULL);
+	if (!io)
+		goto out_err;
+
+	io->tab = tab;
+	io->bg_no = bg_start;
+	io->nr_bgs = nr_blockgroups;
+	io->done = znr_gui_report_blockgroups_done;
+
+	/* Blockgroups of non zoned devices never change */
+	if (znr.dev.is_zoned) {
+		ret = znr_bg_get_zone_range(&znr.dev,
+					    &znr.blockgroups[bg_start],
+					    nr_blockgroups,
+					    &io->zno, &io->nr_zones);
+		if (ret) {
+			fprintf(stderr,
+				"Get blockgroup %u + %u zones failed (%s)\n",
+				bg_start, nr_blockgroups, strerror(-ret));
+			znr_gui_io_free(io);
+			return NULL;
+		}
+
+		io->zones = calloc(io->nr_zones, sizeof(struct blk_zone));
+		if (!io->zones) {
+			znr_gui_io_free(io);
+			goto out_err;
+		}
+	}
+
+	znr_gui_io_submit(io);
+
+	return io;
+
+out_err:
+	fprintf(stderr, "Out of memory for blockgroup report\n");
+	return NULL;
+}
+
+static void znr_gui_blockgroup_status(struct znr_gui_blockgroup *blockgroup);
+static void znr_gui_map_cell_status(unsigned int cell);
+
+/*
+ * Drop the cached drawing of a blockgroup: it is redrawn with the next frame
+ * of the map, if in view.
+ */
+static void znr_gui_blockgroup_invalidate(unsigned int bg_no)
+{
+	if (znrg.blockgroups)
+		g_clear_pointer(&znrg.blockgroups[bg_no].node,
+				gsk_render_node_unref);
+}
+
+/*
+ * Drop the cached drawings of the blockgroups from @first to @last: only the
+ * blockgroups of the last frame of the map have one.
+ */
+static void znr_gui_map_invalidate(unsigned int first, unsigned int last)
+{
+	unsigned int bg_no;
+
+	if (first < znrg.map_first)
+		first = znrg.map_first;
+	if (last > znrg.map_last)
+		last = znrg.map_last;
+
+	for (bg_no = first; bg_no < last; bg_no++)
+		znr_gui_blockgroup_invalidate(bg_no);
+}
+
+/*
+ * Draw a new frame of the map, redrawing only the blockgroups invalidated,
+ * and update the status of the hovered blockgroup.
+ */
+static void znr_gui_map_redraw(void)
+{
+	if (!znrg.map)
+		return;
+
+	gtk_widget_queue_draw(znrg.map);
+	if (znrg.hovered != UINT_MAX)
+		znr_gui_map_cell_status(znrg.hovered);
+}
+
+static void znr_gui_update(void)
+{
+	if (!znrg.map)
+		return;
+
+	/*
+	 * znr_gui_update() is typically invoked when there are changes
+	 * (e.g., extents change): redraw all the blockgroups in view and
+	 * update the status of the hovered blockgroup.
+	 */
+	znr_gui_map_invalidate(0, UINT_MAX);
+	znr_gui_map_redraw();
+}
+
+static void znr_gui_blockgroup_draw_written(struct znr_bg *bg,
+					    GtkSnapshot *snapshot,
+					    const graphene_rect_t *r)
+{
+	long long w, width = r->size.width;
+
+	if (!bg->nr_zones)
+		return;
+
+	if (bg->wp_sector == 0)
+		return;
+
+	/* Written space in blockgroup */
+	w = width * bg->wp_sector / bg->nr_sectors;
+	if (w > width)
+		w = width;
+
+	gtk_snapshot_append_color(snapshot, &znrg.color_seqw,
+				  &GRAPHENE_RECT_INIT(r->origin.x, r->origin.y,
+						      w, r->size.height));
+}
+
+/*
+ * Build the digits atlas of the map.
+ */
+static void znr_gui_map_init_digits(znr_blockgroup_map *map)
+{
+	const GdkRGBA *colors[ZNR_GUI_NR_NUM_COLORS] = {
+		[ZNR_GUI_NUM_TEXT]	= &znrg.color_text,
+		[ZNR_GUI_NUM_EXTENT]	= &znrg.color_extent,
+	};
+	int top = INT_MAX, bottom = INT_MIN;
+	PangoRectangle *ink, logical;
+	GtkSnapshot *snapshot;
+	unsigned int c, d;
+	char str[2];
+
+	for (d = 0; d < 10; d++) {
+		str[0] = '0' + d;
+		str[1] = '\0';
+		pango_layout_set_text(map->layout, str, -1);
+
+		ink = &map->digit_ink[d];
+		pango_layout_get_pixel_extents(map->layout, ink, &logical);
+		if (ink->y < top)
+			top = ink->y;
+		if (ink->y + ink->height > bottom)
+			bottom = ink->y + ink->height;
+
+		for (c = 0; c < ZNR_GUI_NR_NUM_COLORS; c++) {
+			snapshot = gtk_snapshot_new();
+			gtk_snapshot_append_layout(snapshot, map->layout,
+						   colors[c]);
+			map->digits[c][d] = gtk_snapshot_free_to_node(snapshot);
+		}
+	}
+
+	map->digit_advance = logical.width;
+	map->digit_top = top;
+	map->digit_height = bottom - top;
+	map->digit_baseline =
+		pango_layout_get_baseline(map->layout) / PANGO_SCALE;
+}
+
+/*
+ * Width of the ink of the number @str.
+ */
+static int znr_gui_map_num_width(znr_blockgroup_map *map, const char *str)
+{
+	size_t len = strlen(str);
+	PangoRectangle *first, *last;
+
+	if (!map->digits[0][0])
+		znr_gui_map_init_digits(map);
+
+	first = &map->digit_ink[str[0] - '0'];
+	last = &map->digit_ink[str[len - 1] - '0'];
+
+	return (int)(len - 1) * map->digit_advance +
+		last->x + last->width - first->x;
+}
+
+/*
+ * Draw the number @str at @x, @y, @x being the left side of the number ink
+ * and @y the top of the digits ink if @top is true, their baseline otherwise.
+ * No text is shaped: the digits are appended from the digits atlas.
+ */
+static void znr_gui_map_draw_num(znr_blockgroup_map *map,
+				 GtkSnapshot *snapshot,
+				 enum znr_gui_num_color color,
+				 const char *str, float x, float y, bool top)
+{
+	unsigned int i;
+
+	if (!map->digits[0][0])
+		znr_gui_map_init_digits(map);
+
+	/* Origin of the layout of the first digit */
+	x -= map->digit_ink[str[0] - '0'].x;
+	y -= top ? map->digit_top : map->digit_baseline;
+
+	for (i = 0; str[i]; i++) {
+		gtk_snapshot_save(snapshot);
+		gtk_snapshot_translate(snapshot,
+			&GRAPHENE_POINT_INIT(x + i * map->digit_advance, y));
+		gtk_snapshot_append_node(snapshot,
+					 map->digits[color][str[i] - '0']);
+		gtk_snapshot_restore(snapshot);
+	}
+}
+
+/*
+ * Draw the blockgroup number @bg_no at the center of the rectangle @r.
+ */
+static void znr_gui_blockgroup_draw_num(znr_blockgroup_map *map,
+					unsigned int bg_no,
+					GtkSnapshot *snapshot,
+					const graphene_rect_t *r)
+{
+	char str[16];
+	int w;
+
+	/* Draw blockgroup number */
+	snprintf(str, sizeof(str), "%u", bg_no);
+	w = znr_gui_map_num_width(map, str);
+	znr_gui_map_draw_num(map, snapshot, ZNR_GUI_NUM_TEXT, str,
+			     r->origin.x + r->size.width / 2 - w / 2.0,
+			     r->origin.y + r->size.height / 2 -
+			     map->digit_height / 2.0,
+			     true);
+}
+
+/*
+ * Draw an outline of width @width inside the rectangle @r.
+ */
+static void znr_gui_map_draw_outline(GtkSnapshot *snapshot,
+				     const graphene_rect_t *r,
+				     const GdkRGBA *color, float width)
+{
+	const float widths[4] = { width, width, width, width };
+	const GdkRGBA colors[4] = { *color, *color, *color, *color };
+	GskRoundedRect outline;
+
+	gsk_rounded_rect_init_from_rect(&outline, r, 0);
+	gtk_snapshot_append_border(snapshot, &outline, widths, colors);
+}
+
+static bool znr_gui_blockgroup_tab_open(struct znr_gui_blockgroup *blockgroup,
+					struct znr_gui_extents_tab **ext_tab)
+
+{
+	AdwTabPage *page;
+	struct znr_gui_extents_tab *tab;
+	struct znr_gui_extents_tab *in_focus = znr_gui_get_current_extents_tab();
+	int nr_pages, i;
+
+	if (!in_focus->blockgroup)
+		return false;
+
+	nr_pages = adw_tab_view_get_n_pages(znrg.extents_tab_view);
+	for (i = 0; i < nr_pages; ++i) {
+		page = adw_tab_view_get_nth_page(znrg.extents_tab_view, i);
+		if (!page)
+			continue;
+
+		tab = g_object_get_data(G_OBJECT(page), "tab");
+		if (!tab || !tab->blockgroup)
+			continue;
+
+		if (blockgroup == tab->blockgroup) {
+			*ext_tab = tab;
+			return true;
+		}
+	}
+
+	*ext_tab = NULL;
+	return false;
+}
+
+static bool
+znr_gui_should_draw_blockgroup_extents(struct znr_gui_blockgroup *blockgroup,
+				       struct znr_gui_extents_tab **ext_tab)
+{
+	struct znr_gui_extents_tab *tab = znr_gui_get_current_extents_tab();
+
+	if (!tab)
+		return false;
+
+	if (!blockgroup)
+		return false;
+
+	if (!znrg.extents_tab_view)
+		return false;
+
+	/*
+	 * If a blockgroup tab is in focus, allow drawing extents for all
+	 * blockgroup tabs
+	 */
+	if (znr_gui_blockgroup_tab_open(blockgroup, ext_tab))
+		return true;
+
+	/* If a file tab is in focus, draw extents for that file */
+	if (tab->file) {
+		*ext_tab = tab;
+		return true;
+	}
+
+	return false;
+}
+
+static inline bool znr_gui_extent_in_blockgroup(struct znr_extent *ext,
+						struct znr_bg *bg)
+{
+	return ext->sector >= bg->sector &&
+		ext->sector + ext->nr_sectors <= bg->sector + bg->nr_sectors;
+}
+
+static int znr_gui_extent_cmp(const void *a, const void *b)
+{
+	const struct znr_extent *ea = *(struct znr_extent * const *)a;
+	const struct znr_extent *eb = *(struct znr_extent * const *)b;
+
+	if (ea->sector < eb->sector)
+		return -1;
+
+	return ea->sector > eb->sector;
+}
+
+/*
+ * All extents of a tab are known: sort them by sector.
+ */
+static void znr_gui_extents_tab_sort(struct znr_gui_extents_tab *tab)
+{
+	unsigned int i;
+
+	free(tab->sorted_extents);
+	tab->sorted_extents = NULL;
+	if (!tab->nr_extents)
+		return;
+
+	tab->sorted_extents = malloc(tab->nr_extents *
+				     sizeof(struct znr_extent *));
+	if (!tab->sorted_extents) {
+		/* Draw by scanning all extents */
+		fprintf(stderr, "Out of memory for sorting extents\n");
+		return;
+	}
+
+	for (i = 0; i < tab->nr_extents; i++)
+		tab->sorted_extents[i] = &tab->extents[i];
+	qsort(tab->sorted_extents, tab->nr_extents,
+	      sizeof(struct znr_extent *), znr_gui_extent_cmp);
+}
+
+/*
+ * Index of the first sorted extent of a tab starting at or after @sector.
+ */
+static unsigned int
+znr_gui_extents_tab_lookup(struct znr_gui_extents_tab *tab,
+			   unsigned long long sector)
+{
+	unsigned int lo = 0, hi = tab->nr_extents, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (tab->sorted_extents[mid]->sector < sector)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
+static void
+znr_gui_blockgroup_draw_extents(znr_blockgroup_map *map,
+				struct znr_gui_blockgroup *blockgroup,
+				GtkSnapshot *snapshot, const graphene_rect_t *r)
+{
+	unsigned long long bg_sect, bg_len;
+	struct znr_gui_extents_tab *tab = NULL;
+	struct znr_bg *bg = &znr.blockgroups[blockgroup->bg_no];
+	double x, y, w, h, ext_x, ext_w;
+	unsigned int i = 0, c, e, nr_cols;
+	struct znr_extent *ext;
+	bool *cover;
+	char str[16];
+	int tw;
+
+	if (!znr_gui_should_draw_blockgroup_extents(blockgroup, &tab))
+		return;
+
+	bg_sect = bg->sector;
+	bg_len = bg->nr_sectors;
+
+	if (tab->sorted_extents)
+		i = znr_gui_extents_tab_lookup(tab, bg_sect);
+
+	/* Set drawing area with small margin */
+	x = r->origin.x + 1;
+	y = r->origin.y + 1;
+	w = r->size.width - 2;
+	h = r->size.height - 2;
+
+	/* Pixel columns covered by the extents too narrow to be outlined */
+	nr_cols = w > 0 ? (unsigned int)w + 1 : 1;
+	if (nr_cols > map->nr_cover_cols) {
+		cover = realloc(map->cover, nr_cols * sizeof(bool));
+		if (cover) {
+			map->cover = cover;
+			map->nr_cover_cols = nr_cols;
+		}
+	}
+	cover = nr_cols <= map->nr_cover_cols ? map->cover : NULL;
+	if (cover)
+		memset(cover, 0, nr_cols * sizeof(bool));
+
+	/* Keep the extents outline within the blockgroup */
+	gtk_snapshot_push_clip(snapshot, r);
+
+	for (; i < tab->nr_extents; i++) {
+		if (tab->sorted_extents) {
+			ext = tab->sorted_extents[i];
+			if (ext->sector >= bg_sect + bg_len)
+				break;
+		} else {
+			ext = &tab->extents[i];
+		}
+		if (!znr_gui_extent_in_blockgroup(ext, bg))
+			continue;
+
+		/*
+		 * Calculate the extent rectangle position and width as a
+		 * percentage of the blockgroup.
+		 */
+		ext_x = ((ext->sector - bg_sect) * w) / bg_len;
+		ext_w = (ext->nr_sectors * w) / bg_len;
+
+		if (ext_w < ZNR_GUI_EXTENT_MIN_WIDTH && cover) {
+			e = ext_x + ext_w;
+			for (c = ext_x; c <= e && c < nr_cols; c++)
+				cover[c] = true;
+			continue;
+		}
+
+		/* Draw extent rectangle (no colour fill), 3 pixels wide */
+		znr_gui_map_draw_outline(snapshot,
+			&GRAPHENE_RECT_INIT(x + ext_x - 1.5, y - 1.5,
+					    ext_w + 3, h + 3),
+			&znrg.color_extent, 3);
+
+		/*
+		 * With heavily fragmented files, only draw the extent number
+		 * if it fits in the extent
+		 */
+		sprintf(str, "%u", ext->idx);
+		tw = znr_gui_map_num_width(map, str);
+		if (tw > ext_w / 2)
+			continue;
+
+		znr_gui_map_draw_num(map, snapshot, ZNR_GUI_NUM_EXTENT, str,
+				     x + ext_x + ext_w / 2 - tw / 2.0,
+				     y + h - 10, false);
+	}
+
+	/*
+	 * Draw the spans of columns covered by narrow extents as the outlines
+	 * of these extents would: filled, with the outline width around.
+	 */
+	for (c = 0; cover && c < nr_cols; c = e + 1) {
+		for (e = c; e < nr_cols && cover[e]; e++)
+			;
+		if (e == c)
+			continue;
+		gtk_snapshot_append_color(snapshot, &znrg.color_extent,
+			&GRAPHENE_RECT_INIT(x + c - 1.5, y - 1.5,
+					    e - c + 3, h + 3));
+	}
+
+	gtk_snapshot_pop(snapshot);
+}
+
+/*
+ * Set the blockgroup status text with the information of @blockgroup.
+ */
+static void znr_gui_blockgroup_status(struct znr_gui_blockgroup *blockgroup)
+{
+	struct znr_bg *bg = &znr.blockgroups[blockgroup->bg_no];
+	char info[256];
+	char wp[32];
+	char type[32];
+	char usage [8];
+
+	if (!znrg.bg_status)
+		return;
+
+	if (bg->flags == BLK_ZONE_TYPE_SEQWRITE_REQ) {
+		if (bg->nr_zones == 1 &&
+		    bg->zones[0]->cond == BLK_ZONE_COND_FULL) {
+			snprintf(wp, sizeof(wp), "N/A");
+			snprintf(usage, sizeof(usage), "100%%");
+		} else if (bg->nr_zones == 1) {
+			snprintf(wp, sizeof(wp), "0x%lx", bg->wp_sector);
+			snprintf(usage, sizeof(usage), "%lu%%",
+				 bg->wp_sector * 100 / bg->nr_sectors);
+		} else {
+			/* todo: Likely RAID, we need to revise */
+			snprintf(wp, sizeof(wp), "Unknown");
+			snprintf(usage, sizeof(usage), "N/A");
+			fprintf(stderr,
+				"Unsupported number of zones in blockgroups");
+		}
+
+		snprintf(type, sizeof(type), "Sequential Write Required");
+	} else if (bg->flags == BLK_ZONE_TYPE_CONVENTIONAL) {
+		snprintf(wp, sizeof(wp), "N/A");
+		snprintf(type, sizeof(type), "Conventional");
+		snprintf(usage, sizeof(usage), "N/A");
+	} else {
+		snprintf(wp, sizeof(wp), "Unknown");
+		snprintf(type, sizeof(type), "Unknown");
+		snprintf(usage, sizeof(usage), "Unknown");
+	}
+
+	snprintf(info, sizeof(info),
+		 "Blockgroup [%u]: %s • Start: 0x%lx Size: 0x%lx sectors • WP: %s • Usage: %s",
+		 blockgroup->bg_no, type, bg->sector, bg->nr_sectors,
+		 wp, usage);
+	gtk_editable_set_text(GTK_EDITABLE(znrg.bg_status), info);
+}
+
+/*
+ * Draw a blockgroup in the rectangle @r.
+ */
+static void znr_gui_blockgroup_draw(znr_blockgroup_map *map,
+				    struct znr_gui_blockgroup *blockgroup,
+				    GtkSnapshot *snapshot,
+				    const graphene_rect_t *r)
+{
+	struct znr_bg *bg = &znr.blockgroups[blockgroup->bg_no];
+	const GdkRGBA *color;
+
+	/* Draw blockgroup background based on type in flags field */
+	if (bg->flags == BLK_ZONE_TYPE_CONVENTIONAL) {
+		color = &znrg.color_conv;
+	} else if (bg->flags == BLK_ZONE_TYPE_SEQWRITE_REQ) {
+		color = &znrg.color_seq;
+	} else {
+		fprintf(stderr, "Unknown blockgroup type: %u\n", bg->flags);
+		color = &znrg.color_seq;
+	}
+	gtk_snapshot_append_color(snapshot, color, r);
+
+	znr_gui_blockgroup_draw_written(bg, snapshot, r);
+
+	/* Draw file extents */
+	znr_gui_blockgroup_draw_extents(map, blockgroup, snapshot, r);
+
+	/* Draw blockgroup number */
+	znr_gui_blockgroup_draw_num(map, blockgroup->bg_no, snapshot, r);
+}
+
+/*
+ * Set the blockgroup status text with the summary of the map cell @cell.
+ */
+static void znr_gui_summary_status(unsigned int cell)
+{
+	struct znr_gui_summary *s = &znrg.summary[znrg.lod][cell];
+	unsigned int first = cell << znrg.lod;
+	char info[256];
+
+	if (!znrg.bg_status)
+		return;
+
+	snprintf(info, sizeof(info),
+		 "Blockgroups [%u-%u]: %u Conventional, %u Sequential (%u active, %u full) • Usage: %llu%% • Max write rate: %.1f MiB/s",
+		 first, first + s->nr_bgs - 1, s->nr_conv,
+		 s->nr_bgs - s->nr_conv, s->nr_active, s->nr_full,
+		 s->nr_sectors ? s->wp_sectors * 100 / s->nr_sectors : 0,
+		 (double)(s->max_rate << SECTOR_SHIFT) / (1024 * 1024));
+	gtk_editable_set_text(GTK_EDITABLE(znrg.bg_status), info);
+}
+
+/*
+ * Set the blockgroup status text with the information of the map cell @cell.
+ */
+static void znr_gui_map_cell_status(unsigned int cell)
+{
+	if (znrg.lod)
+		znr_gui_summary_status(cell);
+	else
+		znr_gui_blockgroup_status(&znrg.blockgroups[cell]);
+}
+
+/*
+ * Draw the summary of the map cell @cell in the rectangle @r: the share of
+ * conventional blockgroups on the left and of sequential blockgroups on the
+ * right, with their written space, and the number of the first blockgroup.
+ */
+static void znr_gui_summary_draw(znr_blockgroup_map *map, unsigned int cell,
+				 GtkSnapshot *snapshot,
+				 const graphene_rect_t *r)
+{
+	struct znr_gui_summary *s = &znrg.summary[znrg.lod][cell];
+	float x = r->origin.x, y = r->origin.y, h = r->size.height;
+	float conv_w, seq_w;
+
+	conv_w = r->size.width * s->nr_conv / s->nr_bgs;
+	seq_w = r->size.width - conv_w;
+
+	if (conv_w > 0)
+		gtk_snapshot_append_color(snapshot, &znrg.color_conv,
+				&GRAPHENE_RECT_INIT(x, y, conv_w, h));
+
+	if (seq_w > 0) {
+		gtk_snapshot_append_color(snapshot, &znrg.color_seq,
+				&GRAPHENE_RECT_INIT(x + conv_w, y, seq_w, h));
+		if (s->wp_sectors)
+			gtk_snapshot_append_color(snapshot, &znrg.color_seqw,
+				&GRAPHENE_RECT_INIT(x + conv_w, y,
+					seq_w * s->wp_sectors / s->nr_sectors,
+					h));
+	}
+
+	znr_gui_blockgroup_draw_num(map, cell << znrg.lod, snapshot, r);
+}
+
+/*
+ * Get the cached drawing of a blockgroup, drawing it if it was invalidated.
+ */
+static GskRenderNode *
+znr_gui_blockgroup_node(znr_blockgroup_map *map,
+			struct znr_gui_blockgroup *blockgroup)
+{
+	GtkSnapshot *snapshot;
+
+	if (blockgroup->node)
+		return blockgroup->node;
+
+	snapshot = gtk_snapshot_new();
+	znr_gui_blockgroup_draw(map, blockgroup, snapshot,
+				&GRAPHENE_RECT_INIT(0, 0, znrg.node_width,
+						    znrg.node_height));
+	blockgroup->node = gtk_snapshot_free_to_node(snapshot);
+	znrg.map_nodes++;
+
+	return blockgroup->node;
+}
+
+/*
+ * Draw the selection and hover highlights of the map cell @cell in the
+ * rectangle @r of the map. These are not part of the cached drawing of the
+ * blockgroups, so that moving the pointer does not redraw blockgroups.
+ */
+static void znr_gui_map_draw_highlight(unsigned int cell,
+				       GtkSnapshot *snapshot,
+				       const graphene_rect_t *r,
+				       const GdkRGBA *fg_color)
+{
+	/* Draw selection highlight if the cell has the blockgroup selected */
+	if (znrg.show_blockgroup != UINT_MAX &&
+	    cell == znrg.show_blockgroup >> znrg.lod) {
+		znr_gui_map_draw_outline(snapshot, r, &znrg.color_jz, 4);
+		znrg.show_blockgroup = UINT_MAX;
+	}
+
+	/* Draw hover highlight if the cell is hovered */
+	if (cell == znrg.hovered)
+		znr_gui_map_draw_outline(snapshot, r, fg_color, 3);
+}
+
+static void znr_gui_close_extents_tab(struct znr_gui_extents_tab *tab)
+{
+	if (!tab || !tab->page)
+		return;
+
+	/* Stop receiving extents for this tab */
+	if (tab->cancellable) {
+		g_cancellable_cancel(tab->cancellable);
+		g_object_unref(tab->cancellable);
+	}
+
+	g_object_set_data(G_OBJECT(tab->page), "tab", (gpointer)NULL);
+
+	/* The extents list may outlive the tab: empty it */
+	if (tab->selection) {
+		g_signal_handlers_disconnect_by_data(tab->selection, tab);
+		g_object_unref(tab->selection);
+	}
+	if (tab->model) {
+		znr_gui_extents_model_detach(tab->model);
+		g_object_unref(tab->model);
+	}
+
+	if (tab->blockgroup)
+		tab->blockgroup->tab = NULL;
+	else if (tab->file)
+		znr_fs_free_file(tab->file);
+
+	free(tab->extents);
+	free(tab->sorted_extents);
+	free(tab);
+}
+
+static void znr_gui_close_all_extents_tabs(void)
+{
+	struct znr_gui_extents_tab *tab;
+	AdwTabPage *page;
+	int nr_pages, i;
+
+	if (!znrg.extents_dialog)
+		return;
+
+	nr_pages = adw_tab_view_get_n_pages(znrg.extents_tab_view);
+	for (i = 0; i < nr_pages; ++i) {
+		page = adw_tab_view_get_nth_page(znrg.extents_tab_view, i);
+		if (!page)
+			return;
+		tab = g_object_get_data(G_OBJECT(page), "tab");
+		znr_gui_close_extents_tab(tab);
+	}
+}
+
+static void znr_gui_close_extents_dialog(void)
+{
+	if (!znrg.extents_dialog)
+		return;
+
+	znr_gui_close_all_extents_tabs();
+	gtk_window_close(GTK_WINDOW(znrg.extents_dialog));
+
+	znrg.extents_tab_view = NULL;
+	znrg.extents_dialog = NULL;
+
+	znr_gui_update();
+}
+
+static void
+znr_gui_extents_dialog_close_cb(GtkWidget *widget __attribute__((unused)),
+				gpointer user_data)
+{
+	znr_gui_close_extents_dialog();
+}
+
+static gboolean znr_gui_extents_tab_close_cb(AdwTabView *tab_view,
+					AdwTabPage *page, gpointer user_data)
+{
+	struct znr_gui_extents_tab *tab;
+
+	/* If this is the last tab, close the entire dialog */
+	if (adw_tab_view_get_n_pages(tab_view) == 1) {
+		znr_gui_close_extents_dialog();
+		return GDK_EVENT_STOP;
+	}
+
+	tab = (struct znr_gui_extents_tab *)
+		g_object_get_data(G_OBJECT(page), "tab");
+	if (tab) {
+		znr_gui_close_extents_tab(tab);
+		znr_gui_update();
+	}
+
+	return GDK_EVENT_PROPAGATE;
+}
+
+static void znr_gui_extents_tab_focus_cb(GObject *object, GParamSpec *pspec,
+					 gpointer __attribute__((unused)))
+{
+	struct znr_gui_extents_tab *tab = znr_gui_get_current_extents_tab();
+
+	if (!tab)
+		return;
+
+	if (tab->blockgroup) {
+		znrg.show_blockgroup = tab->blockgroup->bg_no;
+		znr_gui_map_scroll_to(tab->blockgroup->bg_no);
+	}
+
+	znr_gui_update();
+}
+
+static void znr_gui_open_extents_dialog(void)
+{
+	GtkEventController *controller;
+	GtkWidget *tab_toolbar;
+	AdwTabBar *tab_bar;
+	GtkWidget *dialog;
+
+	if (znrg.extents_dialog)
+		return;
+
+	/*
+	 * Default libadwaita behavior is to hide tabs if N tabs == 1.
+	 * Having the blockgroup number visible at all times in the tab
+	 * is useful, so disable autohide.
+	 */
+	znrg.extents_tab_view = adw_tab_view_new();
+	tab_bar = adw_tab_bar_new();
+	adw_tab_bar_set_autohide(tab_bar, false);
+	adw_tab_bar_set_view(tab_bar, znrg.extents_tab_view);
+
+	tab_toolbar = adw_toolbar_view_new();
+	adw_toolbar_view_add_top_bar(ADW_TOOLBAR_VIEW(tab_toolbar),
+				     GTK_WIDGET(tab_bar));
+	adw_toolbar_view_set_content(ADW_TOOLBAR_VIEW(tab_toolbar),
+				     GTK_WIDGET(znrg.extents_tab_view));
+
+	dialog = gtk_window_new();
+	gtk_window_set_child(GTK_WINDOW(dialog),
+			     GTK_WIDGET(tab_toolbar));
+	gtk_window_set_default_size(GTK_WINDOW(dialog), 700, 500);
+	gtk_window_set_title(GTK_WINDOW(dialog), "Extents Information");
+	gtk_window_set_modal(GTK_WINDOW(dialog), false);
+	gtk_window_set_resizable(GTK_WINDOW(dialog), true);
+	gtk_window_set_destroy_with_parent(GTK_WINDOW(dialog), true);
+	gtk_window_set_transient_for(GTK_WINDOW(dialog),
+				     GTK_WINDOW(znrg.window));
+	znrg.extents_dialog = dialog;
+
+	controller = gtk_event_controller_focus_new();
+	gtk_widget_add_controller(dialog, controller);
+
+	g_signal_connect(dialog, "close-request",
+			 G_CALLBACK(znr_gui_extents_dialog_close_cb),
+			 NULL);
+	g_signal_connect(znrg.extents_tab_view, "close-page",
+			 G_CALLBACK(znr_gui_extents_tab_close_cb),
+			 NULL);
+	g_signal_connect(znrg.extents_tab_view,
+			 "notify::selected-page",
+			 G_CALLBACK(znr_gui_extents_tab_focus_cb), NULL);
+	gtk_window_present(GTK_WINDOW(dialog));
+}
+
+static const char *znr_gui_extent_col_titles[ZNR_GUI_NR_EXT_COLS] = {
+	[ZNR_GUI_EXT_COL_IDX]		= "Extent",
+	[ZNR_GUI_EXT_COL_INO]		= "Inode",
+	[ZNR_GUI_EXT_COL_SECTOR]	= "Sector",
+	[ZNR_GUI_EXT_COL_END]		= "End",
+	[ZNR_GUI_EXT_COL_LEN]		= "Length",
+	[ZNR_GUI_EXT_COL_ZONE]		= "Zone",
+};
+
+static unsigned long long znr_gui_extent_col_val(struct znr_extent *ext,
+						 enum znr_gui_extent_col col)
+{
+	switch (col) {
+	case ZNR_GUI_EXT_COL_INO:
+		return znr_query_field_val(ext, ZNR_QUERY_INO);
+	case ZNR_GUI_EXT_COL_SECTOR:
+		return znr_query_field_val(ext, ZNR_QUERY_SECTOR);
+	case ZNR_GUI_EXT_COL_END:
+		return znr_query_field_val(ext, ZNR_QUERY_END);
+	case ZNR_GUI_EXT_COL_LEN:
+		return znr_query_field_val(ext, ZNR_QUERY_LEN);
+	case ZNR_GUI_EXT_COL_ZONE:
+		return znr_query_field_val(ext, ZNR_QUERY_ZONE);
+	default:
+		return ext->idx;
+	}
+}
+
+G_DEFINE_TYPE(znr_extent_row, znr_extent_row, G_TYPE_OBJECT)
+
+static void znr_extent_row_init(znr_extent_row *row)
+{
+}
+
+static void znr_extent_row_class_init(znr_extent_rowClass *class)
+{
+}
+
+static GType znr_extents_model_get_item_type(GListModel *list)
+{
+	return ZNR_TYPE_EXTENT_ROW;
+}
+
+static guint znr_extents_model_get_n_items(GListModel *list)
+{
+	return ZNR_EXTENTS_MODEL(list)->nr_extents;
+}
+
+/*
+ * Create the row of the extent at @position in the list.
+ */
+static gpointer znr_extents_model_get_item(GListModel *list, guint position)
+{
+	znr_extents_model *model = ZNR_EXTENTS_MODEL(list);
+	struct znr_extent *ext;
+	znr_extent_row *row;
+	unsigned int col;
+
+	if (!model->tab || position >= model->nr_extents)
+		return NULL;
+
+	row = g_object_new(ZNR_TYPE_EXTENT_ROW, NULL);
+	row->pos = model->order[position];
+	ext = &model->tab->extents[row->pos];
+	for (col = 0; col < ZNR_GUI_NR_EXT_COLS; col++)
+		row->vals[col] = znr_gui_extent_col_val(ext, col);
+
+	return row;
+}
+
+static void znr_extents_model_list_init(GListModelInterface *iface)
+{
+	iface->get_item_type = znr_extents_model_get_item_type;
+	iface->get_n_items = znr_extents_model_get_n_items;
+	iface->get_item = znr_extents_model_get_item;
+}
+
+G_DEFINE_TYPE_WITH_CODE(znr_extents_model, znr_extents_model, G_TYPE_OBJECT,
+			G_IMPLEMENT_INTERFACE(G_TYPE_LIST_MODEL,
+					      znr_extents_model_list_init))
+
+static void znr_extents_model_finalize(GObject *object)
+{
+	znr_extents_model *model = ZNR_EXTENTS_MODEL(object);
+
+	free(model->order);
+
+	G_OBJECT_CLASS(znr_extents_model_parent_class)->finalize(object);
+}
+
+static void znr_extents_model_init(znr_extents_model *model)
+{
+	model->sort_col = -1;
+}
+
+/*
+ * Note: znr_extents_modelClass is generated by the macro above, hence
+ * we can't avoid the camelcase.
+ */
+static void znr_extents_model_class_init(znr_extents_modelClass *class)
+{
+	G_OBJECT_CLASS(class)->finalize = znr_extents_model_finalize;
+}
+
+static int znr_gui_extents_model_cmp(const void *a, const void *b,
+				     void *data)
+{
+	znr_extents_model *model = data;
+	unsigned int ia = *(const unsigned int *)a;
+	unsigned int ib = *(const unsigned int *)b;
+	struct znr_extent *extents = model->tab->extents;
+	unsigned long long va, vb;
+	int ret;
+
+	va = znr_gui_extent_col_val(&extents[ia], model->sort_col);
+	vb = znr_gui_extent_col_val(&extents[ib], model->sort_col);
+	if (va != vb)
+		ret = va < vb ? -1 : 1;
+	else
+		ret = ia < ib ? -1 : ia > ib;
+
+	return model->sort_desc ? -ret : ret;
+}
+
+static void znr_gui_extents_model_sort(znr_extents_model *model)
+{
+	unsigned int i;
+
+	if (model->sort_col < 0) {
+		for (i = 0; i < model->nr_extents; i++)
+			model->order[i] = i;
+		return;
+	}
+
+	qsort_r(model->order, model->nr_extents, sizeof(unsigned int),
+		znr_gui_extents_model_cmp, model);
+}
+
+/*
+ * Extents were added to the tab of @model: add them to the list.
+ */
+static int znr_gui_extents_model_update(znr_extents_model *model)
+{
+	struct znr_gui_extents_tab *tab = model->tab;
+	unsigned int i, nr_extents = model->nr_extents;
+	unsigned int *order;
+
+	if (!tab || tab->nr_extents == nr_extents)
+		return 0;
+
+	order = realloc(model->order, tab->nr_extents * sizeof(unsigned int));
+	if (!order)
+		return -ENOMEM;
+
+	for (i = nr_extents; i < tab->nr_extents; i++)
+		order[i] = i;
+	model->order = order;
+	model->nr_extents = tab->nr_extents;
+
+	if (model->sort_col < 0) {
+		g_list_model_items_changed(G_LIST_MODEL(model), nr_extents, 0,
+					   model->nr_extents - nr_extents);
+		return 0;
+	}
+
+	/* The new extents may go anywhere in the sorted list */
+	znr_gui_extents_model_sort(model);
+	g_list_model_items_changed(G_LIST_MODEL(model), 0, nr_extents,
+				   model->nr_extents);
+
+	return 0;
+}
+
+/*
+ * The tab of @model is closed: empty the list.
+ */
+static void znr_gui_extents_model_detach(znr_extents_model *model)
+{
+	unsigned int nr_extents = model->nr_extents;
+
+	model->tab = NULL;
+	model->nr_extents = 0;
+	g_list_model_items_changed(G_LIST_MODEL(model), 0, nr_extents, 0);
+}
+
+/*
+ * The extents of the tab of @model are requested again: empty the list.
+ */
+static void znr_gui_extents_model_clear(znr_extents_model *model)
+{
+	unsigned int nr_extents = model->nr_extents;
+
+	model->nr_extents = 0;
+	g_list_model_items_changed(G_LIST_MODEL(model), 0, nr_extents, 0);
+}
+
+/*
+ * The sorted column of an extents list changed: sort the list. The list is
+ * not wrapped in a GtkSortListModel, which would create the rows of all
+ * extents.
+ */
+static void znr_gui_extents_sort_cb(GtkSorter *sorter, GtkSorterChange change,
+				    gpointer user_data)
+{
+	GtkColumnViewSorter *cvs = GTK_COLUMN_VIEW_SORTER(sorter);
+	znr_extents_model *model = user_data;
+	GtkColumnViewColumn *column;
+
+	column = gtk_column_view_sorter_get_primary_sort_column(cvs);
+	if (column) {
+		model->sort_col = GPOINTER_TO_INT(
+			g_object_get_data(G_OBJECT(column), "col"));
+		model->sort_desc =
+			gtk_column_view_sorter_get_primary_sort_order(cvs) ==
+			GTK_SORT_DESCENDING;
+	} else {
+		model->sort_col = -1;
+	}
+
+	if (!model->tab)
+		return;
+
+	znr_gui_extents_model_sort(model);
+	g_list_model_items_changed(G_LIST_MODEL(model), 0, model->nr_extents,
+				   model->nr_extents);
+}
+
+static void znr_gui_extent_cell_setup(GtkSignalListItemFactory *factory,
+				      GtkListItem *list_item,
+				      gpointer user_data)
+{
+	GtkWidget *label = gtk_label_new(NULL);
+
+	gtk_label_set_xalign(GTK_LABEL(label), 1);
+	gtk_widget_add_css_class(label, "monospace");
+	gtk_list_item_set_child(list_item, label);
+}
+
+/*
+ * Extent rows are formatted only when shown.
+ */
+static void znr_gui_extent_cell_bind(GtkSignalListItemFactory *factory,
+				     GtkListItem *list_item,
+				     gpointer user_data)
+{
+	znr_extent_row *row = gtk_list_item_get_item(list_item);
+	unsigned int col = GPOINTER_TO_UINT(user_data);
+	char str[32];
+
+	snprintf(str, sizeof(str), "%llu", row->vals[col]);
+	gtk_label_set_text(GTK_LABEL(gtk_list_item_get_child(list_item)), str);
+}
+
+/*
+ * Show the information of the extent selected in an extents list.
+ */
+static void znr_gui_extents_select_cb(GObject *object, GParamSpec *pspec,
+				      gpointer user_data)
+{
+	struct znr_gui_extents_tab *tab = user_data;
+	znr_extent_row *row;
+
+	row = gtk_single_selection_get_selected_item(tab->selection);
+	if (!row || row->pos >= tab->nr_extents) {
+		gtk_label_set_text(GTK_LABEL(tab->details), "");
+		return;
+	}
+
+	gtk_label_set_markup(GTK_LABEL(tab->details),
+			     tab->extents[row->pos].info);
+}
+
+/*
+ * Create the extents list of a tab.
+ */
+static GtkWidget *znr_gui_extents_list(struct znr_gui_extents_tab *tab)
+{
+	GtkListItemFactory *factory;
+	GtkColumnViewColumn *column;
+	GtkSorter *sorter;
+	GtkWidget *view;
+	unsigned int col;
+
+	tab->model = g_object_new(ZNR_TYPE_EXTENTS_MODEL, NULL);
+	tab->model->tab = tab;
+
+	tab->selection = gtk_single_selection_new(g_object_ref(tab->model));
+	gtk_single_selection_set_autoselect(tab->selection, FALSE);
+	gtk_single_selection_set_can_unselect(tab->selection, TRUE);
+	g_signal_connect(tab->selection, "notify::selected-item",
+			 G_CALLBACK(znr_gui_extents_select_cb), tab);
+
+	view = gtk_column_view_new(
+		GTK_SELECTION_MODEL(g_object_ref(tab->selection)));
+	gtk_column_view_set_show_column_separators(GTK_COLUMN_VIEW(view),
+						   TRUE);
+
+	for (col = 0; col < ZNR_GUI_NR_EXT_COLS; col++) {
+		factory = gtk_signal_list_item_factory_new();
+		g_signal_connect(factory, "setup",
+				 G_CALLBACK(znr_gui_extent_cell_setup), NULL);
+		g_signal_connect(factory, "bind",
+				 G_CALLBACK(znr_gui_extent_cell_bind),
+				 GUINT_TO_POINTER(col));
+
+		column = gtk_column_view_column_new(
+				znr_gui_extent_col_titles[col], factory);
+		g_object_set_data(G_OBJECT(column), "col",
+				  GINT_TO_POINTER(col));
+
+		/* Make the column sortable: the model does the sorting */
+		sorter = GTK_SORTER(gtk_custom_sorter_new(NULL, NULL, NULL));
+		gtk_column_view_column_set_sorter(column, sorter);
+		g_object_unref(sorter);
+		gtk_column_view_column_set_expand(column, TRUE);
+		gtk_column_view_append_column(GTK_COLUMN_VIEW(view), column);
+		g_object_unref(column);
+	}
+
+	g_signal_connect(gtk_column_view_get_sorter(GTK_COLUMN_VIEW(view)),
+			 "changed", G_CALLBACK(znr_gui_extents_sort_cb),
+			 tab->model);
+
+	return view;
+}
+
+static struct znr_gui_extents_tab *
+znr_gui_add_extents_dialog_tab(char *tab_label,
+			       GtkTextBuffer *tab_text_buffer)
+{
+	GtkWidget *extents_view, *extents_box, *extents_scroll, *extents_text;
+	struct znr_gui_extents_tab *tab;
+
+	tab = calloc(1, sizeof(*tab));
+	if (!tab) {
+		znr_gui_err("Failed to allocate new tab", NULL);
+		return NULL;
+	}
+
+	/* Make sure we have an extents dialog window. */
+	znr_gui_open_extents_dialog();
+
+	/*
+	 * The tab shows the information text on top of the extents list,
+	 * followed by the information of the extent selected.
+	 */
+	extents_view = adw_view_stack_new();
+	extents_box = gtk_box_new(GTK_ORIENTATION_VERTICAL, 5);
+
+	extents_text = gtk_text_view_new();
+	gtk_text_view_set_buffer(GTK_TEXT_VIEW(extents_text), tab_text_buffer);
+	gtk_text_view_set_editable(GTK_TEXT_VIEW(extents_text), FALSE);
+	gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(extents_text), FALSE);
+
+	gtk_text_view_set_top_margin(GTK_TEXT_VIEW(extents_text), 10);
+	gtk_text_view_set_left_margin(GTK_TEXT_VIEW(extents_text), 20);
+	gtk_text_view_set_right_margin(GTK_TEXT_VIEW(extents_text), 10);
+	gtk_text_view_set_bottom_margin(GTK_TEXT_VIEW(extents_text), 10);
+	gtk_box_append(GTK_BOX(extents_box), extents_text);
+
+	/* Scrolled window for the extents list */
+	extents_scroll = gtk_scrolled_window_new();
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(extents_scroll),
+				GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_widget_set_hexpand(extents_scroll, TRUE);
+	gtk_widget_set_vexpand(extents_scroll, TRUE);
+	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(extents_scroll),
+				      znr_gui_extents_list(tab));
+	gtk_box_append(GTK_BOX(extents_box), extents_scroll);
+
+	tab->details = gtk_label_new(NULL);
+	gtk_label_set_selectable(GTK_LABEL(tab->details), TRUE);
+	gtk_label_set_xalign(GTK_LABEL(tab->details), 0);
+	gtk_widget_set_margin_start(tab->details, 20);
+	gtk_widget_set_margin_bottom(tab->details, 10);
+	gtk_box_append(GTK_BOX(extents_box), tab->details);
+
+	adw_view_stack_add_titled_with_icon(ADW_VIEW_STACK(extents_view),
+					    extents_box,
+					    tab_label, tab_label,
+					    "info-outline-symbolic");
+
+	/* Add a new tab for this blockgroup */
+	tab->page = adw_tab_view_append(znrg.extents_tab_view, extents_view);
+	adw_tab_page_set_title(tab->page, tab_label);
+	g_object_set_data(G_OBJECT(tab->page), "tab", (gpointer)tab);
+	adw_tab_view_set_selected_page(znrg.extents_tab_view, tab->page);
+
+	return tab;
+}
+
+/*
+ * Extents received for a blockgroup tab: add them to the tab and its extents
+ * list right away.
+ */
+static void znr_gui_extents_tab_recv(struct znr_gui_io *io,
+				     struct znr_extent *extents,
+				     unsigned int nr_extents)
+{
+	struct znr_gui_extents_tab *tab = io->tab;
+	struct znr_extent *ext;
+
+	ext = realloc(tab->extents,
+		      (tab->nr_extents + nr_extents) * sizeof(*ext));
+	if (!ext) {
+		fprintf(stderr, "Out of memory for blockgroup extents\n");
+		g_cancellable_cancel(io->cancellable);
+		return;
+	}
+
+	memcpy(&ext[tab->nr_extents], extents, nr_extents * sizeof(*ext));
+	tab->extents = ext;
+	tab->nr_extents += nr_extents;
+	free(tab->sorted_extents);
+	tab->sorted_extents = NULL;
+
+	if (znr_gui_extents_model_update(tab->model)) {
+		fprintf(stderr, "Out of memory for blockgroup extents\n");
+		g_cancellable_cancel(io->cancellable);
+		return;
+	}
+
+	znr_gui_update();
+}
+
+/*
+ * All extents of a blockgroup tab were received: show their number.
+ */
+static void znr_gui_extents_tab_done(struct znr_gui_io *io)
+{
+	struct znr_gui_extents_tab *tab = io->tab;
+	GtkTextIter iter;
+	char info[128];
+	int ret = io->ret;
+
+	if (g_cancellable_is_cancelled(io->cancellable))
+		return;
+
+	tab->loading = false;
+
+	if (ret < 0) {
+		snprintf(info, sizeof(info),
+			 "<tt><i>Failed to get all extents (%s)</i></tt>\n\n",
+			 strerror(-ret));
+		if (!io->quiet)
+			znr_gui_err("Failed to get blockgroup extents\n",
+				    NULL);
+	} else if (!tab->nr_extents) {
+		snprintf(info, sizeof(info),
+			 "\n<tt><i>No extents in this blockgroup</i></tt>");
+	} else {
+		snprintf(info, sizeof(info),
+			 "<tt><b>Total Extents</b>: %u</tt>",
+			 tab->nr_extents);
+	}
+
+	gtk_text_buffer_get_iter_at_mark(tab->text_buffer, &iter,
+					 tab->total_mark);
+	gtk_text_buffer_insert_markup(tab->text_buffer, &iter,
+				      info, strlen(info));
+
+	znr_gui_extents_tab_sort(tab);
+	znr_gui_update();
+}
+
+/*
+ * The blockgroup of a tab was reported: set the blockgroup information text.
+ * The extents of the blockgroup follow it.
+ */
+static void znr_gui_blockgroup_tab_info(struct znr_gui_extents_tab *tab,
+					unsigned int bg_no, int ret)
+{
+	struct znr_bg *bg = &znr.blockgroups[bg_no];
+	GtkTextIter iter;
+	char info[256];
+
+	if (ret)
+		snprintf(info, sizeof(info),
+			 "<b>Blockgroup %u</b>\n<i>Report failed (%s)</i>\n\n",
+			 bg_no, strerror(-ret));
+	else if (bg->wp_sector >= bg->nr_sectors)
+		snprintf(info, sizeof(info),
+			 "<b>Blockgroup %u</b>\nSector: %lu\nSize: %lu sectors\nWP: N/A (Blockgroup full) \n\n",
+			 bg_no, bg->sector, bg->nr_sectors);
+	else
+		snprintf(info, sizeof(info),
+			 "<b>Blockgroup %u</b>\nSector: %lu\nSize: %lu sectors\nWP: %lu\n\n",
+			 bg_no, bg->sector, bg->nr_sectors, bg->wp_sector);
+
+	gtk_text_buffer_get_start_iter(tab->text_buffer, &iter);
+	gtk_text_buffer_insert_markup(tab->text_buffer, &iter, info,
+				      strlen(info));
+	tab->total_mark = gtk_text_buffer_create_mark(tab->text_buffer, NULL,
+						      &iter, TRUE);
+}
+
+/*
+ * Get the extents in the blockgroup of a tab. With a server, these are
+ * received in chunks and the tab and blockgroup overlay are updated as each
+ * chunk is received. Auto-refreshes (@quiet set) do not report errors in a
+ * dialog.
+ */
+static void znr_gui_blockgroup_tab_extents(struct znr_gui_extents_tab *tab,
+					   bool quiet)
+{
+	struct znr_bg *bg = &znr.blockgroups[tab->blockgroup->bg_no];
+	struct znr_gui_io *io;
+
+	io = znr_gui_io_alloc(ZNR_GUI_IO_BLOCKGROUP_EXTENTS, tab->cancellable);
+	if (!io) {
+		if (!quiet)
+			znr_gui_err("Failed to get blockgroup extents\n",
+				    NULL);
+		return;
+	}
+
+	io->tab = tab;
+	io->quiet = quiet;
+	io->sector = bg->sector;
+	io->nr_sectors = bg->nr_sectors;
+	io->recv = znr_gui_extents_tab_recv;
+	io->done = znr_gui_extents_tab_done;
+	tab->loading = true;
+	znr_gui_io_submit(io);
+}
+
+/*
+ * Refresh a blockgroup tab in place: show the blockgroup information again
+ * and get its extents again, dropping the extents being received.
+ */
+static void znr_gui_blockgroup_tab_refresh(struct znr_gui_extents_tab *tab)
+{
+	tab->stale = false;
+
+	g_cancellable_cancel(tab->cancellable);
+	g_object_unref(tab->cancellable);
+	tab->cancellable = g_cancellable_new();
+
+	free(tab->extents);
+	tab->extents = NULL;
+	tab->nr_extents = 0;
+	free(tab->sorted_extents);
+	tab->sorted_extents = NULL;
+	znr_gui_extents_model_clear(tab->model);
+
+	gtk_text_buffer_delete_mark(tab->text_buffer, tab->total_mark);
+	gtk_text_buffer_set_text(tab->text_buffer, "", 0);
+	znr_gui_blockgroup_tab_info(tab, tab->blockgroup->bg_no, 0);
+
+	znr_gui_blockgroup_tab_extents(tab, true);
+}
+
+/*
+ * Refresh in place the blockgroup tabs whose blockgroup changed, once their
+ * blockgroup information is shown. Tabs still receiving extents are
+ * refreshed by a following auto-refresh, once their extents are all received,
+ * so that the extents of a blockgroup being written are always shown.
+ */
+static void znr_gui_refresh_stale_tabs(void)
+{
+	struct znr_gui_extents_tab *tab;
+	unsigned int nr_refreshed = 0;
+	AdwTabPage *page;
+	int nr_pages, i;
+
+	if (!znrg.extents_dialog)
+		return;
+
+	nr_pages = adw_tab_view_get_n_pages(znrg.extents_tab_view);
+	for (i = 0; i < nr_pages; i++) {
+		page = adw_tab_view_get_nth_page(znrg.extents_tab_view, i);
+		tab = g_object_get_data(G_OBJECT(page), "tab");
+		if (tab && tab->blockgroup && tab->stale && tab->total_mark &&
+		    !tab->loading) {
+			znr_gui_blockgroup_tab_refresh(tab);
+			nr_refreshed++;
+		}
+	}
+
+	/* Remove the extents dropped from the map */
+	if (nr_refreshed)
+		znr_gui_update();
+}
+
+/*
+ * Open the tab of a blockgroup, or focus it if it is already open.
+ */
+static void znr_gui_open_blockgroup_tab(struct znr_gui_blockgroup *blockgroup)
 {
-	GtkWidget *extents_view, *extents_scroll, *extents_text;
 	struct znr_gui_extents_tab *tab;
+	GtkTextBuffer *text_buffer;
+	struct znr_gui_io *io;
+	char tab_label[32];
+
+	if (!blockgroup)
+		return;
+
+	/* If the blockgroup already has a tab, focus it. */
+	if (blockgroup->tab) {
+		adw_tab_view_set_selected_page(znrg.extents_tab_view,
+					       blockgroup->tab->page);
+		return;
+	}
+
+	/* Open the tab, filled as the replies to its requests complete. */
+	text_buffer = gtk_text_buffer_new(NULL);
+	snprintf(tab_label, sizeof(tab_label), "Blockgroup %u",
+		 blockgroup->bg_no);
+	tab = znr_gui_add_extents_dialog_tab(tab_label, text_buffer);
+	if (!tab)
+		return;
+
+	blockgroup->tab = tab;
+	tab->blockgroup = blockgroup;
+	tab->text_buffer = text_buffer;
+	tab->cancellable = g_cancellable_new();
+
+	/* Update the blockgroup */
+	io = znr_gui_report_blockgroups(blockgroup->bg_no, 1, tab);
+	if (!io) {
+		znr_gui_err("Report Blockgroup Failed",
+			    "Report blockgroups for blockgroup %u failed",
+			    blockgroup->bg_no);
+		znr_gui_blockgroup_tab_info(tab, blockgroup->bg_no, -ENOMEM);
+	}
+
+	znr_gui_blockgroup_tab_extents(tab, false);
+}
+
+static void znr_gui_draw_legend(char *str, const GdkRGBA *color, cairo_t *cr,
+				gint *x, gint y, GtkWidget *widget)
+{
+	cairo_text_extents_t te;
+	GdkRGBA fg_color;
+	gint w = 10;
+
+	/* Get foreground color from theme */
+	gtk_widget_get_color(widget, &fg_color);
+
+	/* Draw box border with theme foreground color */
+	gdk_cairo_set_source_rgba(cr, &fg_color);
+	cairo_set_line_width(cr, 2);
+	cairo_rectangle(cr, *x, y - w / 2, w, w);
+	cairo_stroke_preserve(cr);
+
+	/* Fill box with blockgroup color */
+	gdk_cairo_set_source_rgba(cr, color);
+	cairo_fill(cr);
+	*x += w;
+
+	/* Draw text with theme foreground color */
+	gdk_cairo_set_source_rgba(cr, &fg_color);
+	cairo_text_extents(cr, str, &te);
+	cairo_move_to(cr,
+		      *x + 5 - te.x_bearing,
+		      y - te.height / 2 - te.y_bearing);
+	cairo_show_text(cr, str);
+	*x += te.x_advance + 20;
+}
+
+static void znr_gui_draw_legend_cb(GtkDrawingArea *drawing_area,
+				   cairo_t *cr,
+				   int width  __attribute__((unused)),
+				   int height  __attribute__((unused)),
+				   gpointer user_data  __attribute__((unused)))
+{
+	gint x = 80, y = 8;
+	GtkWidget *widget = GTK_WIDGET(drawing_area);
+
+	/* Set font */
+	cairo_select_font_face(cr, "Monospace",
+			       CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
+	cairo_set_font_size(cr, 10);
+
+	/* Blockgroup spans conventional zones legend */
+	znr_gui_draw_legend("Conventional",
+			    &znrg.color_conv, cr, &x, y, widget);
+
+        /*
+         * If the device is not zoned, until we can display an allocation
+         * pointer for emulated zones, keeps sequential unwritten/written
+         * legends hidden.
+         */
+        if (znr.dev.is_zoned) {
+                /* Blockgroup spans sequential zones legend */
+                znr_gui_draw_legend("Sequential (Unwritten)",
+                                    &znrg.color_seq, cr, &x, y, widget);
+
+                /* Sequential written zones legend */
+                znr_gui_draw_legend("Sequential (Written)",
+                                    &znrg.color_seqw, cr, &x, y, widget);
+        }
+
+	/* Extent highlight legend */
+	znr_gui_draw_legend("File Extent",
+			    &znrg.color_extent, cr, &x, y, widget);
+}
+
+static void znr_gui_blockgroup_size(int *width, int *height)
+{
+	/* Use a 2.5 : 1 aspect ratio for a blockgroup size */
+	if (width)
+		*width = znrg.zoom_level * 15;
+	if (height)
+		*height = znrg.zoom_level * 6;
+}
+
+/*
+ * Distance between the blockgroups of 2 consecutive columns and rows of the
+ * map.
+ */
+static void znr_gui_map_pitch(int *width, int *height)
+{
+	znr_gui_blockgroup_size(width, height);
+	if (width)
+		*width += ZNR_GUI_BLOCKGROUP_MARGINS;
+	if (height)
+		*height += ZNR_GUI_BLOCKGROUP_MARGINS;
+}
+
+static unsigned int znr_gui_map_nr_rows(void)
+{
+	return (znr_gui_nr_cells(znrg.lod) + znrg.nr_col - 1) / znrg.nr_col;
+}
+
+/*
+ * Resize the blockgroup map to new dimensions by updating blockgroup sizes:
+ * the number of columns is recalculated when the map is allocated.
+ */
+static void znr_gui_resize_map(unsigned int new_zoom_level)
+{
+	if (!znrg.map)
+		return;
+
+	/* Update zoom level */
+	znrg.zoom_level = new_zoom_level;
+
+	gtk_widget_queue_resize(znrg.map);
+}
+
+/*
+ * Blockgroup at the center of the view.
+ */
+static unsigned int znr_gui_map_center_blockgroup(void)
+{
+	unsigned long long cell;
+	GtkAdjustment *vadj;
+	int row_pitch;
+
+	if (!znrg.scroll_window || !znr.nr_blockgroups)
+		return 0;
+
+	vadj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(
+		znrg.scroll_window));
+	znr_gui_map_pitch(NULL, &row_pitch);
+
+	cell = (unsigned long long)((gtk_adjustment_get_value(vadj) +
+		gtk_adjustment_get_page_size(vadj) / 2) / row_pitch) *
+		znrg.nr_col + znrg.nr_col / 2;
+	cell <<= znrg.lod;
+
+	return MIN(cell, znr.nr_blockgroups - 1);
+}
+
+/*
+ * Zoom out: increase rows and columns (show more blockgroups).
+ */
+static void znr_gui_zoom_out_cb(GtkWidget *widget __attribute__((unused)),
+				gpointer user_data __attribute__((unused)))
+{
+	unsigned int new_zoom_level;
+
+	/*
+	 * Already at max zoom out: summarize twice as many blockgroups in each
+	 * cell, until all cells fit in a row.
+	 */
+	if (znrg.zoom_level == ZNR_GUI_MAX_ZOOM_OUT) {
+		if (znrg.lod + 1 < znrg.nr_lods &&
+		    znr_gui_nr_cells(znrg.lod) > znrg.nr_col)
+			znr_gui_map_set_lod(znrg.lod + 1,
+					    znr_gui_map_center_blockgroup());
+		return;
+	}
+
+	new_zoom_level = znrg.zoom_level - 2;
+
+	/* Limit maximum grid size */
+	if (new_zoom_level >= 2)
+		znr_gui_resize_map(new_zoom_level);
+}
+
+/*
+ * Zoom in: decrease rows and columns (show fewer blockgroups).
+ */
+static void znr_gui_zoom_in_cb(GtkWidget *widget __attribute__((unused)),
+			       gpointer user_data __attribute__((unused)))
+{
+	unsigned int new_zoom_level = znrg.zoom_level + 2;
+
+	/* Summarize half as many blockgroups in each cell first */
+	if (znrg.lod) {
+		znr_gui_map_set_lod(znrg.lod - 1,
+				    znr_gui_map_center_blockgroup());
+		return;
+	}
+
+	/* Limit minimum grid size */
+	if (new_zoom_level <= 30)
+		znr_gui_resize_map(new_zoom_level);
+}
+
+static int znr_gui_get_first_blockgroup_in_view(unsigned int *first_blockgroup)
+{
+	GtkAdjustment *vadj;
+	int first_row;
+	int row_pitch;
+
+	znr_gui_map_pitch(NULL, &row_pitch);
+
+	if (!znrg.scroll_window)
+		return -EINVAL;
+
+	vadj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(
+                znrg.scroll_window));
+	if (!vadj)
+		return -EINVAL;
+
+	first_row = gtk_adjustment_get_value(vadj) / row_pitch;
+	*first_blockgroup = (first_row * znrg.nr_col) << znrg.lod;
+
+	return 0;
+}
+
+/*
+ * Number of blockgroups in view, including the partially visible rows.
+ */
+static unsigned int znr_gui_get_nr_blockgroups_in_view(void)
+{
+	unsigned long long nr;
+	int row_pitch;
+
+	if (!znrg.map)
+		return 0;
+
+	znr_gui_map_pitch(NULL, &row_pitch);
+
+	nr = (unsigned long long)(gtk_widget_get_height(znrg.map) / row_pitch +
+				  2) * znrg.nr_col;
+
+	return MIN(nr << znrg.lod, znr.nr_blockgroups);
+}
+
+/*
+ * Scroll the map so that the blockgroup @bg_no is in view.
+ */
+static void znr_gui_map_scroll_to(unsigned int bg_no)
+{
+	GtkAdjustment *vadj;
+	double y, value, page;
+	int row_pitch;
+
+	if (!znrg.scroll_window)
+		return;
+
+	vadj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(
+		znrg.scroll_window));
+	znr_gui_map_pitch(NULL, &row_pitch);
+
+	y = (double)((bg_no >> znrg.lod) / znrg.nr_col) * row_pitch;
+	value = gtk_adjustment_get_value(vadj);
+	page = gtk_adjustment_get_page_size(vadj);
+	if (y < value)
+		gtk_adjustment_set_value(vadj, y);
+	else if (y + row_pitch > value + page)
+		gtk_adjustment_set_value(vadj, y + row_pitch - page);
+}
+
+/*
+ * Scroll the map so that the row of the blockgroup @bg_no is at the center of
+ * the view.
+ */
+static void znr_gui_map_center_on(unsigned int bg_no)
+{
+	GtkAdjustment *vadj;
+	int row_pitch;
+
+	if (!znrg.scroll_window)
+		return;
+
+	vadj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(
+		znrg.scroll_window));
+	znr_gui_map_pitch(NULL, &row_pitch);
+
+	gtk_adjustment_set_value(vadj,
+		(double)((bg_no >> znrg.lod) / znrg.nr_col) * row_pitch +
+		(row_pitch - gtk_adjustment_get_page_size(vadj)) / 2);
+}
+
+/*
+ * The view was scrolled: cancel the pending report of the blockgroups
+ * previously in view if it was not executed yet.
+ */
+static void znr_gui_view_changed_cb(GtkAdjustment *vadj, gpointer user_data)
+{
+	unsigned int first_blockgroup;
+
+	if (!znrg.view_io ||
+	    znr_gui_get_first_blockgroup_in_view(&first_blockgroup))
+		return;
+
+	if (first_blockgroup != znrg.view_io->bg_no) {
+		g_cancellable_cancel(znrg.view_io->cancellable);
+		znrg.view_io = NULL;
+	}
+}
+
+static gboolean znr_gui_refresh_local_cb(gpointer user_data);
+
+/*
+ * Schedule the next auto-refresh, replacing the one pending, if any.
+ */
+static void znr_gui_refresh_schedule(void)
+{
+	g_clear_handle_id(&znrg.refresh_source, g_source_remove);
+	znrg.refresh_source = g_timeout_add(znrg.refresh_adaptive ?
+					    znrg.refresh_cur_ms :
+					    znrg.refresh_ms,
+					    znr_gui_refresh_local_cb, NULL);
+}
+
+/*
+ * An auto-refresh report completed: refresh in place the blockgroup tabs
+ * whose blockgroup changed and, in adaptive mode, schedule the next refresh,
+ * sooner if write pointers moved and later otherwise.
+ */
+static void znr_gui_refresh_done(unsigned int nr_moved)
+{
+	znr_gui_refresh_stale_tabs();
+
+	if (!znrg.refresh_ms || !znrg.refresh_adaptive)
+		return;
 
-	tab = calloc(1, sizeof(*tab));
-	if (!tab) {
-		znr_gui_err("Failed to allocate new tab", NULL);
-		return NULL;
-	}
+	if (nr_moved)
+		znrg.refresh_cur_ms = znrg.refresh_ms;
+	else
+		znrg.refresh_cur_ms = MIN(znrg.refresh_cur_ms * 2,
+					  znrg.refresh_max_ms);
+	znr_gui_refresh_schedule();
+}
 
-	/* Make sure we have an extents dialog window. */
-	znr_gui_open_extents_dialog();
+static gboolean znr_gui_refresh_local_cb(gpointer user_data)
+{
+	unsigned int first_blockgroup = 0;
 
-	/* Scrolled window for the tab text */
-	extents_view = adw_view_stack_new();
-	extents_scroll = gtk_scrolled_window_new();
-	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(extents_scroll),
-				GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-	gtk_widget_set_hexpand(extents_scroll, TRUE);
-	gtk_widget_set_vexpand(extents_scroll, TRUE);
+	if (znr_gui_get_first_blockgroup_in_view(&first_blockgroup))
+		znr_gui_err("Failed to refresh local blockgroups\n", NULL);
 
-	extents_text = gtk_text_view_new();
-	gtk_text_view_set_buffer(GTK_TEXT_VIEW(extents_text), tab_text_buffer);
-	gtk_text_view_set_editable(GTK_TEXT_VIEW(extents_text), FALSE);
-	gtk_text_view_set_cursor_visible(GTK_TEXT_VIEW(extents_text), FALSE);
+	/*
+	 * Do not queue reports of the same blockgroups faster than the
+	 * I/O worker executes them.
+	 */
+	if (znrg.view_io) {
+		if (znrg.view_io->bg_no == first_blockgroup)
+			goto out;
+		g_cancellable_cancel(znrg.view_io->cancellable);
+	}
 
-	gtk_text_view_set_top_margin(GTK_TEXT_VIEW(extents_text), 10);
-	gtk_text_view_set_left_margin(GTK_TEXT_VIEW(extents_text), 20);
-	gtk_text_view_set_right_margin(GTK_TEXT_VIEW(extents_text), 10);
-	gtk_text_view_set_bottom_margin(GTK_TEXT_VIEW(extents_text), 50);
+	znrg.view_io = znr_gui_report_blockgroups(first_blockgroup,
+					znr_gui_get_nr_blockgroups_in_view(), NULL);
+	if (znrg.view_io) {
+		znrg.view_io->quiet = true;
+		znrg.view_io->auto_refresh = true;
+	}
 
-	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(extents_scroll),
-				      extents_text);
+out:
+	if (znrg.refresh_ms < ZNR_GUI_MIN_REFRESH_MS) {
+		znrg.refresh_source = 0;
+		return G_SOURCE_REMOVE;
+	}
 
-	adw_view_stack_add_titled_with_icon(ADW_VIEW_STACK(extents_view),
-					    extents_scroll,
-					    tab_label, tab_label,
-					    "info-outline-symbolic");
+	if (!znrg.refresh_adaptive)
+		return G_SOURCE_CONTINUE;
 
-	/* Add a new tab for this blockgroup */
-	tab->page = adw_tab_view_append(znrg.extents_tab_view, extents_view);
-	adw_tab_page_set_title(tab->page, tab_label);
-	g_object_set_data(G_OBJECT(tab->page), "tab", (gpointer)tab);
-	adw_tab_view_set_selected_page(znrg.extents_tab_view, tab->page);
+	/* The next refresh is scheduled once the report completes */
+	znrg.refresh_source = 0;
+	if (!znrg.view_io)
+		znr_gui_refresh_done(0);
 
-	return tab;
+	return G_SOURCE_REMOVE;
 }
 
-static void znr_gui_blockgroup_click_cb(GtkGestureClick *self, gint n_press,
-					gdouble x, gdouble y,
-					gpointer user_data)
+static void znr_gui_refresh_ms_check_cb(GtkWidget *widget,
+				gpointer user_data __attribute__((unused)))
 {
-	struct znr_gui_blockgroup *blockgroup =
-		(struct znr_gui_blockgroup *)user_data;
-	struct znr_gui_extents_tab *tab;
-	GtkTextBuffer *text_buffer;
-	struct znr_extent *extents;
-	unsigned int nr_extents;
-	GtkTextIter iter;
-	char *extents_info = NULL;
-	char info[256];
-	char tab_label[32], *bg_info;
-	int ret;
+	const char *text;
+	char *endptr;
+	unsigned long long refresh_ms, refresh_max_ms;
+	bool active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget));
 
-	if (!blockgroup || !blockgroup->bg)
-		return;
+	if (active) {
+		text = gtk_editable_get_text(GTK_EDITABLE(znrg.refresh_ms_entry));
+		errno = 0;
+		refresh_ms = strtoull(text, &endptr, 10);
+		if (errno || endptr == text || *endptr != '\0' ||
+		    refresh_ms < ZNR_GUI_MIN_REFRESH_MS ||
+		    refresh_ms > UINT_MAX) {
+			znr_gui_err("Invalid Input",
+				    "Enter a valid period (Minimum %dms)",
+				    ZNR_GUI_MIN_REFRESH_MS);
+			gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(widget),
+						     FALSE);
+			return;
+		}
 
-	/* If the blockgroup already has a tab, focus it. */
-	if (blockgroup->tab) {
-		adw_tab_view_set_selected_page(znrg.extents_tab_view,
-					       blockgroup->tab->page);
-		return;
+		/* The adaptive mode longest period defaults to 10 s */
+		text = gtk_editable_get_text(GTK_EDITABLE(znrg.refresh_max_ms_entry));
+		if (!text || !strlen(text)) {
+			refresh_max_ms = MAX(refresh_ms,
+					     ZNR_GUI_DEF_MAX_REFRESH_MS);
+		} else {
+			errno = 0;
+			refresh_max_ms = strtoull(text, &endptr, 10);
+			if (errno || endptr == text || *endptr != '\0' ||
+			    refresh_max_ms < refresh_ms ||
+			    refresh_max_ms > UINT_MAX) {
+				znr_gui_err("Invalid Input",
+					"Enter a valid maximum period "
+					"(Minimum %llums)", refresh_ms);
+				gtk_toggle_button_set_active(
+					GTK_TOGGLE_BUTTON(widget), FALSE);
+				return;
+			}
+		}
+
+		znrg.refresh_ms = refresh_ms;
+		znrg.refresh_max_ms = refresh_max_ms;
+		znrg.refresh_cur_ms = refresh_ms;
+		znr_gui_refresh_schedule();
+	} else {
+		znrg.refresh_ms = 0;
+		g_clear_handle_id(&znrg.refresh_source, g_source_remove);
 	}
+}
 
-	/* Update the blockgroup */
-	ret = znr_gui_report_blockgroups(blockgroup->bg_no, 1);
-	if (ret) {
-		znr_gui_err("Report Blockgroup Failed",
-			    "Report blockgroups for blockgroup %u failed (%s)",
-			    blockgroup->bg_no, strerror(errno));
+/*
+ * Toggle the adaptive auto-refresh: restart from the shortest period.
+ */
+static void znr_gui_refresh_adaptive_cb(GtkCheckButton *check,
+				gpointer user_data __attribute__((unused)))
+{
+	znrg.refresh_adaptive = gtk_check_button_get_active(check);
+	znrg.refresh_cur_ms = znrg.refresh_ms;
+	if (znrg.refresh_ms)
+		znr_gui_refresh_schedule();
+}
+
+static void znr_gui_refresh_cb(GtkWidget *widget __attribute__((unused)),
+			       gpointer user_data __attribute__((unused)))
+{
+	znr_gui_close_extents_dialog();
+	znr_gui_report_blockgroups(0, znr.nr_blockgroups, NULL);
+}
+
+static void
+znr_gui_show_blockgroup_cb(GtkWidget *button __attribute__((unused)),
+			   gpointer user_data __attribute__((unused)))
+{
+	const char *text;
+	char *endptr;
+	long bg_no;
+
+	text = gtk_editable_get_text(GTK_EDITABLE(znrg.show_blockgroup_entry));
+	if (!text || !strlen(text))
 		return;
-	}
 
-	/* Get all extents in the clicked blockgroup */
-	ret = znr_fs_get_extents_in_range(blockgroup->bg->sector,
-					  blockgroup->bg->nr_sectors,
-					  &extents, &nr_extents);
-	if (ret) {
-		znr_gui_err("Failed to get blockgroup extents\n", NULL);
+	errno = 0;
+	bg_no = strtol(text, &endptr, 10);
+	if (errno == ERANGE || endptr == text || *endptr != '\0' ||
+	    bg_no < 0 || (unsigned long)bg_no >= znr.nr_blockgroups) {
+		znr_gui_err("Invalid blockgroup number",
+			    "Blockgroup: %s", text);
+		gtk_editable_set_text(GTK_EDITABLE(znrg.show_blockgroup_entry),
+				      "");
 		return;
 	}
 
+	znr_gui_map_scroll_to(bg_no);
+	gtk_editable_set_text(GTK_EDITABLE(znrg.show_blockgroup_entry), "");
+
+	/* When the grid updates, this blockgroup will be selected */
+	znrg.show_blockgroup = bg_no;
+	znr_gui_update();
+}
+
+static void znr_gui_clear_file_search_entry(void)
+{
+	gtk_editable_set_text(GTK_EDITABLE(znrg.search_entry), "");
+	znr_gui_update();
+}
+
+/*
+ * Open a tab showing a file extents.
+ */
+static void znr_gui_open_file_tab(struct znr_fs_file *f,
+				  struct znr_extent *extents,
+				  unsigned int nr_extents)
+{
+	struct znr_gui_extents_tab *tab;
+	GtkTextBuffer *text_buffer;
+	GtkTextIter iter;
+	char *extents_info;
+	char tab_label[256];
+
 	/* Build extent information string */
-	extents_info = znr_gui_extent_info(extents, nr_extents, NULL);
+	extents_info = znr_gui_extent_info(nr_extents, f);
 	if (!extents_info) {
 		znr_gui_err("Failed to get extent information\n", NULL);
-		return;
+		goto free;
 	}
 
 	/* Set the extents information text. */
 	text_buffer = gtk_text_buffer_new(NULL);
 	gtk_text_buffer_get_start_iter(text_buffer, &iter);
-
-	if (blockgroup->bg->wp_sector >= blockgroup->bg->nr_sectors)
-		snprintf(info, sizeof(info),
-			 "<b>Blockgroup %u</b>\nSector: %lu\nSize: %lu sectors\nWP: N/A (Blockgroup full) \n\n",
-			 blockgroup->bg_no, blockgroup->bg->sector,
-			 blockgroup->bg->nr_sectors);
-	else
-		snprintf(info, sizeof(info),
-			 "<b>Blockgroup %u</b>\nSector: %lu\nSize: %lu sectors\nWP: %lu\n\n",
-			 blockgroup->bg_no, blockgroup->bg->sector,
-			 blockgroup->bg->nr_sectors, blockgroup->bg->wp_sector);
-	bg_info = info;
-	gtk_text_buffer_insert_markup(text_buffer, &iter, bg_info,
-				      strlen(bg_info));
 	gtk_text_buffer_insert_markup(text_buffer, &iter, extents_info,
 				      strlen(extents_info));
 	free(extents_info);
 
 	/* Open the tab */
-	snprintf(tab_label, sizeof(tab_label), "Blockgroup %u",
-		 blockgroup->bg_no);
+	snprintf(tab_label, sizeof(tab_label), "File %s", f->path);
 	tab = znr_gui_add_extents_dialog_tab(tab_label, text_buffer);
 	if (!tab)
-		return;
+		goto free;
 
-	blockgroup->tab = tab;
-	tab->blockgroup = blockgroup;
+	tab->file = f;
+	tab->text_buffer = text_buffer;
 	tab->extents = extents;
 	tab->nr_extents = nr_extents;
+	znr_gui_extents_tab_sort(tab);
+	if (znr_gui_extents_model_update(tab->model))
+		znr_gui_err("Failed to list the file extents\n", NULL);
 
-	znr_gui_update();
+	return;
+
+free:
+	znr_fs_free_file(f);
+	free(extents);
 }
 
-static void znr_gui_draw_legend(char *str, const GdkRGBA *color, cairo_t *cr,
-				gint *x, gint y, GtkWidget *widget)
+/*
+ * The extents of the files searched were received: open a tab for each file
+ * and update all blockgroups.
+ */
+static void znr_gui_search_file_done(struct znr_gui_io *io)
 {
-	cairo_text_extents_t te;
-	GdkRGBA fg_color;
-	gint w = 10;
+	struct znr_batch_req *reqs = io->reqs;
+	struct znr_fs_file *f;
+	unsigned int i;
 
-	/* Get foreground color from theme */
-	gtk_widget_get_color(widget, &fg_color);
+	if (io->ret) {
+		znr_gui_err("Failed to get file extents", "Error: %s",
+			    strerror(-io->ret));
+		znr_gui_clear_file_search_entry();
+		return;
+	}
 
-	/* Draw box border with theme foreground color */
-	gdk_cairo_set_source_rgba(cr, &fg_color);
-	cairo_set_line_width(cr, 2);
-	cairo_rectangle(cr, *x, y - w / 2, w, w);
-	cairo_stroke_preserve(cr);
+	for (i = 0; i < io->nr_reqs; i++) {
+		if (reqs[i].err) {
+			znr_gui_err("Failed to get file extents",
+				    "File: %s/%s\nError: %s",
+				    znr.mnt_dir.path, reqs[i].path,
+				    strerror(reqs[i].err));
+			continue;
+		}
 
-	/* Fill box with blockgroup color */
-	gdk_cairo_set_source_rgba(cr, color);
-	cairo_fill(cr);
-	*x += w;
+		f = znr_fs_alloc_file(reqs[i].path);
+		if (!f) {
+			znr_gui_err("Failed to allocate file\n", NULL);
+			continue;
+		}
+		if (reqs[i].nr)
+			f->ino = reqs[i].extents[0].ino;
 
-	/* Draw text with theme foreground color */
-	gdk_cairo_set_source_rgba(cr, &fg_color);
-	cairo_text_extents(cr, str, &te);
-	cairo_move_to(cr,
-		      *x + 5 - te.x_bearing,
-		      y - te.height / 2 - te.y_bearing);
-	cairo_show_text(cr, str);
-	*x += te.x_advance + 20;
+		/* The tab owns the extents */
+		znr_gui_open_file_tab(f, reqs[i].extents, reqs[i].nr);
+		reqs[i].extents = NULL;
+	}
+
+	znr_gui_report_blockgroups(0, znr.nr_blockgroups, NULL);
 }
 
-static void znr_gui_draw_legend_cb(GtkDrawingArea *drawing_area,
-				   cairo_t *cr,
-				   int width  __attribute__((unused)),
-				   int height  __attribute__((unused)),
-				   gpointer user_data  __attribute__((unused)))
+/*
+ * Show the extents of the files listed in the search entry. Several files can
+ * be searched at once by separating their paths with commas: all file
+ * extents are then obtained with a single batch request.
+ */
+static void znr_gui_search_file_cb(GtkWidget *button, gpointer user_data)
 {
-	gint x = 80, y = 8;
-	GtkWidget *widget = GTK_WIDGET(drawing_area);
+	struct znr_gui_io *io;
+	const char *text;
+	unsigned int i;
 
-	/* Set font */
-	cairo_select_font_face(cr, "Monospace",
-			       CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_BOLD);
-	cairo_set_font_size(cr, 10);
+	text = gtk_editable_get_text(GTK_EDITABLE(znrg.search_entry));
+	if (!text || !strlen(text))
+		return;
 
-	/* Blockgroup spans conventional zones legend */
-	znr_gui_draw_legend("Conventional",
-			    &znrg.color_conv, cr, &x, y, widget);
+	io = znr_gui_io_alloc(ZNR_GUI_IO_FILE_EXTENTS, NULL);
+	if (!io)
+		goto out_err;
 
-        /*
-         * If the device is not zoned, until we can display an allocation
-         * pointer for emulated zones, keeps sequential unwritten/written
-         * legends hidden.
-         */
-        if (znr.dev.is_zoned) {
-                /* Blockgroup spans sequential zones legend */
-                znr_gui_draw_legend("Sequential (Unwritten)",
-                                    &znrg.color_seq, cr, &x, y, widget);
+	io->reqs = calloc(ZNR_BATCH_MAX_REQS, sizeof(struct znr_batch_req));
+	if (!io->reqs) {
+		znr_gui_io_free(io);
+		goto out_err;
+	}
 
-                /* Sequential written zones legend */
-                znr_gui_draw_legend("Sequential (Written)",
-                                    &znrg.color_seqw, cr, &x, y, widget);
-        }
+	/* The batch requests point to the paths, freed with the request */
+	io->paths = g_strsplit(text, ",", -1);
+	for (i = 0; io->paths[i] && io->nr_reqs < ZNR_BATCH_MAX_REQS; i++) {
+		g_strstrip(io->paths[i]);
+		if (!strlen(io->paths[i]))
+			continue;
+		io->reqs[io->nr_reqs].type = ZNR_BATCH_FILE_EXTENTS;
+		io->reqs[io->nr_reqs].path = io->paths[i];
+		io->nr_reqs++;
+	}
 
-	/* Extent highlight legend */
-	znr_gui_draw_legend("File Extent",
-			    &znrg.color_extent, cr, &x, y, widget);
+	if (!io->nr_reqs) {
+		znr_gui_io_free(io);
+		return;
+	}
+
+	/* Get extents for the files by path */
+	io->done = znr_gui_search_file_done;
+	znr_gui_io_submit(io);
+
+	return;
+
+out_err:
+	znr_gui_err("Failed to get file extents", "Error: %s",
+		    strerror(ENOMEM));
 }
 
-static void znr_gui_blockgroup_da_size(int *width, int *height)
+/*
+ * Cell at the map coordinates @x, @y, UINT_MAX if there is none (e.g. the
+ * margins between cells). At level of detail 0, this is a blockgroup.
+ */
+static unsigned int znr_gui_map_cell_at(znr_blockgroup_map *map,
+					double x, double y)
 {
-	/* Use a 2.5 : 1 aspect ratio for a blockgroup drawing area size */
-	if (width)
-		*width = znrg.zoom_level * 15;
-	if (height)
-		*height = znrg.zoom_level * 6;
+	unsigned long long row, col, cell;
+	int bw, bh, pw, ph;
+
+	znr_gui_blockgroup_size(&bw, &bh);
+	znr_gui_map_pitch(&pw, &ph);
+
+	if (map->vadj)
+		y += gtk_adjustment_get_value(map->vadj);
+	if (x < 0 || y < 0)
+		return UINT_MAX;
+
+	col = x / pw;
+	row = y / ph;
+	if (col >= znrg.nr_col)
+		return UINT_MAX;
+
+	x -= col * pw;
+	y -= row * ph;
+	if (x < ZNR_GUI_BLOCKGROUP_MARGIN ||
+	    x >= ZNR_GUI_BLOCKGROUP_MARGIN + bw ||
+	    y < ZNR_GUI_BLOCKGROUP_MARGIN ||
+	    y >= ZNR_GUI_BLOCKGROUP_MARGIN + bh)
+		return UINT_MAX;
+
+	cell = row * znrg.nr_col + col;
+	if (cell >= znr_gui_nr_cells(znrg.lod))
+		return UINT_MAX;
+
+	return cell;
+}
+
+static void znr_gui_map_set_hovered(znr_blockgroup_map *map)
+{
+	unsigned int cell = UINT_MAX;
+
+	if (map->has_pointer)
+		cell = znr_gui_map_cell_at(map, map->pointer_x,
+					   map->pointer_y);
+	if (cell == znrg.hovered)
+		return;
+
+	znrg.hovered = cell;
+	if (cell != UINT_MAX)
+		znr_gui_map_cell_status(cell);
+
+	gtk_widget_queue_draw(GTK_WIDGET(map));
+}
+
+static void znr_gui_map_motion_cb(GtkEventControllerMotion *ctrl,
+				  gdouble x, gdouble y, gpointer user_data)
+{
+	znr_blockgroup_map *map = user_data;
+
+	map->has_pointer = true;
+	map->pointer_x = x;
+	map->pointer_y = y;
+	znr_gui_map_set_hovered(map);
+}
+
+static void znr_gui_map_leave_cb(GtkEventControllerMotion *ctrl,
+				 gpointer user_data)
+{
+	znr_blockgroup_map *map = user_data;
+
+	map->has_pointer = false;
+	znr_gui_map_set_hovered(map);
 }
 
 /*
- * Helper to resize a single drawing area widget
+ * Zoom into the summary cell @cell: go down at least one level of detail, and
+ * down to the finest level showing all its blockgroups in view, centered.
  */
-static void znr_gui_resize_drawing_area(gpointer key, gpointer value,
-					gpointer user_data)
+static void znr_gui_map_zoom_into(znr_blockgroup_map *map, unsigned int cell)
 {
-	GtkWidget *da = GTK_WIDGET(value);
-	int zw, zh;
+	unsigned long long nr_in_view, first, center;
+	unsigned int lod = znrg.lod - 1;
+	int row_pitch;
+
+	znr_gui_map_pitch(NULL, &row_pitch);
+	nr_in_view = (unsigned long long)
+		MAX(gtk_widget_get_height(GTK_WIDGET(map)) / row_pitch, 1) *
+		znrg.nr_col;
 
-	znr_gui_blockgroup_da_size(&zw, &zh);
-	gtk_widget_set_size_request(da, zw, zh);
-	gtk_widget_queue_resize(da);
+	/* At level lod - 1, the cell spans 2^(znrg.lod - lod + 1) cells */
+	while (lod && (1ULL << (znrg.lod - lod + 1)) <= nr_in_view)
+		lod--;
+
+	first = (unsigned long long)cell << znrg.lod;
+	center = MIN(first + (1ULL << znrg.lod) / 2, znr.nr_blockgroups - 1);
+	znr_gui_map_set_lod(lod, center);
 }
 
-/*
- * Resize the blockgroup grid to new dimensions by updating blockgroup sizes
- */
-static void znr_gui_resize_grid(unsigned int new_zoom_level)
+static void znr_gui_map_click_cb(GtkGestureClick *self, gint n_press,
+				 gdouble x, gdouble y, gpointer user_data)
 {
-	int gw, zw;
+	znr_blockgroup_map *map = user_data;
+	unsigned int cell;
 
-	if (!znrg.grid_view)
+	cell = znr_gui_map_cell_at(map, x, y);
+	if (cell == UINT_MAX)
 		return;
 
-	/* Update zoom level */
-	znrg.zoom_level = new_zoom_level;
-
-	/* Recalculate number of columns based on new blockgroup size */
-	gw = gtk_widget_get_width(znrg.scroll_window);
-	znr_gui_blockgroup_da_size(&zw, NULL);
-	znrg.nr_col = gw / zw;
+	if (znrg.lod)
+		znr_gui_map_zoom_into(map, cell);
+	else
+		znr_gui_open_blockgroup_tab(&znrg.blockgroups[cell]);
+}
 
-	/* Update grid column count */
-	gtk_grid_view_set_max_columns(GTK_GRID_VIEW(znrg.grid_view),
-				      znrg.nr_col);
-	gtk_grid_view_set_min_columns(GTK_GRID_VIEW(znrg.grid_view),
-				      znrg.nr_col);
+static void znr_gui_map_value_changed_cb(GtkAdjustment *adj,
+					 gpointer user_data)
+{
+	znr_blockgroup_map *map = user_data;
 
-	/* Resize all currently visible drawing areas */
-	if (znrg.drawing_areas)
-		g_hash_table_foreach(znrg.drawing_areas,
-				     znr_gui_resize_drawing_area, NULL);
+	znr_gui_map_set_hovered(map);
+	gtk_widget_queue_draw(GTK_WIDGET(map));
+	if (znrg.minimap)
+		gtk_widget_queue_draw(znrg.minimap);
 }
 
 /*
- * Zoom out: increase rows and columns (show more blockgroups).
+ * Set the adjustments ranges: the vertical one spans all rows of
+ * blockgroups, the map is never scrolled horizontally.
  */
-static void znr_gui_zoom_out_cb(GtkWidget *widget __attribute__((unused)),
-				gpointer user_data __attribute__((unused)))
+static void znr_gui_map_configure(znr_blockgroup_map *map)
 {
-	unsigned int new_zoom_level;
-
-	/* Already at max zoom out */
-	if (znrg.zoom_level == ZNR_GUI_MAX_ZOOM_OUT)
-		return;
-
-	new_zoom_level = znrg.zoom_level - 2;
+	int width = gtk_widget_get_width(GTK_WIDGET(map));
+	int height = gtk_widget_get_height(GTK_WIDGET(map));
+	double upper, value;
+	int row_pitch;
 
-	/* Limit maximum grid size */
-	if (new_zoom_level >= 2)
-		znr_gui_resize_grid(new_zoom_level);
+	znr_gui_map_pitch(NULL, &row_pitch);
+
+	if (map->hadj)
+		gtk_adjustment_configure(map->hadj, 0, 0, width,
+					 width * 0.1, width * 0.9, width);
+
+	if (map->vadj) {
+		upper = (double)znr_gui_map_nr_rows() * row_pitch;
+		if (upper < height)
+			upper = height;
+		value = gtk_adjustment_get_value(map->vadj);
+		if (value > upper - height)
+			value = upper - height;
+		gtk_adjustment_configure(map->vadj, value, 0, upper,
+					 row_pitch, height * 0.9, height);
+	}
 }
 
 /*
- * Zoom in: decrease rows and columns (show fewer blockgroups).
+ * Set the level of detail of the map, centering the view on the blockgroup
+ * @bg_no.
  */
-static void znr_gui_zoom_in_cb(GtkWidget *widget __attribute__((unused)),
-			       gpointer user_data __attribute__((unused)))
+static void znr_gui_map_set_lod(unsigned int lod, unsigned int bg_no)
 {
-	unsigned int new_zoom_level = znrg.zoom_level + 2;
+	znr_blockgroup_map *map;
 
-	/* Limit minimum grid size */
-	if (new_zoom_level <= 30)
-		znr_gui_resize_grid(new_zoom_level);
+	if (!znrg.map || lod == znrg.lod)
+		return;
+
+	map = ZNR_BLOCKGROUP_MAP(znrg.map);
+	znrg.lod = lod;
+	znrg.hovered = UINT_MAX;
+
+	znr_gui_map_configure(map);
+	znr_gui_map_center_on(bg_no);
+	znr_gui_map_set_hovered(map);
+	znr_gui_update();
+	if (znrg.minimap)
+		gtk_widget_queue_draw(znrg.minimap);
 }
 
-static int znr_gui_get_first_blockgroup_in_view(unsigned int *first_blockgroup)
+static void znr_gui_map_set_adjustment(znr_blockgroup_map *map,
+				       GtkAdjustment **map_adj,
+				       GtkAdjustment *adj)
 {
-	GtkAdjustment *vadj;
-	int first_row;
-	int bgh;
-	int row_pitch;
-
-	znr_gui_blockgroup_da_size(NULL, &bgh);
-	row_pitch = bgh + ZNR_GUI_BLOCKGROUP_MARGINS;
+	if (adj && *map_adj == adj)
+		return;
 
-	if (!znrg.scroll_window)
-		return -EINVAL;
+	if (*map_adj) {
+		g_signal_handlers_disconnect_by_func(*map_adj,
+				znr_gui_map_value_changed_cb, map);
+		g_object_unref(*map_adj);
+	}
 
-	vadj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(
-                znrg.scroll_window));
-	if (!vadj)
-		return -EINVAL;
+	if (!adj)
+		adj = gtk_adjustment_new(0, 0, 0, 0, 0, 0);
+	g_signal_connect(adj, "value-changed",
+			 G_CALLBACK(znr_gui_map_value_changed_cb), map);
+	*map_adj = g_object_ref_sink(adj);
 
-	first_row = gtk_adjustment_get_value(vadj) / row_pitch;
-	*first_blockgroup = first_row * znrg.nr_col;
+	znr_gui_map_configure(map);
+}
 
-	return 0;
+static void znr_blockgroup_map_set_property(GObject *object, guint prop_id,
+					    const GValue *value,
+					    GParamSpec *pspec)
+{
+	znr_blockgroup_map *map = ZNR_BLOCKGROUP_MAP(object);
+
+	switch (prop_id) {
+	case ZNR_MAP_PROP_HADJUSTMENT:
+		znr_gui_map_set_adjustment(map, &map->hadj,
+					   g_value_get_object(value));
+		break;
+	case ZNR_MAP_PROP_VADJUSTMENT:
+		znr_gui_map_set_adjustment(map, &map->vadj,
+					   g_value_get_object(value));
+		break;
+	case ZNR_MAP_PROP_HSCROLL_POLICY:
+		map->hscroll_policy = g_value_get_enum(value);
+		break;
+	case ZNR_MAP_PROP_VSCROLL_POLICY:
+		map->vscroll_policy = g_value_get_enum(value);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
 }
 
-static gboolean znr_gui_refresh_local_cb(gpointer user_data)
+static void znr_blockgroup_map_get_property(GObject *object, guint prop_id,
+					    GValue *value, GParamSpec *pspec)
 {
-	unsigned int first_blockgroup = 0;
+	znr_blockgroup_map *map = ZNR_BLOCKGROUP_MAP(object);
+
+	switch (prop_id) {
+	case ZNR_MAP_PROP_HADJUSTMENT:
+		g_value_set_object(value, map->hadj);
+		break;
+	case ZNR_MAP_PROP_VADJUSTMENT:
+		g_value_set_object(value, map->vadj);
+		break;
+	case ZNR_MAP_PROP_HSCROLL_POLICY:
+		g_value_set_enum(value, map->hscroll_policy);
+		break;
+	case ZNR_MAP_PROP_VSCROLL_POLICY:
+		g_value_set_enum(value, map->vscroll_policy);
+		break;
+	default:
+		G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+		break;
+	}
+}
 
-	if (znr_gui_get_first_blockgroup_in_view(&first_blockgroup))
-		znr_gui_err("Failed to refresh local blockgroups\n", NULL);
+static void znr_blockgroup_map_dispose(GObject *object)
+{
+	znr_blockgroup_map *map = ZNR_BLOCKGROUP_MAP(object);
+	unsigned int c, d;
 
-	if (znrg.visible_blockgroups_no > znr.nr_blockgroups) {
-		fprintf(stderr, "Invalid visible blockgroups number: %lld\n",
-			znrg.visible_blockgroups_no);
-		return G_SOURCE_REMOVE;
+	if (map->hadj) {
+		g_signal_handlers_disconnect_by_func(map->hadj,
+				znr_gui_map_value_changed_cb, map);
+		g_clear_object(&map->hadj);
 	}
+	if (map->vadj) {
+		g_signal_handlers_disconnect_by_func(map->vadj,
+				znr_gui_map_value_changed_cb, map);
+		g_clear_object(&map->vadj);
+	}
+	g_clear_object(&map->layout);
+	for (c = 0; c < ZNR_GUI_NR_NUM_COLORS; c++) {
+		for (d = 0; d < 10; d++)
+			g_clear_pointer(&map->digits[c][d],
+					gsk_render_node_unref);
+	}
+	g_clear_pointer(&map->cover, free);
+	map->nr_cover_cols = 0;
 
-	znr_gui_close_extents_dialog();
-	znr_gui_report_blockgroups(first_blockgroup,
-				   znrg.visible_blockgroups_no);
-	znr_gui_update();
-
-	if (znrg.refresh_ms >= ZNR_GUI_MIN_REFRESH_MS)
-		return G_SOURCE_CONTINUE;
-	return G_SOURCE_REMOVE;
+	G_OBJECT_CLASS(znr_blockgroup_map_parent_class)->dispose(object);
 }
 
-static void znr_gui_refresh_ms_check_cb(GtkWidget *widget,
-				gpointer user_data __attribute__((unused)))
+static void znr_blockgroup_map_measure(GtkWidget *widget,
+				       GtkOrientation orientation,
+				       int for_size, int *minimum,
+				       int *natural, int *minimum_baseline,
+				       int *natural_baseline)
 {
-	const char *text;
-	char *endptr;
-	unsigned long long refresh_ms;
-	bool active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(widget));
+	int pw, ph;
 
-	if (active) {
-		text = gtk_editable_get_text(GTK_EDITABLE(znrg.refresh_ms_entry));
-		errno = 0;
-		refresh_ms = strtoull(text, &endptr, 10);
-		if (errno || endptr == text || *endptr != '\0' ||
-		    refresh_ms < ZNR_GUI_MIN_REFRESH_MS) {
-			znr_gui_err("Invalid Input",
-				    "Enter a valid period (Minimum %dms)",
-				    ZNR_GUI_MIN_REFRESH_MS);
-			gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(widget),
-						     FALSE);
-			return;
-		}
-		znrg.refresh_ms = refresh_ms;
-		g_timeout_add(znrg.refresh_ms, znr_gui_refresh_local_cb, NULL);
+	znr_gui_map_pitch(&pw, &ph);
+
+	/* Start with the default number of columns */
+	if (orientation == GTK_ORIENTATION_HORIZONTAL) {
+		*minimum = pw;
+		*natural = pw * znrg.nr_col_min;
 	} else {
-		znrg.refresh_ms = 0;
+		*minimum = ph;
+		*natural = ph * MIN(znr_gui_map_nr_rows(), 16);
 	}
 }
 
-static void znr_gui_refresh_cb(GtkWidget *widget __attribute__((unused)),
-			       gpointer user_data __attribute__((unused)))
+/*
+ * The map size changed: fit as many columns of blockgroups as possible in
+ * its width.
+ */
+static void znr_blockgroup_map_size_allocate(GtkWidget *widget, int width,
+					     int height, int baseline)
 {
-        struct znr_gui_blockgroup_report_info *bg_rep;
+	znr_blockgroup_map *map = ZNR_BLOCKGROUP_MAP(widget);
+	int col_pitch;
 
-        bg_rep = calloc(1, sizeof(struct znr_gui_blockgroup_report_info));
-        if (!bg_rep) {
-                fprintf(stderr, "Out of memory for blockgroup report\n");
-                return;
-        }
+	znr_gui_map_pitch(&col_pitch, NULL);
+	znrg.nr_col = width / col_pitch;
+	if (!znrg.nr_col)
+		znrg.nr_col = 1;
 
-        znr_gui_close_extents_dialog();
-        bg_rep->starting_blockgroup = 0;
-        bg_rep->nr_blockgroups = znr.nr_blockgroups;
-        g_idle_add(znr_gui_deferred_report_blockgroups, bg_rep);
+	znr_gui_map_configure(map);
+	if (znrg.minimap)
+		gtk_widget_queue_draw(znrg.minimap);
 }
 
-static void
-znr_gui_show_blockgroup_cb(GtkWidget *button __attribute__((unused)),
-			   gpointer user_data __attribute__((unused)))
+/*
+ * Draw the rows of blockgroups in view.
+ */
+static void znr_blockgroup_map_snapshot(GtkWidget *widget,
+					GtkSnapshot *snapshot)
 {
-	const char *text;
-	char *endptr;
-	long bg_no;
+	znr_blockgroup_map *map = ZNR_BLOCKGROUP_MAP(widget);
+	int width = gtk_widget_get_width(widget);
+	int height = gtk_widget_get_height(widget);
+	unsigned long long first, last, cell;
+	gint64 start = g_get_monotonic_time();
+	int bw, bh, pw, ph;
+	GdkRGBA fg_color;
+	graphene_rect_t r;
+	double offset;
+	gint64 us;
 
-	text = gtk_editable_get_text(GTK_EDITABLE(znrg.show_blockgroup_entry));
-	if (!text || !strlen(text))
+	if (!znrg.blockgroups || !znr.nr_blockgroups)
 		return;
 
-	errno = 0;
-	bg_no = strtol(text, &endptr, 10);
-	if (errno == ERANGE || endptr == text || *endptr != '\0' ||
-	    bg_no < 0 || (unsigned long)bg_no >= znr.nr_blockgroups) {
-		znr_gui_err("Invalid blockgroup number",
-			    "Blockgroup: %s", text);
-		gtk_editable_set_text(GTK_EDITABLE(znrg.show_blockgroup_entry),
-				      "");
-		return;
+	znr_gui_blockgroup_size(&bw, &bh);
+	znr_gui_map_pitch(&pw, &ph);
+	offset = map->vadj ? gtk_adjustment_get_value(map->vadj) : 0;
+
+	first = (unsigned long long)(offset / ph) * znrg.nr_col;
+	last = (unsigned long long)((offset + height) / ph + 1) * znrg.nr_col;
+	if (last > znr_gui_nr_cells(znrg.lod))
+		last = znr_gui_nr_cells(znrg.lod);
+
+	/*
+	 * Drop the cached drawings of the blockgroups that left the view, and
+	 * all of them if the blockgroups size changed. Summary cells are
+	 * drawn without cache.
+	 */
+	if (znrg.lod) {
+		znr_gui_map_invalidate(0, UINT_MAX);
+		znrg.map_first = 0;
+		znrg.map_last = 0;
+	} else {
+		if (bw != znrg.node_width || bh != znrg.node_height) {
+			znr_gui_map_invalidate(0, UINT_MAX);
+			znrg.node_width = bw;
+			znrg.node_height = bh;
+		} else {
+			znr_gui_map_invalidate(0, first);
+			znr_gui_map_invalidate(last, UINT_MAX);
+		}
+		znrg.map_first = first;
+		znrg.map_last = last;
 	}
 
-	gtk_grid_view_scroll_to(GTK_GRID_VIEW(znrg.grid_view), bg_no,
-				GTK_LIST_SCROLL_FOCUS, NULL);
-	gtk_editable_set_text(GTK_EDITABLE(znrg.show_blockgroup_entry), "");
+	/* Hover highlight with the theme foreground color */
+	gtk_widget_get_color(widget, &fg_color);
 
-	/* When the grid updates, this blockgroup will be selected */
-	znrg.show_blockgroup = bg_no;
-	znr_gui_update();
+	/*
+	 * Blockgroups drawings that did not change are appended as is, so that
+	 * the renderer only repaints the blockgroups that changed.
+	 */
+	gtk_snapshot_push_clip(snapshot,
+			       &GRAPHENE_RECT_INIT(0, 0, width, height));
+	for (cell = first; cell < last; cell++) {
+		graphene_rect_init(&r, (cell % znrg.nr_col) * pw +
+				   ZNR_GUI_BLOCKGROUP_MARGIN,
+				   (cell / znrg.nr_col) * ph +
+				   ZNR_GUI_BLOCKGROUP_MARGIN - offset,
+				   bw, bh);
+		if (znrg.lod) {
+			znr_gui_summary_draw(map, cell, snapshot, &r);
+		} else {
+			gtk_snapshot_save(snapshot);
+			gtk_snapshot_translate(snapshot, &r.origin);
+			gtk_snapshot_append_node(snapshot,
+				znr_gui_blockgroup_node(map,
+						&znrg.blockgroups[cell]));
+			gtk_snapshot_restore(snapshot);
+		}
+		znr_gui_map_draw_highlight(cell, snapshot, &r, &fg_color);
+	}
+	gtk_snapshot_pop(snapshot);
+
+	us = g_get_monotonic_time() - start;
+	znrg.map_frames++;
+	znrg.map_bgs += last - first;
+	znrg.map_us += us;
+	if ((unsigned long long)us > znrg.map_max_us)
+		znrg.map_max_us = us;
 }
 
-static void znr_gui_clear_file_search_entry(void)
+static void znr_blockgroup_map_init(znr_blockgroup_map *map)
 {
-	gtk_editable_set_text(GTK_EDITABLE(znrg.search_entry), "");
-	znr_gui_update();
+	GtkEventController *ctrl;
+	PangoFontDescription *font;
+	GtkGesture *gesture;
+
+	/* Blockgroup and extent numbers font */
+	map->layout = gtk_widget_create_pango_layout(GTK_WIDGET(map), NULL);
+	font = pango_font_description_from_string("Monospace Bold");
+	pango_font_description_set_absolute_size(font, 10 * PANGO_SCALE);
+	pango_layout_set_font_description(map->layout, font);
+	pango_font_description_free(font);
+
+	/* Setup event handlers */
+	ctrl = gtk_event_controller_motion_new();
+	gtk_widget_add_controller(GTK_WIDGET(map), ctrl);
+	g_signal_connect(ctrl, "enter",
+			 G_CALLBACK(znr_gui_map_motion_cb), map);
+	g_signal_connect(ctrl, "motion",
+			 G_CALLBACK(znr_gui_map_motion_cb), map);
+	g_signal_connect(ctrl, "leave",
+			 G_CALLBACK(znr_gui_map_leave_cb), map);
+
+	gesture = gtk_gesture_click_new();
+	gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(gesture),
+				      GDK_BUTTON_PRIMARY);
+	gtk_widget_add_controller(GTK_WIDGET(map),
+				  GTK_EVENT_CONTROLLER(gesture));
+	g_signal_connect(gesture, "pressed",
+			 G_CALLBACK(znr_gui_map_click_cb), map);
 }
 
-static void znr_gui_search_file_cb(GtkWidget *button, gpointer user_data)
+/*
+ * Note: znr_blockgroup_mapClass is generated by the macro above, hence
+ * we can't avoid the camelcase.
+ */
+static void znr_blockgroup_map_class_init(znr_blockgroup_mapClass *class)
 {
-        struct znr_gui_blockgroup_report_info *bg_rep;
-	struct znr_gui_extents_tab *tab;
-	struct znr_fs_file *f = NULL;
-	GtkTextBuffer *text_buffer;
-	struct znr_extent *extents;
-	unsigned int nr_extents;
-	GtkTextIter iter;
-	char *extents_info;
-	char tab_label[256];
-	const char *text;
-	int ret;
-
-	text = gtk_editable_get_text(GTK_EDITABLE(znrg.search_entry));
-	if (!text || !strlen(text))
-		return;
+	GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(class);
+	GObjectClass *object_class = G_OBJECT_CLASS(class);
+
+	object_class->set_property = znr_blockgroup_map_set_property;
+	object_class->get_property = znr_blockgroup_map_get_property;
+	object_class->dispose = znr_blockgroup_map_dispose;
+
+	widget_class->measure = znr_blockgroup_map_measure;
+	widget_class->size_allocate = znr_blockgroup_map_size_allocate;
+	widget_class->snapshot = znr_blockgroup_map_snapshot;
+
+	g_object_class_override_property(object_class,
+			ZNR_MAP_PROP_HADJUSTMENT, "hadjustment");
+	g_object_class_override_property(object_class,
+			ZNR_MAP_PROP_VADJUSTMENT, "vadjustment");
+	g_object_class_override_property(object_class,
+			ZNR_MAP_PROP_HSCROLL_POLICY, "hscroll-policy");
+	g_object_class_override_property(object_class,
+			ZNR_MAP_PROP_VSCROLL_POLICY, "vscroll-policy");
+
+	gtk_widget_class_set_css_name(widget_class, "blockgroupmap");
+}
 
-	/* Get extents for the file by bath */
-        ret = znr_fs_get_file_extents_by_path(text, &f, &extents, &nr_extents);
-        if (ret) {
-                znr_gui_err("Failed to get file extents",
-			    "File: %s/%s\nError: %s",
-                            znr.mnt_dir.path, text,
-                            strerror(errno));
-                znr_gui_clear_file_search_entry();
-                return;
-        }
+/*
+ * Minimap widget: an overview of all blockgroups drawn with a single texture,
+ * scaled to the widget size, with the blockgroups in view in the map
+ * outlined. Clicking the minimap centers the map on the blockgroup clicked.
+ */
+#define ZNR_TYPE_MINIMAP		znr_minimap_get_type()
+G_DECLARE_FINAL_TYPE(znr_minimap, znr_minimap, ZNR, MINIMAP, GtkWidget)
 
-	/* Build extent information string */
-	extents_info = znr_gui_extent_info(extents, nr_extents, f);
-	if (!extents_info) {
-		znr_gui_err("Failed to get extent information\n", NULL);
-		return;
-	}
+struct _znr_minimap {
+	GtkWidget		parent;
+};
 
-        bg_rep = calloc(1, sizeof(struct znr_gui_blockgroup_report_info));
-        if (!bg_rep) {
-                fprintf(stderr, "Out of memory for blockgroup report\n");
-                return;
-        }
+G_DEFINE_TYPE(znr_minimap, znr_minimap, GTK_TYPE_WIDGET)
 
-        bg_rep->starting_blockgroup = 0;
-        bg_rep->nr_blockgroups = znr.nr_blockgroups;
-        g_idle_add(znr_gui_deferred_report_blockgroups, bg_rep);
+static void znr_gui_minimap_color(guint8 *px, const GdkRGBA *color)
+{
+	px[0] = color->red * 255;
+	px[1] = color->green * 255;
+	px[2] = color->blue * 255;
+	px[3] = color->alpha * 255;
+}
 
-	/* Set the extents information text. */
-	text_buffer = gtk_text_buffer_new(NULL);
-	gtk_text_buffer_get_start_iter(text_buffer, &iter);
-	gtk_text_buffer_insert_markup(text_buffer, &iter, extents_info,
-				      strlen(extents_info));
-	free(extents_info);
+/*
+ * Set the pixel of a blockgroup: the conventional color, or the sequential
+ * color blended with the written color according to the blockgroup fill.
+ */
+static void znr_gui_minimap_update(unsigned int bg_no)
+{
+	struct znr_bg *bg = &znr.blockgroups[bg_no];
+	const guint8 *seq = znrg.minimap_seq;
+	const guint8 *seqw = znrg.minimap_seqw;
+	unsigned int i, fill = 0;
+	guint8 *px;
 
-	/* Open the tab */
-	snprintf(tab_label, sizeof(tab_label), "File %s", f->path);
-	tab = znr_gui_add_extents_dialog_tab(tab_label, text_buffer);
-	if (!tab)
+	if (!znrg.minimap_pixels)
 		return;
 
-	tab->file = f;
-	tab->extents = extents;
-	tab->nr_extents = nr_extents;
+	px = &znrg.minimap_pixels[bg_no * 4];
+	if (bg->flags == BLK_ZONE_TYPE_CONVENTIONAL) {
+		memcpy(px, znrg.minimap_conv, 4);
+	} else {
+		if (bg->nr_zones && bg->nr_sectors) {
+			fill = bg->wp_sector * 256 / bg->nr_sectors;
+			if (fill > 256)
+				fill = 256;
+		}
+		for (i = 0; i < 4; i++)
+			px[i] = (seq[i] * (256 - fill) + seqw[i] * fill) >> 8;
+	}
 
+	g_clear_object(&znrg.minimap_texture);
 }
 
-/* This should only be called when it is required to grow the drawing area */
-static void znr_gui_grid_setup_cb(GtkListItemFactory *factory,
-				  GtkListItem *list_item, gpointer user_data)
+static void znr_gui_minimap_update_all(void)
 {
-	GtkWidget *da = gtk_drawing_area_new();
-	int zw, zh;
-
-	znr_gui_blockgroup_da_size(&zw, &zh);
-	gtk_widget_set_size_request(da, zw, zh);
+	unsigned int i;
 
-	gtk_widget_set_halign(da, GTK_ALIGN_FILL);
-	gtk_widget_set_valign(da, GTK_ALIGN_FILL);
-	gtk_widget_set_vexpand(da, TRUE);
-	gtk_widget_set_hexpand(da, TRUE);
+	for (i = 0; i < znr.nr_blockgroups; i++)
+		znr_gui_minimap_update(i);
 
-	gtk_list_item_set_child(list_item, da);
+	if (znrg.minimap)
+		gtk_widget_queue_draw(znrg.minimap);
 }
 
-static void znr_gui_grid_bind_cb(GtkListItemFactory *factory,
-				 GtkListItem *list_item, gpointer user_data)
+static void znr_gui_minimap_click_cb(GtkGestureClick *self, gint n_press,
+				     gdouble x, gdouble y, gpointer user_data)
 {
-	struct znr_gui_blockgroup *blockgroup = NULL;
-	znr_blockgroup_item *bg_item;
-	GtkWidget *da;
-	GtkEventController *ctrl;
-	GtkGesture *gesture;
+	GtkWidget *widget = user_data;
+	int width = gtk_widget_get_width(widget);
+	int height = gtk_widget_get_height(widget);
+	unsigned int row, col, bg_no;
 
-	bg_item = ZNR_BLOCKGROUP_ITEM(gtk_list_item_get_item(list_item));
-	da = gtk_list_item_get_child(list_item);
-
-	blockgroup = g_object_get_data(G_OBJECT(da), "blockgroup_data");
-	if (!blockgroup) {
-		/* First time binding */
-		blockgroup = g_new0(struct znr_gui_blockgroup, 1);
-		blockgroup->da = da;
-		g_object_set_data_full(G_OBJECT(da), "blockgroup_data",
-				       blockgroup, g_free);
-
-		/* Setup event handlers */
-		ctrl = gtk_event_controller_motion_new();
-		gtk_widget_add_controller(da,
-					  GTK_EVENT_CONTROLLER(ctrl));
-
-		g_signal_connect(ctrl, "enter",
-				 G_CALLBACK(znr_gui_blockgroup_enter_cb),
-				 blockgroup);
-		g_signal_connect(ctrl, "leave",
-				 G_CALLBACK(znr_gui_blockgroup_leave_cb),
-				 blockgroup);
-
-		gesture = gtk_gesture_click_new();
-		gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(gesture),
-					      GDK_BUTTON_PRIMARY);
-		gtk_widget_add_controller(da, GTK_EVENT_CONTROLLER(gesture));
-		g_signal_connect(gesture, "pressed",
-				 G_CALLBACK(znr_gui_blockgroup_click_cb),
-				 blockgroup);
-	}
-
-	/* Update blockgroup data for current item */
-	blockgroup->bg_no = bg_item->bg_no;
-	blockgroup->bg = bg_item->bg;
-	blockgroup->hovered = false;
-
-	/* Track drawing area for updates */
-	if (znrg.drawing_areas) {
-		g_hash_table_insert(znrg.drawing_areas, da, da);
-		znrg.visible_blockgroups_no++;
-	}
-	gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(da),
-				       znr_gui_blockgroup_draw_cb,
-				       blockgroup,
-				       NULL);
+	if (!znrg.minimap_pixels || width <= 0 || height <= 0)
+		return;
+
+	row = y * znrg.minimap_rows / height;
+	col = x * znrg.minimap_cols / width;
+	if (row >= znrg.minimap_rows)
+		row = znrg.minimap_rows - 1;
+	if (col >= znrg.minimap_cols)
+		col = znrg.minimap_cols - 1;
+
+	bg_no = row * znrg.minimap_cols + col;
+	if (bg_no >= znr.nr_blockgroups)
+		bg_no = znr.nr_blockgroups - 1;
+
+	znr_gui_map_center_on(bg_no);
 }
 
-static void znr_gui_grid_unbind_cb(GtkListItemFactory *factory,
-				      GtkListItem *list_item,
-				      gpointer user_data)
+static void znr_minimap_snapshot(GtkWidget *widget, GtkSnapshot *snapshot)
 {
-	GtkWidget *da = gtk_list_item_get_child(list_item);
+	int width = gtk_widget_get_width(widget);
+	int height = gtk_widget_get_height(widget);
+	unsigned int first, nr, cols = znrg.minimap_cols;
+	GdkRGBA fg_color;
+	GBytes *bytes;
+	float row_h;
 
-	if (!da)
+	if (!znrg.minimap_pixels)
 		return;
 
-	/* Remove from tracking hash table */
-	if (znrg.drawing_areas) {
-		g_hash_table_remove(znrg.drawing_areas, da);
-		if (znrg.visible_blockgroups_no > 0)
-			znrg.visible_blockgroups_no--;
+	/* Upload the pixels again only if they changed */
+	if (!znrg.minimap_texture) {
+		bytes = g_bytes_new(znrg.minimap_pixels,
+				    (gsize)cols * znrg.minimap_rows * 4);
+		znrg.minimap_texture =
+			gdk_memory_texture_new(cols, znrg.minimap_rows,
+					       GDK_MEMORY_R8G8B8A8, bytes,
+					       cols * 4);
+		g_bytes_unref(bytes);
 	}
 
-	gtk_drawing_area_set_draw_func(GTK_DRAWING_AREA(da), NULL, NULL, NULL);
-}
+	gtk_snapshot_append_scaled_texture(snapshot, znrg.minimap_texture,
+			GSK_SCALING_FILTER_TRILINEAR,
+			&GRAPHENE_RECT_INIT(0, 0, width, height));
 
-static GtkWidget *znr_gui_create_grid(void)
-{
-	GtkListItemFactory *factory;
-	znr_blockgroup_item *bg_item;
-	GtkSelectionModel *selection;
-	GtkWidget *grid_view;
-	unsigned int i;
+	/* Outline the rows of blockgroups in view */
+	if (znr_gui_get_first_blockgroup_in_view(&first))
+		return;
+	nr = znr_gui_get_nr_blockgroups_in_view();
+	row_h = (float)height / znrg.minimap_rows;
 
-	/* Initialize hash table for tracking drawing areas */
-	if (znrg.drawing_areas) {
-		g_hash_table_destroy(znrg.drawing_areas);
-		znrg.visible_blockgroups_no = 0;
-	}
-	znrg.drawing_areas = g_hash_table_new(g_direct_hash, g_direct_equal);
+	gtk_widget_get_color(widget, &fg_color);
+	znr_gui_map_draw_outline(snapshot,
+		&GRAPHENE_RECT_INIT(0, first / cols * row_h, width,
+				    MAX((nr + cols - 1) / cols * row_h, 4)),
+		&fg_color, 2);
+}
 
-	/* Create a blockgroup g_list */
-	znrg.blockgroup_list = g_list_store_new(ZNR_TYPE_BLOCKGROUP_ITEM);
-	for (i = 0; i < znr.nr_blockgroups; ++i) {
-		bg_item = znr_blockgroup_item_new(i, &znr.blockgroups[i]);
-		g_list_store_append(znrg.blockgroup_list, bg_item);
-		g_object_unref(bg_item);
-	}
+static void znr_minimap_measure(GtkWidget *widget,
+				GtkOrientation orientation, int for_size,
+				int *minimum, int *natural,
+				int *minimum_baseline, int *natural_baseline)
+{
+	if (orientation == GTK_ORIENTATION_HORIZONTAL)
+		*minimum = *natural = ZNR_GUI_MINIMAP_WIDTH;
+	else
+		*minimum = *natural = 0;
+}
 
-	/* Use no_selection otherwise we see blockgroup 0 selected on start */
-	selection = GTK_SELECTION_MODEL(gtk_no_selection_new(G_LIST_MODEL(znrg.blockgroup_list)));
+static void znr_minimap_init(znr_minimap *minimap)
+{
+	GtkGesture *gesture;
 
-	/* Setup widget behavior */
-	factory = gtk_signal_list_item_factory_new();
-	g_signal_connect(factory, "setup",
-			 G_CALLBACK(znr_gui_grid_setup_cb), NULL);
-	g_signal_connect(factory, "bind",
-			 G_CALLBACK(znr_gui_grid_bind_cb), NULL);
-	g_signal_connect(factory, "unbind",
-			 G_CALLBACK(znr_gui_grid_unbind_cb), NULL);
+	gesture = gtk_gesture_click_new();
+	gtk_gesture_single_set_button(GTK_GESTURE_SINGLE(gesture),
+				      GDK_BUTTON_PRIMARY);
+	gtk_widget_add_controller(GTK_WIDGET(minimap),
+				  GTK_EVENT_CONTROLLER(gesture));
+	g_signal_connect(gesture, "pressed",
+			 G_CALLBACK(znr_gui_minimap_click_cb), minimap);
+}
 
-	/* Create grid view */
-	grid_view = gtk_grid_view_new(selection, factory);
-	gtk_grid_view_set_max_columns(GTK_GRID_VIEW(grid_view), znrg.nr_col);
-	gtk_grid_view_set_min_columns(GTK_GRID_VIEW(grid_view), znrg.nr_col);
+/*
+ * Note: znr_minimapClass is generated by the macro above, hence
+ * we can't avoid the camelcase.
+ */
+static void znr_minimap_class_init(znr_minimapClass *class)
+{
+	GtkWidgetClass *widget_class = GTK_WIDGET_CLASS(class);
 
-	/* Make grid fit window */
-	gtk_widget_set_halign(grid_view, GTK_ALIGN_FILL);
-	gtk_widget_set_valign(grid_view, GTK_ALIGN_FILL);
-	gtk_widget_set_hexpand(grid_view, TRUE);
-	gtk_widget_set_vexpand(grid_view, TRUE);
+	widget_class->measure = znr_minimap_measure;
+	widget_class->snapshot = znr_minimap_snapshot;
 
-	return grid_view;
+	gtk_widget_class_set_css_name(widget_class, "minimap");
 }
 
 /*
- * Called when the user resizes the window, adjusts the number of columns
- * accordingly
+ * Create the minimap. The blockgroup colors must be set.
  */
-static void window_size_changed_cb(GtkWidget *widget)
+static GtkWidget *znr_gui_create_minimap(void)
 {
-	unsigned int w = gtk_widget_get_width(widget);
-	int blockgroup_da_w = 0;
-	unsigned int max_cols;
+	GtkWidget *minimap;
+	unsigned int cols;
 
-	znr_gui_blockgroup_da_size(&blockgroup_da_w, NULL);
-	if (!blockgroup_da_w || !w)
-		return;
-	/*
-	 * Max cols we can fit into the current window without horizontal
-	 * scrolling
-	 */
-	max_cols = w / blockgroup_da_w;
-	max_cols = max_cols > 1 ? max_cols - 1 : max_cols;
+	if (!znr.nr_blockgroups)
+		return NULL;
 
-	if (max_cols != znrg.nr_col) {
-		znrg.nr_col = max_cols;
-		gtk_grid_view_set_max_columns(GTK_GRID_VIEW(znrg.grid_view),
-					      znrg.nr_col);
-		gtk_grid_view_set_min_columns(GTK_GRID_VIEW(znrg.grid_view),
-					      znrg.nr_col);
-	}
+	/* Square pixels in a strip about 4 times taller than wide */
+	cols = sqrt(znr.nr_blockgroups / 4);
+	if (cols > ZNR_GUI_MINIMAP_MAX_COLS)
+		cols = ZNR_GUI_MINIMAP_MAX_COLS;
+	if (!cols)
+		cols = 1;
+
+	znrg.minimap_cols = cols;
+	znrg.minimap_rows = (znr.nr_blockgroups + cols - 1) / cols;
+	znrg.minimap_pixels = calloc((size_t)cols * znrg.minimap_rows, 4);
+	if (!znrg.minimap_pixels)
+		return NULL;
+
+	znr_gui_minimap_color(znrg.minimap_conv, &znrg.color_conv);
+	znr_gui_minimap_color(znrg.minimap_seq, &znrg.color_seq);
+	znr_gui_minimap_color(znrg.minimap_seqw, &znrg.color_seqw);
+	znr_gui_minimap_update_all();
+
+	minimap = g_object_new(ZNR_TYPE_MINIMAP, NULL);
+	gtk_widget_set_vexpand(minimap, TRUE);
+	gtk_widget_set_margin_top(minimap, 10);
+	gtk_widget_set_margin_bottom(minimap, 10);
+	gtk_widget_set_margin_end(minimap, 10);
+	gtk_widget_set_tooltip_text(minimap, "Blockgroups overview");
+
+	return minimap;
+}
+
+static GtkWidget *znr_gui_create_map(void)
+{
+	GtkWidget *map;
+	unsigned int i;
+
+	znrg.blockgroups = calloc(znr.nr_blockgroups ? znr.nr_blockgroups : 1,
+				  sizeof(struct znr_gui_blockgroup));
+	if (!znrg.blockgroups)
+		return NULL;
+
+	for (i = 0; i < znr.nr_blockgroups; i++)
+		znrg.blockgroups[i].bg_no = i;
+
+	if (znr_gui_summary_alloc())
+		return NULL;
+
+	map = g_object_new(ZNR_TYPE_BLOCKGROUP_MAP, NULL);
+
+	/* Make map fit window */
+	gtk_widget_set_halign(map, GTK_ALIGN_FILL);
+	gtk_widget_set_valign(map, GTK_ALIGN_FILL);
+	gtk_widget_set_hexpand(map, TRUE);
+	gtk_widget_set_vexpand(map, TRUE);
+
+	return map;
 }
 
 static void znr_gui_create_app(GtkApplication *app, gpointer user_data)
@@ -1479,8 +4214,9 @@ static void znr_gui_create_app(GtkApplication *app, gpointer user_data)
 	GtkWidget *top_vbox, *vbox, *frame, *hbox, *scroll_window, *bottom_row;
 	GtkWidget *label, *da, *entry, *search_button;
 	GtkWidget *zoom_label, *zoom_out_button, *zoom_in_button;
-	GtkWidget *refresh_button, *refresh_toggle;
+	GtkWidget *refresh_button, *refresh_toggle, *adaptive_check;
 	GtkCssProvider *css_provider;
+	GtkAdjustment *vadj;
 	char str[512];
 	int n;
 
@@ -1506,9 +4242,6 @@ static void znr_gui_create_app(GtkApplication *app, gpointer user_data)
 	znrg.window = gtk_application_window_new(app);
 	gtk_window_set_title(GTK_WINDOW(znrg.window), "Zonar");
 
-	g_signal_connect(znrg.window, "notify::default-width",
-			 G_CALLBACK(window_size_changed_cb), NULL);
-
 	/* Top vbox */
 	top_vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 10);
 	gtk_window_set_child(GTK_WINDOW(znrg.window), top_vbox);
@@ -1592,10 +4325,24 @@ static void znr_gui_create_app(GtkApplication *app, gpointer user_data)
 
 	znrg.scroll_window = scroll_window;
 
-	/* Create scrollable grid view */
-	znrg.grid_view = znr_gui_create_grid();
+	vadj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(scroll_window));
+	g_signal_connect(vadj, "value-changed",
+			 G_CALLBACK(znr_gui_view_changed_cb), NULL);
+
+	/* Create scrollable blockgroup map */
+	znrg.map = znr_gui_create_map();
+	if (!znrg.map) {
+		fprintf(stderr, "Failed to create blockgroup map\n");
+		g_application_quit(G_APPLICATION(app));
+		return;
+	}
 	gtk_scrolled_window_set_child(GTK_SCROLLED_WINDOW(scroll_window),
-				      znrg.grid_view);
+				      znrg.map);
+
+	/* Blockgroups overview beside the map */
+	znrg.minimap = znr_gui_create_minimap();
+	if (znrg.minimap)
+		gtk_box_append(GTK_BOX(hbox), znrg.minimap);
 
 
 	/* hbox for zoom and refresh button */
@@ -1635,6 +4382,11 @@ static void znr_gui_create_app(GtkApplication *app, gpointer user_data)
 	g_signal_connect(refresh_button, "clicked",
 			 G_CALLBACK(znr_gui_refresh_cb), NULL);
 
+	/* In-flight requests indicator */
+	znrg.io_spinner = gtk_spinner_new();
+	gtk_box_append(GTK_BOX(hbox), znrg.io_spinner);
+	znr_gui_io_update_spinner();
+
 	/* Blockgroup navigation label */
 	snprintf(str, sizeof(str) - 1, "<b>Jump to blockgroup</b>");
 	label = gtk_label_new(NULL);
@@ -1669,6 +4421,15 @@ static void znr_gui_create_app(GtkApplication *app, gpointer user_data)
 	gtk_box_append(GTK_BOX(hbox), entry);
 	znrg.refresh_ms_entry = entry;
 
+	/* Adaptive auto-refresh longest period text entry */
+	entry = gtk_entry_new();
+	gtk_entry_set_placeholder_text(GTK_ENTRY(entry), "Max period (ms)");
+	gtk_widget_set_tooltip_text(entry,
+		"Longest adaptive auto refresh period (ms, default 10000)");
+	gtk_widget_set_hexpand(entry, FALSE);
+	gtk_box_append(GTK_BOX(hbox), entry);
+	znrg.refresh_max_ms_entry = entry;
+
 	/* Auto-refresh toggle */
 	refresh_toggle = gtk_toggle_button_new_with_label("Auto refresh");
 	gtk_widget_set_tooltip_text(refresh_toggle,
@@ -1678,6 +4439,15 @@ static void znr_gui_create_app(GtkApplication *app, gpointer user_data)
 	g_signal_connect(refresh_toggle, "toggled",
 			 G_CALLBACK(znr_gui_refresh_ms_check_cb), NULL);
 
+	/* Adaptive auto-refresh toggle */
+	adaptive_check = gtk_check_button_new_with_label("Adaptive");
+	gtk_widget_set_tooltip_text(adaptive_check,
+		"Refresh at the period entered while write pointers move, "
+		"backing off up to the maximum period otherwise");
+	gtk_box_append(GTK_BOX(hbox), adaptive_check);
+	g_signal_connect(adaptive_check, "toggled",
+			 G_CALLBACK(znr_gui_refresh_adaptive_cb), NULL);
+
 	/* Bottom Row */
 	bottom_row = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
 	gtk_box_append(GTK_BOX(top_vbox), bottom_row);
@@ -1733,7 +4503,7 @@ static void znr_gui_create_app(GtkApplication *app, gpointer user_data)
 	/* Text entry */
 	entry = gtk_entry_new();
 	gtk_entry_set_placeholder_text(GTK_ENTRY(entry),
-			"Enter file path (relative to mount point)...");
+			"Enter file paths (relative to mount point, comma separated)...");
 	gtk_widget_set_hexpand(entry, TRUE);
 	gtk_widget_set_margin_end(entry, 10);
 	gtk_box_append(GTK_BOX(hbox), entry);
@@ -1754,13 +4524,33 @@ static void znr_gui_create_app(GtkApplication *app, gpointer user_data)
 
 static void znr_gui_destroy(void)
 {
+	znrg.refresh_ms = 0;
+	g_clear_handle_id(&znrg.refresh_source, g_source_remove);
 	znr_gui_close_extents_dialog();
-
-	/* Cleanup drawing areas hash table */
-	if (znrg.drawing_areas) {
-		g_hash_table_destroy(znrg.drawing_areas);
-		znrg.drawing_areas = NULL;
-	}
+	znrg.io_spinner = NULL;
+	znr_gui_io_stop();
+
+	if (znr.verbose && znrg.map_frames)
+		printf("Blockgroup map: %llu frames, %llu blockgroups/frame, "
+		       "%llu redrawn/frame, snapshot %llu us/frame "
+		       "(max %llu us)\n",
+		       znrg.map_frames, znrg.map_bgs / znrg.map_frames,
+		       znrg.map_nodes / znrg.map_frames,
+		       znrg.map_us / znrg.map_frames, znrg.map_max_us);
+	if (znr.verbose && znrg.map_reports)
+		printf("Blockgroup refresh: %llu reports, "
+		       "%llu blockgroups changed/report\n",
+		       znrg.map_reports, znrg.map_changed / znrg.map_reports);
+
+	znr_gui_map_invalidate(0, UINT_MAX);
+	znrg.map = NULL;
+	free(znrg.blockgroups);
+	znr_gui_summary_free();
+	znrg.minimap = NULL;
+	g_clear_object(&znrg.minimap_texture);
+	free(znrg.minimap_pixels);
+	znrg.minimap_pixels = NULL;
+	znrg.blockgroups = NULL;
 
 	/* Cleanup signal handling resources */
 	if (znrg.gio_channel) {
@@ -1866,6 +4656,15 @@ int znr_gui_run(void)
 
 	znrg.zoom_level = ZNR_GUI_MAX_ZOOM_OUT;
 	znrg.show_blockgroup = UINT_MAX;
+	znrg.hovered = UINT_MAX;
+
+	/* Start the I/O worker */
+	ret = znr_gui_io_start();
+	if (ret) {
+		fprintf(stderr, "Failed to start I/O worker\n");
+		znr_gui_io_stop();
+		return ret;
+	}
 
 	/* Create the main window */
 	adw_init();
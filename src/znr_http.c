@@ -0,0 +1,809 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "znr.h"
+
+static struct znr_http {
+	int			sd;
+	bool			stop;
+	bool			thread_started;
+	pthread_t		thread;
+
+	/* Connections being served and event streams among them */
+	unsigned int		nr_conns;
+	unsigned int		nr_streams;
+
+	/*
+	 * Blockgroups state (fill level and zone condition of each
+	 * blockgroup), updated while event streams are open.
+	 */
+	unsigned int		nr_blockgroups;
+	__u8			*state;
+	unsigned long long	gen;
+	unsigned long long	interval_ns;
+	struct blk_zone		*zones;
+	bool			update_started;
+	pthread_t		update_thread;
+
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+} znrh = {
+	.sd = -1,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+#define ZNR_HTTP_STATE_SIZE	2
+
+/*
+ * Web viewer page. It draws the blockgroups with the colors of the GUI and
+ * applies the delta events as they are received.
+ */
+static const char znr_http_page[] =
+	"<!DOCTYPE html>\n"
+	"<html><head><meta charset=\"utf-8\"><title>Zonar</title>\n"
+	"<style>\n"
+	"body { margin: 8px; background: #8a8484; font-family: sans-serif; }\n"
+	"#status { color: white; margin-bottom: 8px; }\n"
+	"canvas { display: block; }\n"
+	"</style></head><body>\n"
+	"<div id=\"status\">Connecting...</div>\n"
+	"<canvas id=\"map\"></canvas>\n"
+	"<script>\n"
+	"var S = 24, n = 0, gen = 0, st = null;\n"
+	"var cv = document.getElementById('map'), cx = cv.getContext('2d');\n"
+	"var conds = { 0: 'Conventional', 1: 'Empty', 2: 'Implicit open',\n"
+	"  3: 'Explicit open', 4: 'Closed', 13: 'Read-only', 14: 'Full',\n"
+	"  15: 'Offline' };\n"
+	"function cols() { return Math.max(1, Math.floor(cv.width / S)); }\n"
+	"function draw(i) {\n"
+	"  var x = (i % cols()) * S, y = Math.floor(i / cols()) * S;\n"
+	"  var f = st[2 * i], c = st[2 * i + 1];\n"
+	"  cx.fillStyle = c ? '#25bb00' : 'magenta';\n"
+	"  cx.fillRect(x, y, S - 1, S - 1);\n"
+	"  if (f) {\n"
+	"    cx.fillStyle = 'red';\n"
+	"    cx.fillRect(x, y, Math.max(1, Math.round((S - 1) * f / 255)),"
+	" S - 1);\n"
+	"  }\n"
+	"  cx.fillStyle = 'black';\n"
+	"  cx.fillText(i, x + S / 2, y + S / 2);\n"
+	"}\n"
+	"function layout() {\n"
+	"  var c = Math.max(1, Math.floor((window.innerWidth - 16) / S));\n"
+	"  cv.width = c * S;\n"
+	"  cv.height = Math.ceil(n / c) * S;\n"
+	"  cx.font = '8px monospace';\n"
+	"  cx.textAlign = 'center';\n"
+	"  cx.textBaseline = 'middle';\n"
+	"  for (var i = 0; i < n; i++)\n"
+	"    draw(i);\n"
+	"}\n"
+	"function status(s) {\n"
+	"  document.getElementById('status').textContent = s ? s :\n"
+	"    n + ' blockgroups, generation ' + gen + ', updated ' +\n"
+	"    new Date().toLocaleTimeString();\n"
+	"}\n"
+	"var es = new EventSource('/events');\n"
+	"es.addEventListener('init', function (e) {\n"
+	"  var d = JSON.parse(e.data);\n"
+	"  n = d.nr_blockgroups;\n"
+	"  gen = d.gen;\n"
+	"  st = new Uint8Array(2 * n);\n"
+	"  for (var i = 0; i < 2 * n; i++)\n"
+	"    st[i] = parseInt(d.state.substr(2 * i, 2), 16);\n"
+	"  layout();\n"
+	"  status();\n"
+	"});\n"
+	"es.addEventListener('delta', function (e) {\n"
+	"  var d = JSON.parse(e.data);\n"
+	"  gen = d.gen;\n"
+	"  d.bgs.forEach(function (b) {\n"
+	"    st[2 * b[0]] = b[1];\n"
+	"    st[2 * b[0] + 1] = b[2];\n"
+	"    draw(b[0]);\n"
+	"  });\n"
+	"  status();\n"
+	"});\n"
+	"es.onerror = function () { status('Disconnected, retrying...'); };\n"
+	"window.onresize = function () { if (st) layout(); };\n"
+	"cv.onmousemove = function (e) {\n"
+	"  var r = cv.getBoundingClientRect();\n"
+	"  var i = Math.floor((e.clientY - r.top) / S) * cols() +\n"
+	"    Math.floor((e.clientX - r.left) / S);\n"
+	"  if (!st || i >= n)\n"
+	"    return;\n"
+	"  cv.title = 'Blockgroup ' + i + ': ' +\n"
+	"    (conds[st[2 * i + 1]] || 'Unknown') + ', ' +\n"
+	"    Math.round(st[2 * i] * 100 / 255) + '% written';\n"
+	"};\n"
+	"</script></body></html>\n";
+
+/*
+ * Growable text buffer for replies.
+ */
+struct znr_http_buf {
+	char		*data;
+	size_t		len;
+	size_t		size;
+	int		err;
+};
+
+/*
+ * Grow @b so that @len more characters and a terminating null fit in it.
+ */
+static int znr_http_reserve(struct znr_http_buf *b, size_t len)
+{
+	size_t size;
+	char *data;
+
+	if (b->err)
+		return b->err;
+
+	if (b->len + len < b->size)
+		return 0;
+
+	size = b->size ? b->size : 4096;
+	while (size <= b->len + len)
+		size *= 2;
+	data = realloc(b->data, size);
+	if (!data) {
+		b->err = -ENOMEM;
+		return b->err;
+	}
+	b->data = data;
+	b->size = size;
+
+	return 0;
+}
+
+static void znr_http_printf(struct znr_http_buf *b, const char *fmt, ...)
+{
+	va_list ap;
+	int len;
+
+	if (b->err)
+		return;
+
+	va_start(ap, fmt);
+	len = vsnprintf(b->data + b->len, b->size - b->len, fmt, ap);
+	va_end(ap);
+
+	if (b->len + len < b->size) {
+		b->len += len;
+		return;
+	}
+
+	if (znr_http_reserve(b, len))
+		return;
+
+	va_start(ap, fmt);
+	vsnprintf(b->data + b->len, b->size - b->len, fmt, ap);
+	va_end(ap);
+	b->len += len;
+}
+
+static int znr_http_send(int sd, const void *buf, size_t size)
+{
+	const char *p = buf;
+	ssize_t ret;
+
+	while (size) {
+		ret = send(sd, p, size, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		p += ret;
+		size -= ret;
+	}
+
+	return 0;
+}
+
+static int znr_http_send_rep(int sd, const char *status, const char *type,
+			     const void *body, size_t size)
+{
+	char hdr[256];
+	int len, ret;
+
+	len = snprintf(hdr, sizeof(hdr),
+		       "HTTP/1.1 %s\r\n"
+		       "Content-Type: %s\r\n"
+		       "Content-Length: %zu\r\n"
+		       "Cache-Control: no-cache\r\n"
+		       "Connection: close\r\n\r\n",
+		       status, type, size);
+
+	ret = znr_http_send(sd, hdr, len);
+	if (ret || !size)
+		return ret;
+
+	return znr_http_send(sd, body, size);
+}
+
+static int znr_http_send_error(int sd, const char *status)
+{
+	return znr_http_send_rep(sd, status, "text/plain", status,
+				 strlen(status));
+}
+
+/*
+ * Get the state of a blockgroup from the zone information: its fill level,
+ * the written space over the capacity of all its sequential zones, and the
+ * condition of its first zone not full, or full if all are.
+ */
+static void znr_http_set_bg_state(__u8 *st, struct znr_bg *bg,
+				  struct blk_zone *zones)
+{
+	unsigned long long cap, used, bg_cap = 0, bg_used = 0;
+	struct blk_zone *blkz;
+	unsigned int i;
+
+	st[0] = 0;
+	st[1] = 0;
+
+	if (!znr.dev.is_zoned || !bg->nr_zones || !bg->nr_sectors)
+		return;
+
+	for (i = 0; i < bg->nr_zones; i++) {
+		/*
+		 * The blockgroup zone pointers reference the server zone
+		 * array: use the same zone index in the updated zones.
+		 */
+		blkz = &zones[bg->zones[i] - znr.blk_zones];
+		if (blkz->type != BLK_ZONE_TYPE_SEQWRITE_REQ)
+			continue;
+
+		cap = blkz->capacity ? blkz->capacity : blkz->len;
+		used = blkz->wp > blkz->start ? blkz->wp - blkz->start : 0;
+		if (blkz->cond == BLK_ZONE_COND_FULL || used > cap)
+			used = cap;
+		bg_cap += cap;
+		bg_used += used;
+
+		if (!st[1] || st[1] == BLK_ZONE_COND_FULL)
+			st[1] = blkz->cond;
+	}
+
+	if (bg_cap)
+		st[0] = bg_used * 255 / bg_cap;
+}
+
+static void znr_http_set_state(__u8 *state, struct blk_zone *zones)
+{
+	unsigned int i;
+
+	for (i = 0; i < znrh.nr_blockgroups; i++)
+		znr_http_set_bg_state(&state[i * ZNR_HTTP_STATE_SIZE],
+				      &znr.blockgroups[i], zones);
+}
+
+static void znr_http_update(__u8 *state)
+{
+	int ret;
+
+	if (!znr.dev.is_zoned || !znr.nr_zones)
+		return;
+
+	ret = znr_cache_report_zones(0, znr.nr_zones, znrh.zones);
+	if (ret < 0) {
+		znr_err("Web viewer zone report failed %d (%s)\n",
+			-ret, strerror(-ret));
+		return;
+	}
+
+	znr_http_set_state(state, znrh.zones);
+
+	pthread_mutex_lock(&znrh.lock);
+	if (memcmp(znrh.state, state,
+		   znrh.nr_blockgroups * ZNR_HTTP_STATE_SIZE)) {
+		memcpy(znrh.state, state,
+		       znrh.nr_blockgroups * ZNR_HTTP_STATE_SIZE);
+		znrh.gen++;
+		pthread_cond_broadcast(&znrh.cond);
+	}
+	pthread_mutex_unlock(&znrh.lock);
+}
+
+static void znr_http_deadline(struct timespec *ts, unsigned long long ns)
+{
+	clock_gettime(CLOCK_REALTIME, ts);
+	ts->tv_sec += ns / 1000000000ULL;
+	ts->tv_nsec += ns % 1000000000ULL;
+	if (ts->tv_nsec >= 1000000000L) {
+		ts->tv_sec++;
+		ts->tv_nsec -= 1000000000L;
+	}
+}
+
+static void *znr_http_update_thread(void *arg)
+{
+	__u8 *state = arg;
+	struct timespec ts;
+	sigset_t set;
+
+	/* Let the main thread handle signals. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	/* Updates are refreshes: let interactive requests go first */
+	znr_sched_begin(ZNR_SCHED_REFRESH, NULL, NULL);
+
+	/* Leave half of the ioctl budget to client requests */
+	znr_budget_set_poller();
+
+	pthread_mutex_lock(&znrh.lock);
+
+	while (!znrh.stop) {
+		/* Do not report zones if no event stream is open. */
+		if (!znrh.nr_streams) {
+			pthread_cond_wait(&znrh.cond, &znrh.lock);
+			continue;
+		}
+
+		pthread_mutex_unlock(&znrh.lock);
+		znr_http_update(state);
+		pthread_mutex_lock(&znrh.lock);
+
+		if (znrh.stop)
+			break;
+
+		znr_http_deadline(&ts, znrh.interval_ns);
+		pthread_cond_timedwait(&znrh.cond, &znrh.lock, &ts);
+	}
+
+	pthread_mutex_unlock(&znrh.lock);
+
+	znr_sched_end();
+	free(state);
+
+	return NULL;
+}
+
+/*
+ * Add the state of all blockgroups to @b as a JSON object.
+ */
+static void znr_http_print_state(struct znr_http_buf *b, __u8 *state,
+				 unsigned long long gen)
+{
+	static const char hex[] = "0123456789abcdef";
+	size_t i, size = znrh.nr_blockgroups * ZNR_HTTP_STATE_SIZE;
+	char *p;
+
+	znr_http_printf(b, "{\"nr_blockgroups\":%u,\"gen\":%llu,\"state\":\"",
+			znrh.nr_blockgroups, gen);
+
+	/* Hex encode the state directly into the buffer */
+	if (znr_http_reserve(b, size * 2))
+		return;
+	p = b->data + b->len;
+	for (i = 0; i < size; i++) {
+		*p++ = hex[state[i] >> 4];
+		*p++ = hex[state[i] & 0x0f];
+	}
+	*p = '\0';
+	b->len += size * 2;
+
+	znr_http_printf(b, "\"}");
+}
+
+static int znr_http_serve_state(int sd)
+{
+	struct znr_http_buf b = { };
+	unsigned long long gen;
+	__u8 *state;
+	int ret;
+
+	state = malloc(znrh.nr_blockgroups * ZNR_HTTP_STATE_SIZE + 1);
+	if (!state)
+		return znr_http_send_error(sd, "503 Service Unavailable");
+
+	pthread_mutex_lock(&znrh.lock);
+	memcpy(state, znrh.state, znrh.nr_blockgroups * ZNR_HTTP_STATE_SIZE);
+	gen = znrh.gen;
+	pthread_mutex_unlock(&znrh.lock);
+
+	znr_http_print_state(&b, state, gen);
+	znr_http_printf(&b, "\n");
+	if (b.err)
+		ret = znr_http_send_error(sd, "503 Service Unavailable");
+	else
+		ret = znr_http_send_rep(sd, "200 OK", "application/json",
+					b.data, b.len);
+
+	free(b.data);
+	free(state);
+
+	return ret;
+}
+
+/*
+ * Add a delta event with the blockgroups of @state which changed from @sent
+ * to @b, updating @sent.
+ */
+static void znr_http_print_delta(struct znr_http_buf *b, __u8 *state,
+				 __u8 *sent, unsigned long long gen)
+{
+	unsigned int i, nr = 0;
+	__u8 *st;
+
+	znr_http_printf(b, "event: delta\ndata: {\"gen\":%llu,\"bgs\":[", gen);
+	for (i = 0; i < znrh.nr_blockgroups; i++) {
+		st = &state[i * ZNR_HTTP_STATE_SIZE];
+		if (!memcmp(st, &sent[i * ZNR_HTTP_STATE_SIZE],
+			    ZNR_HTTP_STATE_SIZE))
+			continue;
+		znr_http_printf(b, "%s[%u,%u,%u]", nr ? "," : "",
+				i, st[0], st[1]);
+		nr++;
+	}
+	znr_http_printf(b, "]}\n\n");
+
+	memcpy(sent, state, znrh.nr_blockgroups * ZNR_HTTP_STATE_SIZE);
+}
+
+/*
+ * Event stream: send the state of all blockgroups, then the blockgroups
+ * changed after each update, until the connection is closed.
+ */
+static int znr_http_serve_events(int sd)
+{
+	static const char hdr[] =
+		"HTTP/1.1 200 OK\r\n"
+		"Content-Type: text/event-stream\r\n"
+		"Cache-Control: no-cache\r\n"
+		"Connection: close\r\n\r\n";
+	size_t size = znrh.nr_blockgroups * ZNR_HTTP_STATE_SIZE + 1;
+	struct znr_http_buf b = { };
+	unsigned long long gen;
+	__u8 *state, *sent;
+	struct timespec ts;
+	bool changed;
+	int ret;
+
+	state = malloc(size);
+	sent = malloc(size);
+	if (!state || !sent) {
+		ret = znr_http_send_error(sd, "503 Service Unavailable");
+		goto free;
+	}
+
+	ret = znr_http_send(sd, hdr, sizeof(hdr) - 1);
+	if (ret)
+		goto free;
+
+	pthread_mutex_lock(&znrh.lock);
+	znrh.nr_streams++;
+	pthread_cond_broadcast(&znrh.cond);
+	memcpy(sent, znrh.state, size - 1);
+	gen = znrh.gen;
+	pthread_mutex_unlock(&znrh.lock);
+
+	znr_http_printf(&b, "event: init\ndata: ");
+	znr_http_print_state(&b, sent, gen);
+	znr_http_printf(&b, "\n\n");
+
+	while (!b.err) {
+		ret = znr_http_send(sd, b.data, b.len);
+		if (ret)
+			break;
+		b.len = 0;
+
+		pthread_mutex_lock(&znrh.lock);
+		znr_http_deadline(&ts, ZNR_HTTP_KEEPALIVE_MS * 1000000ULL);
+		while (!znrh.stop && znrh.gen == gen) {
+			if (pthread_cond_timedwait(&znrh.cond, &znrh.lock,
+						   &ts) == ETIMEDOUT)
+				break;
+		}
+		changed = znrh.gen != gen;
+		if (changed) {
+			memcpy(state, znrh.state, size - 1);
+			gen = znrh.gen;
+		}
+		pthread_mutex_unlock(&znrh.lock);
+
+		if (znrh.stop)
+			break;
+
+		if (changed)
+			znr_http_print_delta(&b, state, sent, gen);
+		else
+			znr_http_printf(&b, ": keep-alive\n\n");
+	}
+
+	if (b.err)
+		ret = b.err;
+
+	pthread_mutex_lock(&znrh.lock);
+	znrh.nr_streams--;
+	pthread_mutex_unlock(&znrh.lock);
+
+free:
+	free(b.data);
+	free(state);
+	free(sent);
+
+	return ret;
+}
+
+/*
+ * Receive a request header. The request body, if any, is ignored.
+ */
+static int znr_http_recv_req(int sd, char *req, size_t size)
+{
+	size_t len = 0;
+	ssize_t ret;
+
+	while (len < size - 1) {
+		ret = recv(sd, req + len, size - 1 - len, 0);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			return -EIO;
+		len += ret;
+		req[len] = '\0';
+		if (strstr(req, "\r\n\r\n"))
+			return 0;
+	}
+
+	return -E2BIG;
+}
+
+static void znr_http_serve(int sd)
+{
+	char req[ZNR_HTTP_MAX_REQ_SIZE];
+	char method[8], path[256];
+	int ret;
+
+	ret = znr_http_recv_req(sd, req, sizeof(req));
+	if (ret == -E2BIG) {
+		znr_http_send_error(sd, "431 Request Header Fields Too Large");
+		return;
+	}
+	if (ret)
+		return;
+
+	if (sscanf(req, "%7s %255s", method, path) != 2) {
+		znr_http_send_error(sd, "400 Bad Request");
+		return;
+	}
+
+	znr_verbose("HTTP request %s %s\n", method, path);
+
+	if (strcmp(method, "GET") != 0) {
+		znr_http_send_error(sd, "405 Method Not Allowed");
+		return;
+	}
+
+	path[strcspn(path, "?")] = '\0';
+
+	if (strcmp(path, "/") == 0 || strcmp(path, "/index.html") == 0)
+		znr_http_send_rep(sd, "200 OK", "text/html; charset=utf-8",
+				  znr_http_page, sizeof(znr_http_page) - 1);
+	else if (strcmp(path, "/state") == 0)
+		znr_http_serve_state(sd);
+	else if (strcmp(path, "/events") == 0)
+		znr_http_serve_events(sd);
+	else
+		znr_http_send_error(sd, "404 Not Found");
+}
+
+static void *znr_http_conn_thread(void *arg)
+{
+	int sd = (int)(intptr_t)arg;
+	sigset_t set;
+
+	/* Let the main thread handle signals. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	znr_http_serve(sd);
+	close(sd);
+
+	pthread_mutex_lock(&znrh.lock);
+	znrh.nr_conns--;
+	pthread_cond_broadcast(&znrh.cond);
+	pthread_mutex_unlock(&znrh.lock);
+
+	return NULL;
+}
+
+static void *znr_http_thread(void *arg)
+{
+	struct timeval tv = { .tv_sec = 5 };
+	pthread_attr_t attr;
+	pthread_t thread;
+	sigset_t set;
+	bool busy;
+	int sd;
+
+	/* Let the main thread handle signals. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+	while (!znrh.stop) {
+		sd = accept(znrh.sd, NULL, NULL);
+		if (sd < 0) {
+			if (errno == EINTR)
+				continue;
+			if (!znrh.stop)
+				znr_err("HTTP accept failed (%s)\n",
+					strerror(errno));
+			break;
+		}
+
+		/* Do not let stalled peers hold a connection forever */
+		setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+		setsockopt(sd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+		pthread_mutex_lock(&znrh.lock);
+		busy = znrh.nr_conns >= ZNR_HTTP_MAX_CONNECTIONS;
+		if (!busy)
+			znrh.nr_conns++;
+		pthread_mutex_unlock(&znrh.lock);
+
+		if (busy) {
+			znr_http_send_error(sd, "503 Service Unavailable");
+			close(sd);
+			continue;
+		}
+
+		if (pthread_create(&thread, &attr, znr_http_conn_thread,
+				   (void *)(intptr_t)sd)) {
+			znr_err("Failed to create HTTP connection thread\n");
+			close(sd);
+			pthread_mutex_lock(&znrh.lock);
+			znrh.nr_conns--;
+			pthread_mutex_unlock(&znrh.lock);
+		}
+	}
+
+	pthread_attr_destroy(&attr);
+
+	return NULL;
+}
+
+/*
+ * Start the web viewer on the loopback interface port @port. The blockgroups
+ * state is updated every @interval_ms milliseconds while event streams are
+ * open.
+ */
+int znr_http_start(int port, unsigned int interval_ms)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_port = htons(port),
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	size_t size;
+	__u8 *state;
+	int ret, opt = 1;
+
+	if (interval_ms < ZNR_HTTP_MIN_INTERVAL_MS)
+		interval_ms = ZNR_HTTP_MIN_INTERVAL_MS;
+
+	znrh.stop = false;
+	znrh.gen = 0;
+	znrh.interval_ns = (unsigned long long)interval_ms * 1000000ULL;
+	znrh.nr_blockgroups = znr.nr_blockgroups;
+
+	size = znrh.nr_blockgroups * ZNR_HTTP_STATE_SIZE + 1;
+	znrh.state = calloc(1, size);
+	state = calloc(1, size);
+	znrh.zones = calloc(znr.nr_zones ? znr.nr_zones : 1,
+			    sizeof(struct blk_zone));
+	if (!znrh.state || !state || !znrh.zones) {
+		free(state);
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	/* Initial state: the zone information obtained when opening. */
+	if (znr.dev.is_zoned)
+		znr_http_set_state(znrh.state, znr.blk_zones);
+
+	znrh.sd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (znrh.sd < 0) {
+		ret = -errno;
+		znr_err("Create HTTP socket failed (%s)\n", strerror(errno));
+		free(state);
+		goto err;
+	}
+
+	setsockopt(znrh.sd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+
+	if (bind(znrh.sd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+	    listen(znrh.sd, ZNR_HTTP_MAX_CONNECTIONS) < 0) {
+		ret = -errno;
+		znr_err("Listen on HTTP port %d failed (%s)\n",
+			port, strerror(errno));
+		free(state);
+		goto err;
+	}
+
+	ret = pthread_create(&znrh.update_thread, NULL,
+			     znr_http_update_thread, state);
+	if (ret) {
+		znr_err("Failed to create HTTP update thread (%s)\n",
+			strerror(ret));
+		free(state);
+		ret = -ret;
+		goto err;
+	}
+	znrh.update_started = true;
+
+	ret = pthread_create(&znrh.thread, NULL, znr_http_thread, NULL);
+	if (ret) {
+		znr_err("Failed to create HTTP thread (%s)\n", strerror(ret));
+		ret = -ret;
+		goto err;
+	}
+	znrh.thread_started = true;
+
+	printf("Web viewer on http://127.0.0.1:%d/\n", port);
+
+	return 0;
+
+err:
+	znr_http_stop();
+	return ret;
+}
+
+void znr_http_stop(void)
+{
+	pthread_mutex_lock(&znrh.lock);
+	znrh.stop = true;
+	pthread_cond_broadcast(&znrh.cond);
+	pthread_mutex_unlock(&znrh.lock);
+
+	/* Shutting down the listening socket wakes up accept() */
+	if (znrh.sd >= 0)
+		shutdown(znrh.sd, SHUT_RDWR);
+
+	if (znrh.thread_started) {
+		pthread_join(znrh.thread, NULL);
+		znrh.thread_started = false;
+	}
+
+	/* Event streams stop on the broadcast, other requests are short */
+	pthread_mutex_lock(&znrh.lock);
+	while (znrh.nr_conns)
+		pthread_cond_wait(&znrh.cond, &znrh.lock);
+	pthread_mutex_unlock(&znrh.lock);
+
+	if (znrh.update_started) {
+		pthread_join(znrh.update_thread, NULL);
+		znrh.update_started = false;
+	}
+
+	if (znrh.sd >= 0) {
+		close(znrh.sd);
+		znrh.sd = -1;
+	}
+
+	free(znrh.state);
+	znrh.state = NULL;
+	free(znrh.zones);
+	znrh.zones = NULL;
+}
@@ -0,0 +1,46 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#ifndef ZNR_HTTP_H
+#define ZNR_HTTP_H
+
+#include "config.h"
+
+/*
+ * Web viewer. The server listens for HTTP connections on the loopback
+ * interface only and serves:
+ *   - /: a self-contained page drawing the blockgroup map,
+ *   - /state: the state of all blockgroups,
+ *   - /events: a server-sent events stream with the state of all blockgroups
+ *     first ("init" event), followed by the blockgroups changed after each
+ *     update ("delta" events).
+ * The state of a blockgroup is its fill level (0 to 255) and the condition of
+ * its first zone (BLK_ZONE_COND_*, 0 for conventional blockgroups).
+ */
+
+/*
+ * Minimum interval between updates of the blockgroups state.
+ */
+#define ZNR_HTTP_MIN_INTERVAL_MS	250
+
+/*
+ * Maximum number of connections served concurrently.
+ */
+#define ZNR_HTTP_MAX_CONNECTIONS	16
+
+/*
+ * Maximum size of a request header.
+ */
+#define ZNR_HTTP_MAX_REQ_SIZE		4096
+
+/*
+ * Time without any update after which an event stream keep-alive comment is
+ * sent, detecting closed connections.
+ */
+#define ZNR_HTTP_KEEPALIVE_MS		15000
+
+int znr_http_start(int port, unsigned int interval_ms);
+void znr_http_stop(void);
+
+#endif /* ZNR_HTTP_H */
@@ -7,7 +7,12 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
 #include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <netinet/tcp.h>
 
 #include "znr.h"
 
@@ -32,13 +37,14 @@ static struct znr_fs *znr_fs_get_net(enum znr_supported_fs type)
 	return NULL;
 }
 
-static int znr_net_send(struct znr_net_client *ncli,
-			void *buf, size_t buf_size)
+static int __znr_net_send(struct znr_net_client *ncli,
+			  void *buf, size_t buf_size, int flags)
 {
+	unsigned long long start = znr_stats_now_ns();
 	ssize_t ret;
 
 	while (buf_size) {
-		ret = send(ncli->sd, buf, buf_size, 0);
+		ret = send(ncli->sd, buf, buf_size, MSG_NOSIGNAL | flags);
 		if (!ret)
 			return -ECONNRESET;
 		if (ret < 0) {
@@ -48,11 +54,20 @@ static int znr_net_send(struct znr_net_client *ncli,
 
 		buf_size -= ret;
 		buf = (uint8_t *)buf + ret;
+		ncli->tx_bytes += ret;
 	}
 
+	ncli->send_ns += znr_stats_now_ns() - start;
+
 	return 0;
 }
 
+static inline int znr_net_send(struct znr_net_client *ncli,
+			       void *buf, size_t buf_size)
+{
+	return __znr_net_send(ncli, buf, buf_size, 0);
+}
+
 static int znr_net_recv(struct znr_net_client *ncli,
 			void *buf, size_t buf_size)
 {
@@ -69,11 +84,209 @@ static int znr_net_recv(struct znr_net_client *ncli,
 
 		buf_size -= ret;
 		buf = (uint8_t *)buf + ret;
+		ncli->rx_bytes += ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Pass a file descriptor to a local peer, as SCM_RIGHTS ancillary data of a
+ * single byte message.
+ */
+static int znr_net_send_fd(struct znr_net_client *ncli, int fd)
+{
+	union {
+		char		buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr	align;
+	} ctrl;
+	char byte = 0;
+	struct iovec iov = {
+		.iov_base = &byte,
+		.iov_len = 1,
+	};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = ctrl.buf,
+		.msg_controllen = sizeof(ctrl.buf),
+	};
+	struct cmsghdr *cmsg;
+
+	memset(&ctrl, 0, sizeof(ctrl));
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+
+	if (sendmsg(ncli->sd, &msg, MSG_NOSIGNAL) != 1) {
+		znr_err("sendmsg failed (%s)\n", strerror(errno));
+		return -errno;
 	}
 
 	return 0;
 }
 
+static int znr_net_recv_fd(struct znr_net_client *ncli)
+{
+	union {
+		char		buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr	align;
+	} ctrl;
+	char byte;
+	struct iovec iov = {
+		.iov_base = &byte,
+		.iov_len = 1,
+	};
+	struct msghdr msg = {
+		.msg_iov = &iov,
+		.msg_iovlen = 1,
+		.msg_control = ctrl.buf,
+		.msg_controllen = sizeof(ctrl.buf),
+	};
+	struct cmsghdr *cmsg;
+	ssize_t ret;
+	int fd;
+
+	ret = recvmsg(ncli->sd, &msg, MSG_CMSG_CLOEXEC);
+	if (!ret)
+		return -ECONNRESET;
+	if (ret < 0) {
+		znr_err("recvmsg failed (%s)\n", strerror(errno));
+		return -errno;
+	}
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_level != SOL_SOCKET ||
+	    cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+		znr_err("No file descriptor received\n");
+		return -EPROTO;
+	}
+
+	memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+
+	return fd;
+}
+
+/*
+ * Payload fields conversion to and from the wire format. These are no-ops if
+ * native layout was negotiated with ZNR_NET_HELLO.
+ */
+static inline __u32 znr_net_hton32(struct znr_net_client *ncli, __u32 val)
+{
+	return ncli->native ? val : htonl(val);
+}
+
+static inline __u64 znr_net_hton64(struct znr_net_client *ncli, __u64 val)
+{
+	return ncli->native ? val : htonll(val);
+}
+
+#define znr_net_ntoh32(ncli, val)	znr_net_hton32((ncli), (val))
+#define znr_net_ntoh64(ncli, val)	znr_net_hton64((ncli), (val))
+
+static void znr_net_hton_extents(struct znr_net_client *ncli,
+				 struct znr_extent *ext,
+				 unsigned int nr_extents)
+{
+	unsigned int i;
+
+	if (ncli->native)
+		return;
+
+	for (i = 0; i < nr_extents; i++, ext++) {
+		ext->idx = htonl(ext->idx);
+		ext->sector = htonll(ext->sector);
+		ext->nr_sectors = htonll(ext->nr_sectors);
+		ext->ino = htonll(ext->ino);
+	}
+}
+
+static void znr_net_ntoh_extents(struct znr_net_client *ncli,
+				 struct znr_extent *ext,
+				 unsigned int nr_extents)
+{
+	unsigned int i;
+
+	if (ncli->native)
+		return;
+
+	for (i = 0; i < nr_extents; i++, ext++) {
+		ext->idx = ntohl(ext->idx);
+		ext->sector = ntohll(ext->sector);
+		ext->nr_sectors = ntohll(ext->nr_sectors);
+		ext->ino = ntohll(ext->ino);
+	}
+}
+
+static void znr_net_hton_zones(struct znr_net_client *ncli,
+			       struct blk_zone *blkz, unsigned int nr_zones)
+{
+	unsigned int i;
+
+	if (ncli->native)
+		return;
+
+	for (i = 0; i < nr_zones; i++, blkz++) {
+		blkz->start = htonll(blkz->start);
+		blkz->len = htonll(blkz->len);
+		blkz->wp = htonll(blkz->wp);
+		blkz->capacity = htonll(blkz->capacity);
+	}
+}
+
+#define znr_net_ntoh_zones(ncli, blkz, nr)	\
+	znr_net_hton_zones((ncli), (blkz), (nr))
+
+static int znr_net_stream_drain(struct znr_net_client *ncli);
+
+/*
+ * Send a variable length request: the header and path, if any, are sent
+ * together with a single send() call.
+ */
+/*
+ * Priority class bits of the request ID of the requests sent.
+ */
+static inline unsigned int znr_net_req_class(struct znr_net_client *ncli)
+{
+	if (!(ncli->features & ZNR_NET_FEAT_SCHED))
+		return 0;
+
+	return ncli->req_class << ZNR_NET_REQ_CLASS_SHIFT;
+}
+
+static int znr_net_send_varlen_req(struct znr_net_client *ncli,
+				   enum znr_net_req_id id,
+				   __u32 zno, __u32 nr_zones,
+				   __u64 sector, __u64 nr_sectors,
+				   char *path)
+{
+	char buf[sizeof(struct znr_net_varlen_req) + PATH_MAX];
+	struct znr_net_varlen_req *req = (struct znr_net_varlen_req *)buf;
+	size_t path_len = 0;
+
+	if (path) {
+		path_len = strnlen(path, PATH_MAX);
+		if (path_len >= PATH_MAX) {
+			znr_err("Path too long\n");
+			return -ENAMETOOLONG;
+		}
+		memcpy(buf + sizeof(*req), path, path_len);
+	}
+
+	req->magic = htonl(ZNR_NET_VARLEN_MAGIC);
+	req->id = htons(id | znr_net_req_class(ncli));
+	req->path_len = htons(path_len);
+	req->zno = htonl(zno);
+	req->nr_zones = htonl(nr_zones);
+	req->sector = htonll(sector);
+	req->nr_sectors = htonll(nr_sectors);
+
+	return znr_net_send(ncli, buf, sizeof(*req) + path_len);
+}
+
 static int znr_net_send_req(struct znr_net_client *ncli,
 			    enum znr_net_req_id id,
 			    __u32 zno, __u32 nr_zones,
@@ -82,112 +295,321 @@ static int znr_net_send_req(struct znr_net_client *ncli,
 {
 	struct znr_net_req req = {
 		.magic = htonl(ZNR_NET_MAGIC),
-		.id = htonl(id),
+		.id = htonl(id | znr_net_req_class(ncli)),
 		.zno = htonl(zno),
 		.nr_zones = htonl(nr_zones),
 		.sector = htonll(sector),
 		.nr_sectors = htonll(nr_sectors),
 	};
 
+	/*
+	 * The replies to a new request cannot be received before the end of
+	 * the chunked reply being received: drain it first.
+	 */
+	if (ncli->stream_id && id != ZNR_NET_CREDIT && id != ZNR_NET_CANCEL)
+		znr_net_stream_drain(ncli);
+
+	if (ncli->features & ZNR_NET_FEAT_VARLEN)
+		return znr_net_send_varlen_req(ncli, id, zno, nr_zones,
+					       sector, nr_sectors, path);
+
 	if (path)
 		strncpy((char *)req.path, path, sizeof(req.path) - 1);
 
 	return znr_net_send(ncli, (void *) &req, sizeof(req));
 }
 
+/*
+ * Receive the path of a variable length request. Only file extents requests,
+ * which must have one, and query requests have a path, which must not contain
+ * null bytes.
+ */
+static int znr_net_recv_varlen_path(struct znr_net_client *ncli,
+				    struct znr_net_req *req,
+				    unsigned int path_len)
+{
+	int ret;
+
+	if (!path_len) {
+		if (req->id != ZNR_NET_FILE_EXTENTS)
+			return 0;
+		znr_err("Missing request path\n");
+		return -EPROTO;
+	}
+
+	if (req->id != ZNR_NET_FILE_EXTENTS && req->id != ZNR_NET_QUERY) {
+		znr_err("Unexpected path in %s request\n",
+			znr_net_req_name(req->id));
+		return -EPROTO;
+	}
+
+	if (path_len >= PATH_MAX) {
+		znr_err("Invalid request path length %u\n", path_len);
+		return -EPROTO;
+	}
+
+	ret = znr_net_recv(ncli, req->path, path_len);
+	if (ret)
+		return ret;
+
+	if (memchr(req->path, '\0', path_len)) {
+		znr_err("Invalid request path\n");
+		return -EPROTO;
+	}
+
+	return 0;
+}
+
 static int znr_net_recv_req(struct znr_net_client *ncli,
 			    struct znr_net_req *req)
 {
+	struct znr_net_varlen_req *vreq = (struct znr_net_varlen_req *)req;
+	unsigned int path_len = 0, class;
+	bool varlen;
 	int ret;
 
+	/*
+	 * Receive the request header, which has the same size for both
+	 * formats, and the remainder of fixed size requests.
+	 */
 	memset(req, 0, sizeof(*req));
 
-	ret = znr_net_recv(ncli, (void *) req, sizeof(*req));
+	ret = znr_net_recv(ncli, (void *) req, sizeof(*vreq));
 	if (ret)
 		return ret;
 
 	req->magic = ntohl(req->magic);
-	if (req->magic != ZNR_NET_MAGIC) {
-		znr_err("Invalid request magic (0x%08x != 0x%08x)\n",
-			req->magic, ZNR_NET_MAGIC);
-		return -1;
+	varlen = req->magic == ZNR_NET_VARLEN_MAGIC;
+	if (varlen && !(ncli->features & ZNR_NET_FEAT_VARLEN)) {
+		znr_err("Variable length request not negotiated\n");
+		return -EPROTO;
+	}
+
+	if (!varlen) {
+		if (req->magic != ZNR_NET_MAGIC) {
+			znr_err("Invalid request magic (0x%08x != 0x%08x)\n",
+				req->magic, ZNR_NET_MAGIC);
+			return -1;
+		}
+
+		ret = znr_net_recv(ncli, (uint8_t *)req + sizeof(*vreq),
+				   sizeof(*req) - sizeof(*vreq));
+		if (ret)
+			return ret;
+
+		req->path[PATH_MAX - 1] = '\0';
+		req->id = ntohl(req->id);
+	} else {
+		path_len = ntohs(vreq->path_len);
+		req->id = ntohs(vreq->id);
+	}
+
+	if (ncli->features & ZNR_NET_FEAT_SCHED) {
+		class = req->id >> ZNR_NET_REQ_CLASS_SHIFT;
+		req->id &= ZNR_NET_REQ_ID_MASK;
+		if (req->id != ZNR_NET_CREDIT && req->id != ZNR_NET_CANCEL)
+			ncli->req_class = class;
 	}
 
-	req->id = ntohl(req->id);
 	switch (req->id) {
 	case ZNR_NET_MNTDIR_INFO:
 	case ZNR_NET_DEV_INFO:
 	case ZNR_NET_FILE_EXTENTS:
 	case ZNR_NET_BLOCKGROUPS:
-		return 0;
+	case ZNR_NET_HELLO:
+	case ZNR_NET_SHM_MAP:
+	case ZNR_NET_STATS:
+	case ZNR_NET_BATCH:
+	case ZNR_NET_FLEET:
+	case ZNR_NET_CANCEL:
+		break;
+	case ZNR_NET_SELECT_HOST:
+		req->zno = ntohl(req->zno);
+		break;
 	case ZNR_NET_DEV_REP_ZONES:
 		req->zno = ntohl(req->zno);
 		req->nr_zones = ntohl(req->nr_zones);
-		return 0;
+		break;
+	case ZNR_NET_CREDIT:
+		req->nr_zones = ntohl(req->nr_zones);
+		break;
 	case ZNR_NET_EXTENTS_IN_RANGE:
 		req->zno = ntohl(req->zno);
 		req->sector = ntohll(req->sector);
 		req->nr_sectors = ntohll(req->nr_sectors);
-		return 0;
+		break;
+	case ZNR_NET_QUERY:
+	case ZNR_NET_RESUME:
+		req->sector = ntohll(req->sector);
+		req->nr_sectors = ntohll(req->nr_sectors);
+		break;
 	default:
 		znr_err("Invalid request ID\n");
 		return -1;
 	}
+
+	if (varlen)
+		return znr_net_recv_varlen_path(ncli, req, path_len);
+
+	return 0;
 }
 
-static int znr_net_send_rep(struct znr_net_client *ncli,
-			    enum znr_net_req_id id,
-			    int err, void *data, __u32 data_size)
+static int __znr_net_send_rep(struct znr_net_client *ncli,
+			      enum znr_net_req_id id, unsigned int flags,
+			      int err, void *data, __u32 data_size)
 {
 	struct znr_net_rep rep = {
 		.magic = htonl(ZNR_NET_MAGIC),
-		.id = htonl(id),
+		.flags = htons(flags),
+		.id = htons(id),
 	};
 	int ret;
 
+	if (znr_cache_served_stale())
+		rep.flags |= htons(ZNR_NET_REP_STALE);
+
 	rep.err = htonl(err);
-	if (err)
+	if (err) {
+		ncli->xfer_err = true;
 		data_size = 0;
+	}
+	ncli->xfer_bytes += data_size;
 
+	/*
+	 * Avoid the reply data being delayed by the peer delayed ACK of the
+	 * reply header.
+	 */
 	rep.data_size = htonl(data_size);
-	ret = znr_net_send(ncli, (void *) &rep, sizeof(rep));
+	ret = __znr_net_send(ncli, (void *) &rep, sizeof(rep),
+			     data_size ? MSG_MORE : 0);
 	if (!ret && data_size)
 		ret = znr_net_send(ncli, data, data_size);
 
 	return ret;
 }
 
-static int znr_net_recv_rep(struct znr_net_client *ncli,
-			    enum znr_net_req_id id,
-			    int *err, void **data, size_t *data_size)
+static inline int znr_net_send_rep(struct znr_net_client *ncli,
+				   enum znr_net_req_id id,
+				   int err, void *data, __u32 data_size)
+{
+	return __znr_net_send_rep(ncli, id, 0, err, data, data_size);
+}
+
+static void znr_net_account_req(struct znr_net_client *ncli,
+				unsigned int id,
+				unsigned long long *phase_ns)
+{
+	znr_stats_add(&ncli->stats, id, ncli->xfer_err, ncli->xfer_bytes,
+		      phase_ns);
+
+	ncli->send_ns = 0;
+	ncli->wait_ns = 0;
+	ncli->recv_ns = 0;
+	ncli->xfer_bytes = 0;
+	ncli->xfer_err = false;
+}
+
+/*
+ * Client side: account a request once its last reply is received.
+ */
+static void znr_net_account_cli_req(struct znr_net_client *ncli,
+				    unsigned int id)
+{
+	unsigned long long phase_ns[ZNR_STATS_NR_PHASES];
+
+	phase_ns[ZNR_STATS_CLI_SEND] = ncli->send_ns;
+	phase_ns[ZNR_STATS_CLI_WAIT] = ncli->wait_ns;
+	phase_ns[ZNR_STATS_CLI_RECV] = ncli->recv_ns;
+
+	znr_net_account_req(ncli, id, phase_ns);
+}
+
+/*
+ * Server side: account a request once its reply is sent. Whatever is not
+ * queueing or send time is device or file system time.
+ */
+static void znr_net_account_srv_req(struct znr_net_client *ncli,
+				    unsigned int id,
+				    unsigned long long start)
+{
+	unsigned long long phase_ns[ZNR_STATS_NR_PHASES];
+	unsigned long long total = znr_stats_now_ns() - start;
+
+	phase_ns[ZNR_STATS_SRV_QUEUE] = znr_cache_get_wait_ns() +
+		znr_sched_get_wait_ns();
+	phase_ns[ZNR_STATS_SRV_SEND] = ncli->send_ns;
+	if (total > phase_ns[ZNR_STATS_SRV_QUEUE] + ncli->send_ns)
+		phase_ns[ZNR_STATS_SRV_DEV] = total -
+			phase_ns[ZNR_STATS_SRV_QUEUE] - ncli->send_ns;
+	else
+		phase_ns[ZNR_STATS_SRV_DEV] = 0;
+
+	znr_net_account_req(ncli, id, phase_ns);
+}
+
+/*
+ * Receive a reply. For requests with multiple replies, last must be false for
+ * all replies but the last one. Chunked replies are accepted only if @flags is
+ * not NULL, and all chunks but the last one are not considered as last.
+ */
+static int __znr_net_recv_rep(struct znr_net_client *ncli,
+			      enum znr_net_req_id id,
+			      int *err, void **data, size_t *data_size,
+			      unsigned int *flags, bool last)
 {
+	unsigned long long start = znr_stats_now_ns(), rep_time;
 	struct znr_net_rep rep;
 	void *data_buf = NULL;
 	int ret;
 
+	*err = 0;
+	*data = NULL;
+	*data_size = 0;
+	if (flags)
+		*flags = 0;
+
 	ret = znr_net_recv(ncli, (void *) &rep, sizeof(rep));
 	if (ret)
-		return ret;
+		goto out;
+
+	rep_time = znr_stats_now_ns();
+	ncli->wait_ns += rep_time - start;
 
 	rep.magic = ntohl(rep.magic);
 	if (rep.magic != ZNR_NET_MAGIC) {
 		znr_err("Invalid reply magic (0x%08x != 0x%08x)\n",
 			rep.magic, ZNR_NET_MAGIC);
-		return -1;
+		ret = -1;
+		goto out;
 	}
 
-	rep.id = ntohl(rep.id);
+	rep.id = ntohs(rep.id);
 	if (rep.id != id) {
 		znr_err("Invalid reply ID\n");
-		return -1;
+		ret = -1;
+		goto out;
+	}
+
+	rep.flags = ntohs(rep.flags);
+	if ((rep.flags & ZNR_NET_REP_STALE) &&
+	    (!(rep.flags & ZNR_NET_REP_CHUNK) || (rep.flags & ZNR_NET_REP_LAST)))
+		ncli->nr_stale++;
+	if ((rep.flags & ZNR_NET_REP_CHUNK) && !flags) {
+		znr_err("Unexpected chunked reply\n");
+		ret = -EPROTO;
+		goto out;
+	}
+	if (flags) {
+		*flags = rep.flags;
+		if ((rep.flags & ZNR_NET_REP_CHUNK) &&
+		    !(rep.flags & ZNR_NET_REP_LAST))
+			last = false;
 	}
 
 	*err = ntohl(rep.err);
 	if (*err) {
 		errno = *err;
-		*data = NULL;
-		*data_size = 0;
-		return 0;
+		goto out;
 	}
 
 	/* Get the data, if any. */
@@ -197,7 +619,8 @@ static int znr_net_recv_rep(struct znr_net_client *ncli,
 		if (!data_buf) {
 			znr_err("Failed to allocate %u B data buffer\n",
 				rep.data_size);
-			return -ENOMEM;
+			ret = -ENOMEM;
+			goto out;
 		}
 
 		ret = znr_net_recv(ncli, data_buf, rep.data_size);
@@ -206,10 +629,185 @@ static int znr_net_recv_rep(struct znr_net_client *ncli,
 			data_buf = NULL;
 			rep.data_size = 0;
 		}
+		ncli->recv_ns += znr_stats_now_ns() - rep_time;
 	}
 
 	*data = data_buf;
 	*data_size = rep.data_size;
+	ncli->xfer_bytes += rep.data_size;
+
+out:
+	if (ret || *err)
+		ncli->xfer_err = true;
+	if (ret || *err || last)
+		znr_net_account_cli_req(ncli, id);
+
+	return ret;
+}
+
+static inline int znr_net_recv_rep(struct znr_net_client *ncli,
+				   enum znr_net_req_id id,
+				   int *err, void **data, size_t *data_size)
+{
+	return __znr_net_recv_rep(ncli, id, err, data, data_size, NULL, true);
+}
+
+static int znr_net_send_hello_rep(struct znr_net_client *ncli)
+{
+	struct znr_net_hello hello;
+	unsigned int version;
+	int ret;
+
+	ret = znr_net_recv(ncli, (void *) &hello, sizeof(hello));
+	if (ret)
+		return ret;
+
+	version = ntohl(hello.version);
+	if (version < ZNR_NET_PROTO_LEGACY) {
+		znr_err("Invalid protocol version %u\n", version);
+		return znr_net_send_rep(ncli, ZNR_NET_HELLO, EPROTO, NULL, 0);
+	}
+
+	/*
+	 * Use the lowest common protocol version and features. Native layout
+	 * is used only if both peers have the same endianness.
+	 */
+	if (version > ZNR_NET_PROTO_VERSION)
+		version = ZNR_NET_PROTO_VERSION;
+	ncli->version = version;
+	ncli->features = ntohl(hello.features) & znr.net_features;
+	if (hello.byte_order != ZNR_NET_BYTE_ORDER)
+		ncli->features &= ~ZNR_NET_FEAT_NATIVE;
+	ncli->compression = ZNR_NET_COMP_NONE;
+
+	znr_verbose("Sending hello reply (version %u, features 0x%08x)\n",
+		    ncli->version, ncli->features);
+
+	hello.version = htonl(ncli->version);
+	hello.byte_order = ZNR_NET_BYTE_ORDER;
+	hello.features = htonl(ncli->features);
+	hello.compression = htonl(ncli->compression);
+
+	ret = znr_net_send_rep(ncli, ZNR_NET_HELLO, 0,
+			       &hello, sizeof(hello));
+
+	/* The reply itself must use the legacy format. */
+	ncli->native = ncli->features & ZNR_NET_FEAT_NATIVE;
+
+	return ret;
+}
+
+static int znr_net_send_shm_map_rep(struct znr_net_client *ncli)
+{
+	struct znr_net_shm_map shm_map;
+	size_t size = 0;
+	int ret, fd;
+
+	znr_verbose("Sending shared memory map reply\n");
+
+	/* The segment is only shared with local clients. */
+	if (!ncli->local || ncli->shm)
+		return znr_net_send_rep(ncli, ZNR_NET_SHM_MAP, EOPNOTSUPP,
+					NULL, 0);
+
+	fd = znr_shm_get(&size);
+	if (fd < 0)
+		return znr_net_send_rep(ncli, ZNR_NET_SHM_MAP, -fd, NULL, 0);
+
+	shm_map.size = znr_net_hton64(ncli, size);
+	ret = znr_net_send_rep(ncli, ZNR_NET_SHM_MAP, 0,
+			       &shm_map, sizeof(shm_map));
+	if (!ret)
+		ret = znr_net_send_fd(ncli, fd);
+	close(fd);
+
+	if (ret) {
+		znr_shm_put();
+		return ret;
+	}
+
+	ncli->shm = true;
+
+	return 0;
+}
+
+/*
+ * Clients being served, each by its own server thread.
+ */
+static struct znr_net_client *znr_net_clients;
+static unsigned int znr_net_nr_clients;
+static pthread_mutex_t znr_net_clients_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t znr_net_clients_cond = PTHREAD_COND_INITIALIZER;
+
+/*
+ * Server statistics: start time, number of connections since the start and
+ * statistics of the clients that disconnected.
+ */
+static unsigned long long znr_net_start_time;
+static unsigned long long znr_net_nr_connections;
+static struct znr_stats znr_net_srv_stats;
+
+static int znr_net_send_stats_rep(struct znr_net_client *ncli)
+{
+	struct znr_net_stats *srv_stats;
+	struct znr_cache_stats cstats;
+	struct znr_net_client *c;
+	struct znr_stats *stats;
+	size_t i, size;
+	__u64 *val;
+	int ret;
+
+	znr_verbose("Sending statistics reply\n");
+
+	/* The per class statistics follow if the client knows about them */
+	size = sizeof(*srv_stats) + sizeof(*stats);
+	if (ncli->features & ZNR_NET_FEAT_SCHED)
+		size += sizeof(struct znr_sched_stats) * ZNR_SCHED_NR_CLASSES;
+	srv_stats = calloc(1, size);
+	if (!srv_stats)
+		return znr_net_send_rep(ncli, ZNR_NET_STATS, ENOMEM, NULL, 0);
+	stats = (struct znr_stats *)(srv_stats + 1);
+	if (ncli->features & ZNR_NET_FEAT_SCHED)
+		znr_sched_get_stats((struct znr_sched_stats *)(stats + 1));
+
+	/*
+	 * The statistics of the clients being served are updated without
+	 * locking by their server thread: the result is only approximate.
+	 */
+	pthread_mutex_lock(&znr_net_clients_lock);
+	znr_stats_merge(stats, &znr_net_srv_stats);
+	for (c = znr_net_clients; c; c = c->next) {
+		znr_stats_merge(stats, &c->stats);
+		srv_stats->nr_clients++;
+	}
+	pthread_mutex_unlock(&znr_net_clients_lock);
+
+	if (znr.connect) {
+		znr_stats_merge(stats, &ncli->stats);
+		srv_stats->nr_clients = 1;
+	}
+
+	znr_cache_get_stats(&cstats);
+
+	srv_stats->uptime_ms =
+		(znr_stats_now_ns() - znr_net_start_time) / 1000000ULL;
+	srv_stats->nr_connections = znr_net_nr_connections;
+	srv_stats->nr_reqs = ZNR_STATS_MAX_REQS;
+	srv_stats->nr_phases = ZNR_STATS_NR_PHASES;
+	srv_stats->nr_buckets = ZNR_STATS_NR_BUCKETS;
+	srv_stats->cache_hits = cstats.hits;
+	srv_stats->cache_misses = cstats.misses;
+	srv_stats->cache_coalesced = cstats.coalesced;
+	srv_stats->cache_invalidations = cstats.invalidations;
+	srv_stats->cache_evictions = cstats.evictions;
+
+	val = (void *)srv_stats;
+	for (i = 0; i < size / sizeof(__u64); i++)
+		val[i] = znr_net_hton64(ncli, val[i]);
+
+	ret = znr_net_send_rep(ncli, ZNR_NET_STATS, 0, srv_stats, size);
+
+	free(srv_stats);
 
 	return ret;
 }
@@ -241,16 +839,18 @@ static int znr_net_send_dev_info_rep(struct znr_net_client *ncli)
 		sizeof(dev_info.path) - 1);
 	strncpy((char *)dev_info.vendor_id, dev->vendor_id,
 		sizeof(dev_info.vendor_id));
-	dev_info.nr_sectors = htonll(dev->nr_sectors);
-	dev_info.nr_lblocks = htonll(dev->nr_lblocks);
-	dev_info.nr_pblocks = htonll(dev->nr_pblocks);
-	dev_info.zone_size = htonll(dev->zone_size);
-	dev_info.zone_sectors = htonl(dev->zone_sectors);
-	dev_info.lblock_size = htonl(dev->lblock_size);
-	dev_info.pblock_size = htonl(dev->pblock_size);
-	dev_info.nr_zones = htonl(dev->nr_zones);
-	dev_info.max_nr_open_zones = htonl(dev->max_nr_open_zones);
-	dev_info.max_nr_active_zones = htonl(dev->max_nr_active_zones);
+	dev_info.nr_sectors = znr_net_hton64(ncli, dev->nr_sectors);
+	dev_info.nr_lblocks = znr_net_hton64(ncli, dev->nr_lblocks);
+	dev_info.nr_pblocks = znr_net_hton64(ncli, dev->nr_pblocks);
+	dev_info.zone_size = znr_net_hton64(ncli, dev->zone_size);
+	dev_info.zone_sectors = znr_net_hton32(ncli, dev->zone_sectors);
+	dev_info.lblock_size = znr_net_hton32(ncli, dev->lblock_size);
+	dev_info.pblock_size = znr_net_hton32(ncli, dev->pblock_size);
+	dev_info.nr_zones = znr_net_hton32(ncli, dev->nr_zones);
+	dev_info.max_nr_open_zones =
+		znr_net_hton32(ncli, dev->max_nr_open_zones);
+	dev_info.max_nr_active_zones =
+		znr_net_hton32(ncli, dev->max_nr_active_zones);
 	dev_info.is_zoned = dev->is_zoned;
 
 	return znr_net_send_rep(ncli, ZNR_NET_DEV_INFO, 0,
@@ -262,11 +862,9 @@ static int znr_net_send_dev_rep_zones_rep(struct znr_net_client *ncli,
 {
 	unsigned int zno = req->zno;
 	unsigned int nr_zones = req->nr_zones;
-	struct blk_zone *blkz;
+	struct blk_zone *zones = NULL;
 	__u32 data_size = 0;
-	unsigned int i;
-	ssize_t ret;
-	int err = 0;
+	int ret, err = 0;
 
 	znr_verbose("Sending zone report reply (from %u, %u zones)\n",
 		    zno, nr_zones);
@@ -277,85 +875,292 @@ static int znr_net_send_dev_rep_zones_rep(struct znr_net_client *ncli,
 		err = EINVAL;
 		goto reply;
 	}
-	if (!nr_zones || zno + nr_zones - 1 >= znr.dev.nr_zones) {
+	if (!nr_zones || nr_zones > znr.dev.nr_zones - zno) {
 		znr_err("Invalid number of zones %u\n",
 			nr_zones);
 		err = EINVAL;
 		goto reply;
 	}
 
-	ret = znr_dev_report_zones(&znr.dev, zno,
-				   &znr.blk_zones[zno], nr_zones);
-	if (ret < 0) {
-		znr_err("Get zone information failed %d (%s)\n",
-			errno, strerror(errno));
-		err = -ret;
+	/*
+	 * Several clients may be served concurrently: use a private copy of
+	 * the zone information, from the cache if it is fresh enough.
+	 */
+	zones = malloc(nr_zones * sizeof(struct blk_zone));
+	if (!zones) {
+		err = ENOMEM;
 		goto reply;
 	}
 
-	if ((unsigned int)ret != nr_zones) {
-		znr_err("Got %zd zones, expected %u zones\n",
-			ret, nr_zones);
-		err = EINVAL;
+	ret = znr_cache_report_zones(zno, nr_zones, zones);
+	if (ret < 0) {
+		znr_err("Get zone information failed %d (%s)\n",
+			-ret, strerror(-ret));
+		err = -ret;
 		goto reply;
 	}
 
-	blkz = &znr.blk_zones[zno];
-	for (i = 0; i < nr_zones; i++, blkz++) {
-		blkz->start = htonll(blkz->start);
-		blkz->len = htonll(blkz->len);
-		blkz->wp = htonll(blkz->wp);
-		blkz->capacity = htonll(blkz->capacity);
-	}
-
 	data_size = nr_zones * sizeof(struct blk_zone);
+	znr_net_hton_zones(ncli, zones, nr_zones);
 
 reply:
 	ret = znr_net_send_rep(ncli, ZNR_NET_DEV_REP_ZONES, err,
-			       &znr.blk_zones[zno], data_size);
-
-	if (data_size) {
-		/* We used znr zone array, so we must restore it ! */
-		blkz = &znr.blk_zones[zno];
-		for (i = 0; i < nr_zones; i++, blkz++) {
-			blkz->start = ntohll(blkz->start);
-			blkz->len = ntohll(blkz->len);
-			blkz->wp = ntohll(blkz->wp);
-			blkz->capacity = ntohll(blkz->capacity);
-		}
-	}
+			       zones, data_size);
+
+	free(zones);
 
 	return ret;
 }
 
-static int znr_net_send_file_extents_rep(struct znr_net_client *ncli,
-					 struct znr_net_req *req)
+/*
+ * Server side state of a chunked reply: extents of the chunk being built and
+ * number of chunks sent and not yet credited by the client. Batch replies are
+ * chunked as a byte stream, built in buf.
+ */
+struct znr_net_chunked_rep {
+	struct znr_net_client	*ncli;
+	enum znr_net_req_id	id;
+	struct znr_extent	*extents;
+	unsigned int		nr_extents;
+	char			*buf;
+	size_t			len;
+	unsigned int		in_flight;
+	int			send_err;
+};
+
+/*
+ * Wait for the client to credit sent chunks. The time spent waiting is
+ * accounted as send time.
+ */
+static int znr_net_recv_credit(struct znr_net_chunked_rep *cr)
 {
+	struct znr_net_client *ncli = cr->ncli;
+	unsigned long long start = znr_stats_now_ns();
+	struct znr_net_req req;
+	int ret;
+
+	ret = znr_net_recv_req(ncli, &req);
+	ncli->send_ns += znr_stats_now_ns() - start;
+	if (ret)
+		return ret;
+
+	if (req.id == ZNR_NET_CANCEL) {
+		znr_verbose("Chunked reply cancelled\n");
+		return -ECANCELED;
+	}
+
+	if (req.id != ZNR_NET_CREDIT) {
+		znr_err("Unexpected request %u during chunked reply\n",
+			req.id);
+		return -EPROTO;
+	}
+
+	if (!req.nr_zones || req.nr_zones > cr->in_flight) {
+		znr_err("Invalid chunk credit %u (%u chunks in flight)\n",
+			req.nr_zones, cr->in_flight);
+		return -EPROTO;
+	}
+
+	cr->in_flight -= req.nr_zones;
+
+	return 0;
+}
+
+static int znr_net_send_chunk(struct znr_net_chunked_rep *cr, bool last)
+{
+	struct znr_net_client *ncli = cr->ncli;
+	unsigned int flags = ZNR_NET_REP_CHUNK;
+	void *data;
+	size_t size;
+	int ret;
+
+	while (cr->in_flight >= ZNR_NET_CHUNK_WINDOW) {
+		ret = znr_net_recv_credit(cr);
+		if (ret)
+			return ret;
+	}
+
+	if (last)
+		flags |= ZNR_NET_REP_LAST;
+
+	if (cr->buf) {
+		data = cr->buf;
+		size = cr->len;
+		cr->len = 0;
+	} else {
+		znr_net_hton_extents(ncli, cr->extents, cr->nr_extents);
+		data = cr->extents;
+		size = cr->nr_extents * sizeof(struct znr_extent);
+		cr->nr_extents = 0;
+	}
+
+	ret = __znr_net_send_rep(ncli, cr->id, flags, 0, data, size);
+	cr->in_flight++;
+
+	return ret;
+}
+
+/*
+ * Extent walk callback of chunked replies: add extents to the chunk being
+ * built, sending it when full.
+ */
+static int znr_net_chunk_extents(struct znr_extent *extents,
+				 unsigned int nr_extents, void *data)
+{
+	struct znr_net_chunked_rep *cr = data;
+	unsigned int nr;
+	int ret;
+
+	while (nr_extents) {
+		nr = ZNR_NET_CHUNK_EXTENTS - cr->nr_extents;
+		if (nr > nr_extents)
+			nr = nr_extents;
+		memcpy(&cr->extents[cr->nr_extents], extents,
+		       nr * sizeof(struct znr_extent));
+		cr->nr_extents += nr;
+		extents += nr;
+		nr_extents -= nr;
+
+		if (cr->nr_extents < ZNR_NET_CHUNK_EXTENTS)
+			break;
+
+		ret = znr_net_send_chunk(cr, false);
+		if (ret) {
+			cr->send_err = ret;
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Add data to the chunk being built of a byte stream chunked reply, sending it
+ * when full.
+ */
+static int znr_net_chunk_data(struct znr_net_chunked_rep *cr,
+			      const void *data, size_t size)
+{
+	size_t len;
+	int ret;
+
+	while (size) {
+		len = ZNR_NET_CHUNK_SIZE - cr->len;
+		if (len > size)
+			len = size;
+		memcpy(cr->buf + cr->len, data, len);
+		cr->len += len;
+		data = (const char *)data + len;
+		size -= len;
+
+		if (cr->len < ZNR_NET_CHUNK_SIZE)
+			break;
+
+		ret = znr_net_send_chunk(cr, false);
+		if (ret) {
+			cr->send_err = ret;
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int znr_net_start_chunked_rep(struct znr_net_chunked_rep *cr,
+				     struct znr_net_client *ncli,
+				     enum znr_net_req_id id)
+{
+	memset(cr, 0, sizeof(*cr));
+	cr->ncli = ncli;
+	cr->id = id;
+
+	if (id == ZNR_NET_BATCH) {
+		cr->buf = malloc(ZNR_NET_CHUNK_SIZE);
+		if (!cr->buf)
+			return -ENOMEM;
+		return 0;
+	}
+
+	cr->extents = malloc(ZNR_NET_CHUNK_EXTENTS * sizeof(struct znr_extent));
+	if (!cr->extents)
+		return -ENOMEM;
+
+	return 0;
+}
+
+/*
+ * End a chunked reply with its last chunk, or with an error reply if @err is
+ * not 0 or if the client cancelled the request. The extents already sent are
+ * then to be ignored by the client.
+ */
+static int znr_net_end_chunked_rep(struct znr_net_chunked_rep *cr, int err)
+{
+	int ret;
+
+	if (cr->send_err == -ECANCELED) {
+		cr->send_err = 0;
+		err = ECANCELED;
+	}
+
+	if (cr->send_err)
+		ret = cr->send_err;
+	else if (err)
+		ret = __znr_net_send_rep(cr->ncli, cr->id,
+					 ZNR_NET_REP_CHUNK | ZNR_NET_REP_LAST,
+					 err, NULL, 0);
+	else
+		ret = znr_net_send_chunk(cr, true);
+
+	free(cr->extents);
+	cr->extents = NULL;
+	free(cr->buf);
+	cr->buf = NULL;
+
+	return ret;
+}
+
+static int znr_net_send_file_extents_rep(struct znr_net_client *ncli,
+					 struct znr_net_req *req)
+{
+	struct znr_net_chunked_rep cr;
 	struct znr_fs_file *f = NULL;
-	struct znr_extent *extents = NULL, *ext;
+	struct znr_extent *extents = NULL;
 	unsigned int nr_extents = 0;
+	unsigned long long start;
 	__u32 data_size = 0;
-	unsigned int i;
 	int ret, err = 0;
 
 	znr_verbose("Sending file %s extents reply\n", req->path);
 
-	ret = znr_fs_get_file_extents_by_path((char *)req->path,
-					      &f, &extents, &nr_extents);
+	znr_budget_take();
+	ret = znr_sched_get();
+	if (!ret) {
+		start = znr_stats_now_ns();
+		ret = znr_fs_get_file_extents_by_path((char *)req->path, &f,
+						      &extents, &nr_extents);
+		znr_budget_account_io(start);
+		znr_sched_put();
+	}
 	if (ret < 0) {
 		err = -ret;
 		goto reply;
 	}
 
-	if (nr_extents) {
-		ext = &extents[0];
-		for (i = 0; i < nr_extents; i++, ext++) {
-			ext->idx = htonl(ext->idx);
-			ext->sector = htonll(ext->sector);
-			ext->nr_sectors = htonll(ext->nr_sectors);
-			ext->ino = htonll(ext->ino);
+	if (ncli->features & ZNR_NET_FEAT_CHUNKED) {
+		ret = znr_net_start_chunked_rep(&cr, ncli,
+						ZNR_NET_FILE_EXTENTS);
+		if (ret) {
+			err = -ret;
+			goto reply;
 		}
+		if (nr_extents)
+			znr_net_chunk_extents(extents, nr_extents, &cr);
+		ret = znr_net_end_chunked_rep(&cr, 0);
+		goto free;
+	}
 
+	if (nr_extents) {
+		znr_net_hton_extents(ncli, extents, nr_extents);
 		data_size = nr_extents * sizeof(struct znr_extent);
 	}
 
@@ -363,11 +1168,68 @@ reply:
 	ret = znr_net_send_rep(ncli, ZNR_NET_FILE_EXTENTS, err,
 			       extents, data_size);
 
+free:
 	znr_fs_free_file(f);
 	free(extents);
 	return ret;
 }
 
+/*
+ * Send the blockgroups geometry as runs of contiguous blockgroups of the same
+ * size.
+ */
+static int znr_net_send_compact_blockgroups(struct znr_net_client *ncli,
+					    struct znr_bg *bg,
+					    unsigned int nr_blockgroups)
+{
+	struct znr_net_bg_geometry *geo;
+	struct znr_net_bg_run *run = NULL;
+	unsigned int i, nr_runs = 0;
+	size_t data_size;
+	int ret;
+
+	data_size = sizeof(*geo) + nr_blockgroups * sizeof(*run);
+	geo = calloc(1, data_size);
+	if (!geo)
+		return znr_net_send_rep(ncli, ZNR_NET_BLOCKGROUPS, ENOMEM,
+					NULL, 0);
+
+	for (i = 0; i < nr_blockgroups; i++) {
+		if (run && bg[i].nr_sectors == run->nr_sectors &&
+		    bg[i].sector == run->sector +
+				    run->nr_blockgroups * run->nr_sectors) {
+			run->nr_blockgroups++;
+			continue;
+		}
+
+		run = (struct znr_net_bg_run *)(geo + 1) + nr_runs;
+		run->sector = bg[i].sector;
+		run->nr_sectors = bg[i].nr_sectors;
+		run->nr_blockgroups = 1;
+		nr_runs++;
+	}
+
+	znr_verbose("Sending %u blockgroups as %u runs\n",
+		    nr_blockgroups, nr_runs);
+
+	run = (struct znr_net_bg_run *)(geo + 1);
+	for (i = 0; i < nr_runs; i++, run++) {
+		run->sector = znr_net_hton64(ncli, run->sector);
+		run->nr_sectors = znr_net_hton64(ncli, run->nr_sectors);
+		run->nr_blockgroups = znr_net_hton32(ncli, run->nr_blockgroups);
+	}
+
+	geo->nr_blockgroups = znr_net_hton32(ncli, nr_blockgroups);
+	geo->nr_runs = znr_net_hton32(ncli, nr_runs);
+
+	data_size = sizeof(*geo) + nr_runs * sizeof(*run);
+	ret = znr_net_send_rep(ncli, ZNR_NET_BLOCKGROUPS, 0, geo, data_size);
+
+	free(geo);
+
+	return ret;
+}
+
 static int znr_net_send_blockgroups(struct znr_net_client *ncli,
 				    struct znr_net_req *req)
 {
@@ -383,8 +1245,16 @@ static int znr_net_send_blockgroups(struct znr_net_client *ncli,
 		err = ret;
 		goto err_reply;
 	}
+
+	if (ncli->features & ZNR_NET_FEAT_COMPACT_BG) {
+		ret = znr_net_send_compact_blockgroups(ncli, bg,
+						       nr_blockgroups);
+		free(bg);
+		return ret;
+	}
+
 	bg_start = bg;
-	for (i = 0; i < nr_blockgroups; i++, bg++) {
+	for (i = 0; i < nr_blockgroups && !ncli->native; i++, bg++) {
 		bg->sector = htonll(bg->sector);
 		bg->nr_sectors = htonll(bg->nr_sectors);
 		bg->wp_sector = htonll(bg->wp_sector);
@@ -415,36 +1285,174 @@ err_reply:
 	return ret;
 }
 
+/*
+ * Send the zones changed since the state generation of the last
+ * synchronization of a client, or all zones if the client session is unknown
+ * or if this is smaller. The generation sent is taken before reporting the
+ * zones so that changes detected while the reply is built are sent again when
+ * the client resumes its session next time.
+ */
+static int znr_net_send_resume_rep(struct znr_net_client *ncli,
+				   struct znr_net_req *req)
+{
+	unsigned long long session = req->sector, gen = req->nr_sectors;
+	unsigned int nr_zones = 0, nr = 0, nr_blockgroups, flags = 0, i;
+	unsigned long long srv_session, cur_gen, bg_gen;
+	struct znr_net_resume *resume = NULL;
+	struct blk_zone *zones = NULL, *blkz;
+	size_t zno_size = 0, data_size = 0;
+	struct znr_bg *bg = NULL;
+	__u32 *znos = NULL, *rep_znos;
+	int ret, err = 0;
+
+	srv_session = znr_session_id();
+	cur_gen = znr_session_gen();
+
+	/* Start a new session: the client does a full synchronization. */
+	if (!session)
+		goto build;
+
+	if (session != srv_session || gen > cur_gen)
+		flags |= ZNR_NET_RESUME_FULL | ZNR_NET_RESUME_ALL;
+
+	if (znr.dev.is_zoned)
+		nr_zones = znr.dev.nr_zones;
+
+	if (nr_zones) {
+		zones = malloc(nr_zones * sizeof(struct blk_zone));
+		znos = malloc(nr_zones * sizeof(__u32));
+		if (!zones || !znos) {
+			err = ENOMEM;
+			goto reply;
+		}
+
+		/* Detect the zone changes not seen by any client yet */
+		ret = znr_cache_report_zones(0, nr_zones, zones);
+		if (ret < 0) {
+			znr_err("Get zone information failed %d (%s)\n",
+				-ret, strerror(-ret));
+			err = -ret;
+			goto reply;
+		}
+
+		if (!(flags & ZNR_NET_RESUME_ALL)) {
+			nr = znr_session_get_changes(gen, znos);
+			zno_size = (nr * sizeof(__u32) + 7) & ~7UL;
+			if (zno_size + nr * sizeof(struct blk_zone) >=
+			    nr_zones * sizeof(struct blk_zone))
+				flags |= ZNR_NET_RESUME_ALL;
+		}
+
+		if (flags & ZNR_NET_RESUME_ALL) {
+			nr = nr_zones;
+			zno_size = 0;
+		}
+	}
+
+	ret = znr_bg_get_blockgroups(&bg, &nr_blockgroups);
+	if (ret < 0) {
+		err = -ret;
+		goto reply;
+	}
+	bg_gen = znr_session_update_blockgroups(bg, nr_blockgroups);
+	free(bg);
+	if (bg_gen > gen)
+		flags |= ZNR_NET_RESUME_BLOCKGROUPS;
+
+build:
+	znr_verbose("Sending resume reply (generation %llu -> %llu, "
+		    "%u zones, flags 0x%x)\n",
+		    gen, cur_gen, nr, flags);
+
+	data_size = sizeof(*resume) + zno_size + nr * sizeof(struct blk_zone);
+	resume = calloc(1, data_size);
+	if (!resume) {
+		err = ENOMEM;
+		goto reply;
+	}
+
+	resume->session = znr_net_hton64(ncli, srv_session);
+	resume->gen = znr_net_hton64(ncli, cur_gen);
+	resume->flags = znr_net_hton32(ncli, flags);
+	resume->nr_zones = znr_net_hton32(ncli, nr);
+
+	rep_znos = (__u32 *)(resume + 1);
+	blkz = (struct blk_zone *)((uint8_t *)rep_znos + zno_size);
+	if (zno_size) {
+		for (i = 0; i < nr; i++) {
+			rep_znos[i] = znr_net_hton32(ncli, znos[i]);
+			memcpy(&blkz[i], &zones[znos[i]], sizeof(*blkz));
+		}
+	} else if (nr) {
+		memcpy(blkz, zones, nr * sizeof(*blkz));
+	}
+	znr_net_hton_zones(ncli, blkz, nr);
+
+reply:
+	if (err)
+		ret = znr_net_send_rep(ncli, ZNR_NET_RESUME, err, NULL, 0);
+	else
+		ret = znr_net_send_rep(ncli, ZNR_NET_RESUME, 0,
+				       resume, data_size);
+
+	free(resume);
+	free(zones);
+	free(znos);
+
+	return ret;
+}
+
+/*
+ * Send the extents in a range in chunks, directly from the cached extents.
+ */
+static int
+znr_net_send_chunked_extents_in_range_rep(struct znr_net_client *ncli,
+					  struct znr_net_req *req)
+{
+	struct znr_net_chunked_rep cr;
+	int ret;
+
+	ret = znr_net_start_chunked_rep(&cr, ncli, ZNR_NET_EXTENTS_IN_RANGE);
+	if (ret)
+		return znr_net_send_rep(ncli, ZNR_NET_EXTENTS_IN_RANGE, -ret,
+					NULL, 0);
+
+	ret = znr_cache_walk_extents_in_range(req->sector, req->nr_sectors,
+					      ZNR_FS_EXTENTS_BATCH,
+					      znr_net_chunk_extents, &cr);
+	if (ret < 0 && ret != -ECANCELED && !cr.send_err)
+		znr_err("Extents in range %llu + %llu failed\n",
+			req->sector, req->nr_sectors);
+
+	return znr_net_end_chunked_rep(&cr, ret < 0 ? -ret : 0);
+}
+
 static int znr_net_send_extents_in_range_rep(struct znr_net_client *ncli,
 					     struct znr_net_req *req)
 {
-	struct znr_extent *extents = NULL, *ext;
+	struct znr_extent *extents = NULL;
 	unsigned int nr_extents = 0;
 	__u32 data_size = 0;
-	unsigned int i;
 	int ret, err = 0;
 
 	znr_verbose("Sending extents in range %llu + %llu reply\n",
 		    req->sector, req->nr_sectors);
 
-	ret = znr_fs_get_extents_in_range(req->sector, req->nr_sectors,
-					  &extents, &nr_extents);
+	if (ncli->features & ZNR_NET_FEAT_CHUNKED)
+		return znr_net_send_chunked_extents_in_range_rep(ncli, req);
+
+	ret = znr_cache_get_extents_in_range(req->sector, req->nr_sectors,
+					     &extents, &nr_extents);
 	if (ret < 0) {
-		znr_err("Extents in range %llu + %llu failed\n",
-			req->sector, req->nr_sectors);
+		if (ret != -ECANCELED)
+			znr_err("Extents in range %llu + %llu failed\n",
+				req->sector, req->nr_sectors);
 		err = -ret;
 		goto reply;
 	}
 
 	if (nr_extents) {
-		ext = &extents[0];
-		for (i = 0; i < nr_extents; i++, ext++) {
-			ext->idx = htonl(ext->idx);
-			ext->sector = htonll(ext->sector);
-			ext->nr_sectors = htonll(ext->nr_sectors);
-			ext->ino = htonll(ext->ino);
-		}
-
+		znr_net_hton_extents(ncli, extents, nr_extents);
 		data_size = nr_extents * sizeof(struct znr_extent);
 	}
 
@@ -456,81 +1464,677 @@ reply:
 	return ret;
 }
 
-static void znr_net_client_init(struct znr_net_client *ncli)
+/*
+ * Evaluate a query on the extents of a range as they are walked: only the
+ * extents matching, or the aggregates of the groups, are sent.
+ */
+static int znr_net_send_query_rep(struct znr_net_client *ncli,
+				  struct znr_net_req *req)
 {
-	memset(ncli, 0, sizeof(*ncli));
-	ncli->inaddrlen = sizeof(struct sockaddr_in);
-}
+	struct znr_fs_extents fe = { };
+	struct znr_net_chunked_rep cr;
+	__u32 data_size = 0;
+	struct znr_query q;
+	void *data = NULL;
+	int ret, err = 0;
+	unsigned int i;
+	__u64 *val;
 
-static int znr_net_get_port(void)
-{
-	/* Prepare the listening socket. */
-	if (!znr.port)
-		return ZNR_NET_DEFAULT_PORT;
-	if (znr.port < 65535)
-		return znr.port;
+	znr_verbose("Sending query \"%s\" on %llu + %llu reply\n",
+		    (char *)req->path, req->sector, req->nr_sectors);
 
-	znr_err("Invalid port %d\n", znr.port);
+	ret = znr_query_parse(&q, (char *)req->path);
+	if (ret)
+		return znr_net_send_rep(ncli, ZNR_NET_QUERY, -ret, NULL, 0);
 
-	return -1;
+	if (!q.group && (ncli->features & ZNR_NET_FEAT_CHUNKED)) {
+		ret = znr_net_start_chunked_rep(&cr, ncli, ZNR_NET_QUERY);
+		if (ret) {
+			err = -ret;
+			goto reply;
+		}
+		q.cb = znr_net_chunk_extents;
+		q.data = &cr;
+		ret = znr_cache_walk_extents_in_range(req->sector,
+						      req->nr_sectors,
+						      ZNR_FS_EXTENTS_BATCH,
+						      znr_query_extents, &q);
+		if (ret < 0 && ret != -ECANCELED && !cr.send_err)
+			znr_err("Query on %llu + %llu failed\n",
+				req->sector, req->nr_sectors);
+		ret = znr_net_end_chunked_rep(&cr, ret < 0 ? -ret : 0);
+		goto free;
+	}
+
+	q.cb = znr_fs_collect_extents;
+	q.data = &fe;
+	ret = znr_cache_walk_extents_in_range(req->sector, req->nr_sectors,
+					      ZNR_FS_EXTENTS_BATCH,
+					      znr_query_extents, &q);
+	if (ret < 0) {
+		if (ret != -ECANCELED)
+			znr_err("Query on %llu + %llu failed\n",
+				req->sector, req->nr_sectors);
+		err = -ret;
+		goto reply;
+	}
+
+	if (q.group) {
+		znr_query_finish(&q);
+		data = q.groups;
+		data_size = q.nr_groups * sizeof(struct znr_query_group);
+		val = data;
+		for (i = 0; i < data_size / sizeof(__u64); i++)
+			val[i] = znr_net_hton64(ncli, val[i]);
+	} else if (fe.nr_extents) {
+		znr_net_hton_extents(ncli, fe.extents, fe.nr_extents);
+		data = fe.extents;
+		data_size = fe.nr_extents * sizeof(struct znr_extent);
+	}
+
+reply:
+	ret = znr_net_send_rep(ncli, ZNR_NET_QUERY, err, data, data_size);
+
+free:
+	free(fe.extents);
+	znr_query_free(&q);
+	return ret;
 }
 
-static void znr_net_setsockopt(struct znr_net_client *ncli)
+/*
+ * Parse the sub-requests of a batch. Return 0 or a positive errno code.
+ */
+static int znr_net_parse_batch(struct znr_net_client *ncli, void *data,
+			       size_t size, struct znr_batch_req *reqs,
+			       unsigned int nr_reqs)
 {
-	size_t sockbuf_size;
-	int ret;
+	struct znr_net_batch_req breq;
+	size_t ofst = 0, path_size;
+	unsigned int i;
 
-	/* Change the socket send and receive buffer size */
-	sockbuf_size = ZNR_NET_SOCKBUF_SIZE;
-	ret = setsockopt(ncli->sd, SOL_SOCKET, SO_RCVBUF, &sockbuf_size,
-			 sizeof(size_t));
-	if (ret < 0) {
-		znr_err("setsockopt SO_RCVBUF failed (%s)\n", strerror(errno));
-		return;
+	for (i = 0; i < nr_reqs; i++) {
+		if (size - ofst < sizeof(breq))
+			return EINVAL;
+		memcpy(&breq, data + ofst, sizeof(breq));
+		ofst += sizeof(breq);
+
+		reqs[i].type = znr_net_ntoh32(ncli, breq.type);
+		reqs[i].start = znr_net_ntoh64(ncli, breq.start);
+		reqs[i].len = znr_net_ntoh64(ncli, breq.len);
+
+		breq.path_len = znr_net_ntoh32(ncli, breq.path_len);
+		if (!breq.path_len)
+			continue;
+
+		path_size = (breq.path_len + 7) & ~7UL;
+		if (breq.path_len >= PATH_MAX || size - ofst < path_size)
+			return EINVAL;
+		reqs[i].path = strndup(data + ofst, breq.path_len);
+		if (!reqs[i].path)
+			return ENOMEM;
+		ofst += path_size;
 	}
 
-	sockbuf_size = ZNR_NET_SOCKBUF_SIZE;
-	ret = setsockopt(ncli->sd, SOL_SOCKET, SO_SNDBUF, &sockbuf_size,
-			 sizeof(size_t));
-	if (ret < 0) {
-		znr_err("setsockopt SO_SNDBUF failed (%s)\n", strerror(errno));
-		return;
-	}
+	if (ofst != size)
+		return EINVAL;
+
+	return 0;
 }
 
-void znr_net_disconnect(struct znr_net_client *ncli)
+/*
+ * Convert the result of a batch sub-request to the wire format: set its reply
+ * header in @brep and its zones or extents in @part, and return their size.
+ */
+static size_t znr_net_hton_batch_part(struct znr_net_client *ncli,
+				      struct znr_batch_req *req,
+				      struct znr_net_batch_rep *brep,
+				      void **part)
 {
-	if (ncli->sd > 0) {
-		printf("Disconnecting client %s:%d\n",
-		       ncli->ip, ncli->port);
+	size_t data_size;
 
-		shutdown(ncli->sd, SHUT_RDWR);
-		close(ncli->sd);
-		ncli->sd = 0;
+	if (req->zones) {
+		data_size = (size_t)req->nr * sizeof(struct blk_zone);
+		znr_net_hton_zones(ncli, req->zones, req->nr);
+		*part = req->zones;
+	} else {
+		data_size = (size_t)req->nr * sizeof(struct znr_extent);
+		znr_net_hton_extents(ncli, req->extents, req->nr);
+		*part = req->extents;
+	}
+
+	if (data_size > UINT_MAX) {
+		req->err = E2BIG;
+		req->nr = 0;
+		data_size = 0;
 	}
+
+	brep->type = znr_net_hton32(ncli, req->type);
+	brep->err = znr_net_hton32(ncli, req->err);
+	brep->nr = znr_net_hton32(ncli, req->nr);
+	brep->data_size = znr_net_hton32(ncli, data_size);
+
+	return data_size;
 }
 
-int znr_net_connect(struct znr_net_client *ncli)
+/*
+ * Send the reply of a batch in chunks, so that the reply size is not limited
+ * and the data buffered for the connection is bounded as for extents replies.
+ */
+static int znr_net_send_chunked_batch_rep(struct znr_net_client *ncli,
+					  struct znr_batch_req *reqs,
+					  unsigned int nr_reqs)
 {
+	struct znr_net_batch_rep brep[ZNR_BATCH_MAX_REQS];
+	size_t data_size[ZNR_BATCH_MAX_REQS];
+	void *part[ZNR_BATCH_MAX_REQS];
+	struct znr_net_chunked_batch cb = { };
+	struct znr_net_chunked_rep cr;
+	unsigned long long size = 0;
+	unsigned int i;
 	int ret;
 
-	znr_net_client_init(ncli);
-
-	ncli->port = znr_net_get_port();
-	if (ncli->port < 0)
-		return ncli->port;
+	ret = znr_net_start_chunked_rep(&cr, ncli, ZNR_NET_BATCH);
+	if (ret)
+		return znr_net_send_rep(ncli, ZNR_NET_BATCH, -ret, NULL, 0);
 
-	if (inet_pton(AF_INET, znr.ipaddr, &ncli->inaddr.sin_addr) <= 0) {
-		znr_err("Invalid address %s\n", znr.ipaddr);
-		return -errno;
+	for (i = 0; i < nr_reqs; i++) {
+		data_size[i] = znr_net_hton_batch_part(ncli, &reqs[i],
+						       &brep[i], &part[i]);
+		size += sizeof(brep[i]) + data_size[i];
 	}
 
-	inet_ntop(AF_INET, &ncli->inaddr.sin_addr, ncli->ip,
-		  INET_ADDRSTRLEN);
+	cb.size = znr_net_hton64(ncli, size);
+	ret = znr_net_chunk_data(&cr, &cb, sizeof(cb));
 
-	ncli->inaddr.sin_family = AF_INET;
-	ncli->inaddr.sin_addr.s_addr = inet_addr(ncli->ip);
-	ncli->inaddr.sin_port = htons((short)ncli->port);
+	for (i = 0; i < nr_reqs && !ret; i++) {
+		ret = znr_net_chunk_data(&cr, &brep[i], sizeof(brep[i]));
+		if (!ret && data_size[i])
+			ret = znr_net_chunk_data(&cr, part[i], data_size[i]);
+	}
+
+	return znr_net_end_chunked_rep(&cr, 0);
+}
+
+static int znr_net_send_batch_rep(struct znr_net_client *ncli)
+{
+	struct znr_batch_req *reqs = NULL;
+	struct znr_net_batch_rep brep;
+	struct znr_net_batch batch;
+	size_t size, ofst, data_size;
+	unsigned int nr_reqs, i;
+	void *data = NULL, *part;
+	int ret, err = 0;
+
+	ret = znr_net_recv(ncli, (void *) &batch, sizeof(batch));
+	if (ret)
+		return ret;
+
+	nr_reqs = znr_net_ntoh32(ncli, batch.nr_reqs);
+	size = znr_net_ntoh32(ncli, batch.size);
+	if (!nr_reqs || nr_reqs > ZNR_BATCH_MAX_REQS ||
+	    size > ZNR_NET_BATCH_MAX_SIZE) {
+		/* The request data cannot be skipped: drop the client */
+		znr_err("Invalid batch of %u requests, %zu B\n",
+			nr_reqs, size);
+		znr_net_send_rep(ncli, ZNR_NET_BATCH, EINVAL, NULL, 0);
+		return -EPROTO;
+	}
+
+	znr_verbose("Sending batch reply (%u requests)\n", nr_reqs);
+
+	data = malloc(size);
+	if (!data)
+		return -ENOMEM;
+
+	ret = znr_net_recv(ncli, data, size);
+	if (ret)
+		goto free;
+
+	reqs = calloc(nr_reqs, sizeof(*reqs));
+	if (!reqs) {
+		err = ENOMEM;
+		goto reply;
+	}
+
+	err = znr_net_parse_batch(ncli, data, size, reqs, nr_reqs);
+	if (err)
+		goto reply;
+
+	znr_batch_exec_local(reqs, nr_reqs);
+
+	free(data);
+	data = NULL;
+
+	if (ncli->features & ZNR_NET_FEAT_CHUNKED) {
+		ret = znr_net_send_chunked_batch_rep(ncli, reqs, nr_reqs);
+		goto free;
+	}
+
+	/* Build the reply */
+	size = 0;
+	for (i = 0; i < nr_reqs; i++) {
+		size += sizeof(brep);
+		if (reqs[i].zones)
+			size += (size_t)reqs[i].nr * sizeof(struct blk_zone);
+		else
+			size += (size_t)reqs[i].nr * sizeof(struct znr_extent);
+	}
+	if (size > UINT_MAX) {
+		err = E2BIG;
+		goto reply;
+	}
+
+	data = malloc(size);
+	if (!data) {
+		err = ENOMEM;
+		goto reply;
+	}
+
+	for (i = 0, ofst = 0; i < nr_reqs; i++) {
+		data_size = znr_net_hton_batch_part(ncli, &reqs[i],
+						    &brep, &part);
+		memcpy(data + ofst, &brep, sizeof(brep));
+		if (data_size)
+			memcpy(data + ofst + sizeof(brep), part, data_size);
+		ofst += sizeof(brep) + data_size;
+	}
+
+reply:
+	if (err)
+		size = 0;
+	ret = znr_net_send_rep(ncli, ZNR_NET_BATCH, err, data, size);
+
+free:
+	if (reqs) {
+		znr_batch_clear(reqs, nr_reqs);
+		for (i = 0; i < nr_reqs; i++)
+			free(reqs[i].path);
+		free(reqs);
+	}
+	free(data);
+
+	return ret;
+}
+
+/*
+ * Aggregator: send the summary of all hosts.
+ */
+static int znr_net_send_fleet_rep(struct znr_net_client *ncli)
+{
+	struct znr_net_fleet_host *hosts;
+	unsigned int nr_hosts, i, j;
+	__u64 *val;
+	int ret;
+
+	znr_verbose("Sending fleet reply\n");
+
+	hosts = calloc(ZNR_FLEET_MAX_HOSTS, sizeof(*hosts));
+	if (!hosts)
+		return znr_net_send_rep(ncli, ZNR_NET_FLEET, ENOMEM, NULL, 0);
+
+	nr_hosts = znr_fleet_get_hosts(hosts);
+	for (i = 0; i < nr_hosts; i++) {
+		val = &hosts[i].err;
+		for (j = 0; j < (sizeof(*hosts) - ZNR_NET_HOST_NAME_LEN) /
+			     sizeof(__u64); j++)
+			val[j] = znr_net_hton64(ncli, val[j]);
+	}
+
+	ret = znr_net_send_rep(ncli, ZNR_NET_FLEET, 0, hosts,
+			       nr_hosts * sizeof(*hosts));
+
+	free(hosts);
+
+	return ret;
+}
+
+static void znr_net_close_upstream(struct znr_net_client *ncli)
+{
+	if (!ncli->upstream)
+		return;
+
+	znr_net_disconnect(ncli->upstream);
+	free(ncli->upstream);
+	ncli->upstream = NULL;
+}
+
+/*
+ * Aggregator: connect to the host selected by the client. The upstream
+ * connection negotiates at most the features of the client connection and the
+ * client connection then uses the features negotiated with the host, so that
+ * requests and replies can be forwarded as they are.
+ */
+static int znr_net_send_select_host_rep(struct znr_net_client *ncli,
+					struct znr_net_req *req)
+{
+	struct znr_net_client *up;
+	struct znr_net_hello hello;
+	int ret;
+
+	znr_verbose("Sending select host reply (host %u)\n", req->zno);
+
+	znr_net_close_upstream(ncli);
+
+	if (!znr_fleet_enabled())
+		return znr_net_send_rep(ncli, ZNR_NET_SELECT_HOST, EOPNOTSUPP,
+					NULL, 0);
+
+	up = malloc(sizeof(*up));
+	if (!up)
+		return znr_net_send_rep(ncli, ZNR_NET_SELECT_HOST, ENOMEM,
+					NULL, 0);
+
+	ret = znr_fleet_connect(req->zno, up, ncli->features);
+	if (ret) {
+		free(up);
+		return znr_net_send_rep(ncli, ZNR_NET_SELECT_HOST, -ret,
+					NULL, 0);
+	}
+
+	hello.version = htonl(up->version);
+	hello.byte_order = ZNR_NET_BYTE_ORDER;
+	hello.features = htonl(up->features);
+	hello.compression = htonl(up->compression);
+
+	ret = znr_net_send_rep(ncli, ZNR_NET_SELECT_HOST, 0,
+			       &hello, sizeof(hello));
+
+	ncli->upstream = up;
+	ncli->version = up->version;
+	ncli->features = up->features;
+	ncli->native = up->native;
+
+	return ret;
+}
+
+/*
+ * Aggregator: forward the data of a batch request.
+ */
+static int znr_net_forward_batch(struct znr_net_client *ncli)
+{
+	struct znr_net_batch batch;
+	void *data;
+	size_t size;
+	int ret;
+
+	ret = znr_net_recv(ncli, (void *) &batch, sizeof(batch));
+	if (ret)
+		return ret;
+
+	size = znr_net_ntoh32(ncli, batch.size);
+	if (size > ZNR_NET_BATCH_MAX_SIZE) {
+		znr_err("Invalid batch of %zu B\n", size);
+		return -EPROTO;
+	}
+
+	data = malloc(size);
+	if (!data)
+		return -ENOMEM;
+
+	ret = znr_net_recv(ncli, data, size);
+	if (!ret)
+		ret = __znr_net_send(ncli->upstream, (void *) &batch,
+				     sizeof(batch), MSG_MORE);
+	if (!ret)
+		ret = znr_net_send(ncli->upstream, data, size);
+
+	free(data);
+
+	return ret;
+}
+
+/*
+ * Aggregator: forward the replies of the upstream host. Chunks are credited to
+ * the host as they are forwarded, so that the data buffered for the client is
+ * bounded by the client connection socket buffer, and the client credits are
+ * ignored.
+ */
+static int znr_net_forward_reps(struct znr_net_client *ncli,
+				bool *forwarded)
+{
+	struct znr_net_client *up = ncli->upstream;
+	unsigned int flags, credits = 0;
+	struct znr_net_rep rep;
+	size_t size, len;
+	void *buf;
+	int ret;
+
+	buf = malloc(ZNR_NET_CHUNK_SIZE);
+	if (!buf)
+		return -ENOMEM;
+
+	do {
+		ret = znr_net_recv(up, (void *) &rep, sizeof(rep));
+		if (ret)
+			break;
+
+		if (ntohl(rep.magic) != ZNR_NET_MAGIC) {
+			znr_err("Invalid upstream reply magic\n");
+			ret = -EPROTO;
+			break;
+		}
+
+		flags = ntohs(rep.flags);
+		size = ntohl(rep.data_size);
+
+		*forwarded = true;
+		ret = __znr_net_send(ncli, (void *) &rep, sizeof(rep),
+				     size ? MSG_MORE : 0);
+		ncli->xfer_bytes += size;
+		while (!ret && size) {
+			len = size < ZNR_NET_CHUNK_SIZE ?
+				size : ZNR_NET_CHUNK_SIZE;
+			ret = znr_net_recv(up, buf, len);
+			if (!ret)
+				ret = __znr_net_send(ncli, buf, len,
+						     size > len ? MSG_MORE : 0);
+			size -= len;
+		}
+		if (ret)
+			break;
+
+		if (!(flags & ZNR_NET_REP_CHUNK) || (flags & ZNR_NET_REP_LAST))
+			break;
+
+		credits++;
+		if (credits >= ZNR_NET_CHUNK_WINDOW / 2) {
+			ret = znr_net_send_req(up, ZNR_NET_CREDIT, 0,
+					       credits, 0, 0, NULL);
+			credits = 0;
+		}
+	} while (!ret);
+
+	free(buf);
+
+	return ret;
+}
+
+/*
+ * Aggregator: forward a request to the host selected by the client. If the
+ * host fails before any reply was forwarded, the client gets an EHOSTDOWN
+ * error reply and must select a host again. Otherwise, the client is dropped.
+ */
+static int znr_net_forward_req(struct znr_net_client *ncli,
+			       struct znr_net_req *req)
+{
+	bool forwarded = false;
+	int ret;
+
+	if (!ncli->upstream) {
+		/* The request data cannot be skipped: drop the client */
+		if (req->id == ZNR_NET_BATCH)
+			return -EPROTO;
+		return znr_net_send_rep(ncli, req->id, ENXIO, NULL, 0);
+	}
+
+	ncli->upstream->req_class = ncli->req_class;
+	ret = znr_net_send_req(ncli->upstream, req->id,
+			       req->zno, req->nr_zones,
+			       req->sector, req->nr_sectors,
+			       req->id == ZNR_NET_FILE_EXTENTS ||
+			       req->id == ZNR_NET_QUERY ?
+			       (char *)req->path : NULL);
+	if (!ret && req->id == ZNR_NET_BATCH)
+		ret = znr_net_forward_batch(ncli);
+	if (!ret)
+		ret = znr_net_forward_reps(ncli, &forwarded);
+	if (!ret)
+		return 0;
+
+	znr_err("Forwarding %s request failed %d\n",
+		znr_net_req_name(req->id), ret);
+	znr_net_close_upstream(ncli);
+	if (forwarded || req->id == ZNR_NET_BATCH)
+		return ret;
+
+	return znr_net_send_rep(ncli, req->id, EHOSTDOWN, NULL, 0);
+}
+
+static void znr_net_client_init(struct znr_net_client *ncli)
+{
+	memset(ncli, 0, sizeof(*ncli));
+	ncli->inaddrlen = sizeof(struct sockaddr_in);
+	ncli->version = ZNR_NET_PROTO_LEGACY;
+	ncli->host = -1;
+}
+
+static int znr_net_get_port(void)
+{
+	/* Prepare the listening socket. */
+	if (!znr.port)
+		return ZNR_NET_DEFAULT_PORT;
+	if (znr.port < 65535)
+		return znr.port;
+
+	znr_err("Invalid port %d\n", znr.port);
+
+	return -1;
+}
+
+static void znr_net_setsockopt(struct znr_net_client *ncli)
+{
+	size_t sockbuf_size;
+	int ret, one = 1;
+
+	/* Change the socket send and receive buffer size */
+	sockbuf_size = ZNR_NET_SOCKBUF_SIZE;
+	ret = setsockopt(ncli->sd, SOL_SOCKET, SO_RCVBUF, &sockbuf_size,
+			 sizeof(size_t));
+	if (ret < 0) {
+		znr_err("setsockopt SO_RCVBUF failed (%s)\n", strerror(errno));
+		return;
+	}
+
+	sockbuf_size = ZNR_NET_SOCKBUF_SIZE;
+	ret = setsockopt(ncli->sd, SOL_SOCKET, SO_SNDBUF, &sockbuf_size,
+			 sizeof(size_t));
+	if (ret < 0) {
+		znr_err("setsockopt SO_SNDBUF failed (%s)\n", strerror(errno));
+		return;
+	}
+
+	/*
+	 * Requests and replies are sent with a single send() call (or with
+	 * MSG_MORE). Disable Nagle so that a request following a chunk credit
+	 * is not delayed until the credit is acknowledged.
+	 */
+	if (!ncli->local) {
+		ret = setsockopt(ncli->sd, IPPROTO_TCP, TCP_NODELAY,
+				 &one, sizeof(one));
+		if (ret < 0)
+			znr_err("setsockopt TCP_NODELAY failed (%s)\n",
+				strerror(errno));
+	}
+}
+
+void znr_net_disconnect(struct znr_net_client *ncli)
+{
+	if (ncli->sd > 0) {
+		printf("Disconnecting client %s:%d\n",
+		       ncli->ip, ncli->port);
+
+		shutdown(ncli->sd, SHUT_RDWR);
+		close(ncli->sd);
+		ncli->sd = 0;
+	}
+}
+
+/*
+ * For local connections, use the peer process ID as the port number.
+ */
+static void znr_net_set_local_peer(struct znr_net_client *ncli)
+{
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+
+	ncli->local = true;
+	strncpy(ncli->ip, "local", sizeof(ncli->ip) - 1);
+	if (!getsockopt(ncli->sd, SOL_SOCKET, SO_PEERCRED, &cred, &len))
+		ncli->port = cred.pid;
+}
+
+static int znr_net_unix_addr(struct sockaddr_un *addr, const char *path)
+{
+	if (strlen(path) >= sizeof(addr->sun_path)) {
+		znr_err("Invalid unix socket path %s\n", path);
+		return -ENAMETOOLONG;
+	}
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+	strncpy(addr->sun_path, path, sizeof(addr->sun_path) - 1);
+
+	return 0;
+}
+
+static int znr_net_connect_local(struct znr_net_client *ncli,
+				 const char *path)
+{
+	struct sockaddr_un addr;
+	int ret;
+
+	ret = znr_net_unix_addr(&addr, path);
+	if (ret)
+		return ret;
+
+	ncli->sd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (ncli->sd < 0) {
+		znr_err("socket failed (%s)", strerror(errno));
+		return -errno;
+	}
+
+	printf("Connecting to %s...\n", path);
+
+	ret = connect(ncli->sd, (struct sockaddr *) &addr, sizeof(addr));
+	if (ret) {
+		znr_err("connect failed (%s)", strerror(errno));
+		znr_net_disconnect(ncli);
+		return ret;
+	}
+
+	znr_net_set_local_peer(ncli);
+	znr_net_setsockopt(ncli);
+
+	return 0;
+}
+
+static int znr_net_connect_inet(struct znr_net_client *ncli,
+				const char *ipaddr, int port)
+{
+	int ret;
+
+	ncli->port = port;
+	if (inet_pton(AF_INET, ipaddr, &ncli->inaddr.sin_addr) <= 0) {
+		znr_err("Invalid address %s\n", ipaddr);
+		return -errno;
+	}
+
+	inet_ntop(AF_INET, &ncli->inaddr.sin_addr, ncli->ip,
+		  INET_ADDRSTRLEN);
+
+	ncli->inaddr.sin_family = AF_INET;
+	ncli->inaddr.sin_addr.s_addr = inet_addr(ncli->ip);
+	ncli->inaddr.sin_port = htons((short)ncli->port);
 
 	ncli->sd = socket(PF_INET, SOCK_STREAM, 0);
 	if (ncli->sd < 0) {
@@ -541,515 +2145,1973 @@ int znr_net_connect(struct znr_net_client *ncli)
 	printf("Connecting to %s:%d...\n",
 	       ncli->ip, (int)ncli->port);
 
-	ret = connect(ncli->sd,
-		      (struct sockaddr *) &ncli->inaddr,
-		      (socklen_t) sizeof(struct sockaddr_in));
+	ret = connect(ncli->sd,
+		      (struct sockaddr *) &ncli->inaddr,
+		      (socklen_t) sizeof(struct sockaddr_in));
+	if (ret) {
+		znr_err("connect failed (%s)", strerror(errno));
+		znr_net_disconnect(ncli);
+		return ret;
+	}
+
+	znr_net_setsockopt(ncli);
+
+	return 0;
+}
+
+int znr_net_connect(struct znr_net_client *ncli)
+{
+	int port;
+
+	znr_net_client_init(ncli);
+
+	if (znr.unix_path)
+		return znr_net_connect_local(ncli, znr.unix_path);
+
+	port = znr_net_get_port();
+	if (port < 0)
+		return port;
+
+	return znr_net_connect_inet(ncli, znr.ipaddr, port);
+}
+
+/*
+ * Connect to the server @host, an IP address or a unix socket path.
+ */
+int znr_net_connect_host(struct znr_net_client *ncli, const char *host,
+			 int port)
+{
+	struct in_addr addr;
+
+	znr_net_client_init(ncli);
+
+	if (inet_pton(AF_INET, host, &addr) != 1)
+		return znr_net_connect_local(ncli, host);
+
+	return znr_net_connect_inet(ncli, host, port);
+}
+
+static void znr_net_listen_close(void)
+{
+	if (znr.listen_sd > 0) {
+		close(znr.listen_sd);
+		znr.listen_sd = -1;
+		if (znr.unix_path)
+			unlink(znr.unix_path);
+	}
+}
+
+static int znr_net_listen_inet(void)
+{
+	struct sockaddr_in bindaddr;
+	int val, ret;
+
+	znr.listen_port = znr_net_get_port();
+	if (znr.listen_port < 0)
+		return znr.listen_port;
+
+	znr.listen_sd = socket(PF_INET, SOCK_STREAM, 0);
+	if (znr.listen_sd < 0) {
+		znr_err("socket failed (%s)", strerror(errno));
+		return -1;
+	}
+
+	val = 1;
+	ret = setsockopt(znr.listen_sd, SOL_SOCKET, SO_REUSEADDR,
+			 &val, sizeof(int));
+	if (ret) {
+		znr_err("setsockopt failed (%s)", strerror(errno));
+		return ret;
+	}
+
+	memset(&bindaddr, 0, sizeof(bindaddr));
+	bindaddr.sin_family = PF_INET;
+	bindaddr.sin_port = htons(znr.listen_port);
+	ret = bind(znr.listen_sd, (struct sockaddr *) &bindaddr,
+		   sizeof(struct sockaddr_in));
+	if (ret) {
+		znr_err("bind failed (%s)", strerror(errno));
+		return -errno;
+	}
+
+	/* Listen for connections. */
+	if (listen(znr.listen_sd, ZNR_NET_MAX_CLIENTS) < 0) {
+		znr_err("listen failed (%s)", strerror(errno));
+		return -errno;
+	}
+
+	printf("Listening for connections on port %d...\n",
+	       znr.listen_port);
+
+	return 0;
+}
+
+static int znr_net_listen_local(void)
+{
+	struct sockaddr_un addr;
+	struct stat st;
+	int ret;
+
+	ret = znr_net_unix_addr(&addr, znr.unix_path);
+	if (ret)
+		return ret;
+
+	/* Remove a stale socket left by a previous server. */
+	if (!lstat(znr.unix_path, &st) && S_ISSOCK(st.st_mode))
+		unlink(znr.unix_path);
+
+	znr.listen_sd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (znr.listen_sd < 0) {
+		znr_err("socket failed (%s)", strerror(errno));
+		return -1;
+	}
+
+	ret = bind(znr.listen_sd, (struct sockaddr *) &addr, sizeof(addr));
+	if (ret) {
+		znr_err("bind failed (%s)", strerror(errno));
+		return -errno;
+	}
+
+	/* Allow unprivileged local clients to connect. */
+	if (chmod(znr.unix_path, 0666) < 0)
+		znr_err("chmod %s failed (%s)", znr.unix_path, strerror(errno));
+
+	if (listen(znr.listen_sd, ZNR_NET_MAX_CLIENTS) < 0) {
+		znr_err("listen failed (%s)", strerror(errno));
+		return -errno;
+	}
+
+	printf("Listening for local connections on %s...\n",
+	       znr.unix_path);
+
+	return 0;
+}
+
+int znr_net_listen(struct znr_net_client *ncli)
+{
+	int ret;
+
+	if (!znr.listen_sd) {
+		if (znr.unix_path)
+			ret = znr_net_listen_local();
+		else
+			ret = znr_net_listen_inet();
+		if (ret)
+			goto close;
+	}
+
+	znr_net_client_init(ncli);
+	if (znr.unix_path)
+		ncli->sd = accept(znr.listen_sd, NULL, NULL);
+	else
+		ncli->sd = accept(znr.listen_sd,
+				  (struct sockaddr *) &ncli->inaddr,
+				  &ncli->inaddrlen);
+	if (ncli->sd < 0) {
+		if (errno != EINTR)
+			znr_err("accept failed (%s)", strerror(errno));
+		ret = -errno;
+		goto close;
+	}
+
+	if (znr.unix_path) {
+		znr_net_set_local_peer(ncli);
+	} else {
+		inet_ntop(AF_INET, &ncli->inaddr.sin_addr, ncli->ip,
+			  INET_ADDRSTRLEN);
+		ncli->port = ntohs(ncli->inaddr.sin_port);
+	}
+
+	znr_net_setsockopt(ncli);
+
+	printf("Connection from %s:%d\n", ncli->ip, ncli->port);
+
+	return 0;
+
+close:
+	znr_net_listen_close();
+
+	return ret;
+}
+
+/*
+ * Execute a request for the local device or file system.
+ */
+static int znr_net_send_host_rep(struct znr_net_client *ncli,
+				 struct znr_net_req *req)
+{
+	switch (req->id) {
+	case ZNR_NET_MNTDIR_INFO:
+		return znr_net_send_mntdir_info_rep(ncli);
+	case ZNR_NET_DEV_INFO:
+		return znr_net_send_dev_info_rep(ncli);
+	case ZNR_NET_DEV_REP_ZONES:
+		return znr_net_send_dev_rep_zones_rep(ncli, req);
+	case ZNR_NET_FILE_EXTENTS:
+		return znr_net_send_file_extents_rep(ncli, req);
+	case ZNR_NET_EXTENTS_IN_RANGE:
+		return znr_net_send_extents_in_range_rep(ncli, req);
+	case ZNR_NET_BLOCKGROUPS:
+		return znr_net_send_blockgroups(ncli, req);
+	case ZNR_NET_BATCH:
+		return znr_net_send_batch_rep(ncli);
+	case ZNR_NET_RESUME:
+		return znr_net_send_resume_rep(ncli, req);
+	case ZNR_NET_QUERY:
+		return znr_net_send_query_rep(ncli, req);
+	default:
+		return -1;
+	}
+}
+
+/*
+ * Cancellation check of the request being executed: the client cancelled it if
+ * its next request is a ZNR_NET_CANCEL request, which is then received.
+ */
+static bool znr_net_cancelled(void *data)
+{
+	struct znr_net_client *ncli = data;
+	struct znr_net_varlen_req hdr;
+	struct znr_net_req req;
+	__u32 id32;
+	ssize_t ret;
+	__u32 id;
+
+	ret = recv(ncli->sd, &hdr, sizeof(hdr), MSG_PEEK | MSG_DONTWAIT);
+	if (ret != sizeof(hdr))
+		return false;
+
+	if (ntohl(hdr.magic) == ZNR_NET_VARLEN_MAGIC) {
+		id = ntohs(hdr.id);
+	} else if (ntohl(hdr.magic) == ZNR_NET_MAGIC) {
+		memcpy(&id32, &hdr.id, sizeof(id32));
+		id = ntohl(id32);
+	} else {
+		return false;
+	}
+
+	if ((id & ZNR_NET_REQ_ID_MASK) != ZNR_NET_CANCEL)
+		return false;
+
+	return znr_net_recv_req(ncli, &req) == 0;
+}
+
+static void znr_net_server(struct znr_net_client *ncli)
+{
+	unsigned long long start;
+	struct znr_net_req req;
+	int ret = 0;
+
+	printf("Waiting for client %s:%d requests\n",
+	       ncli->ip, ncli->port);
+
+	while (!znr.abort && !ret) {
+		/* Get a request */
+		ret = znr_net_recv_req(ncli, &req);
+		if (ret)
+			break;
+
+		/*
+		 * Credits sent by the client while the last chunk of a chunked
+		 * reply was in flight.
+		 */
+		if (req.id == ZNR_NET_CREDIT)
+			continue;
+
+		/* Cancellation of a request already completed */
+		if (req.id == ZNR_NET_CANCEL)
+			continue;
+
+		start = znr_stats_now_ns();
+		znr_cache_get_wait_ns();
+		znr_sched_get_wait_ns();
+		znr_cache_clear_stale();
+		znr_sched_begin(ncli->req_class,
+				ncli->features & ZNR_NET_FEAT_SCHED ?
+				znr_net_cancelled : NULL, ncli);
+
+		switch (req.id) {
+		case ZNR_NET_HELLO:
+			znr_net_close_upstream(ncli);
+			ret = znr_net_send_hello_rep(ncli);
+			break;
+		case ZNR_NET_SHM_MAP:
+			ret = znr_net_send_shm_map_rep(ncli);
+			break;
+		case ZNR_NET_STATS:
+			ret = znr_net_send_stats_rep(ncli);
+			break;
+		case ZNR_NET_FLEET:
+			ret = znr_net_send_fleet_rep(ncli);
+			break;
+		case ZNR_NET_SELECT_HOST:
+			ret = znr_net_send_select_host_rep(ncli, &req);
+			break;
+		default:
+			/* An aggregator forwards requests to the selected host */
+			if (znr_fleet_enabled())
+				ret = znr_net_forward_req(ncli, &req);
+			else
+				ret = znr_net_send_host_rep(ncli, &req);
+			break;
+		}
+
+		znr_sched_end();
+		znr_net_account_srv_req(ncli, req.id, start);
+	}
+
+	znr_net_close_upstream(ncli);
+}
+
+static void *znr_net_server_thread(void *arg)
+{
+	struct znr_net_client *ncli = arg, **pp;
+	sigset_t set;
+
+	/* Let the main thread handle signals. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	znr_net_server(ncli);
+
+	if (ncli->shm)
+		znr_shm_put();
+
+	pthread_mutex_lock(&znr_net_clients_lock);
+	znr_stats_merge(&znr_net_srv_stats, &ncli->stats);
+	znr_net_disconnect(ncli);
+	for (pp = &znr_net_clients; *pp; pp = &(*pp)->next) {
+		if (*pp == ncli) {
+			*pp = ncli->next;
+			break;
+		}
+	}
+	znr_net_nr_clients--;
+	pthread_cond_broadcast(&znr_net_clients_cond);
+	pthread_mutex_unlock(&znr_net_clients_lock);
+
+	free(ncli);
+
+	return NULL;
+}
+
+static int znr_net_start_server_thread(struct znr_net_client *ncli)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	int ret;
+
+	pthread_mutex_lock(&znr_net_clients_lock);
+
+	if (znr_net_nr_clients >= ZNR_NET_MAX_CLIENTS) {
+		pthread_mutex_unlock(&znr_net_clients_lock);
+		znr_err("Too many clients, rejecting %s:%d\n",
+			ncli->ip, ncli->port);
+		return -EBUSY;
+	}
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	ret = pthread_create(&thread, &attr, znr_net_server_thread, ncli);
+	pthread_attr_destroy(&attr);
+	if (ret) {
+		pthread_mutex_unlock(&znr_net_clients_lock);
+		znr_err("Failed to create server thread (%s)\n",
+			strerror(ret));
+		return -ret;
+	}
+
+	ncli->next = znr_net_clients;
+	znr_net_clients = ncli;
+	znr_net_nr_clients++;
+	znr_net_nr_connections++;
+
+	pthread_mutex_unlock(&znr_net_clients_lock);
+
+	return 0;
+}
+
+static void znr_net_stop_server_threads(void)
+{
+	struct znr_net_client *ncli;
+
+	pthread_mutex_lock(&znr_net_clients_lock);
+
+	/* Wake up the server threads waiting for requests. */
+	for (ncli = znr_net_clients; ncli; ncli = ncli->next)
+		shutdown(ncli->sd, SHUT_RDWR);
+
+	while (znr_net_nr_clients)
+		pthread_cond_wait(&znr_net_clients_cond,
+				  &znr_net_clients_lock);
+
+	pthread_mutex_unlock(&znr_net_clients_lock);
+}
+
+void znr_net_run_server(struct znr_net_client *ncli)
+{
+	struct znr_net_client *srv_ncli;
+	int ret;
+
+	znr_net_start_time = znr_stats_now_ns();
+
+	if (znr.connect) {
+		/* Connect to client. */
+		ret = znr_net_connect(ncli);
+		if (!ret) {
+			znr_net_nr_connections++;
+			znr_net_server(ncli);
+			znr_net_disconnect(ncli);
+		}
+		return;
+	}
+
+	/* Wait for client connections and serve each from its own thread. */
+	while (!znr.abort) {
+		srv_ncli = malloc(sizeof(*srv_ncli));
+		if (!srv_ncli) {
+			znr_err("No memory for client\n");
+			break;
+		}
+
+		ret = znr_net_listen(srv_ncli);
+		if (ret) {
+			free(srv_ncli);
+			break;
+		}
+
+		ret = znr_net_start_server_thread(srv_ncli);
+		if (ret) {
+			znr_net_disconnect(srv_ncli);
+			free(srv_ncli);
+		}
+	}
+
+	znr_net_stop_server_threads();
+	znr_net_listen_close();
+}
+
+/*
+ * Use the protocol parameters of a ZNR_NET_HELLO reply.
+ */
+static int znr_net_set_proto(struct znr_net_client *ncli,
+			     struct znr_net_hello *hello, size_t data_size)
+{
+	unsigned int compression;
+
+	if (data_size != sizeof(*hello)) {
+		znr_err("Invalid hello reply size (%zu != %zu)\n",
+			data_size, sizeof(*hello));
+		return -EPROTO;
+	}
+
+	compression = ntohl(hello->compression);
+	if (compression != ZNR_NET_COMP_NONE) {
+		znr_err("Unsupported compression %u\n", compression);
+		return -EPROTO;
+	}
+
+	ncli->version = ntohl(hello->version);
+	ncli->features = ntohl(hello->features) & ZNR_NET_FEATURES;
+	ncli->compression = compression;
+	ncli->native = (ncli->features & ZNR_NET_FEAT_NATIVE) &&
+		hello->byte_order == ZNR_NET_BYTE_ORDER;
+
+	znr_verbose("Protocol version %u, features 0x%08x, %s layout\n",
+		    ncli->version, ncli->features,
+		    ncli->native ? "native" : "network");
+
+	return 0;
+}
+
+/*
+ * Negotiate the protocol version and the features among @features.
+ */
+int znr_net_negotiate(struct znr_net_client *ncli, unsigned int features)
+{
+	struct znr_net_hello hello = {
+		.version = htonl(ZNR_NET_PROTO_VERSION),
+		.byte_order = ZNR_NET_BYTE_ORDER,
+		.features = htonl(features),
+		.compression = htonl(ZNR_NET_COMP_NONE),
+	};
+	struct znr_net_hello *rep_hello = NULL;
+	size_t data_size = 0;
+	int ret, err;
+
+	znr_verbose("Sending hello request\n");
+
+	ncli->version = ZNR_NET_PROTO_LEGACY;
+	ncli->features = 0;
+	ncli->compression = ZNR_NET_COMP_NONE;
+	ncli->native = false;
+
+	ret = znr_net_send_req(ncli, ZNR_NET_HELLO, 0, 0, 0, 0, NULL);
+	if (!ret)
+		ret = znr_net_send(ncli, (void *) &hello, sizeof(hello));
+	if (!ret)
+		ret = znr_net_recv_rep(ncli, ZNR_NET_HELLO, &err,
+				       (void **)&rep_hello, &data_size);
+	if (ret)
+		return ret;
+
+	if (err) {
+		znr_err("Protocol negotiation failed\n");
+		return -err;
+	}
+
+	ret = znr_net_set_proto(ncli, rep_hello, data_size);
+	free(rep_hello);
+
+	return ret;
+}
+
+int znr_net_hello(struct znr_net_client *ncli)
+{
+	int ret;
+
+	ret = znr_net_negotiate(ncli, znr.net_features);
+	if (ret == -ECONNRESET && (znr.connect || znr.listen)) {
+		/*
+		 * Servers predating ZNR_NET_HELLO drop the connection on
+		 * unknown requests: reconnect and use the legacy protocol.
+		 * In reverse mode, these servers exit once disconnected:
+		 * wait for the server to be started again.
+		 */
+		printf("Server does not support protocol negotiation, "
+		       "using legacy protocol\n");
+		znr_net_disconnect(ncli);
+		if (znr.listen) {
+			printf("Restart the server to connect again\n");
+			return znr_net_listen(ncli);
+		}
+		return znr_net_connect(ncli);
+	}
+
+	return ret;
+}
+
+int znr_net_map_shm(struct znr_net_client *ncli)
+{
+	struct znr_net_shm_map *shm_map = NULL;
+	size_t data_size = 0;
+	int ret, err, fd;
+
+	znr_verbose("Sending shared memory map request\n");
+
+	if (!ncli->local)
+		return -EOPNOTSUPP;
+
+	ret = znr_net_send_req(ncli, ZNR_NET_SHM_MAP, 0, 0, 0, 0, NULL);
+	if (ret)
+		return ret;
+
+	ret = znr_net_recv_rep(ncli, ZNR_NET_SHM_MAP, &err,
+			       (void **)&shm_map, &data_size);
+	if (ret)
+		return ret;
+
+	if (err) {
+		znr_err("Map shared memory failed (%s)\n", strerror(err));
+		return -err;
+	}
+
+	if (data_size != sizeof(*shm_map)) {
+		znr_err("Invalid shared memory map size (%zu != %zu)\n",
+			data_size, sizeof(*shm_map));
+		free(shm_map);
+		return -EPROTO;
+	}
+
+	fd = znr_net_recv_fd(ncli);
+	if (fd < 0) {
+		free(shm_map);
+		return fd;
+	}
+
+	ret = znr_shm_map(fd, znr_net_ntoh64(ncli, shm_map->size));
+	close(fd);
+	free(shm_map);
+	if (ret)
+		return ret;
+
+	ncli->shm = true;
+
+	return 0;
+}
+
+int znr_net_get_mntdir_info(struct znr_net_client *ncli)
+{
+	struct znr_net_mntdir_info *mntdir_info = NULL;
+	size_t data_size = 0;
+	int ret, err;
+
+	znr_verbose("Sending mntdir info request\n");
+
+	ret = znr_net_send_req(ncli, ZNR_NET_MNTDIR_INFO, 0, 0, 0, 0, NULL);
+	if (ret)
+		return ret;
+
+	ret = znr_net_recv_rep(ncli, ZNR_NET_MNTDIR_INFO, &err,
+			       (void **)&mntdir_info, &data_size);
+	if (ret)
+		return ret;
+
+	if (err) {
+		znr_err("Get mntdir info failed\n");
+		return -err;
+	}
+
+	if (data_size != sizeof(*mntdir_info)) {
+		znr_err("Invalid mntdir info size (%zu != %zu)\n",
+			data_size, sizeof(*mntdir_info));
+		ret = -1;
+		goto free;
+	}
+
+	znr.mnt_dir.path = strdup((char *)mntdir_info->mnt_path);
+	if (!znr.mnt_dir.path) {
+		znr_err("Get FS path failed\n");
+		ret = -1;
+		goto free;
+	}
+
+	znr.mnt_dir.fs = znr_fs_get_net(mntdir_info->fs_type);
+	if (!znr.mnt_dir.fs) {
+		znr_err("Get FS type failed\n");
+		ret = -1;
+	}
+
+free:
+	free(mntdir_info);
+
+	return ret;
+}
+
+/*
+ * Get the information of the server device into @dev and its path into
+ * @dev_path, which the caller must free.
+ */
+int znr_net_get_device(struct znr_net_client *ncli, struct znr_device *dev,
+		       char **dev_path)
+{
+	struct znr_net_dev_info *dev_info = NULL;
+	size_t data_size = 0;
+	int ret, err;
+
+	znr_verbose("Sending device info request\n");
+
+	ret = znr_net_send_req(ncli, ZNR_NET_DEV_INFO, 0, 0, 0, 0, NULL);
+	if (ret)
+		return ret;
+
+	ret = znr_net_recv_rep(ncli, ZNR_NET_DEV_INFO, &err,
+			       (void **)&dev_info, &data_size);
+	if (ret)
+		return ret;
+
+	if (err) {
+		znr_err("Get device info failed\n");
+		return -1;
+	}
+
+	if (data_size != sizeof(*dev_info)) {
+		znr_err("Invalid device info size (%zu != %zu)\n",
+			data_size, sizeof(dev_info));
+		ret = -1;
+		goto free;
+	}
+
+	*dev_path = strdup((char *)dev_info->path);
+	if (!*dev_path) {
+		znr_err("Failed to get device path\n");
+		ret = -ENOMEM;
+		goto free;
+	}
+
+	strncpy(dev->vendor_id, (char *)dev_info->vendor_id,
+		sizeof(dev->vendor_id));
+	dev->nr_sectors = znr_net_ntoh64(ncli, dev_info->nr_sectors);
+	ncli->dev_sectors = dev->nr_sectors;
+	dev->nr_lblocks = znr_net_ntoh64(ncli, dev_info->nr_lblocks);
+	dev->nr_pblocks = znr_net_ntoh64(ncli, dev_info->nr_pblocks);
+	dev->zone_size = znr_net_ntoh64(ncli, dev_info->zone_size);
+	dev->zone_sectors = znr_net_ntoh32(ncli, dev_info->zone_sectors);
+	dev->lblock_size = znr_net_ntoh32(ncli, dev_info->lblock_size);
+	dev->pblock_size = znr_net_ntoh32(ncli, dev_info->pblock_size);
+	dev->nr_zones = znr_net_ntoh32(ncli, dev_info->nr_zones);
+	dev->max_nr_open_zones =
+		znr_net_ntoh32(ncli, dev_info->max_nr_open_zones);
+	dev->max_nr_active_zones =
+		znr_net_ntoh32(ncli, dev_info->max_nr_active_zones);
+	dev->is_zoned = dev_info->is_zoned;
+
+free:
+	free(dev_info);
+
+	return ret;
+}
+
+int znr_net_get_dev_info(struct znr_net_client *ncli)
+{
+	return znr_net_get_device(ncli, &znr.dev, &znr.dev_path);
+}
+
+int znr_net_get_dev_rep_zones(struct znr_net_client *ncli,
+			      unsigned int zno,
+			      struct blk_zone *zones, unsigned int nr_zones)
+{
+	void *data = NULL;
+	struct blk_zone *blkz;
+	size_t data_size = 0;
+	unsigned int i;
+	int err, ret = 0;
+
+	/* Local clients read zone information from shared memory. */
+	if (ncli->shm) {
+		ret = znr_shm_report_zones(zno, zones, nr_zones);
+		if (ret != -EAGAIN)
+			return ret;
+	}
+
+	znr_verbose("Sending zone report request (from %u, %u zones)\n",
+		    zno, nr_zones);
+
+	ret = znr_net_send_req(ncli, ZNR_NET_DEV_REP_ZONES,
+			       zno, nr_zones, 0, 0, NULL);
+	if (ret)
+		return ret;
+
+	ret = znr_net_recv_rep(ncli, ZNR_NET_DEV_REP_ZONES, &err,
+			       &data, &data_size);
+	if (ret)
+		return ret;
+
+	if (err) {
+		znr_err("Get report zones failed\n");
+		return -1;
+	}
+
+	if (data_size != sizeof(struct blk_zone) * nr_zones) {
+		znr_err("Invalid number of zones in report\n");
+		ret = -1;
+		goto free;
+	}
+
+	znr_verbose("Zone report: %u zones from zone %u\n",
+		    nr_zones, zno);
+
+	if (ncli->native) {
+		memcpy(zones, data, data_size);
+		goto free;
+	}
+
+	blkz = data;
+	for (i = 0; i < nr_zones; i++, blkz++, zones++) {
+		zones->start = ntohll(blkz->start);
+		zones->len = ntohll(blkz->len);
+		zones->wp = ntohll(blkz->wp);
+		zones->type = blkz->type;
+		zones->cond = blkz->cond;
+		zones->non_seq = blkz->non_seq;
+		zones->reset = blkz->reset;
+		zones->capacity = ntohll(blkz->capacity);
+	}
+
+free:
+	free(data);
+
+	if (ret)
+		return ret;
+	return nr_zones;
+}
+
+/*
+ * Receive the next reply of the extents request being received and pass its
+ * extents to the stream callback. For chunked replies, the server is credited
+ * every ZNR_NET_CHUNK_WINDOW / 2 chunks received. Return 1 if more replies
+ * follow, 0 once the last one is received and a negative error code otherwise.
+ */
+int znr_net_stream_poll(struct znr_net_client *ncli)
+{
+	struct znr_extent *ext = NULL;
+	unsigned int flags, nr_ext;
+	size_t data_size;
+	int ret, err;
+
+	if (!ncli->stream_id)
+		return 0;
+
+	ret = __znr_net_recv_rep(ncli, ncli->stream_id, &err,
+				 (void **)&ext, &data_size, &flags, true);
+	if (ret)
+		goto end;
+
+	if (err) {
+		ret = -err;
+		goto end;
+	}
+
+	if (data_size % sizeof(struct znr_extent)) {
+		znr_err("Data size is not aligned to struct znr_extent\n");
+		free(ext);
+		ret = -EPROTO;
+		goto end;
+	}
+
+	nr_ext = data_size / sizeof(struct znr_extent);
+	znr_net_ntoh_extents(ncli, ext, nr_ext);
+
+	/* On error, stop passing extents but receive the entire reply. */
+	if (nr_ext && ncli->stream_cb) {
+		ret = ncli->stream_cb(ext, nr_ext, ncli->stream_data);
+		if (ret) {
+			ncli->stream_err = ret;
+			ncli->stream_cb = NULL;
+			ret = 0;
+		}
+	}
+
+	free(ext);
+
+	if (!(flags & ZNR_NET_REP_CHUNK) || (flags & ZNR_NET_REP_LAST))
+		goto end;
+
+	ncli->stream_credits++;
+	if (ncli->stream_credits >= ZNR_NET_CHUNK_WINDOW / 2) {
+		ret = znr_net_send_req(ncli, ZNR_NET_CREDIT, 0,
+				       ncli->stream_credits, 0, 0, NULL);
+		if (ret)
+			goto end;
+		ncli->stream_credits = 0;
+	}
+
+	return 1;
+
+end:
+	if (!ret)
+		ret = ncli->stream_err;
+
+	ncli->stream_id = 0;
+	ncli->stream_cb = NULL;
+	ncli->stream_data = NULL;
+	ncli->stream_err = 0;
+	ncli->stream_credits = 0;
+
+	return ret;
+}
+
+/*
+ * Stop passing the extents of the reply being received to the stream
+ * callback. The remaining replies are discarded.
+ */
+void znr_net_stream_detach(struct znr_net_client *ncli)
+{
+	ncli->stream_cb = NULL;
+	ncli->stream_data = NULL;
+}
+
+/*
+ * Detach the stream and, if the server supports it, cancel the extents
+ * request being received so that the server stops walking the file system
+ * for it. The remaining replies, ending with an ECANCELED error reply, are
+ * discarded.
+ */
+void znr_net_stream_cancel(struct znr_net_client *ncli)
+{
+	znr_net_stream_detach(ncli);
+
+	if (!ncli->stream_id || !(ncli->features & ZNR_NET_FEAT_SCHED))
+		return;
+
+	znr_verbose("Cancelling %s request\n",
+		    znr_net_req_name(ncli->stream_id));
+
+	znr_net_send_req(ncli, ZNR_NET_CANCEL, 0, 0, 0, 0, NULL);
+}
+
+static int znr_net_stream_drain(struct znr_net_client *ncli)
+{
+	int ret;
+
+	do {
+		ret = znr_net_stream_poll(ncli);
+	} while (ret > 0);
+
+	return ret;
+}
+
+/*
+ * Start receiving the reply to an extents request, passing the extents of
+ * the first reply to @cb.
+ */
+static int znr_net_stream_start(struct znr_net_client *ncli,
+				enum znr_net_req_id id,
+				znr_fs_extents_cb cb, void *data)
+{
+	ncli->stream_id = id;
+	ncli->stream_cb = cb;
+	ncli->stream_data = data;
+	ncli->stream_err = 0;
+	ncli->stream_credits = 0;
+
+	return znr_net_stream_poll(ncli);
+}
+
+int znr_net_get_file_extents(struct znr_net_client *ncli, char *path,
+			     struct znr_extent **extents,
+			     unsigned int *nr_extents)
+{
+	struct znr_fs_extents fe = { };
+	int ret;
+
+	znr_verbose("Sending file %s extent request\n", path);
+
+	*extents = NULL;
+	*nr_extents = 0;
+
+	if (!path || !strlen(path)) {
+		znr_err("Invalid file path\n");
+		return -1;
+	}
+	ret = znr_net_send_req(ncli, ZNR_NET_FILE_EXTENTS, 0, 0, 0, 0, path);
+	if (ret)
+		return ret;
+
+	ret = znr_net_stream_start(ncli, ZNR_NET_FILE_EXTENTS,
+				   znr_fs_collect_extents, &fe);
+	if (ret > 0)
+		ret = znr_net_stream_drain(ncli);
+	if (ret) {
+		znr_err("Get file %s extents failed\n", path);
+		free(fe.extents);
+		return ret;
+	}
+
+	*extents = fe.extents;
+	*nr_extents = fe.nr_extents;
+
+	znr_verbose("File %s: %u extents\n", path, fe.nr_extents);
+
+	return 0;
+}
+
+int znr_net_start_extents_in_range(struct znr_net_client *ncli,
+				   unsigned long long sector,
+				   unsigned long long nr_sectors,
+				   znr_fs_extents_cb cb, void *data)
+{
+	int ret;
+
+	znr_verbose("Sending extent request in range %llu + %llu\n",
+		    sector, nr_sectors);
+
+	if (sector >= ncli->dev_sectors ||
+	    sector + nr_sectors > ncli->dev_sectors) {
+		znr_err("Invalid sector range %llu + %llu\n",
+			sector, nr_sectors);
+		return -EINVAL;
+	}
+
+	ret = znr_net_send_req(ncli, ZNR_NET_EXTENTS_IN_RANGE, 0, 0,
+			       sector, nr_sectors, NULL);
+	if (ret)
+		return ret;
+
+	ret = znr_net_stream_start(ncli, ZNR_NET_EXTENTS_IN_RANGE, cb, data);
+	if (ret < 0)
+		znr_err("Get extent range %llu + %llu reply failed\n",
+			sector, nr_sectors);
+
+	return ret;
+}
+
+int znr_net_walk_extents_in_range(struct znr_net_client *ncli,
+				  unsigned long long sector,
+				  unsigned long long nr_sectors,
+				  znr_fs_extents_cb cb, void *data)
+{
+	int ret;
+
+	ret = znr_net_start_extents_in_range(ncli, sector, nr_sectors,
+					     cb, data);
+	if (ret > 0)
+		ret = znr_net_stream_drain(ncli);
+
+	return ret;
+}
+
+int znr_net_get_extents_in_range(struct znr_net_client *ncli,
+				 unsigned long long sector,
+				 unsigned long long nr_sectors,
+				 struct znr_extent **extents,
+				 unsigned int *nr_extents)
+{
+	struct znr_fs_extents fe = { };
+	int ret;
+
+	*extents = NULL;
+	*nr_extents = 0;
+
+	ret = znr_net_walk_extents_in_range(ncli, sector, nr_sectors,
+					    znr_fs_collect_extents, &fe);
 	if (ret) {
-		znr_err("connect failed (%s)", strerror(errno));
-		znr_net_disconnect(ncli);
+		free(fe.extents);
 		return ret;
 	}
 
-	znr_net_setsockopt(ncli);
+	*extents = fe.extents;
+	*nr_extents = fe.nr_extents;
+
+	znr_verbose("Sector range %llu + %llu: %u extents\n",
+		    sector, nr_sectors, fe.nr_extents);
 
 	return 0;
 }
 
-static void znr_net_listen_close(void)
+/*
+ * Evaluate the query @q on the extents of a sector range. Without grouping,
+ * the extents matching are passed to the query callback. With grouping, the
+ * query groups are set. Servers not supporting queries send all the extents
+ * of the range, on which the query is then evaluated locally.
+ */
+int znr_net_query(struct znr_net_client *ncli,
+		  unsigned long long sector, unsigned long long nr_sectors,
+		  struct znr_query *q)
 {
-	if (znr.listen_sd > 0) {
-		close(znr.listen_sd);
-		znr.listen_sd = -1;
+	size_t data_size = 0, i;
+	__u64 *val = NULL;
+	int ret, err;
+
+	znr_verbose("Sending query \"%s\" on %llu + %llu\n",
+		    q->str, sector, nr_sectors);
+
+	if (!(ncli->features & ZNR_NET_FEAT_QUERY)) {
+		ret = znr_net_walk_extents_in_range(ncli, sector, nr_sectors,
+						    znr_query_extents, q);
+		if (!ret && q->group)
+			znr_query_finish(q);
+		return ret;
+	}
+
+	if (sector >= ncli->dev_sectors ||
+	    sector + nr_sectors > ncli->dev_sectors) {
+		znr_err("Invalid sector range %llu + %llu\n",
+			sector, nr_sectors);
+		return -EINVAL;
+	}
+
+	ret = znr_net_send_req(ncli, ZNR_NET_QUERY, 0, 0,
+			       sector, nr_sectors, q->str);
+	if (ret)
+		return ret;
+
+	if (!q->group) {
+		ret = znr_net_stream_start(ncli, ZNR_NET_QUERY, q->cb, q->data);
+		if (ret > 0)
+			ret = znr_net_stream_drain(ncli);
+		return ret;
 	}
+
+	ret = znr_net_recv_rep(ncli, ZNR_NET_QUERY, &err,
+			       (void **)&val, &data_size);
+	if (ret)
+		return ret;
+
+	if (err) {
+		znr_err("Query failed (%s)\n", strerror(err));
+		return -err;
+	}
+
+	if (data_size % sizeof(struct znr_query_group)) {
+		znr_err("Invalid query groups size %zu\n", data_size);
+		free(val);
+		return -EPROTO;
+	}
+
+	for (i = 0; i < data_size / sizeof(__u64); i++)
+		val[i] = znr_net_ntoh64(ncli, val[i]);
+
+	free(q->groups);
+	q->groups = (struct znr_query_group *)val;
+	q->nr_groups = data_size / sizeof(struct znr_query_group);
+	q->max_groups = 0;
+
+	return 0;
 }
 
-int znr_net_listen(struct znr_net_client *ncli)
+/*
+ * Build the request data of a batch.
+ */
+static void *znr_net_build_batch(struct znr_net_client *ncli,
+				 struct znr_batch_req *reqs,
+				 unsigned int nr_reqs, size_t *size)
 {
-	struct sockaddr_in bindaddr;
-	int val, ret;
+	struct znr_net_batch_req breq;
+	struct znr_net_batch *batch;
+	size_t path_len, ofst;
+	unsigned int i;
+	void *data;
+
+	*size = 0;
+	for (i = 0; i < nr_reqs; i++) {
+		*size += sizeof(breq);
+		if (reqs[i].path) {
+			path_len = strlen(reqs[i].path);
+			if (path_len >= PATH_MAX)
+				return NULL;
+			*size += (path_len + 7) & ~7UL;
+		}
+	}
 
-	if (!znr.listen_sd) {
-		znr.listen_port = znr_net_get_port();
-		if (znr.listen_port < 0)
-			return znr.listen_port;
+	data = calloc(1, sizeof(*batch) + *size);
+	if (!data)
+		return NULL;
 
-		znr.listen_sd = socket(PF_INET, SOCK_STREAM, 0);
-		if (znr.listen_sd < 0) {
-			znr_err("socket failed (%s)", strerror(errno));
-			return -1;
+	batch = data;
+	batch->nr_reqs = znr_net_hton32(ncli, nr_reqs);
+	batch->size = znr_net_hton32(ncli, *size);
+
+	ofst = sizeof(*batch);
+	for (i = 0; i < nr_reqs; i++) {
+		path_len = reqs[i].path ? strlen(reqs[i].path) : 0;
+		breq.type = znr_net_hton32(ncli, reqs[i].type);
+		breq.path_len = znr_net_hton32(ncli, path_len);
+		breq.start = znr_net_hton64(ncli, reqs[i].start);
+		breq.len = znr_net_hton64(ncli, reqs[i].len);
+		memcpy(data + ofst, &breq, sizeof(breq));
+		ofst += sizeof(breq);
+		if (path_len) {
+			memcpy(data + ofst, reqs[i].path, path_len);
+			ofst += (path_len + 7) & ~7UL;
 		}
+	}
 
-		val = 1;
-		ret = setsockopt(znr.listen_sd, SOL_SOCKET, SO_REUSEADDR,
-				 &val, sizeof(int));
-		if (ret) {
-			znr_err("setsockopt failed (%s)", strerror(errno));
-			goto close;
+	*size += sizeof(*batch);
+
+	return data;
+}
+
+/*
+ * Parse the reply of a batch, setting the result of each sub-request.
+ */
+static int znr_net_parse_batch_rep(struct znr_net_client *ncli,
+				   void *data, size_t size,
+				   struct znr_batch_req *reqs,
+				   unsigned int nr_reqs)
+{
+	struct znr_net_batch_rep brep;
+	size_t ofst = 0, elem_size;
+	unsigned int i;
+	void *buf;
+
+	for (i = 0; i < nr_reqs; i++) {
+		if (size - ofst < sizeof(brep))
+			return -EPROTO;
+		memcpy(&brep, data + ofst, sizeof(brep));
+		ofst += sizeof(brep);
+
+		brep.type = znr_net_ntoh32(ncli, brep.type);
+		brep.err = znr_net_ntoh32(ncli, brep.err);
+		brep.nr = znr_net_ntoh32(ncli, brep.nr);
+		brep.data_size = znr_net_ntoh32(ncli, brep.data_size);
+
+		if (reqs[i].type == ZNR_BATCH_ZONES)
+			elem_size = sizeof(struct blk_zone);
+		else
+			elem_size = sizeof(struct znr_extent);
+		if (brep.type != reqs[i].type ||
+		    brep.data_size != (size_t)brep.nr * elem_size ||
+		    size - ofst < brep.data_size)
+			return -EPROTO;
+
+		reqs[i].err = brep.err;
+		reqs[i].nr = brep.nr;
+		if (!brep.nr) {
+			ofst += brep.data_size;
+			continue;
 		}
 
-		memset(&bindaddr, 0, sizeof(bindaddr));
-		bindaddr.sin_family = PF_INET;
-		bindaddr.sin_port = htons(znr.listen_port);
-		ret = bind(znr.listen_sd, (struct sockaddr *) &bindaddr,
-			   sizeof(struct sockaddr_in));
-		if (ret) {
-			znr_err("bind failed (%s)", strerror(errno));
-			ret = -errno;
-			goto close;
+		buf = malloc(brep.data_size);
+		if (!buf)
+			return -ENOMEM;
+		memcpy(buf, data + ofst, brep.data_size);
+		ofst += brep.data_size;
+
+		if (reqs[i].type == ZNR_BATCH_ZONES) {
+			reqs[i].zones = buf;
+			znr_net_ntoh_zones(ncli, reqs[i].zones, brep.nr);
+		} else {
+			reqs[i].extents = buf;
+			znr_net_ntoh_extents(ncli, reqs[i].extents, brep.nr);
 		}
+	}
 
-		/* Listen for connections. */
-		if (listen(znr.listen_sd, 1) < 0) {
-			znr_err("listen failed (%s)", strerror(errno));
-			ret = -errno;
-			goto close;
+	if (ofst != size)
+		return -EPROTO;
+
+	return 0;
+}
+
+/*
+ * Receive the reply of a batch, chunked or not. A chunked reply starts with the
+ * total size of its data, so that the data of all its chunks is concatenated
+ * into a buffer allocated once. The server is credited every
+ * ZNR_NET_CHUNK_WINDOW / 2 chunks.
+ */
+static int znr_net_recv_batch_rep(struct znr_net_client *ncli, int *err,
+				  void **data, size_t *data_size)
+{
+	unsigned int flags, credits = 0;
+	struct znr_net_chunked_batch cb;
+	size_t chunk_size, size = 0, total = 0;
+	void *chunk, *p, *buf = NULL;
+	int ret, alloc_err = 0;
+	bool first = true;
+
+	*data = NULL;
+	*data_size = 0;
+
+	for (;;) {
+		ret = __znr_net_recv_rep(ncli, ZNR_NET_BATCH, err,
+					 &chunk, &chunk_size, &flags, true);
+		if (ret || *err)
+			goto free;
+
+		if (!(flags & ZNR_NET_REP_CHUNK)) {
+			/* Single reply: use its data as is */
+			*data = chunk;
+			*data_size = chunk_size;
+			return 0;
 		}
 
-		printf("Listening for connections on port %d...\n",
-		       znr.listen_port);
-	}
+		/* On error, keep receiving the entire reply. */
+		p = chunk;
+		if (first && !alloc_err) {
+			if (chunk_size < sizeof(cb)) {
+				alloc_err = -EPROTO;
+			} else {
+				memcpy(&cb, chunk, sizeof(cb));
+				total = znr_net_ntoh64(ncli, cb.size);
+				p += sizeof(cb);
+				chunk_size -= sizeof(cb);
+				buf = malloc(total ? total : 1);
+				if (!buf)
+					alloc_err = -ENOMEM;
+			}
+		}
+		first = false;
+
+		if (chunk_size && !alloc_err) {
+			if (chunk_size > total - size) {
+				alloc_err = -EPROTO;
+			} else {
+				memcpy(buf + size, p, chunk_size);
+				size += chunk_size;
+			}
+		}
+		free(chunk);
 
-	znr_net_client_init(ncli);
-	ncli->sd = accept(znr.listen_sd,
-			  (struct sockaddr *) &ncli->inaddr,
-			  &ncli->inaddrlen);
-	if (ncli->sd < 0) {
-		if (errno != EINTR)
-			znr_err("accept failed (%s)", strerror(errno));
-		ret = -errno;
-		goto close;
-	}
+		if (flags & ZNR_NET_REP_LAST)
+			break;
 
-	inet_ntop(AF_INET, &ncli->inaddr.sin_addr, ncli->ip,
-		  INET_ADDRSTRLEN);
-	ncli->port = ntohs(ncli->inaddr.sin_port);
+		credits++;
+		if (credits >= ZNR_NET_CHUNK_WINDOW / 2) {
+			ret = znr_net_send_req(ncli, ZNR_NET_CREDIT, 0,
+					       credits, 0, 0, NULL);
+			if (ret)
+				goto free;
+			credits = 0;
+		}
+	}
 
-	znr_net_setsockopt(ncli);
+	if (!alloc_err && size != total)
+		alloc_err = -EPROTO;
+	if (alloc_err) {
+		ret = alloc_err;
+		goto free;
+	}
 
-	printf("Connection from %s:%d\n", ncli->ip, ncli->port);
+	*data = buf;
+	*data_size = size;
 
 	return 0;
 
-close:
-	znr_net_listen_close();
-
+free:
+	free(buf);
 	return ret;
 }
 
-static void znr_net_server(struct znr_net_client *ncli)
+int znr_net_batch(struct znr_net_client *ncli,
+		  struct znr_batch_req *reqs, unsigned int nr_reqs)
 {
-	struct znr_net_req req;
-	int ret = 0;
+	void *data = NULL;
+	size_t data_size;
+	unsigned int i;
+	int ret, err;
 
-	printf("Waiting for client %s:%d requests\n",
-	       ncli->ip, ncli->port);
+	znr_verbose("Sending batch request (%u requests)\n", nr_reqs);
 
-	while (!znr.abort && !ret) {
-		/* Get a request */
-		ret = znr_net_recv_req(ncli, &req);
-		if (ret)
-			break;
+	for (i = 0; i < nr_reqs; i++) {
+		reqs[i].err = 0;
+		reqs[i].zones = NULL;
+		reqs[i].extents = NULL;
+		reqs[i].nr = 0;
+	}
 
-		switch (req.id) {
-		case ZNR_NET_MNTDIR_INFO:
-			ret = znr_net_send_mntdir_info_rep(ncli);
-			break;
-		case ZNR_NET_DEV_INFO:
-			ret = znr_net_send_dev_info_rep(ncli);
-			break;
-		case ZNR_NET_DEV_REP_ZONES:
-			ret = znr_net_send_dev_rep_zones_rep(ncli, &req);
-			break;
-		case ZNR_NET_FILE_EXTENTS:
-			ret = znr_net_send_file_extents_rep(ncli, &req);
-			break;
-		case ZNR_NET_EXTENTS_IN_RANGE:
-			ret = znr_net_send_extents_in_range_rep(ncli, &req);
-			break;
-		case ZNR_NET_BLOCKGROUPS:
-			ret = znr_net_send_blockgroups(ncli, &req);
-			break;
-		default:
-			ret = -1;
-			break;
-		}
+	data = znr_net_build_batch(ncli, reqs, nr_reqs, &data_size);
+	if (!data)
+		return -ENOMEM;
+
+	ret = znr_net_send_req(ncli, ZNR_NET_BATCH, 0, 0, 0, 0, NULL);
+	if (!ret)
+		ret = znr_net_send(ncli, data, data_size);
+	free(data);
+	data = NULL;
+	if (ret)
+		return ret;
+
+	ret = znr_net_recv_batch_rep(ncli, &err, &data, &data_size);
+	if (ret)
+		return ret;
+
+	if (err) {
+		znr_err("Batch request failed (%s)\n", strerror(err));
+		return -err;
+	}
+
+	ret = znr_net_parse_batch_rep(ncli, data, data_size, reqs, nr_reqs);
+	if (ret) {
+		znr_err("Invalid batch reply\n");
+		znr_batch_clear(reqs, nr_reqs);
 	}
+
+	free(data);
+
+	return ret;
 }
 
-void znr_net_run_server(struct znr_net_client *ncli)
+/*
+ * Receive the blockgroups geometry and build the blockgroups array from it.
+ */
+static int znr_net_recv_compact_blockgroups(struct znr_net_client *ncli,
+					    struct znr_bg **blockgroups,
+					    unsigned int *nr_blockgroups)
 {
-	int ret;
+	struct znr_net_bg_geometry *geo = NULL;
+	unsigned int nr_bgs, nr_runs, i, j, idx = 0;
+	struct znr_net_bg_run *run;
+	unsigned long long sector, nr_sectors;
+	struct znr_bg *bg = NULL;
+	size_t data_size = 0;
+	int ret, err;
 
-	if (znr.connect) {
-		/* Connect to client. */
-		ret = znr_net_connect(ncli);
-		if (!ret) {
-			znr_net_server(ncli);
-			znr_net_disconnect(ncli);
-		}
-		return;
+	ret = znr_net_recv_rep(ncli, ZNR_NET_BLOCKGROUPS, &err,
+			       (void **)&geo, &data_size);
+	if (ret)
+		return ret;
+
+	if (err) {
+		fprintf(stderr, "Get blockgroups information failed\n");
+		return -1;
 	}
 
-	/* Wait for client connections. */
-	while (!znr.abort) {
-		ret = znr_net_listen(ncli);
-		if (ret)
-			break;
+	if (data_size < sizeof(*geo)) {
+		ret = -EPROTO;
+		goto free;
+	}
 
-		znr_net_server(ncli);
-		znr_net_disconnect(ncli);
+	nr_bgs = znr_net_ntoh32(ncli, geo->nr_blockgroups);
+	nr_runs = znr_net_ntoh32(ncli, geo->nr_runs);
+	if (!nr_bgs || nr_runs > nr_bgs ||
+	    data_size != sizeof(*geo) + nr_runs * sizeof(*run)) {
+		ret = -EPROTO;
+		goto free;
 	}
 
-	znr_net_disconnect(ncli);
-	znr_net_listen_close();
+	bg = calloc(nr_bgs, sizeof(struct znr_bg));
+	if (!bg) {
+		ret = -ENOMEM;
+		goto free;
+	}
+
+	run = (struct znr_net_bg_run *)(geo + 1);
+	for (i = 0; i < nr_runs; i++, run++) {
+		sector = znr_net_ntoh64(ncli, run->sector);
+		nr_sectors = znr_net_ntoh64(ncli, run->nr_sectors);
+		for (j = 0; j < znr_net_ntoh32(ncli, run->nr_blockgroups); j++) {
+			if (idx >= nr_bgs) {
+				ret = -EPROTO;
+				goto free;
+			}
+			bg[idx].sector = sector;
+			bg[idx].nr_sectors = nr_sectors;
+			sector += nr_sectors;
+			idx++;
+		}
+	}
+
+	if (idx != nr_bgs) {
+		ret = -EPROTO;
+		goto free;
+	}
+
+	znr_verbose("Get blockgroups: retrieved %u blockgroups (%u runs)\n",
+		    nr_bgs, nr_runs);
+
+	*blockgroups = bg;
+	*nr_blockgroups = nr_bgs;
+	bg = NULL;
+	ret = nr_bgs;
+
+free:
+	if (ret == -EPROTO)
+		fprintf(stderr, "Invalid blockgroups information received\n");
+	free(bg);
+	free(geo);
+
+	return ret;
 }
 
-int znr_net_get_mntdir_info(struct znr_net_client *ncli)
+int znr_net_get_blockgroups(struct znr_net_client *ncli,
+			    struct znr_bg **blockgroups,
+			    unsigned int *nr_blockgroups)
 {
-	struct znr_net_mntdir_info *mntdir_info = NULL;
+	void *data = NULL;
 	size_t data_size = 0;
-	int ret, err;
+	struct znr_bg *bg;
+	unsigned int i;
+	int err, ret;
 
-	znr_verbose("Sending mntdir info request\n");
+	znr_verbose("Sending get blockgroup information\n");
 
-	ret = znr_net_send_req(ncli, ZNR_NET_MNTDIR_INFO, 0, 0, 0, 0, NULL);
-	if (ret)
-		return ret;
+	if (!nr_blockgroups || !blockgroups)
+		return -EINVAL;
 
-	ret = znr_net_recv_rep(ncli, ZNR_NET_MNTDIR_INFO, &err,
-			       (void **)&mntdir_info, &data_size);
+	if (ncli->shm) {
+		ret = znr_shm_get_blockgroups(blockgroups, nr_blockgroups);
+		if (ret != -EAGAIN)
+			return ret;
+	}
+
+	ret = znr_net_send_req(ncli, ZNR_NET_BLOCKGROUPS, 0, 0, 0, 0, NULL);
 	if (ret)
 		return ret;
 
-	if (err) {
-		znr_err("Get mntdir info failed\n");
-		return -err;
+	if (ncli->features & ZNR_NET_FEAT_COMPACT_BG)
+		return znr_net_recv_compact_blockgroups(ncli, blockgroups,
+							nr_blockgroups);
+
+	/* First receive the number of blockgroups */
+	ret = __znr_net_recv_rep(ncli, ZNR_NET_BLOCKGROUPS, &err,
+				 &data, &data_size, NULL, false);
+	if (ret) {
+		fprintf(stderr, "Get number of blockgroups failed\n");
+		return ret;
 	}
 
-	if (data_size != sizeof(*mntdir_info)) {
-		znr_err("Invalid mntdir info size (%zu != %zu)\n",
-			data_size, sizeof(*mntdir_info));
-		ret = -1;
+	if (data_size != sizeof(*nr_blockgroups)) {
+		fprintf(stderr, "Number of blockgroups, receive error\n");
+		ret = -EINVAL;
 		goto free;
 	}
 
-	znr.mnt_dir.path = strdup((char *)mntdir_info->mnt_path);
-	if (!znr.mnt_dir.path) {
-		znr_err("Get FS path failed\n");
-		ret = -1;
+	*nr_blockgroups = *((unsigned int *)data);
+	free(data);
+
+	znr_verbose("Get blockgroups: attempting to retrieve  %u blockgroups\n",
+		    *nr_blockgroups);
+	/* Get blockgroups data */
+	ret = znr_net_recv_rep(ncli, ZNR_NET_BLOCKGROUPS, &err,
+			       &data, &data_size);
+	if (ret) {
+		fprintf(stderr, "Get blockgroups information failed\n");
+		return ret;
+	}
+
+	if (data_size != sizeof(struct znr_bg) * (*nr_blockgroups)) {
+		fprintf(stderr, "Invalid blockgroups information received\n");
+		ret = -EINVAL;
 		goto free;
 	}
 
-	znr.mnt_dir.fs = znr_fs_get_net(mntdir_info->fs_type);
-	if (!znr.mnt_dir.fs) {
-		znr_err("Get FS type failed\n");
-		ret = -1;
+	znr_verbose("Get blockgroups: retrieved %u blockgroups\n",
+		    *nr_blockgroups);
+
+	bg = data;
+	/* It is the callers responsibility to free this memory */
+	*blockgroups = bg;
+	for (i = 0; i < *nr_blockgroups && !ncli->native; i++, bg++) {
+		bg->sector = ntohll(bg->sector);
+		bg->nr_sectors = ntohll(bg->nr_sectors);
+		bg->wp_sector = ntohll(bg->wp_sector);
+		bg->flags = ntohl(bg->flags);
 	}
 
+	return (int)*nr_blockgroups;
 free:
-	free(mntdir_info);
+	free(data);
 
 	return ret;
 }
 
-int znr_net_get_dev_info(struct znr_net_client *ncli)
+int znr_net_get_stats(struct znr_net_client *ncli,
+		      struct znr_net_stats *srv_stats,
+		      struct znr_stats *stats,
+		      struct znr_sched_stats *sched_stats)
 {
-	struct znr_device *dev = &znr.dev;
-	struct znr_net_dev_info *dev_info = NULL;
-	size_t data_size = 0;
+	struct znr_net_stats *rep_stats = NULL;
+	size_t data_size = 0, nr_reqs, sched_size = 0, i;
+	__u64 *val;
 	int ret, err;
 
-	znr_verbose("Sending device info request\n");
+	znr_verbose("Sending statistics request\n");
 
-	ret = znr_net_send_req(ncli, ZNR_NET_DEV_INFO, 0, 0, 0, 0, NULL);
+	ret = znr_net_send_req(ncli, ZNR_NET_STATS, 0, 0, 0, 0, NULL);
 	if (ret)
 		return ret;
 
-	ret = znr_net_recv_rep(ncli, ZNR_NET_DEV_INFO, &err,
-			       (void **)&dev_info, &data_size);
+	ret = znr_net_recv_rep(ncli, ZNR_NET_STATS, &err,
+			       (void **)&rep_stats, &data_size);
 	if (ret)
 		return ret;
 
 	if (err) {
-		znr_err("Get device info failed\n");
-		return -1;
+		znr_err("Get statistics failed (%s)\n", strerror(err));
+		return -err;
 	}
 
-	if (data_size != sizeof(*dev_info)) {
-		znr_err("Invalid device info size (%zu != %zu)\n",
-			data_size, sizeof(dev_info));
-		ret = -1;
+	if (data_size < sizeof(*rep_stats) || data_size % sizeof(__u64)) {
+		znr_err("Invalid statistics size %zu\n", data_size);
+		ret = -EPROTO;
 		goto free;
 	}
 
-	znr.dev_path = strdup((char *)dev_info->path);
-	if (!znr.dev_path) {
-		znr_err("Failed to get device path\n");
+	val = (void *)rep_stats;
+	for (i = 0; i < data_size / sizeof(__u64); i++)
+		val[i] = znr_net_ntoh64(ncli, val[i]);
+
+	if (ncli->features & ZNR_NET_FEAT_SCHED)
+		sched_size = sizeof(struct znr_sched_stats) *
+			ZNR_SCHED_NR_CLASSES;
+
+	nr_reqs = rep_stats->nr_reqs;
+	if (rep_stats->nr_phases != ZNR_STATS_NR_PHASES ||
+	    rep_stats->nr_buckets != ZNR_STATS_NR_BUCKETS ||
+	    data_size != sizeof(*rep_stats) +
+			 nr_reqs * sizeof(struct znr_stats_req) + sched_size) {
+		znr_err("Unsupported statistics format\n");
+		ret = -EPROTO;
 		goto free;
 	}
 
-	strncpy(dev->vendor_id, (char *)dev_info->vendor_id,
-		sizeof(dev->vendor_id));
-	dev->nr_sectors = ntohll(dev_info->nr_sectors);
-	dev->nr_lblocks = ntohll(dev_info->nr_lblocks);
-	dev->nr_pblocks = ntohll(dev_info->nr_pblocks);
-	dev->zone_size = ntohll(dev_info->zone_size);
-	dev->zone_sectors = ntohl(dev_info->zone_sectors);
-	dev->lblock_size = ntohl(dev_info->lblock_size);
-	dev->pblock_size = ntohl(dev_info->pblock_size);
-	dev->nr_zones = ntohl(dev_info->nr_zones);
-	dev->max_nr_open_zones = ntohl(dev_info->max_nr_open_zones);
-	dev->max_nr_active_zones = ntohl(dev_info->max_nr_active_zones);
-	dev->is_zoned = dev_info->is_zoned;
+	/* Ignore requests this client does not know about. */
+	if (nr_reqs > ZNR_STATS_MAX_REQS)
+		nr_reqs = ZNR_STATS_MAX_REQS;
+
+	memcpy(srv_stats, rep_stats, sizeof(*srv_stats));
+	memset(stats, 0, sizeof(*stats));
+	memcpy(stats->req, rep_stats + 1,
+	       nr_reqs * sizeof(struct znr_stats_req));
+
+	if (sched_stats) {
+		memset(sched_stats, 0, sched_size ? sched_size :
+		       sizeof(struct znr_sched_stats) * ZNR_SCHED_NR_CLASSES);
+		memcpy(sched_stats, (char *)rep_stats + data_size - sched_size,
+		       sched_size);
+	}
 
 free:
-	free(dev_info);
+	free(rep_stats);
 
 	return ret;
 }
 
-int znr_net_get_dev_rep_zones(struct znr_net_client *ncli,
-			      unsigned int zno,
-			      struct blk_zone *zones, unsigned int nr_zones)
+int znr_net_get_fleet(struct znr_net_client *ncli,
+		      struct znr_net_fleet_host **hosts,
+		      unsigned int *nr_hosts)
 {
-	void *data = NULL;
-	struct blk_zone *blkz;
-	size_t data_size = 0;
-	unsigned int i;
-	int err, ret = 0;
+	struct znr_net_fleet_host *h = NULL;
+	size_t data_size = 0, i, j;
+	__u64 *val;
+	int ret, err;
 
-	znr_verbose("Sending zone report request (from %u, %u zones)\n",
-		    zno, nr_zones);
+	znr_verbose("Sending fleet request\n");
 
-	ret = znr_net_send_req(ncli, ZNR_NET_DEV_REP_ZONES,
-			       zno, nr_zones, 0, 0, NULL);
+	ret = znr_net_send_req(ncli, ZNR_NET_FLEET, 0, 0, 0, 0, NULL);
 	if (ret)
 		return ret;
 
-	ret = znr_net_recv_rep(ncli, ZNR_NET_DEV_REP_ZONES, &err,
-			       &data, &data_size);
+	ret = znr_net_recv_rep(ncli, ZNR_NET_FLEET, &err,
+			       (void **)&h, &data_size);
 	if (ret)
 		return ret;
 
 	if (err) {
-		znr_err("Get report zones failed\n");
-		return -1;
+		znr_err("Get fleet failed (%s)\n", strerror(err));
+		return -err;
 	}
 
-	if (data_size != sizeof(struct blk_zone) * nr_zones) {
-		znr_err("Invalid number of zones in report\n");
-		ret = -1;
-		goto free;
+	if (data_size % sizeof(*h)) {
+		znr_err("Invalid fleet size %zu\n", data_size);
+		free(h);
+		return -EPROTO;
 	}
 
-	znr_verbose("Zone report: %u zones from zone %u\n",
-		    nr_zones, zno);
-
-	blkz = data;
-	for (i = 0; i < nr_zones; i++, blkz++, zones++) {
-		zones->start = ntohll(blkz->start);
-		zones->len = ntohll(blkz->len);
-		zones->wp = ntohll(blkz->wp);
-		zones->type = blkz->type;
-		zones->cond = blkz->cond;
-		zones->non_seq = blkz->non_seq;
-		zones->reset = blkz->reset;
-		zones->capacity = ntohll(blkz->capacity);
+	*nr_hosts = data_size / sizeof(*h);
+	for (i = 0; i < *nr_hosts; i++) {
+		h[i].name[ZNR_NET_HOST_NAME_LEN - 1] = '\0';
+		val = &h[i].err;
+		for (j = 0; j < (sizeof(*h) - ZNR_NET_HOST_NAME_LEN) /
+			     sizeof(__u64); j++)
+			val[j] = znr_net_ntoh64(ncli, val[j]);
 	}
+	*hosts = h;
 
-free:
-	free(data);
-
-	if (ret)
-		return ret;
-	return nr_zones;
+	return 0;
 }
 
-int znr_net_get_file_extents(struct znr_net_client *ncli, char *path,
-			     struct znr_extent **extents,
-			     unsigned int *nr_extents)
+/*
+ * Select the host of an aggregator to which all device and file system
+ * requests are forwarded. The protocol features become the ones negotiated by
+ * the aggregator with the host.
+ */
+int znr_net_select_host(struct znr_net_client *ncli, unsigned int host)
 {
-	struct znr_extent *ext = NULL;
-	unsigned int i, nr_ext = 0;
-	size_t data_size;
-	int err, ret;
-
-	znr_verbose("Sending file %s extent request\n", path);
+	struct znr_net_hello *hello = NULL;
+	size_t data_size = 0;
+	int ret, err;
 
-	*extents = NULL;
-	*nr_extents = 0;
+	znr_verbose("Sending select host request (host %u)\n", host);
 
-	if (!path || !strlen(path)) {
-		znr_err("Invalid file path\n");
-		return -1;
-	}
-	ret = znr_net_send_req(ncli, ZNR_NET_FILE_EXTENTS, 0, 0, 0, 0, path);
+	ret = znr_net_send_req(ncli, ZNR_NET_SELECT_HOST, host, 0, 0, 0, NULL);
 	if (ret)
 		return ret;
 
-	ret = znr_net_recv_rep(ncli, ZNR_NET_FILE_EXTENTS, &err,
-			       (void **)&ext, &data_size);
+	ret = znr_net_recv_rep(ncli, ZNR_NET_SELECT_HOST, &err,
+			       (void **)&hello, &data_size);
 	if (ret)
 		return ret;
 
 	if (err) {
-		znr_err("Get file %s extents failed\n", path);
-		return -1;
-	}
-
-	if (data_size % sizeof(struct znr_extent)) {
-		znr_err("Data size is not aligned to struct znr_extent\n");
-		free(ext);
-		return -1;
+		znr_err("Select host %u failed (%s)\n", host, strerror(err));
+		return -err;
 	}
 
-	nr_ext = data_size / sizeof(struct znr_extent);
-	*extents = ext;
-	*nr_extents = nr_ext;
-
-	znr_verbose("File %s: %u extents\n", path, nr_ext);
-
-	for (i = 0; i < nr_ext; i++, ext++) {
-		ext->idx = ntohl(ext->idx);
-		ext->sector = ntohll(ext->sector);
-		ext->nr_sectors = ntohll(ext->nr_sectors);
-		ext->ino = ntohll(ext->ino);
-	}
+	ret = znr_net_set_proto(ncli, hello, data_size);
+	free(hello);
+	if (!ret)
+		ncli->host = host;
 
 	return ret;
 }
 
-int znr_net_get_extents_in_range(struct znr_net_client *ncli,
-				 unsigned long long sector,
-				 unsigned long long nr_sectors,
-				 struct znr_extent **extents,
-				 unsigned int *nr_extents)
+/*
+ * Resume the session of the last synchronization with the server and get in
+ * @rs the state changes since then. Without a session yet, start a new one:
+ * @rs may then be NULL.
+ */
+int znr_net_resume(struct znr_net_client *ncli, struct znr_net_resync *rs)
 {
-	struct znr_extent *ext = NULL;
-	unsigned int i, nr_ext = 0;
-	size_t data_size;
-	int err, ret;
+	struct znr_net_resume *resume = NULL;
+	size_t data_size = 0, zno_size = 0, zones_size;
+	unsigned int flags, nr, i;
+	__u32 *znos;
+	int ret, err;
 
-	znr_verbose("Sending extent request in range %llu + %llu\n",
-		    sector, nr_sectors);
+	if (!(ncli->features & ZNR_NET_FEAT_RESUME))
+		return -EOPNOTSUPP;
 
-	*extents = NULL;
-	*nr_extents = 0;
+	if (rs)
+		memset(rs, 0, sizeof(*rs));
 
-	if (sector >= znr.dev.nr_sectors ||
-	    sector + nr_sectors > znr.dev.nr_sectors) {
-		znr_err("Invalid sector range %llu + %llu\n",
-			sector, nr_sectors);
-		return -EINVAL;
-	}
+	znr_verbose("Sending resume request (session 0x%016llx, "
+		    "generation %llu)\n",
+		    ncli->session, ncli->gen);
 
-	ret = znr_net_send_req(ncli, ZNR_NET_EXTENTS_IN_RANGE, 0, 0,
-			       sector, nr_sectors, NULL);
+	ret = znr_net_send_req(ncli, ZNR_NET_RESUME, 0, 0,
+			       ncli->session, ncli->gen, NULL);
 	if (ret)
 		return ret;
 
-	ret = znr_net_recv_rep(ncli, ZNR_NET_EXTENTS_IN_RANGE, &err,
-			       (void **)&ext, &data_size);
+	ret = znr_net_recv_rep(ncli, ZNR_NET_RESUME, &err,
+			       (void **)&resume, &data_size);
 	if (ret)
 		return ret;
 
 	if (err) {
-		znr_err("Get extent range %llu + %llu reply failed\n",
-			sector, nr_sectors);
-		return -1;
+		znr_err("Resume session failed (%s)\n", strerror(err));
+		return -err;
 	}
 
-	if (data_size % sizeof(struct znr_extent)) {
-		znr_err("Data size is not aligned to struct znr_extent\n");
-		free(ext);
-		return -1;
+	if (data_size < sizeof(*resume)) {
+		ret = -EPROTO;
+		goto free;
 	}
 
-	nr_ext = data_size / sizeof(struct znr_extent);
-	*extents = ext;
-	*nr_extents = nr_ext;
+	flags = znr_net_ntoh32(ncli, resume->flags);
+	nr = znr_net_ntoh32(ncli, resume->nr_zones);
+	if (!(flags & ZNR_NET_RESUME_ALL))
+		zno_size = ((size_t)nr * sizeof(__u32) + 7) & ~7UL;
+	zones_size = (size_t)nr * sizeof(struct blk_zone);
+	if (data_size != sizeof(*resume) + zno_size + zones_size) {
+		ret = -EPROTO;
+		goto free;
+	}
 
-	znr_verbose("Sector range %llu + %llu: %u extents\n",
-		    sector, nr_sectors, nr_ext);
+	if (rs && nr) {
+		rs->zones = malloc(zones_size);
+		if (zno_size)
+			rs->znos = malloc(nr * sizeof(__u32));
+		if (!rs->zones || (zno_size && !rs->znos)) {
+			znr_net_free_resync(rs);
+			ret = -ENOMEM;
+			goto free;
+		}
 
-	for (i = 0; i < nr_ext; i++, ext++) {
-		ext->idx = ntohl(ext->idx);
-		ext->sector = ntohll(ext->sector);
-		ext->nr_sectors = ntohll(ext->nr_sectors);
-		ext->ino = ntohll(ext->ino);
+		znos = (__u32 *)(resume + 1);
+		for (i = 0; i < nr && zno_size; i++)
+			rs->znos[i] = znr_net_ntoh32(ncli, znos[i]);
+		memcpy(rs->zones, (uint8_t *)znos + zno_size, zones_size);
+		znr_net_ntoh_zones(ncli, rs->zones, nr);
+		rs->nr_zones = nr;
 	}
 
+	if (rs)
+		rs->flags = flags;
+
+	ncli->session = znr_net_ntoh64(ncli, resume->session);
+	ncli->gen = znr_net_ntoh64(ncli, resume->gen);
+
+	znr_verbose("Session 0x%016llx, generation %llu: %u zones changed, "
+		    "flags 0x%x\n",
+		    ncli->session, ncli->gen, nr, flags);
+
+free:
+	if (ret == -EPROTO)
+		znr_err("Invalid resume reply\n");
+	free(resume);
+
 	return ret;
 }
 
-int znr_net_get_blockgroups(struct znr_net_client *ncli,
-			    struct znr_bg **blockgroups,
-			    unsigned int *nr_blockgroups)
+void znr_net_free_resync(struct znr_net_resync *rs)
 {
-	void *data = NULL;
-	size_t data_size = 0;
-	struct znr_bg *bg;
-	unsigned int i;
-	int err, ret;
+	free(rs->znos);
+	free(rs->zones);
+	free(rs->blockgroups);
+	memset(rs, 0, sizeof(*rs));
+}
 
-	znr_verbose("Sending get blockgroup information\n");
+/*
+ * Test if a request error is due to the loss of the connection to the server.
+ */
+bool znr_net_disconnected(int err)
+{
+	switch (-err) {
+	case ECONNRESET:
+	case ECONNABORTED:
+	case ECONNREFUSED:
+	case EPIPE:
+	case ENOTCONN:
+	case ETIMEDOUT:
+	case EHOSTUNREACH:
+	case ENETUNREACH:
+	case ENETDOWN:
+		return true;
+	default:
+		return false;
+	}
+}
 
-	if (!nr_blockgroups || !blockgroups)
-		return -EINVAL;
+/*
+ * Without session resumption, the state changes are all zones.
+ */
+static int znr_net_get_full_resync(struct znr_net_client *ncli,
+				   struct znr_net_resync *rs)
+{
+	int ret;
 
-	ret = znr_net_send_req(ncli, ZNR_NET_BLOCKGROUPS, 0, 0, 0, 0, NULL);
-	if (ret)
+	rs->flags = ZNR_NET_RESUME_FULL | ZNR_NET_RESUME_ALL;
+	if (!znr.dev.is_zoned || !znr.nr_zones)
+		return 0;
+
+	rs->zones = calloc(znr.nr_zones, sizeof(struct blk_zone));
+	if (!rs->zones)
+		return -ENOMEM;
+
+	ret = znr_net_get_dev_rep_zones(ncli, 0, rs->zones, znr.nr_zones);
+	if (ret < 0)
 		return ret;
+	if ((unsigned int)ret != znr.nr_zones)
+		return -EIO;
 
-	/* First receive the number of blockgroups */
-	ret = znr_net_recv_rep(ncli, ZNR_NET_BLOCKGROUPS, &err,
-			       &data, &data_size);
-	if (ret) {
-		fprintf(stderr, "Get number of blockgroups failed\n");
+	rs->nr_zones = znr.nr_zones;
+
+	return 0;
+}
+
+/*
+ * If the session could not be resumed, check that the server still has the
+ * same device and get the blockgroups, which must not have changed in number.
+ */
+static int znr_net_check_resync(struct znr_net_client *ncli,
+				struct znr_net_resync *rs)
+{
+	struct znr_device dev;
+	char *dev_path = NULL;
+	int ret;
+
+	if (rs->flags & ZNR_NET_RESUME_FULL) {
+		memset(&dev, 0, sizeof(dev));
+		ret = znr_net_get_device(ncli, &dev, &dev_path);
+		if (ret)
+			return ret;
+		free(dev_path);
+
+		if (dev.nr_sectors != znr.dev.nr_sectors ||
+		    dev.nr_zones != znr.dev.nr_zones ||
+		    dev.zone_sectors != znr.dev.zone_sectors ||
+		    dev.is_zoned != znr.dev.is_zoned) {
+			znr_err("Server device changed\n");
+			return -ESTALE;
+		}
+	}
+
+	if (!(rs->flags & (ZNR_NET_RESUME_FULL | ZNR_NET_RESUME_BLOCKGROUPS)))
+		return 0;
+
+	ret = znr_net_get_blockgroups(ncli, &rs->blockgroups,
+				      &rs->nr_blockgroups);
+	if (ret < 0)
 		return ret;
+
+	if (rs->nr_blockgroups != znr.nr_blockgroups) {
+		znr_err("Number of blockgroups changed (%u -> %u)\n",
+			znr.nr_blockgroups, rs->nr_blockgroups);
+		return -ESTALE;
 	}
 
-	if (data_size != sizeof(*nr_blockgroups)) {
-		fprintf(stderr, "Number of blockgroups, receive error\n");
-		ret = -EINVAL;
-		goto free;
+	return 0;
+}
+
+/*
+ * Reconnect to the server after the loss of the connection, retrying with an
+ * exponential backoff, and get in @rs the state changes since the last
+ * synchronization. The changes are applied with znr_resync().
+ */
+int znr_net_reconnect(struct znr_net_client *ncli, struct znr_net_resync *rs)
+{
+	unsigned long long session = ncli->session, gen = ncli->gen;
+	unsigned long long dev_sectors = ncli->dev_sectors;
+	unsigned int delay_ms = ZNR_NET_RECONNECT_MS, i;
+	int host = ncli->host;
+	bool shm = ncli->shm;
+	int ret = -ENOTCONN;
+
+	memset(rs, 0, sizeof(*rs));
+
+	for (i = 0; i < ZNR_NET_RECONNECT_TRIES; i++) {
+		if (i) {
+			usleep(delay_ms * 1000);
+			delay_ms *= 2;
+		}
+
+		znr_net_disconnect(ncli);
+		if (znr.listen)
+			ret = znr_net_listen(ncli);
+		else
+			ret = znr_net_connect(ncli);
+		if (!ret)
+			ret = znr_net_hello(ncli);
+		if (!ret)
+			break;
+
+		znr_err("Reconnection attempt %u / %u failed\n",
+			i + 1, ZNR_NET_RECONNECT_TRIES);
 	}
+	if (ret)
+		return ret;
 
-	*nr_blockgroups = *((unsigned int *)data);
-	free(data);
+	ncli->session = session;
+	ncli->gen = gen;
+	ncli->dev_sectors = dev_sectors;
 
-	znr_verbose("Get blockgroups: attempting to retrieve  %u blockgroups\n",
-		    *nr_blockgroups);
-	/* Get blockgroups data */
-	ret = znr_net_recv_rep(ncli, ZNR_NET_BLOCKGROUPS, &err,
-			       &data, &data_size);
+	if (host >= 0) {
+		ret = znr_net_select_host(ncli, host);
+		if (ret)
+			return ret;
+	}
+
+	if (shm && znr_net_map_shm(ncli))
+		printf("Shared memory not available, using requests\n");
+
+	if (session)
+		ret = znr_net_resume(ncli, rs);
+	else
+		ret = -EOPNOTSUPP;
+	if (ret == -EOPNOTSUPP)
+		ret = znr_net_get_full_resync(ncli, rs);
+	if (!ret)
+		ret = znr_net_check_resync(ncli, rs);
 	if (ret) {
-		fprintf(stderr, "Get blockgroups information failed\n");
+		znr_net_free_resync(rs);
 		return ret;
 	}
 
-	if (data_size != sizeof(struct znr_bg) * (*nr_blockgroups)) {
-		fprintf(stderr, "Invalid blockgroups information received\n");
-		ret = -EINVAL;
-		goto free;
-	}
+	printf("Reconnected: %u zones%s changed%s\n",
+	       rs->nr_zones,
+	       rs->flags & ZNR_NET_RESUME_ALL ? " (all)" : "",
+	       rs->flags & ZNR_NET_RESUME_FULL ? ", full resync" : "");
 
-	znr_verbose("Get blockgroups: retrieved %u blockgroups\n",
-		    *nr_blockgroups);
+	return 0;
+}
 
-	bg = data;
-	/* It is the callers responsibility to free this memory */
-	*blockgroups = bg;
-	for (i = 0; i < *nr_blockgroups; i++, bg++) {
-		bg->sector = ntohll(bg->sector);
-		bg->nr_sectors = ntohll(bg->nr_sectors);
-		bg->wp_sector = ntohll(bg->wp_sector);
-		bg->flags = ntohl(bg->flags);
+void znr_net_print_stats(struct znr_net_stats *srv_stats,
+			 struct znr_stats *stats,
+			 struct znr_sched_stats *sched_stats)
+{
+	printf("Server statistics:\n");
+	printf("  Uptime: %llu.%03llu s\n",
+	       srv_stats->uptime_ms / 1000, srv_stats->uptime_ms % 1000);
+	printf("  Connections: %llu (%llu clients connected)\n",
+	       srv_stats->nr_connections, srv_stats->nr_clients);
+	printf("  Cache: %llu hits, %llu misses, %llu coalesced, "
+	       "%llu invalidations, %llu evictions\n",
+	       srv_stats->cache_hits, srv_stats->cache_misses,
+	       srv_stats->cache_coalesced, srv_stats->cache_invalidations,
+	       srv_stats->cache_evictions);
+	if (sched_stats) {
+		printf("Classes:\n");
+		znr_sched_print_stats(stdout, sched_stats);
 	}
+	printf("Requests:\n");
+	znr_stats_print(stdout, stats, znr_stats_srv_phases);
+}
 
-	return (int)*nr_blockgroups;
-free:
-	free(data);
+const char *znr_net_req_name(unsigned int id)
+{
+	static const char *req_names[] = {
+		[ZNR_NET_MNTDIR_INFO]		= "MNTDIR_INFO",
+		[ZNR_NET_DEV_INFO]		= "DEV_INFO",
+		[ZNR_NET_DEV_REP_ZONES]		= "DEV_REP_ZONES",
+		[ZNR_NET_FILE_EXTENTS]		= "FILE_EXTENTS",
+		[ZNR_NET_EXTENTS_IN_RANGE]	= "EXTENTS_IN_RANGE",
+		[ZNR_NET_BLOCKGROUPS]		= "BLOCKGROUPS",
+		[ZNR_NET_HELLO]			= "HELLO",
+		[ZNR_NET_SHM_MAP]		= "SHM_MAP",
+		[ZNR_NET_STATS]			= "STATS",
+		[ZNR_NET_CREDIT]		= "CREDIT",
+		[ZNR_NET_BATCH]			= "BATCH",
+		[ZNR_NET_FLEET]			= "FLEET",
+		[ZNR_NET_SELECT_HOST]		= "SELECT_HOST",
+		[ZNR_NET_RESUME]		= "RESUME",
+		[ZNR_NET_CANCEL]		= "CANCEL",
+		[ZNR_NET_QUERY]			= "QUERY",
+	};
 
-	return ret;
+	if (id >= sizeof(req_names) / sizeof(req_names[0]) || !req_names[id])
+		return "UNKNOWN";
+
+	return req_names[id];
 }
@@ -8,6 +8,10 @@
 #include "config.h"
 #include "znr_device.h"
 #include "znr_fs.h"
+#include "znr_stats.h"
+#include "znr_batch.h"
+#include "znr_sched.h"
+#include "znr_query.h"
 
 #include <stdlib.h>
 #include <stdbool.h>
@@ -16,6 +20,7 @@
 #include <stdint.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
@@ -33,6 +38,91 @@
 
 #define ZNR_NET_SOCKBUF_SIZE	(1024 * 1024)
 
+/*
+ * Maximum number of clients a server serves concurrently.
+ */
+#define ZNR_NET_MAX_CLIENTS	16
+
+/*
+ * Protocol versions. Legacy peers do not send ZNR_NET_HELLO and always use
+ * network byte order for all fields.
+ */
+#define ZNR_NET_PROTO_LEGACY	1
+#define ZNR_NET_PROTO_VERSION	2
+
+/*
+ * Byte order marker: sent as is (not converted) in ZNR_NET_HELLO so that a
+ * peer can detect if it shares the same endianness.
+ */
+#define ZNR_NET_BYTE_ORDER	0x01020304U
+
+/*
+ * Optional protocol features negotiated with ZNR_NET_HELLO.
+ */
+#define ZNR_NET_FEAT_NATIVE	(1U << 0)	/* Native layout payloads */
+#define ZNR_NET_FEAT_CHUNKED	(1U << 1)	/* Chunked extent replies */
+#define ZNR_NET_FEAT_BATCH	(1U << 2)	/* ZNR_NET_BATCH requests */
+#define ZNR_NET_FEAT_COMPACT_BG	(1U << 3)	/* Blockgroup geometry runs */
+#define ZNR_NET_FEAT_VARLEN	(1U << 4)	/* Variable length requests */
+#define ZNR_NET_FEAT_RESUME	(1U << 5)	/* ZNR_NET_RESUME requests */
+#define ZNR_NET_FEAT_SCHED	(1U << 6)	/* Request classes, cancel */
+#define ZNR_NET_FEAT_QUERY	(1U << 7)	/* ZNR_NET_QUERY requests */
+
+#define ZNR_NET_FEATURES	(ZNR_NET_FEAT_NATIVE | \
+				 ZNR_NET_FEAT_CHUNKED | \
+				 ZNR_NET_FEAT_BATCH | \
+				 ZNR_NET_FEAT_COMPACT_BG | \
+				 ZNR_NET_FEAT_VARLEN | \
+				 ZNR_NET_FEAT_RESUME | \
+				 ZNR_NET_FEAT_SCHED | \
+				 ZNR_NET_FEAT_QUERY)
+
+/*
+ * With ZNR_NET_FEAT_SCHED negotiated, the request ID field of request headers
+ * carries the request priority class (enum znr_sched_class) in its bits 12
+ * and above.
+ */
+#define ZNR_NET_REQ_CLASS_SHIFT	12
+#define ZNR_NET_REQ_ID_MASK	((1U << ZNR_NET_REQ_CLASS_SHIFT) - 1)
+
+/*
+ * Chunked replies: extents are sent in chunks of at most ZNR_NET_CHUNK_SIZE
+ * bytes and the server stops sending when ZNR_NET_CHUNK_WINDOW chunks were not
+ * yet acknowledged by the client with ZNR_NET_CREDIT. This bounds the reply
+ * data buffered for a connection to ZNR_NET_CHUNK_SIZE * ZNR_NET_CHUNK_WINDOW
+ * bytes, whatever the number of extents.
+ */
+#define ZNR_NET_CHUNK_SIZE	(256 * 1024)
+#define ZNR_NET_CHUNK_EXTENTS	(ZNR_NET_CHUNK_SIZE / sizeof(struct znr_extent))
+#define ZNR_NET_CHUNK_WINDOW	4
+
+/*
+ * Payload compression algorithms negotiated with ZNR_NET_HELLO.
+ */
+#define ZNR_NET_COMP_NONE	0
+
+/*
+ * Client reconnection attempts after a connection loss, and delay before the
+ * first retry, doubled after each failed attempt.
+ */
+#define ZNR_NET_RECONNECT_TRIES	6
+#define ZNR_NET_RECONNECT_MS	250
+
+/*
+ * Client side state changes obtained with ZNR_NET_RESUME when reconnecting:
+ * the zones changed since the last synchronization, all zones if
+ * ZNR_NET_RESUME_ALL is set (znos is then NULL), and the blockgroups if their
+ * geometry changed (blockgroups is otherwise NULL).
+ */
+struct znr_net_resync {
+	unsigned int		flags;
+	unsigned int		nr_zones;
+	__u32			*znos;
+	struct blk_zone		*zones;
+	struct znr_bg		*blockgroups;
+	unsigned int		nr_blockgroups;
+};
+
 struct znr_net_client {
 	int			sd;
 	struct sockaddr_in	inaddr;
@@ -40,6 +130,77 @@ struct znr_net_client {
 
 	char			ip[INET_ADDRSTRLEN + 1];
 	int			port;
+
+	/*
+	 * Local (unix socket) connection. For local clients, ip is "local" and
+	 * port is the client process ID. With shm set, the client uses the
+	 * server shared memory segment for zone and blockgroup information.
+	 */
+	bool			local;
+	bool			shm;
+
+	/*
+	 * Request statistics, total bytes sent and received on the connection,
+	 * and accounting of the request being executed:
+	 * time spent sending, waiting for and receiving replies, data bytes
+	 * transferred and error reply sent or received.
+	 */
+	struct znr_stats	stats;
+	unsigned long long	tx_bytes;
+	unsigned long long	rx_bytes;
+	unsigned long long	nr_stale;
+	unsigned long long	send_ns;
+	unsigned long long	wait_ns;
+	unsigned long long	recv_ns;
+	size_t			xfer_bytes;
+	bool			xfer_err;
+
+	/*
+	 * Negotiated protocol parameters. With native set, payloads are
+	 * exchanged in the host layout without any byte swapping.
+	 */
+	unsigned int		version;
+	unsigned int		features;
+	unsigned int		compression;
+	bool			native;
+
+	/* Client side: capacity of the server device */
+	unsigned long long	dev_sectors;
+
+	/*
+	 * Priority class of the requests sent (client side) or of the request
+	 * being executed (server side).
+	 */
+	unsigned int		req_class;
+
+	/*
+	 * Client side session ID and state generation of the last
+	 * synchronization with the server, and aggregator host selected (-1
+	 * if none), restored when reconnecting.
+	 */
+	unsigned long long	session;
+	unsigned long long	gen;
+	int			host;
+
+	/*
+	 * Client side reply being received in chunks: request ID (0 if none),
+	 * callback the extents are passed to, first callback error and number
+	 * of chunks received and not yet credited to the server.
+	 */
+	unsigned int		stream_id;
+	znr_fs_extents_cb	stream_cb;
+	void			*stream_data;
+	int			stream_err;
+	unsigned int		stream_credits;
+
+	/*
+	 * Aggregator side connection to the host selected by the client with
+	 * ZNR_NET_SELECT_HOST, to which requests are forwarded.
+	 */
+	struct znr_net_client	*upstream;
+
+	/* Server side list of clients */
+	struct znr_net_client	*next;
 };
 
 #define ZNR_NET_MAGIC				   \
@@ -48,6 +209,12 @@ struct znr_net_client {
 	 ((__u32)'n' << 8) |			   \
 	 ((__u32)'e'))
 
+#define ZNR_NET_VARLEN_MAGIC			   \
+	(((__u32)'z' << 24) |			   \
+	 ((__u32)'o' << 16) |			   \
+	 ((__u32)'n' << 8) |			   \
+	 ((__u32)'v'))
+
 enum znr_net_req_id {
 	ZNR_NET_MNTDIR_INFO = 1,
 	ZNR_NET_DEV_INFO,
@@ -55,8 +222,184 @@ enum znr_net_req_id {
 	ZNR_NET_FILE_EXTENTS,
 	ZNR_NET_EXTENTS_IN_RANGE,
 	ZNR_NET_BLOCKGROUPS,
+	ZNR_NET_HELLO,
+	ZNR_NET_SHM_MAP,
+	ZNR_NET_STATS,
+	ZNR_NET_CREDIT,
+	ZNR_NET_BATCH,
+	ZNR_NET_FLEET,
+	ZNR_NET_SELECT_HOST,
+	ZNR_NET_RESUME,
+	ZNR_NET_CANCEL,
+	ZNR_NET_QUERY,
 };
 
+struct znr_net_hello {
+	__u32		version;
+	__u32		byte_order;
+	__u32		features;
+	__u32		compression;
+} __attribute__ ((packed));
+
+/*
+ * ZNR_NET_SHM_MAP reply data. The segment file descriptor is passed as
+ * SCM_RIGHTS ancillary data of a single byte message following the reply.
+ */
+struct znr_net_shm_map {
+	__u64		size;
+} __attribute__ ((packed));
+
+/*
+ * ZNR_NET_STATS reply data: server information followed by nr_reqs
+ * struct znr_stats_req, one per request ID, and with ZNR_NET_FEAT_SCHED
+ * negotiated, by ZNR_SCHED_NR_CLASSES struct znr_sched_stats. All fields are
+ * 64-bits, so that the structure needs no packing and can be converted as an
+ * array of __u64.
+ */
+struct znr_net_stats {
+	__u64		uptime_ms;
+	__u64		nr_connections;
+	__u64		nr_clients;
+	__u64		nr_reqs;
+	__u64		nr_phases;
+	__u64		nr_buckets;
+	__u64		cache_hits;
+	__u64		cache_misses;
+	__u64		cache_coalesced;
+	__u64		cache_invalidations;
+	__u64		cache_evictions;
+};
+
+/*
+ * ZNR_NET_BATCH request data: a struct znr_net_batch followed by size bytes of
+ * nr_reqs sub-requests. Each sub-request is a struct znr_net_batch_req,
+ * followed by path_len bytes of path (without a terminating null byte) padded
+ * to a multiple of 8 bytes.
+ */
+#define ZNR_NET_BATCH_MAX_SIZE	\
+	(ZNR_BATCH_MAX_REQS * (sizeof(struct znr_net_batch_req) + PATH_MAX))
+
+struct znr_net_batch {
+	__u32		nr_reqs;
+	__u32		size;
+} __attribute__ ((packed));
+
+struct znr_net_batch_req {
+	__u32		type;
+	__u32		path_len;
+	__u64		start;
+	__u64		len;
+} __attribute__ ((packed));
+
+/*
+ * ZNR_NET_BATCH reply data: for each sub-request, in order, a
+ * struct znr_net_batch_rep followed by data_size bytes of nr struct blk_zone
+ * or struct znr_extent.
+ */
+struct znr_net_batch_rep {
+	__u32		type;
+	__u32		err;
+	__u32		nr;
+	__u32		data_size;
+} __attribute__ ((packed));
+
+/*
+ * Chunked ZNR_NET_BATCH reply data: the size of the sub-requests reply data
+ * that follows, so that clients can allocate it once.
+ */
+struct znr_net_chunked_batch {
+	__u64		size;
+} __attribute__ ((packed));
+
+/*
+ * Compact ZNR_NET_BLOCKGROUPS reply data: a struct znr_net_bg_geometry
+ * followed by nr_runs runs of contiguous blockgroups of the same size, e.g.
+ * one run for all XFS AGs and one run for all RGs. The blockgroups write
+ * pointer and type are not part of the geometry: clients obtain these from
+ * zone reports.
+ */
+struct znr_net_bg_geometry {
+	__u32		nr_blockgroups;
+	__u32		nr_runs;
+} __attribute__ ((packed));
+
+struct znr_net_bg_run {
+	__u64		sector;
+	__u64		nr_sectors;
+	__u32		nr_blockgroups;
+	__u32		reserved;
+} __attribute__ ((packed));
+
+/*
+ * ZNR_NET_FLEET reply data: one struct znr_net_fleet_host per host of an
+ * aggregator, in the order of the aggregator command line. The host index
+ * selects the host with ZNR_NET_SELECT_HOST. All fields following the name are
+ * 64-bits, so that the structure needs no packing and these fields can be
+ * converted as an array of __u64.
+ */
+#define ZNR_NET_HOST_NAME_LEN	64
+
+struct znr_net_fleet_host {
+	__u8		name[ZNR_NET_HOST_NAME_LEN];
+
+	/* Error code of the last poll (0 if it succeeded) */
+	__u64		err;
+
+	/* Time since the last successful poll */
+	__u64		age_ms;
+	__u64		nr_polls;
+
+	/* Zones state */
+	__u64		nr_zones;
+	__u64		nr_conv_zones;
+	__u64		nr_empty_zones;
+	__u64		nr_open_zones;
+	__u64		nr_closed_zones;
+	__u64		nr_full_zones;
+	__u64		max_nr_open_zones;
+
+	/* Capacity and written sectors of sequential zones */
+	__u64		capacity;
+	__u64		used;
+
+	/*
+	 * Full zones with less than ZNR_FLEET_GC_LIVE_PCT % of live data,
+	 * and bytes per second written since the previous poll.
+	 */
+	__u64		nr_gc_candidates;
+	__u64		write_bps;
+};
+
+/*
+ * ZNR_NET_RESUME request: sector is the session ID of the client (0 to start
+ * a new session) and nr_sectors the state generation of its last
+ * synchronization. The reply data is a struct znr_net_resume followed, unless
+ * ZNR_NET_RESUME_ALL is set, by nr_zones __u32 zone numbers padded to a
+ * multiple of 8 bytes, and by nr_zones struct blk_zone. With
+ * ZNR_NET_RESUME_FULL, the session is unknown to the server (e.g. the server
+ * restarted): all zones are sent and the client must check the device and
+ * blockgroups it knows. ZNR_NET_RESUME_BLOCKGROUPS indicates that the
+ * blockgroups geometry changed.
+ */
+#define ZNR_NET_RESUME_FULL		(1U << 0)
+#define ZNR_NET_RESUME_ALL		(1U << 1)
+#define ZNR_NET_RESUME_BLOCKGROUPS	(1U << 2)
+
+struct znr_net_resume {
+	__u64		session;
+	__u64		gen;
+	__u32		flags;
+	__u32		nr_zones;
+} __attribute__ ((packed));
+
+/*
+ * ZNR_NET_QUERY request: the query (see znr_query.h) is sent as the request
+ * path and evaluated on the extents of the sector range sector + nr_sectors.
+ * Without grouping, the reply is the extents matching, chunked like
+ * ZNR_NET_EXTENTS_IN_RANGE replies. With grouping, the reply data is an array
+ * of struct znr_query_group sorted by key.
+ */
+
 struct znr_net_mntdir_info {
 	__u32		fs_type;
 	__u8		mnt_path[PATH_MAX];
@@ -88,20 +431,64 @@ struct znr_net_req {
 	__u8		path[PATH_MAX];
 } __attribute__ ((packed));
 
+/*
+ * Variable length request, used once ZNR_NET_FEAT_VARLEN is negotiated: the
+ * header is followed by path_len bytes of path, without a terminating null
+ * byte. Only ZNR_NET_FILE_EXTENTS requests have a path. The header has the
+ * same size as the fixed part of struct znr_net_req so that the server can
+ * receive either format with a single receive of the header, and tell them
+ * apart with the magic.
+ */
+struct znr_net_varlen_req {
+	__u32		magic;
+	__u16		id;
+	__u16		path_len;
+	__u32		zno;
+	__u32		nr_zones;
+	__u64		sector;
+	__u64		nr_sectors;
+} __attribute__ ((packed));
+
+/*
+ * Reply flags. A chunked reply is a sequence of replies with
+ * ZNR_NET_REP_CHUNK set, the last one also having ZNR_NET_REP_LAST set.
+ * ZNR_NET_REP_STALE is set by servers over their ioctl budget for replies
+ * with data older than their cache freshness window.
+ */
+#define ZNR_NET_REP_CHUNK	(1U << 0)
+#define ZNR_NET_REP_LAST	(1U << 1)
+#define ZNR_NET_REP_STALE	(1U << 2)
+
 struct znr_net_rep {
 	__u32		magic;
-	__u32		id;
+	__u16		flags;
+	__u16		id;
 	__u32		err;
 	__u32		data_size;
 } __attribute__ ((packed));
 
 int znr_net_connect(struct znr_net_client *ncli);
+int znr_net_connect_host(struct znr_net_client *ncli, const char *host,
+			 int port);
 int znr_net_listen(struct znr_net_client *ncli);
 void znr_net_disconnect(struct znr_net_client *ncli);
 
 void znr_net_run_server(struct znr_net_client *ncli);
 
+int znr_net_negotiate(struct znr_net_client *ncli, unsigned int features);
+int znr_net_hello(struct znr_net_client *ncli);
+int znr_net_map_shm(struct znr_net_client *ncli);
+int znr_net_get_stats(struct znr_net_client *ncli,
+		      struct znr_net_stats *srv_stats,
+		      struct znr_stats *stats,
+		      struct znr_sched_stats *sched_stats);
+void znr_net_print_stats(struct znr_net_stats *srv_stats,
+			 struct znr_stats *stats,
+			 struct znr_sched_stats *sched_stats);
+const char *znr_net_req_name(unsigned int id);
 int znr_net_get_mntdir_info(struct znr_net_client *ncli);
+int znr_net_get_device(struct znr_net_client *ncli, struct znr_device *dev,
+		       char **dev_path);
 int znr_net_get_dev_info(struct znr_net_client *ncli);
 int znr_net_get_dev_rep_zones(struct znr_net_client *ncli,
 			      unsigned int start_zone_no,
@@ -114,8 +501,32 @@ int znr_net_get_extents_in_range(struct znr_net_client *ncli,
 				 unsigned long long nr_sectors,
 				 struct znr_extent **extents,
 				 unsigned int *nr_extents);
+int znr_net_start_extents_in_range(struct znr_net_client *ncli,
+				   unsigned long long sector,
+				   unsigned long long nr_sectors,
+				   znr_fs_extents_cb cb, void *data);
+int znr_net_walk_extents_in_range(struct znr_net_client *ncli,
+				  unsigned long long sector,
+				  unsigned long long nr_sectors,
+				  znr_fs_extents_cb cb, void *data);
+int znr_net_query(struct znr_net_client *ncli,
+		  unsigned long long sector, unsigned long long nr_sectors,
+		  struct znr_query *q);
+int znr_net_stream_poll(struct znr_net_client *ncli);
+void znr_net_stream_detach(struct znr_net_client *ncli);
+void znr_net_stream_cancel(struct znr_net_client *ncli);
+int znr_net_batch(struct znr_net_client *ncli,
+		  struct znr_batch_req *reqs, unsigned int nr_reqs);
 int znr_net_get_blockgroups(struct znr_net_client *ncli,
 			    struct znr_bg **blockgroups,
 			    unsigned int *nr_blockgroups);
+int znr_net_get_fleet(struct znr_net_client *ncli,
+		      struct znr_net_fleet_host **hosts,
+		      unsigned int *nr_hosts);
+int znr_net_select_host(struct znr_net_client *ncli, unsigned int host);
+int znr_net_resume(struct znr_net_client *ncli, struct znr_net_resync *rs);
+int znr_net_reconnect(struct znr_net_client *ncli, struct znr_net_resync *rs);
+void znr_net_free_resync(struct znr_net_resync *rs);
+bool znr_net_disconnected(int err);
 
 #endif /* ZNR_NET_H */
@@ -0,0 +1,410 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+
+#include "znr.h"
+
+static const char *znr_query_fields[] = {
+	[ZNR_QUERY_INO]		= "ino",
+	[ZNR_QUERY_TYPE]	= "type",
+	[ZNR_QUERY_SECTOR]	= "sector",
+	[ZNR_QUERY_END]		= "end",
+	[ZNR_QUERY_LEN]		= "len",
+	[ZNR_QUERY_ZONE]	= "zone",
+};
+
+#define ZNR_QUERY_NR_FIELDS	\
+	(sizeof(znr_query_fields) / sizeof(znr_query_fields[0]))
+
+static const char *znr_query_ops[] = {
+	[ZNR_QUERY_EQ]		= "=",
+	[ZNR_QUERY_NE]		= "!=",
+	[ZNR_QUERY_LT]		= "<",
+	[ZNR_QUERY_LE]		= "<=",
+	[ZNR_QUERY_GT]		= ">",
+	[ZNR_QUERY_GE]		= ">=",
+};
+
+#define ZNR_QUERY_NR_OPS	\
+	(sizeof(znr_query_ops) / sizeof(znr_query_ops[0]))
+
+const char *znr_query_field_name(enum znr_query_field field)
+{
+	if (field >= ZNR_QUERY_NR_FIELDS)
+		return "unknown";
+
+	return znr_query_fields[field];
+}
+
+/*
+ * Get the next token of a query: a word, a number or an operator.
+ */
+static const char *znr_query_token(const char *p, char *tok, size_t size)
+{
+	size_t len = 0;
+
+	while (isspace(*p))
+		p++;
+
+	if (isalnum(*p) || *p == '_') {
+		while ((isalnum(p[len]) || p[len] == '_') && len < size - 1)
+			len++;
+	} else if (*p && strchr("=!<>", *p)) {
+		while (p[len] && strchr("=!<>", p[len]) && len < size - 1)
+			len++;
+	} else if (*p) {
+		len = 1;
+	}
+
+	memcpy(tok, p, len);
+	tok[len] = '\0';
+
+	return p + len;
+}
+
+static int znr_query_get_field(const char *tok, enum znr_query_field *field)
+{
+	unsigned int i;
+
+	if (strcmp(tok, "owner") == 0) {
+		*field = ZNR_QUERY_INO;
+		return 0;
+	}
+
+	for (i = 0; i < ZNR_QUERY_NR_FIELDS; i++) {
+		if (strcmp(tok, znr_query_fields[i]) == 0) {
+			*field = i;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static int znr_query_get_op(const char *tok, enum znr_query_op *op)
+{
+	unsigned int i;
+
+	if (strcmp(tok, "==") == 0) {
+		*op = ZNR_QUERY_EQ;
+		return 0;
+	}
+
+	for (i = 0; i < ZNR_QUERY_NR_OPS; i++) {
+		if (strcmp(tok, znr_query_ops[i]) == 0) {
+			*op = i;
+			return 0;
+		}
+	}
+
+	return -EINVAL;
+}
+
+/*
+ * Parse the query @str into @q.
+ */
+int znr_query_parse(struct znr_query *q, const char *str)
+{
+	char tok[ZNR_QUERY_MAX_LEN];
+	struct znr_query_cond *c;
+	const char *p = str;
+	char *end;
+
+	memset(q, 0, sizeof(*q));
+
+	if (strlen(str) >= ZNR_QUERY_MAX_LEN) {
+		znr_err("Query too long\n");
+		return -EINVAL;
+	}
+	strcpy(q->str, str);
+
+	p = znr_query_token(p, tok, sizeof(tok));
+	while (tok[0] && strcmp(tok, "group") != 0) {
+		if (q->nr_conds >= ZNR_QUERY_MAX_CONDS) {
+			znr_err("Too many query conditions\n");
+			return -EINVAL;
+		}
+		c = &q->conds[q->nr_conds];
+
+		if (znr_query_get_field(tok, &c->field))
+			goto invalid;
+
+		p = znr_query_token(p, tok, sizeof(tok));
+		if (znr_query_get_op(tok, &c->op))
+			goto invalid;
+
+		p = znr_query_token(p, tok, sizeof(tok));
+		if (!isdigit(tok[0]))
+			goto invalid;
+		errno = 0;
+		c->val = strtoull(tok, &end, 0);
+		if (errno || *end)
+			goto invalid;
+
+		q->nr_conds++;
+
+		p = znr_query_token(p, tok, sizeof(tok));
+		if (strcmp(tok, "and") == 0) {
+			p = znr_query_token(p, tok, sizeof(tok));
+			if (!tok[0] || strcmp(tok, "group") == 0)
+				goto invalid;
+		} else if (tok[0] && strcmp(tok, "group") != 0) {
+			goto invalid;
+		}
+	}
+
+	if (tok[0]) {
+		p = znr_query_token(p, tok, sizeof(tok));
+		if (strcmp(tok, "by") != 0)
+			goto invalid;
+		p = znr_query_token(p, tok, sizeof(tok));
+		if (znr_query_get_field(tok, &q->group_by))
+			goto invalid;
+		q->group = true;
+
+		p = znr_query_token(p, tok, sizeof(tok));
+		if (tok[0])
+			goto invalid;
+	}
+
+	return 0;
+
+invalid:
+	znr_err("Invalid query \"%s\" at \"%s\"\n", str, tok);
+	return -EINVAL;
+}
+
+unsigned long long znr_query_field_val(struct znr_extent *ext,
+				       enum znr_query_field field)
+{
+	switch (field) {
+	case ZNR_QUERY_INO:
+		return ext->ino;
+	case ZNR_QUERY_TYPE:
+		return ext->type;
+	case ZNR_QUERY_SECTOR:
+		return ext->sector;
+	case ZNR_QUERY_END:
+		return ext->sector + ext->nr_sectors;
+	case ZNR_QUERY_LEN:
+		return ext->nr_sectors;
+	case ZNR_QUERY_ZONE:
+		if (!znr.dev.zone_sectors)
+			return 0;
+		return ext->sector / znr.dev.zone_sectors;
+	}
+
+	return 0;
+}
+
+static bool znr_query_match(struct znr_query *q, struct znr_extent *ext)
+{
+	struct znr_query_cond *c;
+	unsigned long long val;
+	unsigned int i;
+
+	for (i = 0; i < q->nr_conds; i++) {
+		c = &q->conds[i];
+		val = znr_query_field_val(ext, c->field);
+		switch (c->op) {
+		case ZNR_QUERY_EQ:
+			if (val != c->val)
+				return false;
+			break;
+		case ZNR_QUERY_NE:
+			if (val == c->val)
+				return false;
+			break;
+		case ZNR_QUERY_LT:
+			if (val >= c->val)
+				return false;
+			break;
+		case ZNR_QUERY_LE:
+			if (val > c->val)
+				return false;
+			break;
+		case ZNR_QUERY_GT:
+			if (val <= c->val)
+				return false;
+			break;
+		case ZNR_QUERY_GE:
+			if (val < c->val)
+				return false;
+			break;
+		}
+	}
+
+	return true;
+}
+
+static inline unsigned int znr_query_hash(struct znr_query *q,
+					  unsigned long long key)
+{
+	return (key * 0x9e3779b97f4a7c15ULL) >> 32 & (q->max_groups - 1);
+}
+
+/*
+ * Find the group of @key in the hash table, or the empty entry for it.
+ * Groups in use have at least one extent.
+ */
+static struct znr_query_group *znr_query_lookup(struct znr_query *q,
+						unsigned long long key)
+{
+	unsigned int i = znr_query_hash(q, key);
+
+	while (q->groups[i].nr_extents && q->groups[i].key != key)
+		i = (i + 1) & (q->max_groups - 1);
+
+	return &q->groups[i];
+}
+
+static int znr_query_grow(struct znr_query *q)
+{
+	struct znr_query_group *old = q->groups, *g;
+	unsigned int i, max_groups = q->max_groups;
+
+	if (max_groups >= ZNR_QUERY_MAX_GROUPS) {
+		znr_err("Too many query groups\n");
+		return -E2BIG;
+	}
+
+	q->max_groups = max_groups ? max_groups * 2 : 1024;
+	q->groups = calloc(q->max_groups, sizeof(*g));
+	if (!q->groups) {
+		q->groups = old;
+		q->max_groups = max_groups;
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < max_groups; i++) {
+		if (!old[i].nr_extents)
+			continue;
+		g = znr_query_lookup(q, old[i].key);
+		*g = old[i];
+	}
+
+	free(old);
+
+	return 0;
+}
+
+static int znr_query_aggregate(struct znr_query *q, struct znr_extent *ext)
+{
+	unsigned long long key = znr_query_field_val(ext, q->group_by);
+	unsigned long long end = ext->sector + ext->nr_sectors;
+	struct znr_query_group *g;
+	int ret;
+
+	g = q->max_groups ? znr_query_lookup(q, key) : NULL;
+	if (!g || !g->nr_extents) {
+		/* New group: grow the table to keep it at most half full */
+		if ((q->nr_groups + 1) * 2 > q->max_groups) {
+			ret = znr_query_grow(q);
+			if (ret)
+				return ret;
+			g = znr_query_lookup(q, key);
+		}
+		g->key = key;
+		g->sector = ext->sector;
+		g->end = end;
+		q->nr_groups++;
+	}
+
+	g->nr_extents++;
+	g->nr_sectors += ext->nr_sectors;
+	if (ext->sector < g->sector)
+		g->sector = ext->sector;
+	if (end > g->end)
+		g->end = end;
+
+	return 0;
+}
+
+/*
+ * Extent walk callback evaluating the query @data on a batch of extents:
+ * the extents matching are passed to the query callback, or aggregated.
+ */
+int znr_query_extents(struct znr_extent *extents, unsigned int nr_extents,
+		      void *data)
+{
+	struct znr_query *q = data;
+	unsigned int i, nr = 0;
+	int ret;
+
+	if (!q->group && !q->batch) {
+		q->batch = malloc(ZNR_FS_EXTENTS_BATCH *
+				  sizeof(struct znr_extent));
+		if (!q->batch)
+			return -ENOMEM;
+	}
+
+	for (i = 0; i < nr_extents; i++) {
+		if (!znr_query_match(q, &extents[i]))
+			continue;
+
+		if (q->group) {
+			ret = znr_query_aggregate(q, &extents[i]);
+			if (ret)
+				return ret;
+			continue;
+		}
+
+		memcpy(&q->batch[nr++], &extents[i], sizeof(struct znr_extent));
+		if (nr == ZNR_FS_EXTENTS_BATCH) {
+			ret = q->cb(q->batch, nr, q->data);
+			if (ret)
+				return ret;
+			nr = 0;
+		}
+	}
+
+	if (nr)
+		return q->cb(q->batch, nr, q->data);
+
+	return 0;
+}
+
+static int znr_query_group_cmp(const void *a, const void *b)
+{
+	const struct znr_query_group *ga = a, *gb = b;
+
+	if (ga->key < gb->key)
+		return -1;
+
+	return ga->key > gb->key;
+}
+
+/*
+ * Turn the hash table of the groups into an array sorted by key.
+ */
+void znr_query_finish(struct znr_query *q)
+{
+	unsigned int i, nr = 0;
+
+	for (i = 0; i < q->max_groups; i++) {
+		if (q->groups[i].nr_extents)
+			q->groups[nr++] = q->groups[i];
+	}
+
+	if (nr)
+		qsort(q->groups, nr, sizeof(*q->groups), znr_query_group_cmp);
+
+	q->nr_groups = nr;
+	q->max_groups = 0;
+}
+
+void znr_query_free(struct znr_query *q)
+{
+	free(q->batch);
+	q->batch = NULL;
+	free(q->groups);
+	q->groups = NULL;
+	q->nr_groups = 0;
+	q->max_groups = 0;
+}
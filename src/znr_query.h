@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#ifndef ZNR_QUERY_H
+#define ZNR_QUERY_H
+
+#include "config.h"
+#include "znr_fs.h"
+
+#include <stdbool.h>
+#include <linux/types.h>
+
+/*
+ * Extent queries filter the extents of a sector range and optionally
+ * aggregate them by group. A query is a list of conditions separated by
+ * "and", optionally followed by "group by <field>", e.g.:
+ *
+ *   ino = 131 and len > 8
+ *   sector >= 1048576 and end <= 2097152 group by ino
+ *
+ * Conditions compare a field with a number using one of =, !=, <, <=, > and
+ * >=. Fields are ino (or owner), type (0 for file extents, 1 for zone
+ * extents), sector, end (sector + len), len (number of sectors) and zone
+ * (zone number of the first sector). Without grouping, the extents matching
+ * all conditions are the result. With grouping, the result is, for each
+ * value of the group field, the number of extents matching, their total
+ * length, lowest start sector and highest end sector.
+ */
+#define ZNR_QUERY_MAX_LEN	256
+#define ZNR_QUERY_MAX_CONDS	8
+#define ZNR_QUERY_MAX_GROUPS	(1U << 20)
+
+enum znr_query_field {
+	ZNR_QUERY_INO,
+	ZNR_QUERY_TYPE,
+	ZNR_QUERY_SECTOR,
+	ZNR_QUERY_END,
+	ZNR_QUERY_LEN,
+	ZNR_QUERY_ZONE,
+};
+
+enum znr_query_op {
+	ZNR_QUERY_EQ,
+	ZNR_QUERY_NE,
+	ZNR_QUERY_LT,
+	ZNR_QUERY_LE,
+	ZNR_QUERY_GT,
+	ZNR_QUERY_GE,
+};
+
+struct znr_query_cond {
+	enum znr_query_field	field;
+	enum znr_query_op	op;
+	unsigned long long	val;
+};
+
+/*
+ * Aggregate of a group. All fields are 64-bits, so that the structure needs
+ * no packing and can be converted as an array of __u64.
+ */
+struct znr_query_group {
+	__u64		key;
+	__u64		nr_extents;
+	__u64		nr_sectors;
+	__u64		sector;
+	__u64		end;
+};
+
+struct znr_query {
+	char			str[ZNR_QUERY_MAX_LEN];
+
+	unsigned int		nr_conds;
+	struct znr_query_cond	conds[ZNR_QUERY_MAX_CONDS];
+
+	bool			group;
+	enum znr_query_field	group_by;
+
+	/*
+	 * Without grouping, the extents matching are passed to cb in
+	 * batches of at most ZNR_FS_EXTENTS_BATCH extents.
+	 */
+	znr_fs_extents_cb	cb;
+	void			*data;
+	struct znr_extent	*batch;
+
+	/*
+	 * With grouping, the groups, sorted by key once the query is
+	 * finished. During the query, this is an open addressing hash table
+	 * of max_groups entries.
+	 */
+	struct znr_query_group	*groups;
+	unsigned int		nr_groups;
+	unsigned int		max_groups;
+};
+
+int znr_query_parse(struct znr_query *q, const char *str);
+int znr_query_extents(struct znr_extent *extents, unsigned int nr_extents,
+		      void *data);
+void znr_query_finish(struct znr_query *q);
+void znr_query_free(struct znr_query *q);
+const char *znr_query_field_name(enum znr_query_field field);
+unsigned long long znr_query_field_val(struct znr_extent *ext,
+				       enum znr_query_field field);
+
+#endif /* ZNR_QUERY_H */
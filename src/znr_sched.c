@@ -0,0 +1,282 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "znr.h"
+
+static struct znr_sched {
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+
+	/* Device held and number of requests waiting for it per class */
+	bool			busy;
+	unsigned int		waiting[ZNR_SCHED_NR_CLASSES];
+
+	struct znr_sched_stats	stats[ZNR_SCHED_NR_CLASSES];
+} znrs = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+/*
+ * Request executed by the calling thread.
+ */
+static __thread struct znr_sched_req {
+	enum znr_sched_class	cls;
+	bool			held;
+	bool			cancelled;
+	znr_sched_cancel_cb	cancel_cb;
+	void			*data;
+	unsigned long long	wait_ns;
+} znr_sched_req;
+
+/*
+ * Start executing a request of class @cls. If @cancelled is not NULL, it is
+ * called to check if the request was cancelled while waiting for or using the
+ * device.
+ */
+void znr_sched_begin(enum znr_sched_class cls,
+		     znr_sched_cancel_cb cancelled, void *data)
+{
+	if (cls >= ZNR_SCHED_NR_CLASSES)
+		cls = ZNR_SCHED_BACKGROUND;
+
+	znr_sched_req.cls = cls;
+	znr_sched_req.cancelled = false;
+	znr_sched_req.cancel_cb = cancelled;
+	znr_sched_req.data = data;
+}
+
+void znr_sched_end(void)
+{
+	if (znr_sched_req.held)
+		znr_sched_put();
+
+	znr_sched_req.cls = ZNR_SCHED_INTERACTIVE;
+	znr_sched_req.cancel_cb = NULL;
+	znr_sched_req.data = NULL;
+}
+
+/*
+ * Test if the request executed by the calling thread was cancelled.
+ */
+bool znr_sched_cancelled(void)
+{
+	struct znr_sched_req *r = &znr_sched_req;
+
+	if (!r->cancelled && r->cancel_cb && r->cancel_cb(r->data)) {
+		r->cancelled = true;
+
+		pthread_mutex_lock(&znrs.lock);
+		znrs.stats[r->cls].cancelled++;
+		pthread_mutex_unlock(&znrs.lock);
+
+		znr_verbose("%s request cancelled\n",
+			    znr_sched_class_name(r->cls));
+	}
+
+	return r->cancelled;
+}
+
+/*
+ * Test if a request of a class higher than @cls waits for the device.
+ */
+static bool znr_sched_higher_waiting(enum znr_sched_class cls)
+{
+	unsigned int i;
+
+	for (i = 0; i < cls; i++) {
+		if (znrs.waiting[i])
+			return true;
+	}
+
+	return false;
+}
+
+static void znr_sched_timedwait(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_nsec += ZNR_SCHED_CANCEL_CHECK_MS * 1000000L;
+	if (ts.tv_nsec >= 1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000L;
+	}
+
+	pthread_cond_timedwait(&znrs.cond, &znrs.lock, &ts);
+}
+
+/*
+ * Get the device for the request executed by the calling thread, waiting for
+ * the requests of a higher or the same class getting it first.
+ */
+int znr_sched_get(void)
+{
+	struct znr_sched_req *r = &znr_sched_req;
+	unsigned long long start, wait_ns;
+	struct znr_sched_stats *st;
+	int ret = 0;
+
+	if (r->held)
+		return 0;
+
+	if (znr_sched_cancelled())
+		return -ECANCELED;
+
+	start = znr_stats_now_ns();
+
+	pthread_mutex_lock(&znrs.lock);
+
+	znrs.waiting[r->cls]++;
+	while (znrs.busy || znr_sched_higher_waiting(r->cls)) {
+		if (!r->cancel_cb) {
+			pthread_cond_wait(&znrs.cond, &znrs.lock);
+			continue;
+		}
+
+		znr_sched_timedwait();
+
+		pthread_mutex_unlock(&znrs.lock);
+		if (znr_sched_cancelled())
+			ret = -ECANCELED;
+		pthread_mutex_lock(&znrs.lock);
+		if (ret)
+			break;
+	}
+	znrs.waiting[r->cls]--;
+
+	wait_ns = znr_stats_now_ns() - start;
+	r->wait_ns += wait_ns;
+
+	if (ret) {
+		/* Let another waiting request get the device */
+		pthread_cond_broadcast(&znrs.cond);
+		pthread_mutex_unlock(&znrs.lock);
+		return ret;
+	}
+
+	znrs.busy = true;
+	r->held = true;
+
+	st = &znrs.stats[r->cls];
+	st->count++;
+	st->wait_us += wait_ns / 1000;
+	if (wait_ns / 1000 > st->max_wait_us)
+		st->max_wait_us = wait_ns / 1000;
+
+	pthread_mutex_unlock(&znrs.lock);
+
+	return 0;
+}
+
+void znr_sched_put(void)
+{
+	if (!znr_sched_req.held)
+		return;
+
+	pthread_mutex_lock(&znrs.lock);
+	znrs.busy = false;
+	znr_sched_req.held = false;
+	pthread_cond_broadcast(&znrs.cond);
+	pthread_mutex_unlock(&znrs.lock);
+}
+
+/*
+ * Test if the calling thread holds the device.
+ */
+bool znr_sched_held(void)
+{
+	return znr_sched_req.held;
+}
+
+/*
+ * Preemption point of long device accesses: give the device to higher
+ * priority requests waiting for it. Return -ECANCELED if the request executed
+ * by the calling thread was cancelled.
+ */
+int znr_sched_yield(void)
+{
+	struct znr_sched_req *r = &znr_sched_req;
+	bool preempt;
+
+	if (!r->held)
+		return 0;
+
+	if (znr_sched_cancelled())
+		return -ECANCELED;
+
+	pthread_mutex_lock(&znrs.lock);
+	preempt = znr_sched_higher_waiting(r->cls);
+	if (preempt)
+		znrs.stats[r->cls].preempted++;
+	pthread_mutex_unlock(&znrs.lock);
+
+	if (!preempt)
+		return 0;
+
+	znr_verbose("%s request preempted\n", znr_sched_class_name(r->cls));
+
+	znr_sched_put();
+
+	return znr_sched_get();
+}
+
+/*
+ * Get and reset the time the calling thread spent waiting for the device.
+ */
+unsigned long long znr_sched_get_wait_ns(void)
+{
+	unsigned long long wait_ns = znr_sched_req.wait_ns;
+
+	znr_sched_req.wait_ns = 0;
+
+	return wait_ns;
+}
+
+const char *znr_sched_class_name(unsigned int cls)
+{
+	static const char *names[ZNR_SCHED_NR_CLASSES] = {
+		[ZNR_SCHED_INTERACTIVE]	= "Interactive",
+		[ZNR_SCHED_REFRESH]	= "Refresh",
+		[ZNR_SCHED_BACKGROUND]	= "Background",
+	};
+
+	if (cls >= ZNR_SCHED_NR_CLASSES)
+		return "Unknown";
+
+	return names[cls];
+}
+
+/*
+ * Get the statistics of all classes into @stats, an array of
+ * ZNR_SCHED_NR_CLASSES entries.
+ */
+void znr_sched_get_stats(struct znr_sched_stats *stats)
+{
+	pthread_mutex_lock(&znrs.lock);
+	memcpy(stats, znrs.stats, sizeof(znrs.stats));
+	pthread_mutex_unlock(&znrs.lock);
+}
+
+void znr_sched_print_stats(FILE *f, struct znr_sched_stats *stats)
+{
+	struct znr_sched_stats *st;
+	unsigned int i;
+
+	for (i = 0; i < ZNR_SCHED_NR_CLASSES; i++) {
+		st = &stats[i];
+		fprintf(f, "  %s: %llu device accesses, wait avg %llu us, "
+			"max %llu us, %llu preempted, %llu cancelled\n",
+			znr_sched_class_name(i), st->count,
+			st->count ? st->wait_us / st->count : 0,
+			st->max_wait_us, st->preempted, st->cancelled);
+	}
+}
@@ -0,0 +1,72 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#ifndef ZNR_SCHED_H
+#define ZNR_SCHED_H
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stdbool.h>
+
+/*
+ * Request priority classes, from the highest to the lowest priority:
+ * interactive requests (e.g. a click on a blockgroup), periodic refreshes
+ * and background jobs (e.g. fleet polling and census walks).
+ */
+enum znr_sched_class {
+	ZNR_SCHED_INTERACTIVE,
+	ZNR_SCHED_REFRESH,
+	ZNR_SCHED_BACKGROUND,
+
+	ZNR_SCHED_NR_CLASSES,
+};
+
+/*
+ * Period of the checks for the cancellation of a request waiting for the
+ * device.
+ */
+#define ZNR_SCHED_CANCEL_CHECK_MS	10
+
+/*
+ * Per class statistics. All fields are 64-bits so that they can be
+ * transferred as an array of 64-bits values.
+ */
+struct znr_sched_stats {
+	/* Device accesses and the time spent waiting for the device. */
+	unsigned long long	count;
+	unsigned long long	wait_us;
+	unsigned long long	max_wait_us;
+
+	/* Accesses preempted by higher priority requests. */
+	unsigned long long	preempted;
+
+	/* Requests cancelled by their client. */
+	unsigned long long	cancelled;
+};
+
+typedef bool (*znr_sched_cancel_cb)(void *data);
+
+/*
+ * Device accesses are serialized: the thread holding the device is preempted
+ * at FSMAP batch boundaries if a higher priority request waits for the
+ * device, and the device is given to the highest priority request waiting.
+ */
+void znr_sched_begin(enum znr_sched_class cls,
+		     znr_sched_cancel_cb cancelled, void *data);
+void znr_sched_end(void);
+bool znr_sched_cancelled(void);
+
+int znr_sched_get(void);
+void znr_sched_put(void);
+bool znr_sched_held(void);
+int znr_sched_yield(void);
+
+unsigned long long znr_sched_get_wait_ns(void);
+
+const char *znr_sched_class_name(unsigned int cls);
+void znr_sched_get_stats(struct znr_sched_stats *stats);
+void znr_sched_print_stats(FILE *f, struct znr_sched_stats *stats);
+
+#endif /* ZNR_SCHED_H */
@@ -0,0 +1,178 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/random.h>
+
+#include "znr.h"
+
+static struct znr_session {
+	pthread_mutex_t		lock;
+
+	unsigned long long	id;
+	unsigned long long	gen;
+
+	/* Generation of the last change of each zone */
+	unsigned long long	*zone_gen;
+	unsigned int		nr_zones;
+
+	/* Blockgroups geometry hash and generation of its last change */
+	unsigned long long	bg_hash;
+	unsigned long long	bg_gen;
+} znrss = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/*
+ * FNV-1a hash of the blockgroups geometry.
+ */
+static unsigned long long znr_session_bg_hash(struct znr_bg *bg,
+					      unsigned int nr_blockgroups)
+{
+	unsigned long long hash = 0xcbf29ce484222325ULL;
+	unsigned long long val[2];
+	unsigned int i, j;
+	uint8_t *b;
+
+	for (i = 0; i < nr_blockgroups; i++) {
+		val[0] = bg[i].sector;
+		val[1] = bg[i].nr_sectors;
+		b = (uint8_t *)val;
+		for (j = 0; j < sizeof(val); j++) {
+			hash ^= b[j];
+			hash *= 0x100000001b3ULL;
+		}
+	}
+
+	return hash;
+}
+
+int znr_session_init(void)
+{
+	struct timespec ts;
+	unsigned long long id = 0;
+
+	if (getrandom(&id, sizeof(id), 0) != sizeof(id)) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		id = ((unsigned long long)ts.tv_sec << 32) ^ ts.tv_nsec ^
+			((unsigned long long)getpid() << 16);
+	}
+
+	pthread_mutex_lock(&znrss.lock);
+
+	free(znrss.zone_gen);
+	znrss.zone_gen = NULL;
+	znrss.nr_zones = 0;
+
+	if (znr.dev.is_zoned && znr.nr_zones) {
+		znrss.zone_gen = calloc(znr.nr_zones, sizeof(*znrss.zone_gen));
+		if (!znrss.zone_gen) {
+			pthread_mutex_unlock(&znrss.lock);
+			return -ENOMEM;
+		}
+		znrss.nr_zones = znr.nr_zones;
+	}
+
+	/* Session IDs are never 0, which clients use to start a session. */
+	znrss.id = id ? id : 1;
+	znrss.gen = 1;
+	znrss.bg_hash = znr_session_bg_hash(znr.blockgroups,
+					    znr.nr_blockgroups);
+	znrss.bg_gen = 0;
+
+	pthread_mutex_unlock(&znrss.lock);
+
+	znr_verbose("Session 0x%016llx\n", znrss.id);
+
+	return 0;
+}
+
+void znr_session_destroy(void)
+{
+	pthread_mutex_lock(&znrss.lock);
+	free(znrss.zone_gen);
+	znrss.zone_gen = NULL;
+	znrss.nr_zones = 0;
+	znrss.id = 0;
+	pthread_mutex_unlock(&znrss.lock);
+}
+
+unsigned long long znr_session_id(void)
+{
+	unsigned long long id;
+
+	pthread_mutex_lock(&znrss.lock);
+	id = znrss.id;
+	pthread_mutex_unlock(&znrss.lock);
+
+	return id;
+}
+
+unsigned long long znr_session_gen(void)
+{
+	unsigned long long gen;
+
+	pthread_mutex_lock(&znrss.lock);
+	gen = znrss.gen;
+	pthread_mutex_unlock(&znrss.lock);
+
+	return gen;
+}
+
+/*
+ * A change of the write pointer or condition of zone @zno was detected.
+ */
+void znr_session_zone_changed(unsigned int zno)
+{
+	pthread_mutex_lock(&znrss.lock);
+	if (zno < znrss.nr_zones)
+		znrss.zone_gen[zno] = ++znrss.gen;
+	pthread_mutex_unlock(&znrss.lock);
+}
+
+/*
+ * Check the current blockgroups geometry and return the generation of its last
+ * change.
+ */
+unsigned long long znr_session_update_blockgroups(struct znr_bg *bg,
+						  unsigned int nr_blockgroups)
+{
+	unsigned long long hash = znr_session_bg_hash(bg, nr_blockgroups);
+	unsigned long long bg_gen;
+
+	pthread_mutex_lock(&znrss.lock);
+	if (hash != znrss.bg_hash) {
+		znr_verbose("Blockgroups geometry changed\n");
+		znrss.bg_hash = hash;
+		znrss.bg_gen = ++znrss.gen;
+	}
+	bg_gen = znrss.bg_gen;
+	pthread_mutex_unlock(&znrss.lock);
+
+	return bg_gen;
+}
+
+/*
+ * Get in @znos the numbers of the zones changed after generation @gen. @znos
+ * must have room for all zones of the device. Return the number of zones.
+ */
+unsigned int znr_session_get_changes(unsigned long long gen, __u32 *znos)
+{
+	unsigned int i, nr = 0;
+
+	pthread_mutex_lock(&znrss.lock);
+	for (i = 0; i < znrss.nr_zones; i++) {
+		if (znrss.zone_gen[i] > gen)
+			znos[nr++] = i;
+	}
+	pthread_mutex_unlock(&znrss.lock);
+
+	return nr;
+}
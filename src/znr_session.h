@@ -0,0 +1,33 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#ifndef ZNR_SESSION_H
+#define ZNR_SESSION_H
+
+#include "config.h"
+#include "znr_device.h"
+
+struct znr_bg;
+
+/*
+ * Server state generations, for clients to resume their session after a
+ * reconnection. The server state generation is incremented each time a zone
+ * change is detected, the zone being tagged with the new generation, and each
+ * time the blockgroups geometry changes. A resuming client gets the zones
+ * changed since the generation of its last synchronization. Generations are
+ * only meaningful within a session, identified with a random ID chosen when
+ * the server starts.
+ */
+int znr_session_init(void);
+void znr_session_destroy(void);
+
+unsigned long long znr_session_id(void);
+unsigned long long znr_session_gen(void);
+
+void znr_session_zone_changed(unsigned int zno);
+unsigned long long znr_session_update_blockgroups(struct znr_bg *bg,
+						  unsigned int nr_blockgroups);
+unsigned int znr_session_get_changes(unsigned long long gen, __u32 *znos);
+
+#endif /* ZNR_SESSION_H */
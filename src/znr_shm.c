@@ -0,0 +1,520 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sched.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "znr.h"
+
+/*
+ * Shared memory segment. The server creates, maps (read-write) and updates
+ * the segment. Local clients map it read-only.
+ */
+static struct znr_shm {
+	struct znr_shm_hdr	*hdr;
+	size_t			size;
+
+	/* Layout, as validated by clients when mapping the segment */
+	unsigned int		nr_zones;
+	unsigned int		nr_blockgroups;
+	unsigned long long	zones_offset;
+	unsigned long long	blockgroups_offset;
+
+	/* Server side */
+	int			fd;
+	struct blk_zone		*zones;
+	unsigned long long	interval_ns;
+	unsigned int		nr_users;
+	bool			stop;
+	bool			thread_started;
+	pthread_t		thread;
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;
+} znrs = {
+	.fd = -1,
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+#define ZNR_SHM_ALIGN		64
+#define znr_shm_align(x)	\
+	(((x) + ZNR_SHM_ALIGN - 1) & ~((unsigned long long)ZNR_SHM_ALIGN - 1))
+
+static unsigned long long znr_shm_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static inline void *znr_shm_ptr(unsigned long long offset)
+{
+	return (char *)znrs.hdr + offset;
+}
+
+/*
+ * Sequence lock write side: there is a single writer (the update thread).
+ */
+static void znr_shm_write_begin(struct znr_shm_hdr *hdr)
+{
+	__atomic_store_n(&hdr->seq, hdr->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void znr_shm_write_end(struct znr_shm_hdr *hdr)
+{
+	__atomic_store_n(&hdr->seq, hdr->seq + 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Sequence lock read side: copy a consistent snapshot of part of the segment.
+ */
+static int znr_shm_read(void *buf, unsigned long long offset, size_t size)
+{
+	struct znr_shm_hdr *hdr = znrs.hdr;
+	unsigned int i;
+	__u32 seq;
+
+	for (i = 0; i < ZNR_SHM_MAX_READ_RETRIES; i++) {
+		seq = __atomic_load_n(&hdr->seq, __ATOMIC_ACQUIRE);
+		if (seq & 1) {
+			sched_yield();
+			continue;
+		}
+
+		memcpy(buf, znr_shm_ptr(offset), size);
+
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&hdr->seq, __ATOMIC_RELAXED) == seq)
+			return 0;
+	}
+
+	return -EAGAIN;
+}
+
+static void znr_shm_set_bg(struct znr_shm_bg *sbg, struct znr_bg *bg,
+			   struct blk_zone *zones)
+{
+	struct blk_zone *blkz;
+
+	sbg->sector = bg->sector;
+	sbg->nr_sectors = bg->nr_sectors;
+	sbg->flags = bg->flags;
+	sbg->wp_sector = 0;
+
+	if (!znr.dev.is_zoned || !bg->nr_zones)
+		return;
+
+	/*
+	 * The blockgroup zone pointers reference the server zone array:
+	 * use the same zone index in the updated zones.
+	 */
+	blkz = &zones[bg->zones[0] - znr.blk_zones];
+	sbg->flags = blkz->type;
+	if (blkz->type == BLK_ZONE_TYPE_SEQWRITE_REQ)
+		sbg->wp_sector = blkz->wp - bg->sector;
+}
+
+static void znr_shm_publish(struct blk_zone *zones)
+{
+	struct znr_shm_hdr *hdr = znrs.hdr;
+	struct znr_shm_bg *sbg = znr_shm_ptr(znrs.blockgroups_offset);
+	unsigned int i;
+
+	znr_shm_write_begin(hdr);
+
+	memcpy(znr_shm_ptr(znrs.zones_offset), zones,
+	       znrs.nr_zones * sizeof(struct blk_zone));
+	for (i = 0; i < znrs.nr_blockgroups; i++)
+		znr_shm_set_bg(&sbg[i], &znr.blockgroups[i], zones);
+
+	hdr->generation++;
+	hdr->update_time = znr_shm_now_ns();
+
+	znr_shm_write_end(hdr);
+}
+
+static void znr_shm_update(void)
+{
+	int ret;
+
+	if (!znr.dev.is_zoned || !znrs.nr_zones)
+		return;
+
+	ret = znr_cache_report_zones(0, znrs.nr_zones, znrs.zones);
+	if (ret < 0) {
+		znr_err("Shared memory zone report failed %d (%s)\n",
+			-ret, strerror(-ret));
+		return;
+	}
+
+	znr_shm_publish(znrs.zones);
+}
+
+static void *znr_shm_update_thread(void *arg)
+{
+	struct timespec ts;
+	sigset_t set;
+
+	/* Let the main thread handle signals. */
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	/* Updates are refreshes: let interactive requests go first */
+	znr_sched_begin(ZNR_SCHED_REFRESH, NULL, NULL);
+
+	/* Leave half of the ioctl budget to client requests */
+	znr_budget_set_poller();
+
+	pthread_mutex_lock(&znrs.lock);
+
+	while (!znrs.stop) {
+		/* Do not report zones if no client is using the segment. */
+		if (!znrs.nr_users) {
+			pthread_cond_wait(&znrs.cond, &znrs.lock);
+			continue;
+		}
+
+		pthread_mutex_unlock(&znrs.lock);
+		znr_shm_update();
+		pthread_mutex_lock(&znrs.lock);
+
+		if (znrs.stop)
+			break;
+
+		clock_gettime(CLOCK_REALTIME, &ts);
+		ts.tv_sec += znrs.interval_ns / 1000000000ULL;
+		ts.tv_nsec += znrs.interval_ns % 1000000000ULL;
+		if (ts.tv_nsec >= 1000000000L) {
+			ts.tv_sec++;
+			ts.tv_nsec -= 1000000000L;
+		}
+		pthread_cond_timedwait(&znrs.cond, &znrs.lock, &ts);
+	}
+
+	pthread_mutex_unlock(&znrs.lock);
+
+	znr_sched_end();
+
+	return NULL;
+}
+
+/*
+ * Create the shared memory segment for local clients and start the thread
+ * updating it every interval_ms milliseconds while clients use it.
+ */
+int znr_shm_create(unsigned int interval_ms)
+{
+	unsigned long long zones_size, bgs_size;
+	struct znr_shm_hdr *hdr;
+	unsigned int i;
+	int ret;
+
+	if (interval_ms < ZNR_SHM_MIN_INTERVAL_MS)
+		interval_ms = ZNR_SHM_MIN_INTERVAL_MS;
+
+	znrs.nr_zones = znr.dev.is_zoned ? znr.nr_zones : 0;
+	znrs.nr_blockgroups = znr.nr_blockgroups;
+	zones_size = (unsigned long long)znrs.nr_zones *
+		sizeof(struct blk_zone);
+	bgs_size = (unsigned long long)znrs.nr_blockgroups *
+		sizeof(struct znr_shm_bg);
+	znrs.zones_offset = znr_shm_align(sizeof(struct znr_shm_hdr));
+	znrs.blockgroups_offset = znr_shm_align(znrs.zones_offset + zones_size);
+	znrs.size = znrs.blockgroups_offset + bgs_size;
+	znrs.interval_ns = (unsigned long long)interval_ms * 1000000ULL;
+
+	znrs.zones = calloc(znrs.nr_zones ? znrs.nr_zones : 1,
+			    sizeof(struct blk_zone));
+	if (!znrs.zones)
+		return -ENOMEM;
+
+	znrs.fd = memfd_create("zonar", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (znrs.fd < 0) {
+		ret = -errno;
+		znr_err("memfd_create failed (%s)\n", strerror(errno));
+		goto err;
+	}
+
+	if (ftruncate(znrs.fd, znrs.size) < 0) {
+		ret = -errno;
+		znr_err("ftruncate shared memory failed (%s)\n",
+			strerror(errno));
+		goto err;
+	}
+
+	/* Clients cannot change the segment size. */
+	if (fcntl(znrs.fd, F_ADD_SEALS,
+		  F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) {
+		ret = -errno;
+		znr_err("Seal shared memory failed (%s)\n", strerror(errno));
+		goto err;
+	}
+
+	hdr = mmap(NULL, znrs.size, PROT_READ | PROT_WRITE, MAP_SHARED,
+		   znrs.fd, 0);
+	if (hdr == MAP_FAILED) {
+		ret = -errno;
+		znr_err("mmap shared memory failed (%s)\n", strerror(errno));
+		goto err;
+	}
+	znrs.hdr = hdr;
+
+	hdr->magic = ZNR_SHM_MAGIC;
+	hdr->version = ZNR_SHM_VERSION;
+	hdr->interval_ms = interval_ms;
+	hdr->nr_zones = znrs.nr_zones;
+	hdr->nr_blockgroups = znrs.nr_blockgroups;
+	hdr->zones_offset = znrs.zones_offset;
+	hdr->blockgroups_offset = znrs.blockgroups_offset;
+
+	/* Initial content: the zone information obtained when opening. */
+	for (i = 0; i < znrs.nr_zones; i++)
+		znrs.zones[i] = znr.blk_zones[i];
+	znr_shm_publish(znrs.zones);
+
+	znrs.stop = false;
+	ret = pthread_create(&znrs.thread, NULL, znr_shm_update_thread, NULL);
+	if (ret) {
+		znr_err("Failed to create shared memory thread (%s)\n",
+			strerror(ret));
+		ret = -ret;
+		goto err;
+	}
+	znrs.thread_started = true;
+
+	znr_verbose("Shared memory: %zu B, %u zones, %u blockgroups, "
+		    "updated every %u ms\n",
+		    znrs.size, znrs.nr_zones, znrs.nr_blockgroups,
+		    interval_ms);
+
+	return 0;
+
+err:
+	znr_shm_destroy();
+	return ret;
+}
+
+void znr_shm_destroy(void)
+{
+	if (znrs.thread_started) {
+		pthread_mutex_lock(&znrs.lock);
+		znrs.stop = true;
+		pthread_cond_broadcast(&znrs.cond);
+		pthread_mutex_unlock(&znrs.lock);
+		pthread_join(znrs.thread, NULL);
+		znrs.thread_started = false;
+	}
+
+	if (znrs.hdr) {
+		munmap(znrs.hdr, znrs.size);
+		znrs.hdr = NULL;
+	}
+
+	if (znrs.fd >= 0) {
+		close(znrs.fd);
+		znrs.fd = -1;
+	}
+
+	free(znrs.zones);
+	znrs.zones = NULL;
+}
+
+/*
+ * Get a read-only file descriptor for the segment, to pass to a local client.
+ * The caller must close the file descriptor and call znr_shm_put() when the
+ * client is done.
+ */
+int znr_shm_get(size_t *size)
+{
+	char path[64];
+	int fd;
+
+	pthread_mutex_lock(&znrs.lock);
+
+	if (!znrs.hdr) {
+		pthread_mutex_unlock(&znrs.lock);
+		return -ENODEV;
+	}
+
+	/*
+	 * Reopen the memfd read-only so that clients cannot map the segment
+	 * writable.
+	 */
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", znrs.fd);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		fd = -errno;
+		pthread_mutex_unlock(&znrs.lock);
+		znr_err("Reopen shared memory failed (%s)\n",
+			strerror(-fd));
+		return fd;
+	}
+
+	/* Refresh the segment now for a new first user. */
+	if (!znrs.nr_users++)
+		pthread_cond_signal(&znrs.cond);
+
+	*size = znrs.size;
+
+	pthread_mutex_unlock(&znrs.lock);
+
+	return fd;
+}
+
+void znr_shm_put(void)
+{
+	pthread_mutex_lock(&znrs.lock);
+	if (znrs.nr_users)
+		znrs.nr_users--;
+	pthread_mutex_unlock(&znrs.lock);
+}
+
+/*
+ * Map the segment of a local server.
+ */
+int znr_shm_map(int fd, size_t size)
+{
+	unsigned long long zones_end, bgs_end;
+	struct znr_shm_hdr *hdr;
+
+	if (size < sizeof(struct znr_shm_hdr))
+		return -EINVAL;
+
+	hdr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+	if (hdr == MAP_FAILED) {
+		znr_err("mmap shared memory failed (%s)\n", strerror(errno));
+		return -errno;
+	}
+
+	if (hdr->magic != ZNR_SHM_MAGIC || hdr->version != ZNR_SHM_VERSION) {
+		znr_err("Invalid shared memory segment\n");
+		goto err;
+	}
+
+	/* The layout never changes: check it once. */
+	zones_end = hdr->zones_offset +
+		(unsigned long long)hdr->nr_zones * sizeof(struct blk_zone);
+	bgs_end = hdr->blockgroups_offset +
+		(unsigned long long)hdr->nr_blockgroups *
+		sizeof(struct znr_shm_bg);
+	if (hdr->zones_offset < sizeof(struct znr_shm_hdr) ||
+	    hdr->blockgroups_offset < sizeof(struct znr_shm_hdr) ||
+	    zones_end > size || bgs_end > size) {
+		znr_err("Invalid shared memory segment layout\n");
+		goto err;
+	}
+
+	znrs.hdr = hdr;
+	znrs.size = size;
+	znrs.nr_zones = hdr->nr_zones;
+	znrs.nr_blockgroups = hdr->nr_blockgroups;
+	znrs.zones_offset = hdr->zones_offset;
+	znrs.blockgroups_offset = hdr->blockgroups_offset;
+
+	znr_verbose("Mapped shared memory: %zu B, %u zones, %u blockgroups, "
+		    "updated every %u ms\n",
+		    size, znrs.nr_zones, znrs.nr_blockgroups,
+		    hdr->interval_ms);
+
+	return 0;
+
+err:
+	munmap(hdr, size);
+	return -EINVAL;
+}
+
+void znr_shm_unmap(void)
+{
+	if (!znrs.hdr)
+		return;
+
+	munmap(znrs.hdr, znrs.size);
+	znrs.hdr = NULL;
+	znrs.size = 0;
+}
+
+bool znr_shm_mapped(void)
+{
+	return znrs.hdr != NULL;
+}
+
+/*
+ * Get zone information from the segment. Returns -EAGAIN if the segment is
+ * continuously being updated, in which case the caller should fall back to a
+ * zone report request.
+ */
+int znr_shm_report_zones(unsigned int zno, struct blk_zone *zones,
+			 unsigned int nr_zones)
+{
+	int ret;
+
+	if (zno >= znrs.nr_zones || nr_zones > znrs.nr_zones - zno)
+		return -EINVAL;
+
+	ret = znr_shm_read(zones,
+			   znrs.zones_offset + zno * sizeof(struct blk_zone),
+			   nr_zones * sizeof(struct blk_zone));
+	if (ret)
+		return ret;
+
+	return nr_zones;
+}
+
+/*
+ * Get the blockgroups from the segment. The blockgroups array returned must
+ * be freed by the caller.
+ */
+int znr_shm_get_blockgroups(struct znr_bg **blockgroups,
+			    unsigned int *nr_blockgroups)
+{
+	struct znr_shm_bg *sbg;
+	struct znr_bg *bg;
+	unsigned int i;
+	int ret;
+
+	sbg = calloc(znrs.nr_blockgroups ? znrs.nr_blockgroups : 1,
+		     sizeof(struct znr_shm_bg));
+	bg = calloc(znrs.nr_blockgroups ? znrs.nr_blockgroups : 1,
+		    sizeof(struct znr_bg));
+	if (!sbg || !bg) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	ret = znr_shm_read(sbg, znrs.blockgroups_offset,
+			   znrs.nr_blockgroups * sizeof(struct znr_shm_bg));
+	if (ret)
+		goto err;
+
+	for (i = 0; i < znrs.nr_blockgroups; i++) {
+		bg[i].sector = sbg[i].sector;
+		bg[i].nr_sectors = sbg[i].nr_sectors;
+		bg[i].wp_sector = sbg[i].wp_sector;
+		bg[i].flags = sbg[i].flags;
+	}
+
+	free(sbg);
+
+	*blockgroups = bg;
+	*nr_blockgroups = znrs.nr_blockgroups;
+
+	return znrs.nr_blockgroups;
+
+err:
+	free(sbg);
+	free(bg);
+	return ret;
+}
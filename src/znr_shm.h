@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#ifndef ZNR_SHM_H
+#define ZNR_SHM_H
+
+#include "config.h"
+#include "znr_device.h"
+#include "znr_bg.h"
+
+#define ZNR_SHM_MAGIC				   \
+	(((__u32)'z' << 24) |			   \
+	 ((__u32)'s' << 16) |			   \
+	 ((__u32)'h' << 8) |			   \
+	 ((__u32)'m'))
+
+#define ZNR_SHM_VERSION		1
+
+/*
+ * Default and minimum intervals between updates of the shared memory segment.
+ * Each update reports all zones of the device.
+ */
+#define ZNR_SHM_DEFAULT_INTERVAL_MS	1000
+#define ZNR_SHM_MIN_INTERVAL_MS		250
+
+/*
+ * Maximum number of read attempts of a segment being concurrently updated.
+ */
+#define ZNR_SHM_MAX_READ_RETRIES	1024
+
+/*
+ * Blockgroup information in the shared memory segment.
+ */
+struct znr_shm_bg {
+	__u64		sector;
+	__u64		nr_sectors;
+	__u64		wp_sector;
+	__u32		flags;
+	__u32		reserved;
+};
+
+/*
+ * Shared memory segment header. The zone array (struct blk_zone) and the
+ * blockgroup array (struct znr_shm_bg) follow at the given offsets. All fields
+ * use the server native layout and natural alignment: the segment is only
+ * shared with local clients.
+ *
+ * The segment content is protected with a sequence lock: seq is odd while the
+ * server updates the segment and readers must retry if seq is odd or changed
+ * while they were reading.
+ */
+struct znr_shm_hdr {
+	__u32		magic;
+	__u32		version;
+	__u32		seq;
+	__u32		interval_ms;
+	__u32		nr_zones;
+	__u32		nr_blockgroups;
+	__u64		zones_offset;
+	__u64		blockgroups_offset;
+
+	/* Number of updates and time (CLOCK_MONOTONIC ns) of the last one */
+	__u64		generation;
+	__u64		update_time;
+};
+
+/*
+ * Server side.
+ */
+int znr_shm_create(unsigned int interval_ms);
+void znr_shm_destroy(void);
+int znr_shm_get(size_t *size);
+void znr_shm_put(void);
+
+/*
+ * Client side.
+ */
+int znr_shm_map(int fd, size_t size);
+void znr_shm_unmap(void);
+bool znr_shm_mapped(void);
+int znr_shm_report_zones(unsigned int zno, struct blk_zone *zones,
+			 unsigned int nr_zones);
+int znr_shm_get_blockgroups(struct znr_bg **blockgroups,
+			    unsigned int *nr_blockgroups);
+
+#endif /* ZNR_SHM_H */
@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "znr.h"
+
+const char *znr_stats_srv_phases[ZNR_STATS_NR_PHASES] = {
+	"queue", "dev/fs", "send",
+};
+
+const char *znr_stats_cli_phases[ZNR_STATS_NR_PHASES] = {
+	"send", "wait", "recv",
+};
+
+unsigned long long znr_stats_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int znr_stats_bucket(unsigned long long us)
+{
+	unsigned int b;
+
+	if (!us)
+		return 0;
+
+	b = 64 - __builtin_clzll(us);
+	if (b >= ZNR_STATS_NR_BUCKETS)
+		b = ZNR_STATS_NR_BUCKETS - 1;
+
+	return b;
+}
+
+/*
+ * Account a request execution. phase_ns gives the time spent in each of the
+ * ZNR_STATS_NR_PHASES request phases.
+ */
+void znr_stats_add(struct znr_stats *stats, unsigned int id, bool error,
+		   size_t bytes, unsigned long long *phase_ns)
+{
+	struct znr_stats_req *req;
+	struct znr_stats_hist *hist;
+	unsigned long long us;
+	unsigned int i;
+
+	if (id >= ZNR_STATS_MAX_REQS)
+		return;
+
+	req = &stats->req[id];
+	req->count++;
+	if (error)
+		req->errors++;
+	req->bytes += bytes;
+
+	for (i = 0; i < ZNR_STATS_NR_PHASES; i++) {
+		hist = &req->hist[i];
+		us = phase_ns[i] / 1000;
+		hist->total_us += us;
+		if (us > hist->max_us)
+			hist->max_us = us;
+		hist->buckets[znr_stats_bucket(us)]++;
+	}
+}
+
+void znr_stats_merge(struct znr_stats *dst, struct znr_stats *src)
+{
+	struct znr_stats_hist *dh, *sh;
+	unsigned int i, j, b;
+
+	for (i = 0; i < ZNR_STATS_MAX_REQS; i++) {
+		dst->req[i].count += src->req[i].count;
+		dst->req[i].errors += src->req[i].errors;
+		dst->req[i].bytes += src->req[i].bytes;
+		for (j = 0; j < ZNR_STATS_NR_PHASES; j++) {
+			dh = &dst->req[i].hist[j];
+			sh = &src->req[i].hist[j];
+			dh->total_us += sh->total_us;
+			if (sh->max_us > dh->max_us)
+				dh->max_us = sh->max_us;
+			for (b = 0; b < ZNR_STATS_NR_BUCKETS; b++)
+				dh->buckets[b] += sh->buckets[b];
+		}
+	}
+}
+
+/*
+ * Upper bound in micro-seconds of the bucket containing the given percentile.
+ */
+static unsigned long long znr_stats_percentile(struct znr_stats_hist *hist,
+					       unsigned long long count,
+					       unsigned int pct)
+{
+	unsigned long long n = 0, target;
+	unsigned int b;
+
+	target = (count * pct + 99) / 100;
+	for (b = 0; b < ZNR_STATS_NR_BUCKETS - 1; b++) {
+		n += hist->buckets[b];
+		if (n >= target)
+			break;
+	}
+
+	if (b == ZNR_STATS_NR_BUCKETS - 1)
+		return hist->max_us;
+
+	return 1ULL << b;
+}
+
+static void znr_stats_print_hist(FILE *f, const char *phase,
+				 struct znr_stats_hist *hist,
+				 unsigned long long count)
+{
+	unsigned int b;
+
+	fprintf(f, "    %-7s: avg %llu us, p50 < %llu us, p99 < %llu us, "
+		"max %llu us\n",
+		phase, hist->total_us / count,
+		znr_stats_percentile(hist, count, 50),
+		znr_stats_percentile(hist, count, 99),
+		hist->max_us);
+
+	fprintf(f, "             ");
+	for (b = 0; b < ZNR_STATS_NR_BUCKETS; b++) {
+		if (!hist->buckets[b])
+			continue;
+		if (b == ZNR_STATS_NR_BUCKETS - 1)
+			fprintf(f, " [>=%lluus] %llu", 1ULL << (b - 1),
+				hist->buckets[b]);
+		else
+			fprintf(f, " [<%lluus] %llu", 1ULL << b,
+				hist->buckets[b]);
+	}
+	fprintf(f, "\n");
+}
+
+void znr_stats_print(FILE *f, struct znr_stats *stats, const char **phases)
+{
+	struct znr_stats_req *req;
+	unsigned int i, j;
+
+	for (i = 0; i < ZNR_STATS_MAX_REQS; i++) {
+		req = &stats->req[i];
+		if (!req->count)
+			continue;
+
+		fprintf(f, "  %s: %llu requests, %llu errors, %llu B\n",
+			znr_net_req_name(i), req->count, req->errors,
+			req->bytes);
+		for (j = 0; j < ZNR_STATS_NR_PHASES; j++)
+			znr_stats_print_hist(f, phases[j], &req->hist[j],
+					     req->count);
+	}
+}
@@ -0,0 +1,81 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * SPDX-FileCopyrightText: 2026 Western Digital Corporation or its affiliates.
+ */
+#ifndef ZNR_STATS_H
+#define ZNR_STATS_H
+
+#include "config.h"
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Request statistics are kept for request IDs lower than this.
+ */
+#define ZNR_STATS_MAX_REQS	32
+
+/*
+ * Latency histograms use log2 buckets of micro-seconds: bucket 0 counts
+ * latencies lower than 1 us and bucket i latencies in [2^(i-1), 2^i) us. The
+ * last bucket counts all latencies larger than that.
+ */
+#define ZNR_STATS_NR_BUCKETS	24
+
+/*
+ * Request processing phases. On the server side, the time to process a
+ * request is split into queue time (waiting for a device or file system
+ * operation executed for another client), device / file system time and reply
+ * send time. On the client side, the phases are the request send time, the
+ * time waiting for the reply and the reply data receive time.
+ */
+#define ZNR_STATS_NR_PHASES	3
+
+enum znr_stats_srv_phase {
+	ZNR_STATS_SRV_QUEUE,
+	ZNR_STATS_SRV_DEV,
+	ZNR_STATS_SRV_SEND,
+};
+
+enum znr_stats_cli_phase {
+	ZNR_STATS_CLI_SEND,
+	ZNR_STATS_CLI_WAIT,
+	ZNR_STATS_CLI_RECV,
+};
+
+/*
+ * All fields are 64-bits so that statistics can be transferred as an array
+ * of 64-bits values.
+ */
+struct znr_stats_hist {
+	unsigned long long	total_us;
+	unsigned long long	max_us;
+	unsigned long long	buckets[ZNR_STATS_NR_BUCKETS];
+};
+
+struct znr_stats_req {
+	unsigned long long	count;
+	unsigned long long	errors;
+	unsigned long long	bytes;
+	struct znr_stats_hist	hist[ZNR_STATS_NR_PHASES];
+};
+
+/*
+ * Statistics of a connection. These are updated only by the thread serving
+ * or using the connection.
+ */
+struct znr_stats {
+	struct znr_stats_req	req[ZNR_STATS_MAX_REQS];
+};
+
+extern const char *znr_stats_srv_phases[ZNR_STATS_NR_PHASES];
+extern const char *znr_stats_cli_phases[ZNR_STATS_NR_PHASES];
+
+unsigned long long znr_stats_now_ns(void);
+void znr_stats_add(struct znr_stats *stats, unsigned int id, bool error,
+		   size_t bytes, unsigned long long *phase_ns);
+void znr_stats_merge(struct znr_stats *dst, struct znr_stats *src);
+void znr_stats_print(FILE *f, struct znr_stats *stats, const char **phases);
+
+#endif /* ZNR_STATS_H */
@@ -259,32 +259,36 @@ out:
 	return ret;
 }
 
-static int znr_xfs_get_range_extents(unsigned long long sector,
-				     unsigned long long nr_sectors,
-				     struct znr_extent **extents,
-				     unsigned int *nr_extents)
+/*
+ * Walk the extents in a sector range using FSMAP. The extents found are passed
+ * to @cb in batches of at most ZNR_FS_EXTENTS_BATCH extents, one batch per
+ * FSMAP call, so that the memory used does not depend on the size of the
+ * range.
+ */
+static int znr_xfs_walk_range_extents(unsigned long long sector,
+				      unsigned long long nr_sectors,
+				      znr_fs_extents_cb cb, void *data)
 {
-	struct fsmap_head *head, *new_head;
+	struct fsmap_head *head;
 	struct fsmap *l, *h, *p;
-	unsigned int map_size = 512;
+	unsigned int map_size = ZNR_FS_EXTENTS_BATCH;
 	int ret = 0;
 	off_t bperag, bperrtg, agoff, agno;
 	uint64_t start;
-	unsigned int i, max_extents, nr_ext = 0;
+	unsigned int i, nr_ext = 0, nr_batch;
 	unsigned long long sector_end = sector + nr_sectors;
-	struct znr_extent *ext, *ext_base = NULL;
+	struct znr_extent *ext, *batch = NULL;
 	char *ag_rg;
 
 	bperag = (off_t)fs_geo.agblocks * (off_t)fs_geo.blocksize;
 	bperrtg = bytes_per_rtgroup(&fs_geo);
 
-	head = malloc(fsmap_sizeof(map_size));
+	head = calloc(1, fsmap_sizeof(map_size));
 	if (!head) {
 		fprintf(stderr, "No memory for FSMAP");
 		return -ENOMEM;
 	}
 
-	memset(head, 0, fsmap_sizeof(map_size));
 	l = head->fmh_keys;	/* Start of range */
 	h = head->fmh_keys + 1;	/* End of range */
 
@@ -315,21 +319,15 @@ static int znr_xfs_get_range_extents(unsigned long long sector,
 		goto out;
 	}
 
-	/*
-	 * Allocate our array of extents, up to the maximum we can have in a
-	 * zone (zone size / FS block size).
-	 */
-	max_extents = nr_sectors * 512 / fs_geo.blocksize;
-	ext = calloc(max_extents, sizeof(struct znr_extent));
-	if (!ext) {
+	/* Extents of one FSMAP batch */
+	batch = calloc(map_size, sizeof(struct znr_extent));
+	if (!batch) {
 		fprintf(stderr, "No memory for extents\n");
 		ret = -ENOMEM;
 		goto out;
 	}
-	ext_base = ext;
 
-	/* Get the count first */
-	head->fmh_count = 0;
+	head->fmh_count = map_size;
 
 	while (1) {
 		ret = ioctl(znr.mnt_dir.fd, FS_IOC_GETFSMAP, head);
@@ -339,31 +337,13 @@ static int znr_xfs_get_range_extents(unsigned long long sector,
 			ret = -EIO;
 			goto out;
 		}
-
-		/* If we queried for count and need more space, reallocate */
-		if (!head->fmh_count && head->fmh_entries > map_size) {
-			map_size = head->fmh_entries;
-			new_head = realloc(head, fsmap_sizeof(map_size));
-			if (!new_head) {
-				fprintf(stderr, "No memory for FSMAP");
-				ret = -ENOMEM;
-				goto out;
-			}
-			head = new_head;
-			head->fmh_count = map_size;
-			/* Restart loop to fetch data with new count */
-			continue;
-		}
-
-		/* Set count for first real query if we had enough space */
-		if (!head->fmh_count) {
-			head->fmh_count = map_size;
-			continue;
-		}
+		znr_budget_account_ioctl();
 
 		if (!head->fmh_entries)
 			break;
 
+		ext = batch;
+		nr_batch = 0;
 		for (i = 0; i < head->fmh_entries; i++) {
 			p = &head->fmh_recs[i];
 			/*
@@ -402,14 +382,6 @@ static int znr_xfs_get_range_extents(unsigned long long sector,
 				continue;
 			}
 
-			if (nr_ext >= max_extents) {
-				fprintf(stderr,
-					"Too many extents in range %llu + %llu (max: %u)\n",
-					sector, nr_sectors, max_extents);
-				ret = -EIO;
-				goto out;
-			}
-
 			ext->type = ZNR_FS_ZONE_EXTENT;
 			ext->idx = nr_ext;
 			ext->ino = p->fmr_owner;
@@ -435,28 +407,37 @@ static int znr_xfs_get_range_extents(unsigned long long sector,
 				 BTOBBT(p->fmr_physical + p->fmr_length - 1));
 
 			nr_ext++;
+			nr_batch++;
 			ext++;
 		}
 
+		if (nr_batch) {
+			ret = cb(batch, nr_batch, data);
+			if (ret)
+				goto out;
+		}
+
 		/* Check if we are done */
 		p = &head->fmh_recs[head->fmh_entries - 1];
 		if (p->fmr_flags & FMR_OF_LAST)
 			break;
 
+		/* Let higher priority requests use the device */
+		ret = znr_sched_yield();
+		if (ret)
+			goto out;
+
+		/* Each batch is an ioctl charged to the budget */
+		ret = znr_budget_take_next();
+		if (ret)
+			goto out;
+
 		/* Advance to the next batch */
 		fsmap_advance(head);
 	}
 
 out:
-	if (ret || !nr_ext) {
-		free(ext_base);
-		*extents = NULL;
-		*nr_extents = 0;
-	} else {
-		*extents = ext_base;
-		*nr_extents = nr_ext;
-	}
-
+	free(batch);
 	free(head);
 	return ret;
 }
@@ -521,6 +502,6 @@ static int znr_xfs_get_blockgroups(struct znr_bg **blockgroups,
 const struct znr_fs_ops znr_xfs_ops = {
 	.init_fs		= znr_xfs_init_fs,
 	.get_file_extents	= znr_xfs_get_file_extents,
-	.get_extents_in_range	= znr_xfs_get_range_extents,
+	.walk_extents_in_range	= znr_xfs_walk_range_extents,
 	.get_blockgroups        = znr_xfs_get_blockgroups,
 };
@@ -19,7 +19,9 @@ int main(int argc, char **argv)
 	gboolean verbose = FALSE;
 	gboolean listen = FALSE;
 	gchar *connect_addr = NULL;
+	gchar *unix_path = NULL;
 	gint port = 0;
+	gint host = -1;
 	char *mntdir = NULL;
 	GError *error = NULL;
 	GOptionContext *context;
@@ -48,12 +50,24 @@ int main(int argc, char **argv)
 			"Reverse mode: wait for connection from a server",
 			NULL
 		},
+		{
+			"unix", 'u', 0,
+			G_OPTION_ARG_FILENAME, &unix_path,
+			"Connect to a local server unix socket",
+			NULL
+		},
 		{
 			"port", 'p', 0,
 			G_OPTION_ARG_INT, &port,
 			"Specify the connection port",
 			NULL
 		},
+		{
+			"host", 0, 0,
+			G_OPTION_ARG_INT, &host,
+			"Inspect the host <host> of an aggregator server",
+			NULL
+		},
 		G_OPTION_ENTRY_NULL
 	};
 	int ret = 0;
@@ -76,8 +90,9 @@ int main(int argc, char **argv)
 	znr.verbose = verbose;
 	znr.ipaddr = connect_addr;
 	znr.port = port;
+	znr.unix_path = unix_path;
 
-	if (connect_addr)
+	if (connect_addr || unix_path)
 		znr.connect = true;
 	znr.listen = listen;
 	znr.is_net_client = znr.connect || znr.listen;
@@ -105,6 +120,18 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	if (connect_addr && unix_path) {
+		fprintf(stderr,
+			"--connect and --unix are mutually exclusive\n");
+		return 1;
+	}
+
+	if (unix_path && listen) {
+		fprintf(stderr,
+			"--unix and --listen are mutually exclusive\n");
+		return 1;
+	}
+
 	if (connect_addr && listen) {
 		fprintf(stderr,
 			"--connect and --listen are mutually exclusive\n");
@@ -117,6 +144,12 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	if (host >= 0 && !znr.is_net_client) {
+		fprintf(stderr,
+			"--host requires a connection to a server\n");
+		return 1;
+	}
+
 	if (znr.verbose)
 		znr_verbose("Verbose mode enabled\n");
 
@@ -127,6 +160,30 @@ int main(int argc, char **argv)
 	if (ret)
 		return ret;
 
+	if (znr.is_net_client) {
+		ret = znr_net_hello(&znr.ncli);
+		if (ret) {
+			fprintf(stderr, "Protocol negotiation failed\n");
+			goto out;
+		}
+	}
+
+	/* With an aggregator, all requests go to the selected host. */
+	if (host >= 0) {
+		ret = znr_net_select_host(&znr.ncli, host);
+		if (ret) {
+			fprintf(stderr, "Failed to select host %d\n", host);
+			goto out;
+		}
+	}
+
+	/*
+	 * With a local server, get zone and blockgroup information from the
+	 * server shared memory instead of requests.
+	 */
+	if (znr.unix_path && znr_net_map_shm(&znr.ncli))
+		printf("Shared memory not available, using requests\n");
+
 	ret = znr_open(mntdir);
 	if (ret) {
 		fprintf(stderr, "Failed to open device\n");
@@ -139,6 +196,13 @@ int main(int argc, char **argv)
 
 	znr_close();
 out:
+	if (znr.verbose && znr.is_net_client) {
+		printf("Client requests statistics:\n");
+		znr_stats_print(stdout, &znr.ncli.stats,
+				znr_stats_cli_phases);
+	}
+
+	znr_shm_unmap();
 	znr_net_disconnect(&znr.ncli);
 	if (ret)
 		return 1;
@@ -10,9 +10,27 @@
 #include <string.h>
 #include <errno.h>
 #include <signal.h>
+#include <pthread.h>
 
 #include "znr.h"
 
+#define ZONAR_SRV_BENCH_CLIENTS		4
+#define ZONAR_SRV_BENCH_MAX_CLIENTS	ZNR_NET_MAX_CLIENTS
+
+/*
+ * Load generator connection: the connection sends single zone report
+ * requests, cycling through the zones, until the deadline.
+ */
+struct zonar_srv_bench {
+	pthread_t		thread;
+	unsigned int		idx;
+	unsigned int		nr_clients;
+	unsigned long long	end_ns;
+	struct znr_net_client	ncli;
+	unsigned long long	nr_reqs;
+	int			ret;
+};
+
 static void zonar_srv_sigcatcher(int sig)
 {
 	znr.abort = true;
@@ -22,6 +40,13 @@ static void zonar_srv_sigcatcher(int sig)
 static void zonar_srv_usage(char *cmd)
 {
 	printf("Usage: %s [options] <FS mount directory>\n", cmd);
+	printf("       %s --aggregate [options] <host>[,<host>...]\n", cmd);
+	printf("       %s --fleet [--port <port>] <server>\n", cmd);
+	printf("       %s --stats [--port <port>] <server>\n", cmd);
+	printf("       %s --query <query> [--port <port>] <server>\n", cmd);
+	printf("       %s --bench <seconds> [--clients <n>] "
+	       "[--features <mask>]\n"
+	       "                  [--port <port>] <server>\n", cmd);
 	printf("Options:\n");
 	printf("  --help | -h             : Print this help and exit\n");
 	printf("  --version | -V          : Print version and exit\n");
@@ -30,18 +55,394 @@ static void zonar_srv_usage(char *cmd)
 	printf("  --port | -p <port>      : Specify connection port number\n");
 	printf("                            Default: %d\n",
 	       ZNR_NET_DEFAULT_PORT);
+	printf("  --unix | -u <path>      : Serve local clients on the unix\n");
+	printf("                            socket <path>, sharing zone and\n");
+	printf("                            blockgroup information in shared\n");
+	printf("                            memory\n");
+	printf("  --http <port>           : Serve the web viewer on the\n");
+	printf("                            localhost port <port>\n");
+	printf("  --shm-ms <ms>           : Shared memory update period\n");
+	printf("                            (at least %d ms)\n",
+	       ZNR_SHM_MIN_INTERVAL_MS);
+	printf("                            Default: %d ms\n",
+	       ZNR_SHM_DEFAULT_INTERVAL_MS);
+	printf("  --cache-ms <ms>         : Zone report and extents cache\n");
+	printf("                            freshness window (0 disables)\n");
+	printf("                            Default: %d ms\n",
+	       ZNR_CACHE_DEFAULT_MS);
+	printf("  --low-impact            : Use the idle I/O priority class\n");
+	printf("                            and limit ioctls to --rate\n");
+	printf("  --rate <n>              : Limit zone reports and FSMAP\n");
+	printf("                            walks to <n> per second, serving\n");
+	printf("                            requests over budget from stale\n");
+	printf("                            cached data (0 disables)\n");
+	printf("                            Default: %d with --low-impact\n",
+	       ZNR_BUDGET_DEFAULT_RATE);
+	printf("  --cpus <list>           : Run on the CPUs <list>\n");
+	printf("                            (e.g. 0-3,6)\n");
+	printf("  --stats | -s            : Print the request statistics of\n");
+	printf("                            the server <server> (IP address\n");
+	printf("                            or unix socket path) and exit\n");
+	printf("  --query | -q <query>    : Print the extents of the device\n");
+	printf("                            of the server <server> matching\n");
+	printf("                            <query>, e.g. \"ino = 131 and\n");
+	printf("                            len > 8\" or \"type = 0 group by\n");
+	printf("                            ino\", and exit\n");
+	printf("  --aggregate | -a        : Aggregator mode: poll the servers\n");
+	printf("                            <host> (IP address with an\n");
+	printf("                            optional :port suffix or unix\n");
+	printf("                            socket path) and serve their\n");
+	printf("                            summary and requests to clients\n");
+	printf("  --poll-ms <ms>          : Aggregator host poll period\n");
+	printf("                            Default: %d ms\n",
+	       ZNR_FLEET_DEFAULT_POLL_MS);
+	printf("  --gc-ms <ms>            : Aggregator walk period of the\n");
+	printf("                            host extents counting GC\n");
+	printf("                            candidates (at least %d ms)\n",
+	       ZNR_FLEET_MIN_GC_MS);
+	printf("                            Default: 0 (no walk)\n");
+	printf("  --fleet | -f            : Print the hosts summary of the\n");
+	printf("                            aggregator <server> and exit\n");
+	printf("  --bench | -b <seconds>  : Send zone report requests to the\n");
+	printf("                            server <server> for <seconds>\n");
+	printf("                            and print the request rate\n");
+	printf("  --clients <n>           : Number of --bench connections\n");
+	printf("                            Default: %d\n",
+	       ZONAR_SRV_BENCH_CLIENTS);
+	printf("  --features <mask>       : Protocol features to negotiate\n");
+	printf("                            with peers (hexadecimal mask)\n");
+	printf("                            Default: 0x%x\n", ZNR_NET_FEATURES);
+}
+
+/*
+ * Connect to <server> as a client.
+ */
+static void zonar_srv_set_server(char *server)
+{
+	struct in_addr addr;
+
+	if (inet_pton(AF_INET, server, &addr) == 1)
+		znr.ipaddr = server;
+	else
+		znr.unix_path = server;
+
+	znr.is_net_server = false;
+	znr.is_net_client = true;
+	znr.listen = false;
+	znr.connect = true;
+}
+
+/*
+ * Connect to a running server and print its statistics.
+ */
+static int zonar_srv_print_stats(char *server)
+{
+	struct znr_sched_stats sched_stats[ZNR_SCHED_NR_CLASSES];
+	struct znr_net_stats srv_stats;
+	struct znr_stats *stats;
+	int ret;
+
+	zonar_srv_set_server(server);
+
+	stats = malloc(sizeof(*stats));
+	if (!stats)
+		return 1;
+
+	ret = znr_net_connect(&znr.ncli);
+	if (ret)
+		goto free;
+
+	ret = znr_net_hello(&znr.ncli);
+	if (!ret)
+		ret = znr_net_get_stats(&znr.ncli, &srv_stats, stats,
+					sched_stats);
+	if (!ret)
+		znr_net_print_stats(&srv_stats, stats,
+			znr.ncli.features & ZNR_NET_FEAT_SCHED ?
+			sched_stats : NULL);
+
+	znr_net_disconnect(&znr.ncli);
+
+free:
+	free(stats);
+
+	return ret ? 1 : 0;
+}
+
+static int zonar_srv_print_extents(struct znr_extent *extents,
+				   unsigned int nr_extents, void *data)
+{
+	unsigned long long *nr = data;
+	struct znr_extent *ext;
+	unsigned int i;
+
+	for (i = 0; i < nr_extents; i++) {
+		ext = &extents[i];
+		printf("  Sector %llu + %llu: %s extent, ino %llu\n",
+		       ext->sector, ext->nr_sectors,
+		       ext->type == ZNR_FS_ZONE_EXTENT ? "zone" : "file",
+		       ext->ino);
+	}
+
+	*nr += nr_extents;
+
+	return 0;
+}
+
+/*
+ * Connect to a running server and print the result of a query on the
+ * extents of its whole device.
+ */
+static int zonar_srv_query(char *server, char *query)
+{
+	unsigned long long nr_extents = 0;
+	struct znr_query_group *g;
+	struct znr_query q;
+	unsigned int i;
+	int ret;
+
+	if (znr_query_parse(&q, query))
+		return 1;
+	q.cb = zonar_srv_print_extents;
+	q.data = &nr_extents;
+
+	zonar_srv_set_server(server);
+
+	ret = znr_net_connect(&znr.ncli);
+	if (ret)
+		return 1;
+
+	ret = znr_net_hello(&znr.ncli);
+	if (!ret)
+		ret = znr_net_get_dev_info(&znr.ncli);
+	if (!ret)
+		ret = znr_net_query(&znr.ncli, 0, znr.dev.nr_sectors, &q);
+
+	znr_net_disconnect(&znr.ncli);
+
+	if (ret)
+		goto free;
+
+	if (!q.group) {
+		printf("%llu extents\n", nr_extents);
+		goto free;
+	}
+
+	for (i = 0; i < q.nr_groups; i++) {
+		g = &q.groups[i];
+		printf("  %s %llu: %llu extents, %llu sectors, "
+		       "sectors %llu - %llu\n",
+		       znr_query_field_name(q.group_by), g->key,
+		       g->nr_extents, g->nr_sectors, g->sector, g->end);
+	}
+	printf("%u groups\n", q.nr_groups);
+
+free:
+	znr_query_free(&q);
+
+	return ret ? 1 : 0;
+}
+
+/*
+ * Connect to a running aggregator and print its hosts summary.
+ */
+static int zonar_srv_print_fleet(char *server)
+{
+	struct znr_net_fleet_host *hosts = NULL;
+	unsigned int nr_hosts = 0;
+	int ret;
+
+	zonar_srv_set_server(server);
+
+	ret = znr_net_connect(&znr.ncli);
+	if (ret)
+		return 1;
+
+	ret = znr_net_hello(&znr.ncli);
+	if (!ret)
+		ret = znr_net_get_fleet(&znr.ncli, &hosts, &nr_hosts);
+	if (!ret)
+		znr_fleet_print(stdout, hosts, nr_hosts);
+
+	znr_net_disconnect(&znr.ncli);
+	free(hosts);
+
+	return ret ? 1 : 0;
+}
+
+/*
+ * Aggregator mode: poll the hosts and serve clients.
+ */
+static int zonar_srv_aggregate(char *hosts, unsigned int poll_ms,
+			       unsigned int gc_ms)
+{
+	int ret;
+
+	ret = znr_fleet_init(hosts, ZNR_NET_DEFAULT_PORT, poll_ms, gc_ms);
+	if (ret)
+		return 1;
+
+	znr_net_run_server(&znr.ncli);
+
+	znr_fleet_destroy();
+
+	return 0;
+}
+
+static void *zonar_srv_bench_thread(void *arg)
+{
+	struct zonar_srv_bench *b = arg;
+	struct blk_zone zone;
+	unsigned int zno = b->idx;
+	int ret;
+
+	ret = znr_net_connect(&b->ncli);
+	if (ret)
+		goto out;
+
+	ret = znr_net_hello(&b->ncli);
+	if (ret)
+		goto disconnect;
+
+	while (!znr.abort && znr_stats_now_ns() < b->end_ns) {
+		ret = znr_net_get_dev_rep_zones(&b->ncli, zno, &zone, 1);
+		if (ret < 0)
+			break;
+		ret = 0;
+		b->nr_reqs++;
+		zno = (zno + b->nr_clients) % znr.dev.nr_zones;
+	}
+
+disconnect:
+	znr_net_disconnect(&b->ncli);
+out:
+	b->ret = ret;
+
+	return NULL;
+}
+
+/*
+ * Saturate a running server with zone report requests from multiple
+ * connections and print the request rate and the bytes sent and received per
+ * request.
+ */
+static int zonar_srv_bench(char *server, unsigned int secs,
+			   unsigned int nr_clients)
+{
+	unsigned long long nr_reqs = 0, tx_bytes = 0, rx_bytes = 0;
+	unsigned long long start, elapsed_ns, nr_stale = 0;
+	struct zonar_srv_bench *benchs;
+	struct znr_stats *stats;
+	unsigned int i, features;
+	int ret;
+
+	zonar_srv_set_server(server);
+
+	/* Get the number of zones of the device. */
+	ret = znr_net_connect(&znr.ncli);
+	if (ret)
+		return 1;
+
+	ret = znr_net_hello(&znr.ncli);
+	if (!ret)
+		ret = znr_net_get_dev_info(&znr.ncli);
+	features = znr.ncli.features;
+	znr_net_disconnect(&znr.ncli);
+	if (ret)
+		return 1;
+
+	if (!znr.dev.nr_zones) {
+		fprintf(stderr, "Server device has no zones\n");
+		return 1;
+	}
+
+	benchs = calloc(nr_clients, sizeof(*benchs));
+	stats = calloc(1, sizeof(*stats));
+	if (!benchs || !stats) {
+		ret = -ENOMEM;
+		goto free;
+	}
+
+	printf("Benchmarking server %s: %u connections, %u s, "
+	       "%s requests\n",
+	       server, nr_clients, secs,
+	       features & ZNR_NET_FEAT_VARLEN ?
+	       "variable length" : "fixed size");
+
+	start = znr_stats_now_ns();
+	for (i = 0; i < nr_clients; i++) {
+		benchs[i].idx = i;
+		benchs[i].nr_clients = nr_clients;
+		benchs[i].end_ns = start + secs * 1000000000ULL;
+		ret = pthread_create(&benchs[i].thread, NULL,
+				     zonar_srv_bench_thread, &benchs[i]);
+		if (ret) {
+			fprintf(stderr, "Failed to create thread\n");
+			znr.abort = true;
+			nr_clients = i;
+			ret = -ret;
+			break;
+		}
+	}
+
+	for (i = 0; i < nr_clients; i++) {
+		pthread_join(benchs[i].thread, NULL);
+		if (benchs[i].ret && !ret)
+			ret = benchs[i].ret;
+		nr_reqs += benchs[i].nr_reqs;
+		tx_bytes += benchs[i].ncli.tx_bytes;
+		rx_bytes += benchs[i].ncli.rx_bytes;
+		nr_stale += benchs[i].ncli.nr_stale;
+		znr_stats_merge(stats, &benchs[i].ncli.stats);
+	}
+	elapsed_ns = znr_stats_now_ns() - start;
+
+	if (!nr_reqs)
+		goto free;
+
+	printf("Requests: %llu in %llu.%03llu s, %.0f req/s\n",
+	       nr_reqs, elapsed_ns / 1000000000ULL,
+	       (elapsed_ns / 1000000ULL) % 1000,
+	       (double)nr_reqs * 1000000000.0 / (double)elapsed_ns);
+	printf("Bytes per request: %.1f B sent, %.1f B received\n",
+	       (double)tx_bytes / nr_reqs, (double)rx_bytes / nr_reqs);
+	if (nr_stale)
+		printf("Stale replies: %llu (server over its ioctl budget)\n",
+		       nr_stale);
+	znr_stats_print(stdout, stats, znr_stats_cli_phases);
+
+free:
+	free(stats);
+	free(benchs);
+
+	return ret ? 1 : 0;
 }
 
 int main(int argc, char **argv)
 {
+	struct znr_sched_stats sched_stats[ZNR_SCHED_NR_CLASSES];
 	char *mntdir = NULL;
 	struct sigaction act;
+	unsigned int bench_clients = ZONAR_SRV_BENCH_CLIENTS;
+	unsigned int bench_secs = 0;
+	unsigned int poll_ms = ZNR_FLEET_DEFAULT_POLL_MS;
+	unsigned int gc_ms = 0;
+	bool low_impact = false;
+	char *cpus = NULL;
+	int rate = -1;
+	bool aggregate = false;
+	bool fleet = false;
+	char *query = NULL;
+	bool stats = false;
+	int http_port = 0;
 	int ret, i;
 
 	/* By default: listen for connections. */
 	znr_init();
 	znr.is_net_server = true;
 	znr.listen = true;
+	znr.cache_ms = ZNR_CACHE_DEFAULT_MS;
+	znr.shm_ms = ZNR_SHM_DEFAULT_INTERVAL_MS;
 
 	/* Setup signal handler */
 	act.sa_flags = 0;
@@ -93,6 +494,200 @@ int main(int argc, char **argv)
 			continue;
 		}
 
+		if (strcmp(argv[i], "--stats") == 0 ||
+		    strcmp(argv[i], "-s") == 0) {
+			stats = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--query") == 0 ||
+		    strcmp(argv[i], "-q") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+			query = argv[i];
+			continue;
+		}
+
+		if (strcmp(argv[i], "--aggregate") == 0 ||
+		    strcmp(argv[i], "-a") == 0) {
+			aggregate = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--poll-ms") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+
+			if (atoi(argv[i]) <= 0) {
+				fprintf(stderr, "Invalid poll period\n");
+				return 1;
+			}
+			poll_ms = atoi(argv[i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--gc-ms") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+
+			if (atoi(argv[i]) < 0) {
+				fprintf(stderr, "Invalid GC walk period\n");
+				return 1;
+			}
+			gc_ms = atoi(argv[i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--fleet") == 0 ||
+		    strcmp(argv[i], "-f") == 0) {
+			fleet = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--bench") == 0 ||
+		    strcmp(argv[i], "-b") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+
+			if (atoi(argv[i]) <= 0) {
+				fprintf(stderr, "Invalid benchmark duration\n");
+				return 1;
+			}
+			bench_secs = atoi(argv[i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--clients") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+
+			if (atoi(argv[i]) <= 0 ||
+			    atoi(argv[i]) > ZONAR_SRV_BENCH_MAX_CLIENTS) {
+				fprintf(stderr, "Invalid number of clients\n");
+				return 1;
+			}
+			bench_clients = atoi(argv[i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--features") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+
+			znr.net_features = strtoul(argv[i], NULL, 0) &
+				ZNR_NET_FEATURES;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--unix") == 0 ||
+		    strcmp(argv[i], "-u") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+
+			znr.unix_path = argv[i];
+			continue;
+		}
+
+		if (strcmp(argv[i], "--http") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+
+			if (atoi(argv[i]) <= 0 || atoi(argv[i]) > 65535) {
+				fprintf(stderr, "Invalid HTTP port\n");
+				return 1;
+			}
+			http_port = atoi(argv[i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--shm-ms") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+
+			if (atoi(argv[i]) < ZNR_SHM_MIN_INTERVAL_MS) {
+				fprintf(stderr,
+					"Invalid shared memory update period "
+					"(at least %d ms)\n",
+					ZNR_SHM_MIN_INTERVAL_MS);
+				return 1;
+			}
+			znr.shm_ms = atoi(argv[i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--cache-ms") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+
+			if (atoi(argv[i]) < 0) {
+				fprintf(stderr, "Invalid cache freshness\n");
+				return 1;
+			}
+			znr.cache_ms = atoi(argv[i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--low-impact") == 0) {
+			low_impact = true;
+			continue;
+		}
+
+		if (strcmp(argv[i], "--rate") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+
+			if (atoi(argv[i]) < 0) {
+				fprintf(stderr, "Invalid ioctl rate\n");
+				return 1;
+			}
+			rate = atoi(argv[i]);
+			continue;
+		}
+
+		if (strcmp(argv[i], "--cpus") == 0) {
+			i++;
+			if (i >= argc - 1) {
+				fprintf(stderr, "Invalid command line\n");
+				return 1;
+			}
+
+			cpus = argv[i];
+			continue;
+		}
+
 		if (strcmp(argv[i], "--connect") == 0 ||
 		    strcmp(argv[i], "-c") == 0) {
 			i++;
@@ -120,21 +715,147 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	if (stats + fleet + aggregate + (bench_secs > 0) +
+	    (query != NULL) > 1) {
+		fprintf(stderr, "--stats, --fleet, --bench, --query and "
+			"--aggregate are mutually exclusive\n");
+		return 1;
+	}
+
+	if (fleet) {
+		if (znr.connect || znr.unix_path) {
+			fprintf(stderr,
+				"--fleet cannot be used with --connect "
+				"and --unix\n");
+			return 1;
+		}
+
+		return zonar_srv_print_fleet(argv[i]);
+	}
+
+	if (stats) {
+		if (znr.connect || znr.unix_path) {
+			fprintf(stderr,
+				"--stats cannot be used with --connect "
+				"and --unix\n");
+			return 1;
+		}
+
+		return zonar_srv_print_stats(argv[i]);
+	}
+
+	if (query) {
+		if (znr.connect || znr.unix_path) {
+			fprintf(stderr,
+				"--query cannot be used with --connect "
+				"and --unix\n");
+			return 1;
+		}
+
+		return zonar_srv_query(argv[i], query);
+	}
+
+	if (bench_secs) {
+		if (znr.connect || znr.unix_path) {
+			fprintf(stderr,
+				"--bench cannot be used with --connect "
+				"and --unix\n");
+			return 1;
+		}
+
+		return zonar_srv_bench(argv[i], bench_secs, bench_clients);
+	}
+
+	if (znr.connect && znr.unix_path) {
+		fprintf(stderr,
+			"--connect and --unix are mutually exclusive\n");
+		return 1;
+	}
+
+	if (cpus && znr_budget_set_cpus(cpus))
+		return 1;
+
+	if (http_port && (aggregate || znr.connect)) {
+		fprintf(stderr,
+			"--http cannot be used with --aggregate and --connect\n");
+		return 1;
+	}
+
+	if (aggregate)
+		return zonar_srv_aggregate(argv[i], poll_ms, gc_ms);
+
 	mntdir = argv[i];
 
 	if (znr.verbose)
 		printf("Verbose mode enabled\n");
 
+	/*
+	 * Set the I/O priority before opening the device so that all device
+	 * accesses, including the initial zone report, use it.
+	 */
+	if (low_impact && znr_budget_set_idle_ioprio())
+		return 1;
+	if (rate < 0)
+		rate = low_impact ? ZNR_BUDGET_DEFAULT_RATE : 0;
+	znr_budget_init(rate);
+
 	ret = znr_open(mntdir);
 	if (ret)
 		return 1;
 
 	znr_print_info();
+	ret = znr_cache_init(znr.cache_ms);
+	if (ret) {
+		fprintf(stderr, "Failed to initialize cache\n");
+		goto out;
+	}
+
+	ret = znr_session_init();
+	if (ret) {
+		fprintf(stderr, "Failed to initialize session\n");
+		goto out;
+	}
+
+	/*
+	 * Local clients get zone and blockgroup information from shared
+	 * memory, refreshed every --shm-ms while clients use it.
+	 */
+	if (znr.unix_path) {
+		ret = znr_shm_create(znr.shm_ms);
+		if (ret) {
+			fprintf(stderr, "Failed to create shared memory\n");
+			goto out;
+		}
+	}
+
+	/*
+	 * The web viewer blockgroups state is refreshed with the cache
+	 * freshness window period.
+	 */
+	if (http_port) {
+		ret = znr_http_start(http_port, znr.cache_ms);
+		if (ret) {
+			fprintf(stderr, "Failed to start the web viewer\n");
+			znr_shm_destroy();
+			goto out;
+		}
+	}
 
 	/* Run as a server (no GUI). */
 	znr_net_run_server(&znr.ncli);
 
+	if (http_port)
+		znr_http_stop();
+	znr_shm_destroy();
+out:
+	znr_cache_print_stats();
+	znr_budget_print_stats();
+	znr_sched_get_stats(sched_stats);
+	printf("Scheduler:\n");
+	znr_sched_print_stats(stdout, sched_stats);
+	znr_session_destroy();
+	znr_cache_destroy();
 	znr_close();
 
-	return 0;
+	return ret ? 1 : 0;
 }